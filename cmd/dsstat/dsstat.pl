@@ -0,0 +1,244 @@
+#!/usr/bin/perl
+#
+# Print out per-dataset ZFS I/O statistics exported via kstat(1), one
+# line per mounted filesystem, busiest first.  For a definition of
+# fields, use dsstat.pl -v
+#
+# CDDL HEADER START
+#
+# The contents of this file are subject to the terms of the
+# Common Development and Distribution License, Version 1.0 only
+# (the "License").  You may not use this file except in compliance
+# with the License.
+#
+# You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+# or http://www.opensolaris.org/os/licensing.
+# See the License for the specific language governing permissions
+# and limitations under the License.
+#
+# When distributing Covered Code, include this CDDL HEADER in each
+# file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+# If applicable, add the following below this CDDL HEADER, with the
+# fields enclosed by brackets "[]" replaced with your own identifying
+# information: Portions Copyright [yyyy] [name of copyright owner]
+#
+# CDDL HEADER END
+#
+#
+# Each dataset exports an objset-0x<id> kstat holding its counters and
+# latency histograms.  Every interval we take the difference between two
+# snapshots of those kstats, fill the "v" hash of each dataset with its
+# per-second rates and average latencies using calculate(), and print
+# the datasets sorted by the number of operations they served.
+
+use strict;
+use POSIX qw(strftime);
+use Getopt::Long;
+use IO::Handle;
+
+my %cols = (# HDR => [Size, Description]
+	"read"	=>[6, "Reads per second"],
+	"rbyte"	=>[6, "Bytes read per second"],
+	"rlat"	=>[6, "Average read latency"],
+	"write"	=>[6, "Writes per second"],
+	"wbyte"	=>[6, "Bytes written per second"],
+	"wlat"	=>[6, "Average write latency"],
+	"sync"	=>[6, "ZIL commits per second"],
+	"slat"	=>[6, "Average ZIL commit latency"],
+);
+my @hdr = qw(read rbyte rlat write wbyte wlat sync slat);
+my $int = 1;		# Print stats every 1 second by default
+my $count = 0;		# Print stats forever
+my $top = 0;		# Print every dataset by default
+my $pool = "";		# Print datasets of every pool by default
+my $sep = "  ";		# Default separator is 2 spaces
+my $rflag = 0;		# Do not display raw numbers by default
+my $cmd = "Usage: dsstat.pl [-hrv] [-p pool] [-n count] [interval [count]]\n";
+my %prev;
+my %cur;
+
+STDOUT->autoflush;
+
+# Read every objset kstat into %cur, keyed by objset kstat.
+sub kstat_update {
+	my @k = `/usr/sbin/sysctl kstat.zfs`;
+	if (!@k) { exit 1 };
+
+	%prev = %cur;
+	undef %cur;
+
+	foreach my $k (@k) {
+		chomp $k;
+		next unless $k =~ /^(.*\.objset-0x[0-9a-f]+)\.(\w+):\s*(.*)$/;
+		$cur{$1}->{$2} = $3;
+	}
+}
+
+sub detailed_usage {
+	print STDERR "$cmd";
+	print STDERR "Field definitions are as follows\n";
+	foreach my $hdr (@hdr) {
+		print STDERR sprintf("%6s : %s\n", $hdr, $cols{$hdr}[1]);
+	}
+	print STDERR "\nNote: K=10^3 M=10^6 G=10^9 and so on\n";
+	exit(1);
+}
+
+sub usage {
+	print STDERR "$cmd";
+	print STDERR "\t -p : Only print the datasets of this pool\n";
+	print STDERR "\t -n : Only print the busiest count datasets\n";
+	print STDERR "\t -r : Raw output\n";
+	print STDERR "\t -v : Describe the fields\n\nExamples:\n";
+	print STDERR "\tdsstat.pl 5\n";
+	print STDERR "\tdsstat.pl -p tank -n 10 1\n";
+	exit(1);
+}
+
+sub init {
+	my $hflag = '';
+	my $vflag;
+	my $res = GetOptions('p=s' => \$pool,
+		'n=i' => \$top,
+		'help|h|?' => \$hflag,
+		'v' => \$vflag,
+		'r' => \$rflag);
+	$int = $ARGV[0] || $int;
+	$count = $ARGV[1] || $count;
+	usage() if !$res or $hflag;
+	detailed_usage() if $vflag;
+}
+
+# Pretty print num. Arguments are width and num
+sub prettynum {
+	my @suffix=(' ','K', 'M', 'G', 'T', 'P', 'E', 'Z');
+	my $num = $_[1] || 0;
+	my $sz = $_[0];
+	my $index = 0;
+	return sprintf("%*d", $sz, $num) if ($rflag);
+	while ($num >= 10000 and $index < 8) {
+		$num = $num/1000;
+		$index++;
+	}
+	if ($index == 0) {
+		return sprintf("%*d", $sz, $num);
+	} else {
+		return sprintf("%*d%s", $sz - 1, $num, $suffix[$index]);
+	}
+}
+
+# Pretty print a latency in nanoseconds. Arguments are width and num
+sub prettytime {
+	my @suffix=('ns', 'us', 'ms', 's');
+	my $num = $_[1] || 0;
+	my $sz = $_[0];
+	my $index = 0;
+	return sprintf("%*d", $sz, $num) if ($rflag);
+	while ($num >= 1000 and $index < 3) {
+		$num = $num/1000;
+		$index++;
+	}
+	return sprintf("%*d%s", $sz - length($suffix[$index]), $num,
+	    $suffix[$index]);
+}
+
+# Average latency of the named histogram over the interval, using the
+# midpoint of each power-of-two bucket.
+sub histo_average {
+	my ($ks, $prevks, $type) = @_;
+	my ($n, $total) = (0, 0);
+
+	foreach my $key (keys %$ks) {
+		next unless $key =~ /^${type}_lat_(\d+)ns$/;
+		my $c = $ks->{$key} - ($prevks->{$key} || 0);
+		$n += $c;
+		$total += $c * $1 * 1.5;
+	}
+
+	return ($n ? $total / $n : 0);
+}
+
+sub calculate {
+	my ($ks, $prevks) = @_;
+	my %v = ();
+	my %d = ();
+
+	foreach my $key (qw(reads nread writes nwritten syncs)) {
+		$d{$key} = ($ks->{$key} - ($prevks->{$key} || 0)) / $int;
+	}
+
+	$v{"read"} = $d{"reads"};
+	$v{"rbyte"} = $d{"nread"};
+	$v{"rlat"} = histo_average($ks, $prevks, "read");
+	$v{"write"} = $d{"writes"};
+	$v{"wbyte"} = $d{"nwritten"};
+	$v{"wlat"} = histo_average($ks, $prevks, "write");
+	$v{"sync"} = $d{"syncs"};
+	$v{"slat"} = histo_average($ks, $prevks, "sync");
+	$v{"ops"} = $d{"reads"} + $d{"writes"} + $d{"syncs"};
+
+	return \%v;
+}
+
+sub print_header {
+	my $width = shift;
+
+	printf("%s %-*s", strftime("%H:%M:%S", localtime), $width, "dataset");
+	foreach my $col (@hdr) {
+		printf("%s%*s", $sep, $cols{$col}[0], $col);
+	}
+	printf("\n");
+}
+
+sub print_values {
+	my ($width, $name, $v) = @_;
+
+	printf("%8s %-*s", "", $width, $name);
+	foreach my $col (@hdr) {
+		if ($col =~ /lat$/) {
+			printf("%s%s", $sep, prettytime($cols{$col}[0], $v->{$col}));
+		} else {
+			printf("%s%s", $sep, prettynum($cols{$col}[0], $v->{$col}));
+		}
+	}
+	printf("\n");
+}
+
+sub main {
+	my $count_flag = 0;
+
+	init();
+	if ($count > 0) { $count_flag = 1; }
+	kstat_update();
+	while (1) {
+		my @rows = ();
+		my $width = length("dataset");
+
+		foreach my $id (keys %cur) {
+			my $name = $cur{$id}->{"dataset_name"};
+			next if ($pool ne "" and $name !~ /^\Q$pool\E(\/|$)/);
+			# Restart from zero if the dataset was remounted.
+			my $prevks = $prev{$id};
+			$prevks = {} if (defined $prevks and
+			    $prevks->{"dataset_name"} ne $name);
+			push(@rows, [$name, calculate($cur{$id}, $prevks)]);
+		}
+		@rows = sort { $b->[1]{"ops"} <=> $a->[1]{"ops"} or
+		    $a->[0] cmp $b->[0] } @rows;
+		splice(@rows, $top) if ($top > 0 and @rows > $top);
+		foreach my $row (@rows) {
+			$width = length($row->[0]) if length($row->[0]) > $width;
+		}
+
+		print_header($width);
+		foreach my $row (@rows) {
+			print_values($width, $row->[0], $row->[1]);
+		}
+		last if ($count_flag == 1 && $count-- <= 1);
+		printf("\n");
+		sleep($int);
+		kstat_update();
+	}
+}
+
+&main;
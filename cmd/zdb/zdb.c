@@ -47,6 +47,7 @@
 #include <sys/dmu_objset.h>
 #include <sys/dsl_dir.h>
 #include <sys/dsl_dataset.h>
+#include <sys/dsl_livelist.h>
 #include <sys/dsl_pool.h>
 #include <sys/dbuf.h>
 #include <sys/zil.h>
@@ -106,6 +107,7 @@ uint64_t *zopt_object = NULL;
 static unsigned zopt_objects = 0;
 libzfs_handle_t *g_zfs;
 uint64_t max_inflight = 1000;
+static int traverse_threads = 1;
 static int leaked_objects = 0;
 
 static void snprintf_blkptr_compact(char *, size_t, const blkptr_t *);
@@ -130,9 +132,10 @@ static void
 usage(void)
 {
 	(void) fprintf(stderr,
-	    "Usage:\t%s [-AbcdDFGhikLMPsvX] [-e [-V] [-p <path> ...]] "
+	    "Usage:\t%s [-AbcdDFGhikLMPsvXy] [-e [-V] [-p <path> ...]] "
 	    "[-I <inflight I/Os>]\n"
-	    "\t\t[-o <var>=<value>]... [-t <txg>] [-U <cache>] [-x <dumpdir>]\n"
+	    "\t\t[-o <var>=<value>]... [-t <txg>] [-T <threads>] [-U <cache>]\n"
+	    "\t\t[-x <dumpdir>]\n"
 	    "\t\t[<poolname> [<object> ...]]\n"
 	    "\t%s [-AdiPv] [-e [-V] [-p <path> ...]] [-U <cache>] <dataset> "
 	    "[<object> ...]\n"
@@ -178,6 +181,7 @@ usage(void)
 	    "device\n");
 	(void) fprintf(stderr, "        -s report stats on zdb's I/O\n");
 	(void) fprintf(stderr, "        -S simulate dedup to measure effect\n");
+	(void) fprintf(stderr, "        -y verify clone livelists\n");
 	(void) fprintf(stderr, "        -v verbose (applies to all "
 	    "others)\n\n");
 	(void) fprintf(stderr, "    Below options are intended for use "
@@ -196,6 +200,8 @@ usage(void)
 	(void) fprintf(stderr, "        -I <number of inflight I/Os> -- "
 	    "specify the maximum number of checksumming I/Os "
 	    "[default is 200]\n");
+	(void) fprintf(stderr, "        -T <threads> -- number of threads "
+	    "traversing blocks for -b and -c [default is 1]\n");
 	(void) fprintf(stderr, "        -G dump zfs_dbgmsg buffer before "
 	    "exiting\n");
 	(void) fprintf(stderr, "        -F attempt automatic rewind within "
@@ -3076,6 +3082,7 @@ typedef struct zdb_cb {
 	    [BPE_PAYLOAD_SIZE];
 	uint64_t	zcb_start;
 	hrtime_t	zcb_lastprint;
+	kmutex_t	zcb_lock;	/* traversal may be parallel */
 	uint64_t	zcb_totalasize;
 	uint64_t	zcb_errors[256];
 	int		zcb_readfails;
@@ -3283,8 +3290,10 @@ zdb_blkptr_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
 
 	type = BP_GET_TYPE(bp);
 
+	mutex_enter(&zcb->zcb_lock);
 	zdb_count_block(zcb, zilog, bp,
 	    (type & DMU_OT_NEWTYPE) ? ZDB_OT_OTHER : type);
+	mutex_exit(&zcb->zcb_lock);
 
 	is_metadata = (BP_GET_LEVEL(bp) != 0 || DMU_OT_IS_METADATA(type));
 
@@ -3312,31 +3321,38 @@ zdb_blkptr_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
 
 	/* only call gethrtime() every 100 blocks */
 	static int iters;
-	if (++iters > 100)
+	mutex_enter(&zcb->zcb_lock);
+	if (++iters > 100) {
 		iters = 0;
-	else
+	} else {
+		mutex_exit(&zcb->zcb_lock);
 		return (0);
+	}
 
 	if (dump_opt['b'] < 5 && gethrtime() > zcb->zcb_lastprint + NANOSEC) {
 		uint64_t now = gethrtime();
 		char buf[10];
 		uint64_t bytes = zcb->zcb_type[ZB_TOTAL][ZDB_OT_TOTAL].zb_asize;
+		uint64_t blocks = zcb->zcb_type[ZB_TOTAL][ZDB_OT_TOTAL].zb_count;
 		int kb_per_sec =
 		    1 + bytes / (1 + ((now - zcb->zcb_start) / 1000 / 1000));
+		uint64_t blocks_per_sec =
+		    blocks * MILLISEC / (1 + (now - zcb->zcb_start) / MICROSEC);
 		int sec_remaining =
 		    (zcb->zcb_totalasize - bytes) / 1024 / kb_per_sec;
 
 		zfs_nicenum(bytes, buf, sizeof (buf));
 		(void) fprintf(stderr,
-		    "\r%5s completed (%4dMB/s) "
+		    "\r%5s completed (%4dMB/s, %6llu blocks/s) "
 		    "estimated time remaining: %uhr %02umin %02usec        ",
-		    buf, kb_per_sec / 1024,
+		    buf, kb_per_sec / 1024, (u_longlong_t)blocks_per_sec,
 		    sec_remaining / 60 / 60,
 		    sec_remaining / 60 % 60,
 		    sec_remaining % 60);
 
 		zcb->zcb_lastprint = now;
 	}
+	mutex_exit(&zcb->zcb_lock);
 
 	return (0);
 }
@@ -4029,14 +4045,19 @@ dump_block_stats(spa_t *spa)
 		    &zcb, NULL));
 	}
 
+	/* Blocks of destroyed clones still waiting to be freed. */
+	(void) dsl_livelist_iterate_deleted(spa, count_block_cb, &zcb);
+
 	if (dump_opt['c'] > 1)
 		flags |= TRAVERSE_PREFETCH_DATA;
 
 	zcb.zcb_totalasize = metaslab_class_get_alloc(spa_normal_class(spa));
 	zcb.zcb_totalasize += metaslab_class_get_alloc(spa_special_class(spa));
 	zcb.zcb_totalasize += metaslab_class_get_alloc(spa_dedup_class(spa));
+	mutex_init(&zcb.zcb_lock, NULL, MUTEX_DEFAULT, NULL);
 	zcb.zcb_start = zcb.zcb_lastprint = gethrtime();
-	zcb.zcb_haderrors |= traverse_pool(spa, 0, flags, zdb_blkptr_cb, &zcb);
+	zcb.zcb_haderrors |= traverse_pool_parallel(spa, 0, flags,
+	    zdb_blkptr_cb, &zcb, traverse_threads);
 
 	/*
 	 * If we've traversed the data blocks then we need to wait for those
@@ -4051,6 +4072,19 @@ dump_block_stats(spa_t *spa)
 			    ZIO_FLAG_GODFATHER);
 		}
 	}
+	mutex_destroy(&zcb.zcb_lock);
+
+	if (dump_opt['b'] < 5) {
+		hrtime_t elapsed = gethrtime() - zcb.zcb_start;
+		uint64_t blocks = zcb.zcb_type[ZB_TOTAL][ZDB_OT_TOTAL].zb_count;
+
+		(void) printf("\n\tTraversed %llu blocks in %llu seconds "
+		    "with %d thread%s (%llu blocks/s)\n",
+		    (u_longlong_t)blocks, (u_longlong_t)(elapsed / NANOSEC),
+		    traverse_threads, traverse_threads == 1 ? "" : "s",
+		    (u_longlong_t)(blocks * MILLISEC /
+		    (1 + elapsed / MICROSEC)));
+	}
 
 	if (zcb.zcb_haderrors) {
 		(void) printf("\nError counts:\n\n");
@@ -4498,6 +4532,180 @@ verify_device_removal_feature_counts(spa_t *spa)
 	return (ret);
 }
 
+typedef struct livelist_verify_entry {
+	avl_node_t	lve_node;
+	dva_t		lve_dva;
+	uint64_t	lve_birth;
+	int64_t		lve_count;
+} livelist_verify_entry_t;
+
+typedef struct livelist_verify {
+	avl_tree_t	lv_tree;
+	uint64_t	lv_clones;
+	int		lv_errors;
+} livelist_verify_t;
+
+static int
+livelist_verify_compare(const void *arg1, const void *arg2)
+{
+	const livelist_verify_entry_t *l = arg1;
+	const livelist_verify_entry_t *r = arg2;
+	int cmp;
+
+	cmp = AVL_CMP(DVA_GET_VDEV(&l->lve_dva), DVA_GET_VDEV(&r->lve_dva));
+	if (cmp != 0)
+		return (cmp);
+	cmp = AVL_CMP(DVA_GET_OFFSET(&l->lve_dva),
+	    DVA_GET_OFFSET(&r->lve_dva));
+	if (cmp != 0)
+		return (cmp);
+	return (AVL_CMP(l->lve_birth, r->lve_birth));
+}
+
+static void
+livelist_verify_count(livelist_verify_t *lv, const blkptr_t *bp, int delta)
+{
+	livelist_verify_entry_t search, *lve;
+	avl_index_t where;
+
+	search.lve_dva = bp->blk_dva[0];
+	search.lve_birth = bp->blk_birth;
+	lve = avl_find(&lv->lv_tree, &search, &where);
+	if (lve == NULL) {
+		lve = umem_zalloc(sizeof (*lve), UMEM_NOFAIL);
+		lve->lve_dva = bp->blk_dva[0];
+		lve->lve_birth = bp->blk_birth;
+		avl_insert(&lv->lv_tree, lve, where);
+	}
+	lve->lve_count += delta;
+}
+
+/* ARGSUSED */
+static int
+livelist_verify_entry_cb(void *arg, const blkptr_t *bp, dmu_tx_t *tx)
+{
+	livelist_verify_count(arg, bp, 1);
+	return (0);
+}
+
+/* ARGSUSED */
+static int
+livelist_verify_traverse_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
+    const zbookmark_phys_t *zb, const dnode_phys_t *dnp, void *arg)
+{
+	if (bp == NULL || BP_IS_HOLE(bp) || BP_IS_EMBEDDED(bp) ||
+	    zb->zb_level == ZB_ZIL_LEVEL)
+		return (0);
+	livelist_verify_count(arg, bp, -1);
+	return (0);
+}
+
+/*
+ * Check that the livelist of a clone holds exactly the blocks the clone
+ * has written since it was created.
+ */
+/* ARGSUSED */
+static int
+verify_one_livelist(const char *dsname, void *arg)
+{
+	livelist_verify_t *lv = arg;
+	livelist_verify_entry_t *lve;
+	dsl_dataset_t *ds;
+	dsl_dir_t *dd;
+	dsl_pool_t *dp;
+	void *cookie = NULL;
+	int err;
+
+	err = dsl_pool_hold(dsname, FTAG, &dp);
+	if (err != 0)
+		return (0);
+	err = dsl_dataset_hold(dp, dsname, FTAG, &ds);
+	if (err != 0) {
+		dsl_pool_rele(dp, FTAG);
+		return (0);
+	}
+	dd = ds->ds_dir;
+	if (!dsl_livelist_exists(dd)) {
+		dsl_dataset_rele(ds, FTAG);
+		dsl_pool_rele(dp, FTAG);
+		return (0);
+	}
+	lv->lv_clones++;
+
+	avl_create(&lv->lv_tree, livelist_verify_compare,
+	    sizeof (livelist_verify_entry_t),
+	    offsetof(livelist_verify_entry_t, lve_node));
+
+	err = dsl_livelist_iterate(&dd->dd_livelist, &dd->dd_livelist_free,
+	    livelist_verify_entry_cb, lv);
+	if (err == 0) {
+		err = traverse_dataset(ds,
+		    dsl_dataset_phys(ds)->ds_prev_snap_txg,
+		    TRAVERSE_PRE | TRAVERSE_NO_DECRYPT,
+		    livelist_verify_traverse_cb, lv);
+	}
+	if (err != 0) {
+		(void) printf("Error %d verifying the livelist of %s\n",
+		    err, dsname);
+		lv->lv_errors++;
+	}
+
+	while ((lve = avl_destroy_nodes(&lv->lv_tree, &cookie)) != NULL) {
+		if (err == 0 && lve->lve_count != 0) {
+			(void) printf("%s: block vdev %llu offset %llx "
+			    "birth %llu is %s the livelist\n", dsname,
+			    (u_longlong_t)DVA_GET_VDEV(&lve->lve_dva),
+			    (u_longlong_t)DVA_GET_OFFSET(&lve->lve_dva),
+			    (u_longlong_t)lve->lve_birth,
+			    lve->lve_count > 0 ? "freed but still on" :
+			    "referenced but missing from");
+			lv->lv_errors++;
+		}
+		umem_free(lve, sizeof (*lve));
+	}
+	avl_destroy(&lv->lv_tree);
+
+	dsl_dataset_rele(ds, FTAG);
+	dsl_pool_rele(dp, FTAG);
+	return (0);
+}
+
+static int
+verify_livelists(spa_t *spa)
+{
+	livelist_verify_t lv = { 0 };
+	dsl_pool_t *dp = spa_get_dsl(spa);
+	uint64_t deleted = 0;
+	uint64_t refcount = 0;
+
+	if (!spa_feature_is_enabled(spa, SPA_FEATURE_LIVELIST))
+		return (0);
+
+	(void) dmu_objset_find(spa_name(spa), verify_one_livelist, &lv,
+	    DS_FIND_CHILDREN);
+
+	if (dp->dp_livelists_obj != 0) {
+		VERIFY0(zap_count(spa_meta_objset(spa), dp->dp_livelists_obj,
+		    &deleted));
+	}
+	(void) feature_get_refcount(spa,
+	    &spa_feature_table[SPA_FEATURE_LIVELIST], &refcount);
+
+	if (refcount != lv.lv_clones + deleted) {
+		(void) printf("Number of livelists (%llu clones, %llu "
+		    "deleted) does not match feature count (%llu)\n",
+		    (u_longlong_t)lv.lv_clones, (u_longlong_t)deleted,
+		    (u_longlong_t)refcount);
+		lv.lv_errors++;
+	} else if (lv.lv_errors == 0) {
+		(void) printf("Verified %llu livelists and livelist feature "
+		    "refcount of %llu\n", (u_longlong_t)lv.lv_clones,
+		    (u_longlong_t)refcount);
+	}
+
+	return (lv.lv_errors != 0 ? 2 : 0);
+}
+
 #define	BOGUS_SUFFIX "_CHECKPOINTED_UNIVERSE"
 /*
  * Import the checkpointed state of the pool specified by the target
@@ -4963,6 +5171,9 @@ dump_zpool(spa_t *spa)
 			rc = verify_device_removal_feature_counts(spa);
 		}
 	}
+	if (rc == 0 && dump_opt['y'])
+		rc = verify_livelists(spa);
+
 	if (rc == 0 && (dump_opt['b'] || dump_opt['c']))
 		rc = dump_block_stats(spa);
 
@@ -5512,7 +5723,7 @@ main(int argc, char **argv)
 		spa_config_path = spa_config_path_env;
 
 	while ((c = getopt(argc, argv,
-	    "AbcCdDeEFGhiI:klLmMo:Op:PqRsSt:uU:vVX")) != -1) {
+	    "AbcCdDeEFGhiI:klLmMo:Op:PqRsSt:T:uU:vVXy")) != -1) {
 		switch (c) {
 		case 'b':
 		case 'c':
@@ -5531,6 +5742,7 @@ main(int argc, char **argv)
 		case 's':
 		case 'S':
 		case 'u':
+		case 'y':
 			dump_opt[c]++;
 			dump_all = 0;
 			break;
@@ -5580,6 +5792,14 @@ main(int argc, char **argv)
 				usage();
 			}
 			break;
+		case 'T':
+			traverse_threads = strtoul(optarg, NULL, 0);
+			if (traverse_threads <= 0) {
+				(void) fprintf(stderr, "number of traversal "
+				    "threads must be greater than 0\n");
+				usage();
+			}
+			break;
 		case 'U':
 			spa_config_path = optarg;
 			if (spa_config_path[0] != '/') {
@@ -5643,7 +5863,7 @@ main(int argc, char **argv)
 		verbose = MAX(verbose, 1);
 
 	for (c = 0; c < 256; c++) {
-		if (dump_all && strchr("AeEFklLOPRSX", c) == NULL)
+		if (dump_all && strchr("AeEFklLOPRSXy", c) == NULL)
 			dump_opt[c] = 1;
 		if (dump_opt[c])
 			dump_opt[c] += verbose;
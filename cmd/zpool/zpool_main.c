@@ -45,6 +45,7 @@
 #include <libintl.h>
 #include <libuutil.h>
 #include <locale.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -186,6 +187,7 @@ enum iostat_type {
 	IOS_QUEUES = 2,
 	IOS_L_HISTO = 3,
 	IOS_RQ_HISTO = 4,
+	IOS_PERCENTILE = 5,
 	IOS_COUNT,	/* always last element */
 };
 
@@ -195,6 +197,7 @@ enum iostat_type {
 #define	IOS_QUEUES_M	(1ULL << IOS_QUEUES)
 #define	IOS_L_HISTO_M	(1ULL << IOS_L_HISTO)
 #define	IOS_RQ_HISTO_M	(1ULL << IOS_RQ_HISTO)
+#define	IOS_PERCENTILE_M	(1ULL << IOS_PERCENTILE)
 
 /* Mask of all the histo bits */
 #define	IOS_ANYHISTO_M (IOS_L_HISTO_M | IOS_RQ_HISTO_M)
@@ -246,6 +249,12 @@ static const char *vsx_type_to_nvlist[IOS_COUNT][13] = {
 	    ZPOOL_CONFIG_VDEV_IND_TRIM_HISTO,
 	    ZPOOL_CONFIG_VDEV_AGG_TRIM_HISTO,
 	    NULL},
+	[IOS_PERCENTILE] = {
+	    ZPOOL_CONFIG_VDEV_TOT_R_LAT_HISTO,
+	    ZPOOL_CONFIG_VDEV_TOT_W_LAT_HISTO,
+	    ZPOOL_CONFIG_VDEV_DISK_R_LAT_HISTO,
+	    ZPOOL_CONFIG_VDEV_DISK_W_LAT_HISTO,
+	    NULL},
 };
 
 
@@ -360,10 +369,11 @@ get_usage(zpool_help_t idx) {
 		    "\timport [-o mntopts] [-o property=value] ... \n"
 		    "\t    [-d dir | -c cachefile] [-D] [-l] [-f] [-m] [-N] "
 		    "[-R root] [-F [-n]]\n"
-		    "\t    [--rewind-to-checkpoint] <pool | id> [newpool]\n"));
+		    "\t    [--rewind-to-checkpoint] <pool | id> [newpool]\n"
+		    "\timport -v ...\n"));
 	case HELP_IOSTAT:
 		return (gettext("\tiostat [-T d | u] [-ghHLpPvy] "
-		    "[[-lq]|[-r|-w]]\n"
+		    "[[-lqt]|[-r|-w]]\n"
 		    "\t    [[pool ...]|[pool vdev ...]|[vdev ...]] "
 		    "[interval [count]]\n"));
 	case HELP_LABELCLEAR:
@@ -2810,6 +2820,25 @@ zpool_do_checkpoint(int argc, char **argv)
 
 #define	CHECKPOINT_OPT	1024
 
+/*
+ * Print where the time went while scanning devices for pool labels.
+ */
+static void
+print_import_scan_stats(const import_scan_stats_t *iss)
+{
+	(void) printf(gettext("device scan: %llu devices, %llu probed, "
+	    "%llu from label cache, %llu with labels\n"),
+	    (u_longlong_t)iss->iss_devices, (u_longlong_t)iss->iss_probed,
+	    (u_longlong_t)iss->iss_cached, (u_longlong_t)iss->iss_labeled);
+	(void) printf(gettext("  readdir %llums, scan %llums "
+	    "(open %llums, read %llums over all threads), config %llums\n\n"),
+	    (u_longlong_t)NSEC2MSEC(iss->iss_readdir_ns),
+	    (u_longlong_t)NSEC2MSEC(iss->iss_scan_ns),
+	    (u_longlong_t)NSEC2MSEC(iss->iss_open_ns),
+	    (u_longlong_t)NSEC2MSEC(iss->iss_read_ns),
+	    (u_longlong_t)NSEC2MSEC(iss->iss_config_ns));
+}
+
 /*
  * zpool import [-d dir] [-D]
  *       import [-o mntopts] [-o prop=value] ... [-R root] [-D] [-l]
@@ -2853,6 +2882,8 @@ zpool_do_checkpoint(int argc, char **argv)
  *
  *       -o	Set property=value and/or temporary mount options (without '=').
  *
+ *       -v	Report how long the device scan took.
+ *
  *       --rewind-to-checkpoint
  *       	Import the pool and revert back to the checkpoint.
  *
@@ -2888,6 +2919,8 @@ zpool_do_import(int argc, char **argv)
 	uint64_t pool_state, txg = -1ULL;
 	char *cachefile = NULL;
 	importargs_t idata = { 0 };
+	import_scan_stats_t scan_stats = { 0 };
+	boolean_t verbose = B_FALSE;
 	char *endptr;
 
 
@@ -2897,7 +2930,7 @@ zpool_do_import(int argc, char **argv)
 	};
 
 	/* check options */
-	while ((c = getopt_long(argc, argv, ":aCc:d:DEfFlmnNo:R:stT:VX",
+	while ((c = getopt_long(argc, argv, ":aCc:d:DEfFlmnNo:R:stT:vVX",
 	    long_options, NULL)) != -1) {
 		switch (c) {
 		case 'a':
@@ -2976,6 +3009,9 @@ zpool_do_import(int argc, char **argv)
 			}
 			rewind_policy = ZPOOL_DO_REWIND | ZPOOL_EXTREME_REWIND;
 			break;
+		case 'v':
+			verbose = B_TRUE;
+			break;
 		case 'V':
 			flags |= ZFS_IMPORT_VERBATIM;
 			break;
@@ -3159,7 +3195,10 @@ zpool_do_import(int argc, char **argv)
 	idata.poolname = searchname;
 	idata.guid = searchguid;
 	idata.cachefile = cachefile;
+	idata.labelcache = getenv("ZPOOL_IMPORT_LABEL_CACHE");
 	idata.policy = policy;
+	if (verbose)
+		idata.stats = &scan_stats;
 
 	/*
 	 * Under Linux the zpool_find_import_impl() function leverages the
@@ -3171,6 +3210,9 @@ zpool_do_import(int argc, char **argv)
 	pools = zpool_search_import(g_zfs, &idata);
 	thread_fini();
 
+	if (verbose && cachefile == NULL)
+		print_import_scan_stats(&scan_stats);
+
 	if (pools != NULL && idata.exists &&
 	    (argc == 1 || strcmp(argv[0], argv[1]) == 0)) {
 		(void) fprintf(stderr, gettext("cannot import '%s': "
@@ -3384,6 +3426,8 @@ static const name_and_columns_t iostat_top_labels[][IOSTAT_MAX_LABELS] =
 	[IOS_RQ_HISTO] = {{"sync_read", 2}, {"sync_write", 2},
 	    {"async_read", 2}, {"async_write", 2}, {"scrub", 2},
 	    {"trim", 2}, {NULL}},
+	[IOS_PERCENTILE] = {{"total_rwait", 3}, {"total_wwait", 3},
+	    {"disk_rwait", 3}, {"disk_wwait", 3}, {NULL}},
 };
 
 /* Shorthand - if "columns" field not set, default to 1 column */
@@ -3400,6 +3444,9 @@ static const name_and_columns_t iostat_bottom_labels[][IOSTAT_MAX_LABELS] =
 	    {"write"}, {"read"}, {"write"}, {"scrub"}, {"trim"}, {NULL}},
 	[IOS_RQ_HISTO] = {{"ind"}, {"agg"}, {"ind"}, {"agg"}, {"ind"}, {"agg"},
 	    {"ind"}, {"agg"}, {"ind"}, {"agg"}, {"ind"}, {"agg"}, {NULL}},
+	[IOS_PERCENTILE] = {{"p50"}, {"p99"}, {"p999"}, {"p50"}, {"p99"},
+	    {"p999"}, {"p50"}, {"p99"}, {"p999"}, {"p50"}, {"p99"},
+	    {"p999"}, {NULL}},
 };
 
 static const char *histo_to_title[] = {
@@ -3460,6 +3507,7 @@ default_column_width(iostat_cbdata_t *cb, enum iostat_type type)
 		[IOS_QUEUES] = 6,   /* 1M queue entries */
 		[IOS_L_HISTO] = 10, /* 1B ns = 10sec */
 		[IOS_RQ_HISTO] = 6, /* 1M queue entries */
+		[IOS_PERCENTILE] = 10, /* 1B ns = 10sec */
 	};
 
 	if (cb->cb_literal)
@@ -3956,6 +4004,39 @@ single_histo_average(uint64_t *histo, unsigned int buckets)
 	return (count == 0 ? 0 : total / count);
 }
 
+/*
+ * Estimate a percentile, given in tenths of a percent, of a latency histo.
+ * Bucket i counts latencies in [2^i, 2^(i+1)) ns, so find the bucket the
+ * requested sample falls in and interpolate linearly within it.
+ */
+static uint64_t
+single_histo_percentile(uint64_t *histo, unsigned int buckets,
+    unsigned int permille)
+{
+	int i;
+	uint64_t count = 0, seen = 0, rank, base;
+
+	for (i = 0; i < buckets; i++)
+		count += histo[i];
+
+	if (count == 0)
+		return (0);
+
+	/* Index of the sample we want, counting from one */
+	rank = MAX(1, (count * permille + 999) / 1000);
+
+	for (i = 0; i < buckets; i++) {
+		if (seen + histo[i] >= rank) {
+			base = 1ULL << i;
+			return (base + (uint64_t)((double)base *
+			    (rank - seen) / histo[i]));
+		}
+		seen += histo[i];
+	}
+
+	return (1ULL << buckets);
+}
+
 static void
 print_iostat_queues(iostat_cbdata_t *cb, nvlist_t *oldnv,
     nvlist_t *newnv, double scale)
@@ -4036,6 +4117,45 @@ print_iostat_latency(iostat_cbdata_t *cb, nvlist_t *oldnv,
 	free_calc_stats(nva, ARRAY_SIZE(names));
 }
 
+/*
+ * Print the p50/p99/p999 total and disk latencies over the interval.
+ */
+static void
+print_iostat_percentiles(iostat_cbdata_t *cb, nvlist_t *oldnv,
+    nvlist_t *newnv)
+{
+	int i, j;
+	uint64_t val;
+	const char *names[] = {
+		ZPOOL_CONFIG_VDEV_TOT_R_LAT_HISTO,
+		ZPOOL_CONFIG_VDEV_TOT_W_LAT_HISTO,
+		ZPOOL_CONFIG_VDEV_DISK_R_LAT_HISTO,
+		ZPOOL_CONFIG_VDEV_DISK_W_LAT_HISTO,
+	};
+	const unsigned int permille[] = { 500, 990, 999 };
+	struct stat_array *nva;
+
+	unsigned int column_width = default_column_width(cb, IOS_PERCENTILE);
+	enum zfs_nicenum_format format;
+
+	nva = calc_and_alloc_stats_ex(names, ARRAY_SIZE(names), oldnv, newnv);
+
+	if (cb->cb_literal)
+		format = ZFS_NICENUM_RAW;
+	else
+		format = ZFS_NICENUM_TIME;
+
+	for (i = 0; i < ARRAY_SIZE(names); i++) {
+		for (j = 0; j < ARRAY_SIZE(permille); j++) {
+			val = single_histo_percentile(nva[i].data,
+			    nva[i].count, permille[j]);
+			print_one_stat(val, format, column_width,
+			    cb->cb_scripted);
+		}
+	}
+	free_calc_stats(nva, ARRAY_SIZE(names));
+}
+
 /*
  * Print default statistics (capacity/operations/bandwidth)
  */
@@ -4181,6 +4301,8 @@ print_vdev_stats(zpool_handle_t *zhp, const char *name, nvlist_t *oldnv,
 		print_iostat_latency(cb, oldnv, newnv, scale);
 	if (cb->cb_flags & IOS_QUEUES_M)
 		print_iostat_queues(cb, oldnv, newnv, scale);
+	if (cb->cb_flags & IOS_PERCENTILE_M)
+		print_iostat_percentiles(cb, oldnv, newnv);
 	if (cb->cb_flags & IOS_ANYHISTO_M) {
 		printf("\n");
 		print_iostat_histos(cb, oldnv, newnv, scale, name);
@@ -4310,8 +4432,10 @@ refresh_iostat(zpool_handle_t *zhp, void *data)
 
 	/*
 	 * If the pool has disappeared, remove it from the list and continue.
+	 * Only the default stats can do without the extended ones.
 	 */
-	if (zpool_refresh_stats(zhp, &missing) != 0)
+	if (zpool_refresh_vdev_stats(zhp, (cb->cb_flags & ~IOS_DEFAULT_M) != 0,
+	    &missing) != 0)
 		return (-1);
 
 	if (missing)
@@ -4736,7 +4860,7 @@ fsleep(float sec) {
 
 
 /*
- * zpool iostat [-ghHLpPvy] [[-lq]|[-r|-w]] [-n name] [-T d|u]
+ * zpool iostat [-ghHLpPvy] [[-lqt]|[-r|-w]] [-n name] [-T d|u]
  *		[[ pool ...]|[pool vdev ...]|[vdev ...]]
  *		[interval [count]]
  *
@@ -4750,6 +4874,7 @@ fsleep(float sec) {
  *		by a single tab.
  *	-l	Display average latency
  *	-q	Display queue depths
+ *	-t	Display p50/p99/p999 latencies
  *	-w	Display latency histograms
  *	-r	Display request size histogram
  *	-T	Display a timestamp in date(1) or Unix format
@@ -4772,6 +4897,7 @@ zpool_do_iostat(int argc, char **argv)
 	boolean_t verbose = B_FALSE;
 	boolean_t latency = B_FALSE, l_histo = B_FALSE, rq_histo = B_FALSE;
 	boolean_t queues = B_FALSE, parsable = B_FALSE, scripted = B_FALSE;
+	boolean_t percentiles = B_FALSE;
 	boolean_t omit_since_boot = B_FALSE;
 	boolean_t guid = B_FALSE;
 	boolean_t follow_links = B_FALSE;
@@ -4780,12 +4906,12 @@ zpool_do_iostat(int argc, char **argv)
 
 	/* Used for printing error message */
 	const char flag_to_arg[] = {[IOS_LATENCY] = 'l', [IOS_QUEUES] = 'q',
-	    [IOS_L_HISTO] = 'w', [IOS_RQ_HISTO] = 'r'};
+	    [IOS_L_HISTO] = 'w', [IOS_RQ_HISTO] = 'r', [IOS_PERCENTILE] = 't'};
 
 	uint64_t unsupported_flags;
 
 	/* check options */
-	while ((c = getopt(argc, argv, "gLPT:vyhplqrwH")) != -1) {
+	while ((c = getopt(argc, argv, "gLPT:vyhplqrtwH")) != -1) {
 		switch (c) {
 		case 'g':
 			guid = B_TRUE;
@@ -4811,6 +4937,9 @@ zpool_do_iostat(int argc, char **argv)
 		case 'q':
 			queues = B_TRUE;
 			break;
+		case 't':
+			percentiles = B_TRUE;
+			break;
 		case 'H':
 			scripted = B_TRUE;
 			break;
@@ -4919,10 +5048,10 @@ zpool_do_iostat(int argc, char **argv)
 		return (1);
 	}
 
-	if ((l_histo || rq_histo) && (queues || latency)) {
+	if ((l_histo || rq_histo) && (queues || latency || percentiles)) {
 		pool_list_free(list);
 		(void) fprintf(stderr,
-		    gettext("[-r|-w] isn't allowed with [-q|-l]\n"));
+		    gettext("[-r|-w] isn't allowed with [-q|-l|-t]\n"));
 		usage(B_FALSE);
 		return (1);
 	}
@@ -4955,6 +5084,8 @@ zpool_do_iostat(int argc, char **argv)
 			cb.cb_flags |= IOS_LATENCY_M;
 		if (queues)
 			cb.cb_flags |= IOS_QUEUES_M;
+		if (percentiles)
+			cb.cb_flags |= IOS_PERCENTILE_M;
 	}
 
 	/*
@@ -6499,7 +6630,7 @@ zpool_do_trim(int argc, char **argv)
  * Print out detailed scrub status.
  */
 static void
-print_scan_status(pool_scan_stat_t *ps)
+print_scan_status(pool_scan_stat_t *ps, uint_t c)
 {
 	time_t start, end, pause;
 	uint64_t total_secs_left;
@@ -6508,7 +6639,7 @@ print_scan_status(pool_scan_stat_t *ps)
 	uint_t scan_rate, issue_rate;
 	double fraction_done;
 	char processed_buf[7], scanned_buf[7], issued_buf[7], total_buf[7];
-	char srate_buf[7], irate_buf[7];
+	char srate_buf[7], irate_buf[7], mrate_buf[7], drate_buf[7];
 
 	(void) printf(gettext("  scan: "));
 
@@ -6621,6 +6752,18 @@ print_scan_status(pool_scan_stat_t *ps)
 			scanned_buf, issued_buf, total_buf);
 	}
 
+	/* older kernels do not split the issued bytes */
+	if (pause == 0 && c > offsetof(pool_scan_stat_t,
+	    pss_pass_meta_issued) / sizeof (uint64_t) &&
+	    pass_issued >= ps->pss_pass_meta_issued) {
+		zfs_nicenum(ps->pss_pass_meta_issued / elapsed, mrate_buf,
+		    sizeof (mrate_buf));
+		zfs_nicenum((pass_issued - ps->pss_pass_meta_issued) /
+		    elapsed, drate_buf, sizeof (drate_buf));
+		(void) printf(gettext("\tmetadata issued at %s/s, "
+		    "data issued at %s/s\n"), mrate_buf, drate_buf);
+	}
+
 	if (ps->pss_func == POOL_SCAN_RESILVER) {
 		(void) printf(gettext("\t%s resilvered, %.2f%% done"),
 		    processed_buf, 100 * fraction_done);
@@ -7250,7 +7393,7 @@ status_callback(zpool_handle_t *zhp, void *data)
 	if (config != NULL) {
 		uint64_t nerr;
 		nvlist_t **spares, **l2cache;
-		uint_t nspares, nl2cache;
+		uint_t nspares, nl2cache, psc = 0;
 		pool_checkpoint_stat_t *pcs = NULL;
 		pool_scan_stat_t *ps = NULL;
 		pool_removal_stat_t *prs = NULL;
@@ -7258,11 +7401,11 @@ status_callback(zpool_handle_t *zhp, void *data)
 		(void) nvlist_lookup_uint64_array(nvroot,
 		    ZPOOL_CONFIG_CHECKPOINT_STATS, (uint64_t **)&pcs, &c);
 		(void) nvlist_lookup_uint64_array(nvroot,
-		    ZPOOL_CONFIG_SCAN_STATS, (uint64_t **)&ps, &c);
+		    ZPOOL_CONFIG_SCAN_STATS, (uint64_t **)&ps, &psc);
 		(void) nvlist_lookup_uint64_array(nvroot,
 		    ZPOOL_CONFIG_REMOVAL_STATS, (uint64_t **)&prs, &c);
 
-		print_scan_status(ps);
+		print_scan_status(ps, psc);
 		print_checkpoint_scan_warning(ps, pcs);
 		print_removal_status(zhp, prs);
 		print_checkpoint_status(pcs);
@@ -355,6 +355,7 @@ ztest_func_t ztest_dmu_objset_create_destroy;
 ztest_func_t ztest_dmu_prealloc;
 ztest_func_t ztest_fzap;
 ztest_func_t ztest_dmu_snapshot_create_destroy;
+ztest_func_t ztest_dsl_snapshot_chain_destroy;
 ztest_func_t ztest_dsl_prop_get_set;
 ztest_func_t ztest_spa_prop_get_set;
 ztest_func_t ztest_spa_create_destroy;
@@ -409,6 +410,7 @@ ztest_info_t ztest_info[] = {
 #endif
 	ZTI_INIT(ztest_fzap, 1, &zopt_sometimes),
 	ZTI_INIT(ztest_dmu_snapshot_create_destroy, 1, &zopt_sometimes),
+	ZTI_INIT(ztest_dsl_snapshot_chain_destroy, 1, &zopt_rarely),
 	ZTI_INIT(ztest_spa_create_destroy, 1, &zopt_sometimes),
 	ZTI_INIT(ztest_fault_inject, 1, &zopt_sometimes),
 	ZTI_INIT(ztest_dmu_snapshot_hold, 1, &zopt_sometimes),
@@ -2645,7 +2647,7 @@ ztest_zil_remount(ztest_ds_t *zd, uint64_t id)
 	zil_close(zd->zd_zilog);
 
 	/* zfsvfs_setup() */
-	VERIFY(zil_open(os, ztest_get_data) == zd->zd_zilog);
+	VERIFY(zil_open(os, ztest_get_data, NULL) == zd->zd_zilog);
 	zil_replay(os, zd, ztest_replay_vector);
 
 	(void) rw_unlock(&zd->zd_zilog_lock);
@@ -4026,7 +4028,7 @@ ztest_dmu_objset_create_destroy(ztest_ds_t *zd, uint64_t id)
 	/*
 	 * Open the intent log for it.
 	 */
-	zilog = zil_open(os, ztest_get_data);
+	zilog = zil_open(os, ztest_get_data, NULL);
 
 	/*
 	 * Put some objects in there, do a little I/O to them,
@@ -4079,6 +4081,125 @@ ztest_dmu_snapshot_create_destroy(ztest_ds_t *zd, uint64_t id)
 	(void) rw_unlock(&ztest_name_lock);
 }
 
+/*
+ * Overwrite a few random blocks of object, so that each snapshot in a
+ * chain has something on its deadlist.
+ */
+#define	ZTEST_CHAIN_BLOCKSIZE	4096
+#define	ZTEST_CHAIN_BLOCKS	64
+
+static int
+ztest_snapshot_chain_churn(objset_t *os, uint64_t object, void *buf)
+{
+	dmu_tx_t *tx;
+	int i;
+
+	for (i = 0; i < 8; i++) {
+		uint64_t offset = ztest_random(ZTEST_CHAIN_BLOCKS) *
+		    ZTEST_CHAIN_BLOCKSIZE;
+
+		tx = dmu_tx_create(os);
+		dmu_tx_hold_write(tx, object, offset, ZTEST_CHAIN_BLOCKSIZE);
+		if (ztest_tx_assign(tx, TXG_WAIT, FTAG) == 0)
+			return (ENOSPC);
+		dmu_write(os, object, offset, ZTEST_CHAIN_BLOCKSIZE, buf, tx);
+		dmu_tx_commit(tx);
+	}
+	return (0);
+}
+
+/*
+ * Build a chain of snapshots with overlapping deadlists and destroy all
+ * but the first and last in one call, the way a snapshot retention policy
+ * does.  Each destroy merges its deadlist into its successor's, so this
+ * exercises the deadlist merge path.  scripts/zfs-deadlist-survey.sh
+ * measures the same operation at a meaningful scale.
+ */
+/* ARGSUSED */
+void
+ztest_dsl_snapshot_chain_destroy(ztest_ds_t *zd, uint64_t id)
+{
+	char *name, *snapname;
+	nvlist_t *snaps, *errlist;
+	objset_t *os;
+	dmu_tx_t *tx;
+	uint64_t object, nsnaps, s;
+	void *buf;
+	int error;
+
+	name = umem_alloc(ZFS_MAX_DATASET_NAME_LEN, UMEM_NOFAIL);
+	snapname = umem_alloc(ZFS_MAX_DATASET_NAME_LEN, UMEM_NOFAIL);
+	buf = umem_alloc(ZTEST_CHAIN_BLOCKSIZE, UMEM_NOFAIL);
+
+	(void) rw_rdlock(&ztest_name_lock);
+
+	(void) snprintf(name, ZFS_MAX_DATASET_NAME_LEN, "%s/chain_%llu",
+	    ztest_opts.zo_pool, (u_longlong_t)id);
+
+	/*
+	 * Clean up anything left behind by a previous run.
+	 */
+	(void) dmu_objset_find(name, ztest_objset_destroy_cb, NULL,
+	    DS_FIND_CHILDREN | DS_FIND_SNAPSHOTS);
+
+	error = ztest_dataset_create(name);
+	if (error) {
+		if (error == ENOSPC) {
+			ztest_record_enospc(FTAG);
+			goto out;
+		}
+		fatal(0, "dmu_objset_create(%s) = %d", name, error);
+	}
+
+	VERIFY0(ztest_dmu_objset_own(name, DMU_OST_OTHER, B_FALSE, B_TRUE,
+	    FTAG, &os));
+
+	tx = dmu_tx_create(os);
+	dmu_tx_hold_bonus(tx, DMU_NEW_OBJECT);
+	if (ztest_tx_assign(tx, TXG_WAIT, FTAG) == 0) {
+		dmu_objset_disown(os, B_TRUE, FTAG);
+		goto cleanup;
+	}
+	object = dmu_object_alloc(os, DMU_OT_UINT64_OTHER,
+	    ZTEST_CHAIN_BLOCKSIZE, DMU_OT_NONE, 0, tx);
+	dmu_tx_commit(tx);
+
+	nsnaps = 8 + ztest_random(25);
+	for (s = 0; s < nsnaps; s++) {
+		(void) memset(buf, (int)(id + s), ZTEST_CHAIN_BLOCKSIZE);
+		if (ztest_snapshot_chain_churn(os, object, buf) != 0 ||
+		    !ztest_snapshot_create(name, s))
+			break;
+	}
+	dmu_objset_disown(os, B_TRUE, FTAG);
+	if (s < nsnaps)
+		goto cleanup;
+
+	snaps = fnvlist_alloc();
+	errlist = fnvlist_alloc();
+	for (s = 1; s < nsnaps - 1; s++) {
+		(void) snprintf(snapname, ZFS_MAX_DATASET_NAME_LEN, "%s@%llu",
+		    name, (u_longlong_t)s);
+		fnvlist_add_boolean(snaps, snapname);
+	}
+
+	error = dsl_destroy_snapshots_nvl(snaps, B_FALSE, errlist);
+	if (error != 0)
+		fatal(0, "dsl_destroy_snapshots_nvl(%s) = %d", name, error);
+	fnvlist_free(errlist);
+	fnvlist_free(snaps);
+
+cleanup:
+	(void) dmu_objset_find(name, ztest_objset_destroy_cb, NULL,
+	    DS_FIND_CHILDREN | DS_FIND_SNAPSHOTS);
+out:
+	(void) rw_unlock(&ztest_name_lock);
+
+	umem_free(buf, ZTEST_CHAIN_BLOCKSIZE);
+	umem_free(snapname, ZFS_MAX_DATASET_NAME_LEN);
+	umem_free(name, ZFS_MAX_DATASET_NAME_LEN);
+}
+
 /*
  * Cleanup non-standard snapshots and clones.
  */
@@ -6226,7 +6347,7 @@ ztest_run_zdb(char *pool)
 	}
 
 	(void) sprintf(zdb,
-	    "%s -bcc%s%s -d -U %s %s",
+	    "%s -bccy%s%s -d -U %s %s",
 	    bin,
 	    ztest_opts.zo_verbose >= 3 ? "s" : "",
 	    ztest_opts.zo_verbose >= 4 ? "v" : "",
@@ -6577,7 +6698,7 @@ ztest_dataset_open(int d)
 		    (u_longlong_t)zilog->zl_parse_lr_count,
 		    (u_longlong_t)zilog->zl_replaying_seq);
 
-	zilog = zil_open(os, ztest_get_data);
+	zilog = zil_open(os, ztest_get_data, NULL);
 
 	if (zilog->zl_replaying_seq != 0 &&
 	    zilog->zl_replaying_seq < committed_seq)
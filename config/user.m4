@@ -15,4 +15,7 @@ AC_DEFUN([ZFS_AC_CONFIG_USER], [
 dnl #
 dnl #	Checks for library functions
 	AC_CHECK_FUNCS([mlockall])
+	AC_SEARCH_LIBS([lio_listio], [rt],
+	    [AC_DEFINE([HAVE_LIO_LISTIO], 1,
+	    [Define if you have the POSIX AIO lio_listio function])])
 ])
@@ -428,6 +428,8 @@ extern void zpool_dump_ddt(const ddt_stat_t *dds, const ddt_histogram_t *ddh);
 extern nvlist_t *zpool_get_config(zpool_handle_t *, nvlist_t **);
 extern nvlist_t *zpool_get_features(zpool_handle_t *);
 extern int zpool_refresh_stats(zpool_handle_t *, boolean_t *);
+extern int zpool_refresh_vdev_stats(zpool_handle_t *, boolean_t,
+    boolean_t *);
 extern int zpool_get_errlog(zpool_handle_t *, nvlist_t **);
 
 /*
@@ -445,16 +447,34 @@ extern void zpool_print_unsup_feat(nvlist_t *config);
  * Search for pools to import
  */
 
+/*
+ * Where the time goes when scanning devices for pool labels.  The open and
+ * read times are summed over all scanning threads, the others are wall time.
+ */
+typedef struct import_scan_stats {
+	uint64_t iss_devices;		/* device nodes found		*/
+	uint64_t iss_probed;		/* devices whose labels were read */
+	uint64_t iss_labeled;		/* devices with a valid label	*/
+	uint64_t iss_cached;		/* devices found in label cache	*/
+	uint64_t iss_readdir_ns;	/* listing the search paths	*/
+	uint64_t iss_scan_ns;		/* probing all devices		*/
+	uint64_t iss_open_ns;		/* opening devices		*/
+	uint64_t iss_read_ns;		/* reading labels		*/
+	uint64_t iss_config_ns;		/* assembling pool configs	*/
+} import_scan_stats_t;
+
 typedef struct importargs {
 	char **path;		/* a list of paths to search		*/
 	int paths;		/* number of paths to search		*/
 	char *poolname;		/* name of a pool to find		*/
 	uint64_t guid;		/* guid of a pool to find		*/
 	char *cachefile;	/* cachefile to use for import		*/
+	char *labelcache;	/* device label cache, may be NULL	*/
 	int can_be_active : 1;	/* can the pool be active?		*/
 	int unique : 1;		/* does 'poolname' already exist?	*/
 	int exists : 1;		/* set on return if pool already exists	*/
 	nvlist_t *policy;	/* load policy (max txg, rewind, etc.)	*/
+	import_scan_stats_t *stats; /* device scan statistics, may be NULL */
 } importargs_t;
 
 extern nvlist_t *zpool_search_import(libzfs_handle_t *, importargs_t *);
@@ -60,6 +60,9 @@ int lzc_promote(const char *, char *, int);
 int lzc_destroy_snaps(nvlist_t *, boolean_t, nvlist_t **);
 int lzc_bookmark(nvlist_t *, nvlist_t **);
 int lzc_get_bookmarks(const char *, nvlist_t *, nvlist_t **);
+int lzc_list_batch(const char *, nvlist_t *, nvlist_t **);
+int lzc_objs_to_stats(const char *, uint64_t, uint64_t, nvlist_t **);
+int lzc_pool_vdev_stats(const char *, boolean_t, nvlist_t **);
 int lzc_destroy_bookmarks(nvlist_t *, nvlist_t **);
 int lzc_load_key(const char *, boolean_t, uint8_t *, uint_t);
 int lzc_unload_key(const char *);
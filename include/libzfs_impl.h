@@ -38,6 +38,7 @@
 #include <libzfs.h>
 #include <libshare.h>
 #include <libzfs_core.h>
+#include <pthread.h>
 
 #define	MOUNT_POINT_COOKIE		".autodiskmounted"
 #define	MOUNT_POINT_CUSTOM_ICON		".VolumeIcon.icns"
@@ -81,6 +82,7 @@ struct libzfs_handle {
 	uint_t libzfs_shareflags;
 	boolean_t libzfs_mnttab_enable;
 	avl_tree_t libzfs_mnttab_cache;
+	pthread_mutex_t libzfs_mnttab_cache_lock;
 	int libzfs_pool_iter;
 #if defined(HAVE_LIBTOPO)
 	topo_hdl_t *libzfs_topo_hdl;
@@ -122,6 +124,8 @@ struct zpool_handle {
 	size_t zpool_config_size;
 	nvlist_t *zpool_config;
 	nvlist_t *zpool_old_config;
+	uint64_t zpool_config_gen;	/* generation + 1, or 0 if unknown */
+	uint64_t zpool_old_config_gen;
 	nvlist_t *zpool_props;
 	diskaddr_t zpool_start_block;
 };
@@ -163,7 +167,10 @@ int zpool_standard_error_fmt(libzfs_handle_t *, int, const char *, ...);
 int get_dependents(libzfs_handle_t *, boolean_t, const char *, char ***,
     size_t *);
 zfs_handle_t *make_dataset_handle_zc(libzfs_handle_t *, zfs_cmd_t *);
+zfs_handle_t *make_dataset_handle_nvl(libzfs_handle_t *, const char *,
+    nvlist_t *);
 zfs_handle_t *make_dataset_simple_handle_zc(zfs_handle_t *, zfs_cmd_t *);
+zfs_handle_t *make_dataset_simple_handle(zfs_handle_t *, const char *);
 
 int zprop_parse_value(libzfs_handle_t *, nvpair_t *, int, zfs_type_t,
     nvlist_t *, char **, uint64_t *, const char *);
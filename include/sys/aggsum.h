@@ -35,13 +35,13 @@ typedef struct aggsum_bucket {
 } aggsum_bucket_t __attribute__((aligned(64))) /*__aligned(CACHE_LINE_SIZE)*/;
 
 /*
- * Fan out over FANOUT cpus.
+ * Fan out over one bucket per 2^as_bucketshift neighbouring cpus.
  */
 typedef struct aggsum {
-	kmutex_t as_lock;
 	int64_t as_lower_bound;
 	int64_t as_upper_bound;
-	uint64_t as_numbuckets;
+	uint_t as_bucketshift;
+	uint_t as_numbuckets;
 	aggsum_bucket_t *as_buckets;
 } aggsum_t;
 
@@ -0,0 +1,68 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+ */
+
+#ifndef	_SYS_DATASET_KSTATS_H
+#define	_SYS_DATASET_KSTATS_H
+
+#include <sys/zfs_context.h>
+#include <sys/dmu.h>
+#include <sys/fs/zfs.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#define	DATASET_KSTATS_ALIGN	64	/* cache line size */
+
+/*
+ * Per-CPU slice of a dataset's I/O counters.  Each CPU only updates its
+ * own slice, which is aligned and padded out to whole cache lines, and the
+ * slices are summed when the kstat is read.  The latency histograms use
+ * the same power-of-two nanosecond buckets as the vdev latency histograms.
+ */
+typedef struct dataset_kstats_cpu {
+	uint64_t dkc_reads;
+	uint64_t dkc_nread;
+	uint64_t dkc_writes;
+	uint64_t dkc_nwritten;
+	uint64_t dkc_syncs;
+	uint64_t dkc_read_histo[VDEV_L_HISTO_BUCKETS];
+	uint64_t dkc_write_histo[VDEV_L_HISTO_BUCKETS];
+	uint64_t dkc_sync_histo[VDEV_L_HISTO_BUCKETS];
+} __attribute__((aligned(DATASET_KSTATS_ALIGN))) dataset_kstats_cpu_t;
+
+typedef struct dataset_kstats {
+	kmutex_t		dk_lock;	/* protects dk_values */
+	uint_t			dk_ncpus;
+	dataset_kstats_cpu_t	*dk_cpus;	/* aligned within dk_cpus_buf */
+	void			*dk_cpus_buf;
+	kstat_named_t		*dk_values;
+	char			*dk_name;	/* dataset name at mount */
+	kstat_t			*dk_kstat;
+} dataset_kstats_t;
+
+void dataset_kstats_create(dataset_kstats_t *, objset_t *);
+void dataset_kstats_destroy(dataset_kstats_t *);
+
+void dataset_kstats_update_read_kstats(dataset_kstats_t *, int64_t, hrtime_t);
+void dataset_kstats_update_write_kstats(dataset_kstats_t *, int64_t,
+    hrtime_t);
+void dataset_kstats_update_sync_kstats(dataset_kstats_t *, hrtime_t);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _SYS_DATASET_KSTATS_H */
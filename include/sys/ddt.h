@@ -31,6 +31,7 @@
 #include <sys/fs/zfs.h>
 #include <sys/zio.h>
 #include <sys/dmu.h>
+#include <sys/zthr.h>
 
 #ifdef	__cplusplus
 extern "C" {
@@ -146,6 +147,7 @@ struct ddt {
 	ddt_histogram_t	ddt_histogram[DDT_TYPES][DDT_CLASSES];
 	ddt_histogram_t	ddt_histogram_cache[DDT_TYPES][DDT_CLASSES];
 	ddt_object_t	ddt_object_stats[DDT_TYPES][DDT_CLASSES];
+	uint64_t	ddt_warmup_offset[DDT_TYPES][DDT_CLASSES];
 	avl_node_t	ddt_node;
 };
 
@@ -245,6 +247,8 @@ extern int ddt_load(spa_t *spa);
 extern void ddt_unload(spa_t *spa);
 extern void ddt_sync(spa_t *spa, uint64_t txg);
 extern int ddt_walk(spa_t *spa, ddt_bookmark_t *ddb, ddt_entry_t *dde);
+extern boolean_t ddt_warmup_check(void *arg, zthr_t *zthr);
+extern void ddt_warmup_thread(void *arg, zthr_t *zthr);
 extern int ddt_object_update(ddt_t *ddt, enum ddt_type type,
     enum ddt_class _class, ddt_entry_t *dde, dmu_tx_t *tx);
 
@@ -59,6 +59,14 @@ typedef int (blkptr_cb_t)(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
  */
 #define	TRAVERSE_NO_DECRYPT		(1<<5)
 
+/*
+ * While visiting the children of an indirect block, also prefetch the
+ * indirect blocks below the next child, so that the traversal does not
+ * stall each time it moves on to a new subtree.  Used by the async
+ * destroy traversal, which reads every indirect block but no data.
+ */
+#define	TRAVERSE_PREFETCH_AHEAD		(1<<6)
+
 /* Special traverse error return value to indicate skipping of children */
 #define	TRAVERSE_VISIT_NO_CHILDREN	-1
 
@@ -71,6 +79,8 @@ int traverse_dataset_destroyed(spa_t *spa, blkptr_t *blkptr,
     blkptr_cb_t func, void *arg);
 int traverse_pool(spa_t *spa,
     uint64_t txg_start, int flags, blkptr_cb_t func, void *arg);
+int traverse_pool_parallel(spa_t *spa,
+    uint64_t txg_start, int flags, blkptr_cb_t func, void *arg, int nthreads);
 
 #ifdef	__cplusplus
 }
@@ -46,8 +46,10 @@ typedef struct dsl_deadlist_phys {
 typedef struct dsl_deadlist {
 	objset_t *dl_os;
 	uint64_t dl_object;
-	avl_tree_t dl_tree;
+	avl_tree_t dl_tree; /* contains dsl_deadlist_entry_t */
 	boolean_t dl_havetree;
+	avl_tree_t dl_cache; /* contains dsl_deadlist_cache_entry_t */
+	boolean_t dl_havecache;
 	struct dmu_buf *dl_dbuf;
 	dsl_deadlist_phys_t *dl_phys;
 	kmutex_t dl_lock;
@@ -63,6 +65,18 @@ typedef struct dsl_deadlist_entry {
 	bpobj_t dle_bpobj;
 } dsl_deadlist_entry_t;
 
+/*
+ * Space of one key, for answering space queries without opening every
+ * bpobj.  Only used while the deadlist's tree isn't loaded.
+ */
+typedef struct dsl_deadlist_cache_entry {
+	avl_node_t dce_node;
+	uint64_t dce_mintxg;
+	uint64_t dce_bytes;
+	uint64_t dce_comp;
+	uint64_t dce_uncomp;
+} dsl_deadlist_cache_entry_t;
+
 void dsl_deadlist_open(dsl_deadlist_t *dl, objset_t *os, uint64_t object);
 void dsl_deadlist_close(dsl_deadlist_t *dl);
 uint64_t dsl_deadlist_alloc(objset_t *os, dmu_tx_t *tx);
@@ -81,6 +95,16 @@ void dsl_deadlist_merge(dsl_deadlist_t *dl, uint64_t obj, dmu_tx_t *tx);
 void dsl_deadlist_move_bpobj(dsl_deadlist_t *dl, bpobj_t *bpo, uint64_t mintxg,
     dmu_tx_t *tx);
 boolean_t dsl_deadlist_is_open(dsl_deadlist_t *dl);
+void dsl_deadlist_prefetch(dsl_deadlist_t *dl);
+dsl_deadlist_entry_t *dsl_deadlist_first(dsl_deadlist_t *dl);
+dsl_deadlist_entry_t *dsl_deadlist_last(dsl_deadlist_t *dl);
+dsl_deadlist_entry_t *dsl_deadlist_next(dsl_deadlist_t *dl,
+    dsl_deadlist_entry_t *dle);
+dsl_deadlist_entry_t *dsl_deadlist_find(dsl_deadlist_t *dl, uint64_t mintxg);
+void dsl_deadlist_discard_key(dsl_deadlist_t *dl, uint64_t mintxg,
+    dmu_tx_t *tx);
+void dsl_deadlist_replace_key(dsl_deadlist_t *dl, uint64_t mintxg,
+    uint64_t obj, dmu_tx_t *tx);
 
 #ifdef	__cplusplus
 }
@@ -34,6 +34,8 @@
 #include <sys/refcount.h>
 #include <sys/zfs_context.h>
 #include <sys/dsl_crypt.h>
+#include <sys/dsl_deadlist.h>
+#include <sys/bplist.h>
 
 #ifdef	__cplusplus
 extern "C" {
@@ -50,6 +52,7 @@ struct dsl_dataset;
 #define	DD_FIELD_SNAPSHOT_COUNT		"com.joyent:snapshot_count"
 #define	DD_FIELD_CRYPTO_KEY_OBJ		"com.datto:crypto_key_obj"
 #define	DD_FIELD_LAST_REMAP_TXG		"com.delphix:last_remap_txg"
+#define	DD_FIELD_LIVELIST		"org.openzfsonosx:livelist"
 
 typedef enum dd_used {
 	DD_USED_HEAD,
@@ -115,6 +118,17 @@ struct dsl_dir {
 	/* amount of space we expect to write; == amount of dirty data */
 	int64_t dd_space_towrite[TXG_SIZE];
 
+	/*
+	 * Livelist of a clone: the blocks born and freed since the clone
+	 * was created, see dsl_livelist.c.  Modified in syncing context
+	 * only; the pending lists are filled from zio completion.
+	 */
+	dsl_deadlist_t dd_livelist;
+	dsl_deadlist_t dd_livelist_free;
+	bplist_t dd_pending_allocs;
+	bplist_t dd_pending_frees;
+	boolean_t dd_livelist_invalid;	/* protected by dd_lock */
+
 	/* protected by dd_lock; keep at end of struct for better locality */
 	char dd_myname[ZFS_MAX_DATASET_NAME_LEN];
 };
@@ -0,0 +1,63 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#ifndef	_SYS_DSL_LIVELIST_H
+#define	_SYS_DSL_LIVELIST_H
+
+#include <sys/bpobj.h>
+#include <sys/dsl_deadlist.h>
+#include <sys/zthr.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+struct dsl_dir;
+
+extern uint64_t zfs_livelist_max_entries;
+extern int zfs_livelist_condense_free_pct;
+
+void dsl_livelist_open(struct dsl_dir *dd);
+void dsl_livelist_close(struct dsl_dir *dd);
+boolean_t dsl_livelist_exists(struct dsl_dir *dd);
+void dsl_livelist_create(struct dsl_dir *dd, uint64_t mintxg, dmu_tx_t *tx);
+void dsl_livelist_remove(struct dsl_dir *dd, dmu_tx_t *tx);
+void dsl_livelist_born(struct dsl_dir *dd, const blkptr_t *bp);
+void dsl_livelist_killed(struct dsl_dir *dd, const blkptr_t *bp);
+void dsl_livelist_invalidate(struct dsl_dir *dd);
+void dsl_livelist_sync(struct dsl_dir *dd, dmu_tx_t *tx);
+void dsl_livelist_destroy_sync(struct dsl_dir *dd, dmu_tx_t *tx);
+
+int dsl_livelist_iterate(dsl_deadlist_t *ll, dsl_deadlist_t *llf,
+    bpobj_itor_t func, void *arg);
+int dsl_livelist_iterate_deleted(spa_t *spa, bpobj_itor_t func, void *arg);
+boolean_t dsl_livelist_delete_pending(spa_t *spa);
+
+boolean_t dsl_livelist_delete_check(void *arg, zthr_t *zthr);
+void dsl_livelist_delete_thread(void *arg, zthr_t *zthr);
+boolean_t dsl_livelist_condense_check(void *arg, zthr_t *zthr);
+void dsl_livelist_condense_thread(void *arg, zthr_t *zthr);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _SYS_DSL_LIVELIST_H */
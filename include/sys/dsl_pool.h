@@ -106,6 +106,7 @@ typedef struct dsl_pool {
 	uint64_t dp_bptree_obj;
 	uint64_t dp_empty_bpobj;
 	bpobj_t dp_obsolete_bpobj;
+	uint64_t dp_livelists_obj;	/* livelists of destroyed clones */
 
 	struct dsl_scan *dp_scan;
 
@@ -118,6 +119,8 @@ typedef struct dsl_pool {
 	uint64_t dp_mos_used_delta;
 	uint64_t dp_mos_compressed_delta;
 	uint64_t dp_mos_uncompressed_delta;
+	uint64_t dp_condense_ddobj;	/* livelist waiting to be condensed */
+	uint64_t dp_condense_mintxg;	/* ... and the sublist to condense */
 
 	/*
 	 * Time of most recently scheduled (furthest in the future)
@@ -118,6 +118,15 @@ typedef struct dsl_scan {
 	boolean_t scn_async_destroying;
 	boolean_t scn_async_stalled;
 	uint64_t  scn_async_block_min_time_ms;
+	struct scan_free_batch *scn_free_batch;	/* bps not yet dispatched */
+	int64_t scn_free_used;		/* dp_free_dir deltas this txg */
+	int64_t scn_free_comp;
+	int64_t scn_free_uncomp;
+	hrtime_t scn_free_rate_ts;	/* start of rate interval */
+	uint64_t scn_free_rate_blocks;	/* freed in rate interval */
+	uint64_t scn_free_rate_bytes;
+	uint64_t scn_freeing_blocks_rate; /* blocks/s, last interval */
+	uint64_t scn_freeing_bytes_rate;  /* bytes/s, last interval */
 
 	/* flags and stats for controlling scan state */
 	boolean_t scn_is_sorted;	/* doing sequential scan */
@@ -178,6 +187,8 @@ void dsl_scan_ds_clone_swapped(struct dsl_dataset *ds1, struct dsl_dataset *ds2,
 boolean_t dsl_scan_active(dsl_scan_t *scn);
 boolean_t dsl_scan_is_paused_scrub(const dsl_scan_t *scn);
 void dsl_scan_freed(spa_t *spa, const blkptr_t *bp);
+uint64_t dsl_scan_freeing_rate(dsl_scan_t *scn);
+uint64_t dsl_scan_freeing_time(dsl_scan_t *scn);
 void dsl_scan_io_queue_destroy(dsl_scan_io_queue_t *queue);
 void dsl_scan_io_queue_vdev_xfer(vdev_t *svd, vdev_t *tvd);
 
@@ -246,6 +246,9 @@ typedef enum {
 	ZPOOL_PROP_MULTIHOST,
 	ZPOOL_PROP_MAXDNODESIZE,
 	ZPOOL_PROP_AUTOTRIM,
+	ZPOOL_PROP_SCANLATENCY,
+	ZPOOL_PROP_FREEINGRATE,
+	ZPOOL_PROP_FREEINGTIME,
 	ZPOOL_NUM_PROPS
 } zpool_prop_t;
 
@@ -933,6 +936,7 @@ typedef struct pool_scan_stat {
 	/* cumulative time scrub spent paused, needed for rate calculation */
 	uint64_t	pss_pass_scrub_spent_paused;
 	uint64_t	pss_issued;	/* total bytes checked by scanner */
+	uint64_t	pss_pass_meta_issued; /* metadata part of pass_issued */
 } pool_scan_stat_t;
 
 typedef struct pool_removal_stat {
@@ -1167,6 +1171,51 @@ typedef enum {
 #define SNAP_ITER_MIN_TXG       "snap_iter_min_txg"
 #define SNAP_ITER_MAX_TXG       "snap_iter_max_txg"
 
+/*
+ * nvlist name constants for the batched dataset list ioctl, which returns
+ * the children or snapshots of a dataset, with their stats and properties,
+ * several at a time.
+ */
+#define	ZFS_LIST_BATCH_SNAPSHOTS	"snapshots"
+#define	ZFS_LIST_BATCH_SIMPLE		"simple"
+#define	ZFS_LIST_BATCH_CURSOR		"cursor"
+#define	ZFS_LIST_BATCH_COUNT		"count"
+#define	ZFS_LIST_BATCH_PROPS		"props"
+#define	ZFS_LIST_BATCH_DATASETS		"datasets"
+#define	ZFS_LIST_BATCH_STATS		"stats"
+
+#define	ZFS_LIST_BATCH_DEFAULT_COUNT	1024
+
+/*
+ * nvlist name constants for the batched "object to stats" ioctl, which
+ * returns the zfs_stat_t and path of the allocated objects in a range.
+ */
+#define	ZFS_OBJS_TO_STATS_FIRST		"first"
+#define	ZFS_OBJS_TO_STATS_LAST		"last"
+#define	ZFS_OBJS_TO_STATS_COUNT		"count"
+#define	ZFS_OBJS_TO_STATS_OBJECTS	"objects"
+#define	ZFS_OBJS_TO_STATS_ERRORS	"errors"
+#define	ZFS_OBJS_TO_STATS_STATS		"stats"
+#define	ZFS_OBJS_TO_STATS_PATHS		"paths"
+#define	ZFS_OBJS_TO_STATS_NEXT		"next"
+
+#define	ZFS_OBJS_TO_STATS_MAX_COUNT	4096
+
+/*
+ * nvlist name constants for the pool vdev stats ioctl, which returns the
+ * stats of every vdev without generating the pool config.  Each record is
+ * ZPOOL_VDEV_STATS_WORDS() uint64_t words: the vdev guid, its vdev_stat_t
+ * and, when "extended" is requested, its vdev_stat_ex_t.
+ */
+#define	ZPOOL_VDEV_STATS_EXTENDED	"extended"
+#define	ZPOOL_VDEV_STATS_GENERATION	"generation"
+#define	ZPOOL_VDEV_STATS_RECORD_SIZE	"record_size"
+#define	ZPOOL_VDEV_STATS_RECORDS	"records"
+
+#define	ZPOOL_VDEV_STATS_WORDS(extended)				\
+	((sizeof (uint64_t) + sizeof (vdev_stat_t) +			\
+	((extended) ? sizeof (vdev_stat_ex_t) : 0)) / sizeof (uint64_t))
+
 #define	ZVOL_DEFAULT_BLOCKSIZE	131072
 
 /*
@@ -147,9 +147,22 @@ typedef struct osx_kstat {
 	kstat_named_t zfs_send_unmodified_spill_blocks;
 	kstat_named_t zfs_special_class_metadata_reserve_pct;
 
+	kstat_named_t zfs_ddt_warmup;
+	kstat_named_t zfs_ddt_warmup_max_pct;
+
+	kstat_named_t zfs_scan_meta_window;
+	kstat_named_t zfs_scan_meta_mem_lim;
+	kstat_named_t zfs_vdev_scrub_throttle_interval_ms;
+	kstat_named_t zfs_vdev_scrub_throttle_max_active;
+	kstat_named_t zio_compute_offload;
+	kstat_named_t zfs_async_free_parallel;
+	kstat_named_t zfs_livelist_max_entries;
+	kstat_named_t zfs_livelist_condense_free_pct;
+
 	kstat_named_t zfs_vdev_raidz_impl;
 	kstat_named_t icp_gcm_impl;
 	kstat_named_t icp_aes_impl;
+	kstat_named_t icp_sha2_impl;
 	kstat_named_t zfs_fletcher_4_impl;
 } osx_kstat_t;
 
@@ -258,6 +271,18 @@ extern uint64_t  zfs_trim_queue_limit;
 extern uint64_t  zfs_send_unmodified_spill_blocks;
 extern uint64_t  zfs_special_class_metadata_reserve_pct;
 
+extern uint64_t  zfs_ddt_warmup;
+extern uint64_t  zfs_ddt_warmup_max_pct;
+
+extern uint64_t  zfs_scan_meta_window;
+extern uint64_t  zfs_scan_meta_mem_lim;
+extern uint32_t  zfs_vdev_scrub_throttle_interval_ms;
+extern uint32_t  zfs_vdev_scrub_throttle_max_active;
+extern int  zio_compute_offload;
+extern int  zfs_async_free_parallel;
+extern uint64_t  zfs_livelist_max_entries;
+extern int  zfs_livelist_condense_free_pct;
+
 int        kstat_osx_init(void);
 void       kstat_osx_fini(void);
 
@@ -151,6 +151,9 @@ int nv_alloc_init(nv_alloc_t *, const nv_alloc_ops_t *, /* args */ ...);
 void nv_alloc_reset(nv_alloc_t *);
 void nv_alloc_fini(nv_alloc_t *);
 
+/* consumer of nvlist_pack_stream() output */
+typedef int nvlist_stream_f(void *, const char *, size_t);
+
 /* list management */
 int nvlist_alloc(nvlist_t **, uint_t, int);
 void nvlist_free(nvlist_t *);
@@ -164,6 +167,7 @@ uint_t nvlist_nvflag(nvlist_t *);
 
 int nvlist_xalloc(nvlist_t **, uint_t, nv_alloc_t *);
 int nvlist_xpack(nvlist_t *, char **, size_t *, int, nv_alloc_t *);
+int nvlist_pack_stream(nvlist_t *, char *, size_t, nvlist_stream_f *, void *);
 int nvlist_xunpack(char *, size_t, nvlist_t **, nv_alloc_t *);
 int nvlist_xdup(nvlist_t *, nvlist_t **, nv_alloc_t *);
 nv_alloc_t *nvlist_lookup_nv_alloc(nvlist_t *);
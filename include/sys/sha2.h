@@ -118,6 +118,19 @@ extern void SHA512Update(SHA512_CTX *, const void *, size_t);
 
 extern void SHA512Final(void *, SHA512_CTX *);
 
+/*
+ * Block transform selection, used by the checksum benchmark to measure
+ * every supported implementation.  The id of the default selection is
+ * returned by sha2_impl_getid() and can be restored with sha2_impl_setid().
+ */
+extern uint32_t sha2_impl_getcnt(void);
+
+extern const char *sha2_impl_getname(uint32_t);
+
+extern uint64_t sha2_impl_getid(void);
+
+extern void sha2_impl_setid(uint64_t);
+
 #ifdef _SHA2_IMPL
 /*
  * The following types/functions are all private to the implementation
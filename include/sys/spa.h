@@ -780,6 +780,8 @@ extern int spa_open_rewind(const char *pool, spa_t **, void *tag,
     nvlist_t *policy, nvlist_t **config);
 extern int spa_get_stats(const char *pool, nvlist_t **config, char *altroot,
     size_t buflen);
+extern int spa_get_vdev_stats(const char *pool, boolean_t extended,
+    nvlist_t *outnvl);
 extern int spa_create(const char *pool, nvlist_t *nvroot, nvlist_t *props,
     nvlist_t *zplprops, struct dsl_crypto_params *dcp);
 extern int spa_import_rootpool(char *devpath, char *devid);
@@ -923,6 +925,8 @@ typedef struct spa_stats {
 	spa_stats_history_t	io_history;
 	spa_stats_history_t	mmp_history;
 	spa_stats_history_t	iostats;
+	spa_stats_history_t	load_stats;
+	spa_stats_history_t	ddt_warmup;
 } spa_stats_t;
 
 typedef enum txg_state {
@@ -950,6 +954,38 @@ typedef struct spa_iostats {
 	kstat_named_t	autotrim_bytes_failed;
 } spa_iostats_t;
 
+/* Duration of each spa_load() phase, in the order they run */
+typedef enum spa_load_phase {
+	SPA_LOAD_PHASE_MOS,
+	SPA_LOAD_PHASE_METADATA,
+	SPA_LOAD_PHASE_VDEV_METADATA,
+	SPA_LOAD_PHASE_DEDUP_TABLES,
+	SPA_LOAD_PHASE_VERIFY_LOGS,
+	SPA_LOAD_PHASE_VERIFY_POOL_DATA,
+	SPA_LOAD_PHASE_FINISH,
+	SPA_LOAD_PHASE_TOTAL,
+	SPA_LOAD_PHASES
+} spa_load_phase_t;
+
+/* Pool load kstats, one entry per spa_load_phase_t */
+typedef struct spa_load_stats {
+	kstat_named_t	mos_ns;
+	kstat_named_t	metadata_ns;
+	kstat_named_t	vdev_metadata_ns;
+	kstat_named_t	dedup_tables_ns;
+	kstat_named_t	verify_logs_ns;
+	kstat_named_t	verify_pool_data_ns;
+	kstat_named_t	finish_ns;
+	kstat_named_t	total_ns;
+} spa_load_stats_t;
+
+/* Progress of the background DDT warm-up of the current import */
+typedef struct spa_ddt_warmup_stats {
+	kstat_named_t	bytes_total;
+	kstat_named_t	bytes_read;
+	kstat_named_t	done;
+} spa_ddt_warmup_stats_t;
+
 extern void spa_stats_init(spa_t *spa);
 extern void spa_stats_destroy(spa_t *spa);
 extern void spa_read_history_add(spa_t *spa, const zbookmark_phys_t *zb,
@@ -970,6 +1006,11 @@ extern void spa_iostats_trim_add(spa_t *spa, trim_type_t type,
     uint64_t extents_written, uint64_t bytes_written,
     uint64_t extents_skipped, uint64_t bytes_skipped,
     uint64_t extents_failed, uint64_t bytes_failed);
+extern void spa_load_stats_reset(spa_t *spa);
+extern void spa_load_stats_set(spa_t *spa, spa_load_phase_t phase,
+    hrtime_t duration);
+extern void spa_ddt_warmup_stats_set(spa_t *spa, uint64_t total,
+    uint64_t read, boolean_t done);
 
 /* Pool configuration locks */
 extern int spa_config_tryenter(spa_t *spa, int locks, void *tag, krw_t rw);
@@ -1141,6 +1182,10 @@ extern void spa_get_errlists(spa_t *spa, avl_tree_t *last, avl_tree_t *scrub);
 extern void vdev_cache_stat_init(void);
 extern void vdev_cache_stat_fini(void);
 
+/* vdev queue */
+extern void vdev_queue_stat_init(void);
+extern void vdev_queue_stat_fini(void);
+
 /* Initialization and termination */
 extern void spa_init(int flags);
 extern void spa_fini(void);
@@ -152,6 +152,8 @@ typedef enum zio_taskq_type {
 	ZIO_TASKQ_ISSUE_HIGH,
 	ZIO_TASKQ_INTERRUPT,
 	ZIO_TASKQ_INTERRUPT_HIGH,
+	ZIO_TASKQ_COMPUTE,
+	ZIO_TASKQ_COMPUTE_HIGH,
 	ZIO_TASKQ_TYPES
 } zio_taskq_type_t;
 
@@ -284,6 +286,7 @@ struct spa {
 	uint64_t	spa_scan_pass_scrub_spent_paused; /* total paused */
 	uint64_t	spa_scan_pass_exam;	/* examined bytes per pass */
 	uint64_t	spa_scan_pass_issued;	/* issued bytes per pass */
+	uint64_t	spa_scan_pass_meta_issued; /* metadata bytes per pass */
 
 	/*
 	 * We are in the middle of a resilver, and another resilver
@@ -310,6 +313,10 @@ struct spa {
 	spa_checkpoint_info_t spa_checkpoint_info; /* checkpoint accounting */
 	zthr_t		*spa_checkpoint_discard_zthr;
 
+	zthr_t		*spa_livelist_delete_zthr; /* frees deleted clones */
+	boolean_t	spa_livelist_delete_failed; /* stop until reimport */
+	zthr_t		*spa_livelist_condense_zthr; /* condenses livelists */
+
 	char		*spa_root;		/* alternate root directory */
 	uint64_t	spa_ena;		/* spa-wide ereport ENA */
 	int		spa_last_open_failed;	/* error if last open failed */
@@ -353,8 +360,13 @@ struct spa {
 	uint64_t	spa_ddt_stat_object;	/* DDT statistics */
 	uint64_t	spa_dedup_dspace;	/* Cache get_dedup_dspace() */
 	uint64_t	spa_dedup_checksum;	/* default dedup checksum */
+	zthr_t		*spa_ddt_warmup_zthr;	/* prefetches the DDT */
+	uint64_t	spa_ddt_warmup_total;	/* DDT bytes to warm up */
+	uint64_t	spa_ddt_warmup_bytes;	/* DDT bytes read so far */
+	boolean_t	spa_ddt_warmup_done;	/* DDT warm-up finished */
 	uint64_t	spa_dspace;		/* dspace in normal class */
 	kmutex_t	spa_vdev_top_lock;	/* dueling offline/remove */
+	kmutex_t	spa_vdev_load_lock;	/* parallel vdev_load() */
 	kmutex_t	spa_proc_lock;		/* protects spa_proc* */
 	kcondvar_t	spa_proc_cv;		/* spa_proc_state transitions */
 	spa_proc_state_t spa_proc_state;	/* see definition */
@@ -379,6 +391,7 @@ struct spa {
 	uint64_t	spa_all_vdev_zaps;	/* ZAP of per-vd ZAP obj #s */
 	spa_avz_action_t	spa_avz_action;	/* destroy/rebuild AVZ? */
 	uint64_t	spa_autotrim;		/* automatic background trim? */
+	uint64_t	spa_scan_latency;	/* scan throttle target (ms) */
 	uint64_t	spa_errata;		/* errata issues detected */
 	spa_stats_t	spa_stats;		/* assorted spa statistics */
 	spa_keystore_t	spa_keystore;		/* loaded crypto keys */
@@ -155,6 +155,11 @@ struct vdev_queue {
 	zio_t		vq_io_search; /* used as local for stack reduction */
 	kmutex_t	vq_lock;
 	uint64_t	vq_lastoffset;
+	uint32_t	vq_scan_max_active; /* adaptive scrub i/o limit */
+	boolean_t	vq_scan_throttled; /* limit below scrub_max_active */
+	hrtime_t	vq_fg_lat;	/* moving average of sync read latency */
+	hrtime_t	vq_fg_ts;	/* time last sync read completed */
+	hrtime_t	vq_scan_adjust_ts; /* time scrub limit last adjusted */
 };
 
 typedef enum vdev_alloc_bias {
@@ -236,6 +241,7 @@ struct vdev {
 	boolean_t	vdev_reopening;	/* reopen in progress?		*/
 	boolean_t	vdev_nonrot;	/* true if solid state		*/
 	int		vdev_open_error; /* error on last open		*/
+	int		vdev_load_error; /* error on last load		*/
 	kthread_t	*vdev_open_thread; /* thread opening children	*/
 	uint64_t	vdev_crtxg;	/* txg when top-level was added */
 
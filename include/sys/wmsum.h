@@ -0,0 +1,64 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+ */
+
+#ifndef	_SYS_WMSUM_H
+#define	_SYS_WMSUM_H
+
+#include <sys/zfs_context.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/*
+ * Write-mostly sums are per-CPU counters for statistics that are updated
+ * on hot paths but only read when somebody looks at a kstat.  Unlike an
+ * aggsum there is no global state to borrow from, so an update is a single
+ * atomic add to a cache line owned by the current CPU, and reading the
+ * value sums every bucket without taking any locks.  The value read is not
+ * a snapshot; it is only suitable for statistics, not for making decisions.
+ */
+typedef struct wmsum_bucket {
+	uint64_t wmsb_value;
+	uint64_t wmsb_pad[7]; /* pad out to cache line (64 bytes) */
+} wmsum_bucket_t __attribute__((aligned(64)));
+
+typedef struct wmsum {
+	uint_t wms_numbuckets;
+	wmsum_bucket_t *wms_buckets;
+} wmsum_t;
+
+void wmsum_init(wmsum_t *, uint64_t);
+void wmsum_fini(wmsum_t *);
+uint64_t wmsum_value(wmsum_t *);
+
+/*
+ * The thread may be migrated between picking its bucket and updating it,
+ * so the add is still atomic, but it is almost always to a line the CPU
+ * already owns.
+ */
+static inline void
+wmsum_add(wmsum_t *ws, int64_t delta)
+{
+	wmsum_bucket_t *wmsb = &ws->wms_buckets[CPU_SEQID % ws->wms_numbuckets];
+
+	atomic_add_64(&wmsb->wmsb_value, delta);
+}
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _SYS_WMSUM_H */
@@ -203,6 +203,7 @@ typedef struct kthread {
 #define	newproc(f,a,cid,pri,ctp,pid)	(ENOSYS)
 
 extern kthread_t *zk_thread_current(void);
+extern uint_t zk_thread_seqid(void);
 extern void zk_thread_exit(void);
 extern kthread_t *zk_thread_create(caddr_t stk, size_t  stksize,
 	thread_func_t func, void *arg, size_t len,
@@ -608,7 +609,7 @@ extern void delay(clock_t ticks);
 #define	defclsyspri	60
 #define	maxclsyspri	99
 
-#define	CPU_SEQID	((uint64_t)pthread_self() & (max_ncpus - 1))
+#define	CPU_SEQID	((uint64_t)zk_thread_seqid() & (max_ncpus - 1))
 
 #define	kcred		NULL
 #define	CRED()		NULL
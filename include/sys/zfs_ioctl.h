@@ -629,6 +629,9 @@ typedef enum zfs_ioc {
 	ZFS_IOC_POOL_TRIM,
 
 	ZFS_IOC_RECV_NEW,
+	ZFS_IOC_LIST_BATCH,
+	ZFS_IOC_OBJS_TO_STATS,
+	ZFS_IOC_POOL_VDEV_STATS,
 
 	/*
 	 * Linux - 3/64 numbers reserved.
@@ -48,6 +48,8 @@ typedef struct zfs_stat {
 
 extern int zfs_obj_to_stats(objset_t *osp, uint64_t obj, zfs_stat_t *sb,
     char *buf, int len);
+extern void zfs_obj_to_stats_batch(objset_t *osp, const uint64_t *objs,
+    uint_t n, zfs_stat_t *sbs, int32_t *errs, char **paths);
 
 #ifdef	__cplusplus
 }
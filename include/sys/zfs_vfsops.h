@@ -79,6 +79,7 @@ struct zfsvfs {
         struct zfs_fuid_info    *z_fuid_replay; /* fuid info for replay */
         uint64_t        z_assign;       /* TXG_NOWAIT or set by zil_replay() */
         zilog_t         *z_log;         /* intent log pointer */
+        dataset_kstats_t z_kstat;       /* per-dataset I/O kstats */
         uint_t          z_acl_mode;     /* acl chmod/mode behavior */
         uint_t          z_acl_inherit;  /* acl inheritance behavior */
         zfs_case_t      z_case;         /* case-sense */
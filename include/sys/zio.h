@@ -463,6 +463,9 @@ struct zio {
 	uint64_t	io_orig_size;
 	/* io_lsize != io_orig_size iff this is a raw write */
 	uint64_t	io_lsize;
+	/* checksum of io_abd taken at compression time, valid iff size != 0 */
+	zio_cksum_t	io_precksum;
+	uint64_t	io_precksum_size;
 
 	/* Stuff for the vdev stack */
 	vdev_t		*io_vd;
@@ -477,6 +480,7 @@ struct zio {
 	hrtime_t	io_delta;	/* vdev queue service delta */
 	hrtime_t	io_delay;	/* Device access time (disk or */
 					/* file). */
+	hrtime_t	io_compute_ts;	/* dispatched to compute taskq */
 	avl_node_t	io_queue_node;
 	avl_node_t	io_offset_node;
 	avl_node_t	io_alloc_node;
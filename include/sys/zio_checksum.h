@@ -133,6 +133,10 @@ extern enum zio_checksum spa_dedup_checksum(spa_t *spa);
 extern void zio_checksum_templates_free(spa_t *spa);
 extern spa_feature_t zio_checksum_to_feature(enum zio_checksum cksum);
 
+/* Checksum benchmark, see zfs_chksum.c */
+extern void chksum_init(void);
+extern void chksum_fini(void);
+
 #ifdef	__cplusplus
 }
 #endif
@@ -65,6 +65,7 @@ typedef enum spa_feature {
 	SPA_FEATURE_ALLOCATION_CLASSES,
 	SPA_FEATURE_BOOKMARK_V2,
 	SPA_FEATURE_RESILVER_DEFER,
+	SPA_FEATURE_LIVELIST,
 	SPA_FEATURES
 } spa_feature_t;
 
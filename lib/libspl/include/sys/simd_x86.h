@@ -146,7 +146,8 @@ typedef enum cpuid_inst_sets {
 	AVX512ER,
 	AVX512VL,
 	AES,
-	PCLMULQDQ
+	PCLMULQDQ,
+	SHA_NI
 } cpuid_inst_sets_t;
 
 /*
@@ -170,6 +171,7 @@ typedef struct cpuid_feature_desc {
 #define	_AVX512VL_BIT		(1U << 31) /* if used also check other levels */
 #define	_AES_BIT		(1U << 25)
 #define	_PCLMULQDQ_BIT		(1U << 1)
+#define	_SHA_NI_BIT		(1U << 29)
 
 /*
  * Descriptions of supported instruction sets
@@ -197,6 +199,7 @@ static const cpuid_feature_desc_t spl_cpuid_features[] = {
 	[AVX512VL]	= {7U, 0U, _AVX512ER_BIT,	EBX	},
 	[AES]		= {1U, 0U, _AES_BIT,		ECX	},
 	[PCLMULQDQ]	= {1U, 0U, _PCLMULQDQ_BIT,	ECX	},
+	[SHA_NI]	= {7U, 0U, _SHA_NI_BIT,		EBX	},
 };
 
 /*
@@ -269,6 +272,7 @@ CPUID_FEATURE_CHECK(avx512er, AVX512ER);
 CPUID_FEATURE_CHECK(avx512vl, AVX512VL);
 CPUID_FEATURE_CHECK(aes, AES);
 CPUID_FEATURE_CHECK(pclmulqdq, PCLMULQDQ);
+CPUID_FEATURE_CHECK(shani, SHA_NI);
 
 #endif /* !defined(_KERNEL) */
 
@@ -483,6 +487,23 @@ zfs_pclmulqdq_available(void)
 #endif
 }
 
+/*
+ * Check if SHA-NI instruction set is available
+ */
+static inline boolean_t
+zfs_shani_available(void)
+{
+#if defined(_KERNEL)
+#if defined(HAVE_SHA_NI) && defined(CPUID_LEAF7_FEATURE_SHA)
+	return !!(spl_cpuid_leaf7_features() & CPUID_LEAF7_FEATURE_SHA);
+#else
+	return (B_FALSE);
+#endif
+#elif !defined(_KERNEL)
+	return (__cpuid_has_shani());
+#endif
+}
+
 /*
  * AVX-512 family of instruction sets:
  *
@@ -41,6 +41,7 @@
 
 #include <errno.h>
 #include <sys/stat.h>
+#include <sys/sysmacros.h>
 #include <fcntl.h>
 #include <stddef.h>
 #include <string.h>
@@ -327,6 +328,8 @@ zpool_refresh_stats(zpool_handle_t *zhp, boolean_t *missing)
 	}
 
 	zhp->zpool_config = config;
+	zhp->zpool_old_config_gen = zhp->zpool_config_gen;
+	zhp->zpool_config_gen = 0;
 	if (error)
 		zhp->zpool_state = POOL_STATE_UNAVAIL;
 	else
@@ -335,6 +338,237 @@ zpool_refresh_stats(zpool_handle_t *zhp, boolean_t *missing)
 	return (0);
 }
 
+/*
+ * Location of each ZPOOL_CONFIG_VDEV_STATS_EX member in vdev_stat_ex_t.  A
+ * count of zero denotes a single uint64_t rather than an array.
+ */
+#define	VSX_MAP(name, member, count)	\
+	{ name, offsetof(vdev_stat_ex_t, member), count }
+
+static const struct {
+	const char	*vm_name;
+	size_t		vm_offset;
+	uint_t		vm_count;
+} vsx_map[] = {
+	VSX_MAP(ZPOOL_CONFIG_VDEV_SYNC_R_ACTIVE_QUEUE,
+	    vsx_active_queue[ZIO_PRIORITY_SYNC_READ], 0),
+	VSX_MAP(ZPOOL_CONFIG_VDEV_SYNC_W_ACTIVE_QUEUE,
+	    vsx_active_queue[ZIO_PRIORITY_SYNC_WRITE], 0),
+	VSX_MAP(ZPOOL_CONFIG_VDEV_ASYNC_R_ACTIVE_QUEUE,
+	    vsx_active_queue[ZIO_PRIORITY_ASYNC_READ], 0),
+	VSX_MAP(ZPOOL_CONFIG_VDEV_ASYNC_W_ACTIVE_QUEUE,
+	    vsx_active_queue[ZIO_PRIORITY_ASYNC_WRITE], 0),
+	VSX_MAP(ZPOOL_CONFIG_VDEV_SCRUB_ACTIVE_QUEUE,
+	    vsx_active_queue[ZIO_PRIORITY_SCRUB], 0),
+	VSX_MAP(ZPOOL_CONFIG_VDEV_TRIM_ACTIVE_QUEUE,
+	    vsx_active_queue[ZIO_PRIORITY_TRIM], 0),
+	VSX_MAP(ZPOOL_CONFIG_VDEV_SYNC_R_PEND_QUEUE,
+	    vsx_pend_queue[ZIO_PRIORITY_SYNC_READ], 0),
+	VSX_MAP(ZPOOL_CONFIG_VDEV_SYNC_W_PEND_QUEUE,
+	    vsx_pend_queue[ZIO_PRIORITY_SYNC_WRITE], 0),
+	VSX_MAP(ZPOOL_CONFIG_VDEV_ASYNC_R_PEND_QUEUE,
+	    vsx_pend_queue[ZIO_PRIORITY_ASYNC_READ], 0),
+	VSX_MAP(ZPOOL_CONFIG_VDEV_ASYNC_W_PEND_QUEUE,
+	    vsx_pend_queue[ZIO_PRIORITY_ASYNC_WRITE], 0),
+	VSX_MAP(ZPOOL_CONFIG_VDEV_SCRUB_PEND_QUEUE,
+	    vsx_pend_queue[ZIO_PRIORITY_SCRUB], 0),
+	VSX_MAP(ZPOOL_CONFIG_VDEV_TRIM_PEND_QUEUE,
+	    vsx_pend_queue[ZIO_PRIORITY_TRIM], 0),
+	VSX_MAP(ZPOOL_CONFIG_VDEV_TOT_R_LAT_HISTO,
+	    vsx_total_histo[ZIO_TYPE_READ], VDEV_L_HISTO_BUCKETS),
+	VSX_MAP(ZPOOL_CONFIG_VDEV_TOT_W_LAT_HISTO,
+	    vsx_total_histo[ZIO_TYPE_WRITE], VDEV_L_HISTO_BUCKETS),
+	VSX_MAP(ZPOOL_CONFIG_VDEV_DISK_R_LAT_HISTO,
+	    vsx_disk_histo[ZIO_TYPE_READ], VDEV_L_HISTO_BUCKETS),
+	VSX_MAP(ZPOOL_CONFIG_VDEV_DISK_W_LAT_HISTO,
+	    vsx_disk_histo[ZIO_TYPE_WRITE], VDEV_L_HISTO_BUCKETS),
+	VSX_MAP(ZPOOL_CONFIG_VDEV_SYNC_R_LAT_HISTO,
+	    vsx_queue_histo[ZIO_PRIORITY_SYNC_READ], VDEV_L_HISTO_BUCKETS),
+	VSX_MAP(ZPOOL_CONFIG_VDEV_SYNC_W_LAT_HISTO,
+	    vsx_queue_histo[ZIO_PRIORITY_SYNC_WRITE], VDEV_L_HISTO_BUCKETS),
+	VSX_MAP(ZPOOL_CONFIG_VDEV_ASYNC_R_LAT_HISTO,
+	    vsx_queue_histo[ZIO_PRIORITY_ASYNC_READ], VDEV_L_HISTO_BUCKETS),
+	VSX_MAP(ZPOOL_CONFIG_VDEV_ASYNC_W_LAT_HISTO,
+	    vsx_queue_histo[ZIO_PRIORITY_ASYNC_WRITE], VDEV_L_HISTO_BUCKETS),
+	VSX_MAP(ZPOOL_CONFIG_VDEV_SCRUB_LAT_HISTO,
+	    vsx_queue_histo[ZIO_PRIORITY_SCRUB], VDEV_L_HISTO_BUCKETS),
+	VSX_MAP(ZPOOL_CONFIG_VDEV_TRIM_LAT_HISTO,
+	    vsx_queue_histo[ZIO_PRIORITY_TRIM], VDEV_L_HISTO_BUCKETS),
+	VSX_MAP(ZPOOL_CONFIG_VDEV_SYNC_IND_R_HISTO,
+	    vsx_ind_histo[ZIO_PRIORITY_SYNC_READ], VDEV_RQ_HISTO_BUCKETS),
+	VSX_MAP(ZPOOL_CONFIG_VDEV_SYNC_IND_W_HISTO,
+	    vsx_ind_histo[ZIO_PRIORITY_SYNC_WRITE], VDEV_RQ_HISTO_BUCKETS),
+	VSX_MAP(ZPOOL_CONFIG_VDEV_ASYNC_IND_R_HISTO,
+	    vsx_ind_histo[ZIO_PRIORITY_ASYNC_READ], VDEV_RQ_HISTO_BUCKETS),
+	VSX_MAP(ZPOOL_CONFIG_VDEV_ASYNC_IND_W_HISTO,
+	    vsx_ind_histo[ZIO_PRIORITY_ASYNC_WRITE], VDEV_RQ_HISTO_BUCKETS),
+	VSX_MAP(ZPOOL_CONFIG_VDEV_IND_SCRUB_HISTO,
+	    vsx_ind_histo[ZIO_PRIORITY_SCRUB], VDEV_RQ_HISTO_BUCKETS),
+	VSX_MAP(ZPOOL_CONFIG_VDEV_IND_TRIM_HISTO,
+	    vsx_ind_histo[ZIO_PRIORITY_TRIM], VDEV_RQ_HISTO_BUCKETS),
+	VSX_MAP(ZPOOL_CONFIG_VDEV_SYNC_AGG_R_HISTO,
+	    vsx_agg_histo[ZIO_PRIORITY_SYNC_READ], VDEV_RQ_HISTO_BUCKETS),
+	VSX_MAP(ZPOOL_CONFIG_VDEV_SYNC_AGG_W_HISTO,
+	    vsx_agg_histo[ZIO_PRIORITY_SYNC_WRITE], VDEV_RQ_HISTO_BUCKETS),
+	VSX_MAP(ZPOOL_CONFIG_VDEV_ASYNC_AGG_R_HISTO,
+	    vsx_agg_histo[ZIO_PRIORITY_ASYNC_READ], VDEV_RQ_HISTO_BUCKETS),
+	VSX_MAP(ZPOOL_CONFIG_VDEV_ASYNC_AGG_W_HISTO,
+	    vsx_agg_histo[ZIO_PRIORITY_ASYNC_WRITE], VDEV_RQ_HISTO_BUCKETS),
+	VSX_MAP(ZPOOL_CONFIG_VDEV_AGG_SCRUB_HISTO,
+	    vsx_agg_histo[ZIO_PRIORITY_SCRUB], VDEV_RQ_HISTO_BUCKETS),
+	VSX_MAP(ZPOOL_CONFIG_VDEV_AGG_TRIM_HISTO,
+	    vsx_agg_histo[ZIO_PRIORITY_TRIM], VDEV_RQ_HISTO_BUCKETS),
+};
+
+/*
+ * Copy one ZFS_IOC_POOL_VDEV_STATS record into the stats of the matching
+ * vdev config.  Returns -1 if the record is for a different vdev.
+ */
+static int
+vdev_stats_update(nvlist_t *nv, const uint64_t *rec, boolean_t extended)
+{
+	const char *vsx = (const char *)(rec + 1 +
+	    sizeof (vdev_stat_t) / sizeof (uint64_t));
+	nvlist_t *nvx;
+	uint64_t guid, *vs, *val;
+	uint_t c;
+	int i;
+
+	if (nvlist_lookup_uint64(nv, ZPOOL_CONFIG_GUID, &guid) != 0 ||
+	    guid != rec[0])
+		return (-1);
+
+	if (nvlist_lookup_uint64_array(nv, ZPOOL_CONFIG_VDEV_STATS,
+	    &vs, &c) != 0)
+		return (0);
+	if (c != sizeof (vdev_stat_t) / sizeof (uint64_t))
+		return (-1);
+	memcpy(vs, rec + 1, sizeof (vdev_stat_t));
+
+	if (!extended ||
+	    nvlist_lookup_nvlist(nv, ZPOOL_CONFIG_VDEV_STATS_EX, &nvx) != 0)
+		return (0);
+
+	for (i = 0; i < ARRAY_SIZE(vsx_map); i++) {
+		const uint64_t *src = (const uint64_t *)
+		    (vsx + vsx_map[i].vm_offset);
+
+		if (vsx_map[i].vm_count == 0) {
+			if (nvlist_exists(nvx, vsx_map[i].vm_name))
+				fnvlist_add_uint64(nvx, vsx_map[i].vm_name,
+				    *src);
+		} else if (nvlist_lookup_uint64_array(nvx, vsx_map[i].vm_name,
+		    &val, &c) == 0) {
+			if (c != vsx_map[i].vm_count)
+				return (-1);
+			memcpy(val, src, c * sizeof (uint64_t));
+		}
+	}
+
+	return (0);
+}
+
+static int
+vdev_stats_update_tree(nvlist_t *nv, const uint64_t **recp,
+    const uint64_t *end, uint64_t words, boolean_t extended)
+{
+	nvlist_t **child;
+	uint_t c, children;
+
+	if (*recp + words > end || vdev_stats_update(nv, *recp, extended) != 0)
+		return (-1);
+	*recp += words;
+
+	if (nvlist_lookup_nvlist_array(nv, ZPOOL_CONFIG_CHILDREN,
+	    &child, &children) == 0) {
+		for (c = 0; c < children; c++) {
+			if (vdev_stats_update_tree(child[c], recp, end, words,
+			    extended) != 0)
+				return (-1);
+		}
+	}
+
+	return (0);
+}
+
+/*
+ * Refresh only the vdev statistics of the given pool.  This is meant for
+ * 'zpool iostat', which polls large pools at short intervals and would
+ * otherwise fetch and unpack the whole config each time.  The stats are
+ * fetched with lzc_pool_vdev_stats() and copied into the previous config,
+ * which then becomes the current one, so no config is generated, packed
+ * or unpacked.  Only the vdev tree and cache devices are updated, and the
+ * extended stats only if 'extended' is set.  Whenever the pool layout may
+ * have changed this falls back to zpool_refresh_stats().
+ */
+int
+zpool_refresh_vdev_stats(zpool_handle_t *zhp, boolean_t extended,
+    boolean_t *missing)
+{
+	nvlist_t *result, *config, *nvroot, **l2cache;
+	const uint64_t *rec, *end;
+	uint64_t *recs, gen, words;
+	uint_t c, nrecs, nl2cache;
+	int error;
+
+	*missing = B_FALSE;
+
+	if (lzc_pool_vdev_stats(zhp->zpool_name, extended, &result) != 0)
+		return (zpool_refresh_stats(zhp, missing));
+
+	if (nvlist_lookup_uint64(result, ZPOOL_VDEV_STATS_GENERATION,
+	    &gen) != 0 ||
+	    nvlist_lookup_uint64(result, ZPOOL_VDEV_STATS_RECORD_SIZE,
+	    &words) != 0 || words != ZPOOL_VDEV_STATS_WORDS(extended) ||
+	    nvlist_lookup_uint64_array(result, ZPOOL_VDEV_STATS_RECORDS,
+	    &recs, &nrecs) != 0) {
+		nvlist_free(result);
+		return (zpool_refresh_stats(zhp, missing));
+	}
+
+	/*
+	 * Both configs must be of the current generation for the old one
+	 * to be reused.  Otherwise refresh the whole config, and remember
+	 * the generation it was fetched at.
+	 */
+	config = zhp->zpool_old_config;
+	if (config == NULL || zhp->zpool_config_gen != gen + 1 ||
+	    zhp->zpool_old_config_gen != gen + 1) {
+		nvlist_free(result);
+		error = zpool_refresh_stats(zhp, missing);
+		if (error == 0 && !*missing)
+			zhp->zpool_config_gen = gen + 1;
+		return (error);
+	}
+
+	rec = recs;
+	end = recs + nrecs;
+	error = nvlist_lookup_nvlist(config, ZPOOL_CONFIG_VDEV_TREE, &nvroot);
+	if (error == 0)
+		error = vdev_stats_update_tree(nvroot, &rec, end, words,
+		    extended);
+	if (error == 0 && nvlist_lookup_nvlist_array(nvroot,
+	    ZPOOL_CONFIG_L2CACHE, &l2cache, &nl2cache) == 0) {
+		for (c = 0; c < nl2cache && error == 0; c++) {
+			if (rec + words > end ||
+			    vdev_stats_update(l2cache[c], rec, extended) != 0)
+				error = -1;
+			rec += words;
+		}
+	}
+	nvlist_free(result);
+
+	if (error != 0 || rec != end) {
+		zhp->zpool_config_gen = zhp->zpool_old_config_gen = 0;
+		return (zpool_refresh_stats(zhp, missing));
+	}
+
+	zhp->zpool_old_config = zhp->zpool_config;
+	zhp->zpool_config = config;
+
+	return (0);
+}
+
 /*
  * The following environment variables are undocumented
  * and should be used for testing purposes only:
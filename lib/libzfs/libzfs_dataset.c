@@ -372,25 +372,24 @@ get_recvd_props_ioctl(zfs_handle_t *zhp)
 	return (0);
 }
 
+/*
+ * Store the given stats and properties in the handle.  On success, the handle
+ * takes ownership of allprops.
+ */
 static int
-put_stats_zhdl(zfs_handle_t *zhp, zfs_cmd_t *zc)
+put_stats_zhdl_nvl(zfs_handle_t *zhp, const dmu_objset_stats_t *stats,
+    nvlist_t *allprops)
 {
-	nvlist_t *allprops, *userprops;
+	nvlist_t *userprops;
 
-	zhp->zfs_dmustats = zc->zc_objset_stats; /* structure assignment */
-
-	if (zcmd_read_dst_nvlist(zhp->zfs_hdl, zc, &allprops) != 0) {
-		return (-1);
-	}
+	zhp->zfs_dmustats = *stats; /* structure assignment */
 
 	/*
 	 * XXX Why do we store the user props separately, in addition to
 	 * storing them in zfs_props?
 	 */
-	if ((userprops = process_user_props(zhp, allprops)) == NULL) {
-		nvlist_free(allprops);
+	if ((userprops = process_user_props(zhp, allprops)) == NULL)
 		return (-1);
-	}
 
 	nvlist_free(zhp->zfs_props);
 	nvlist_free(zhp->zfs_user_props);
@@ -401,6 +400,23 @@ put_stats_zhdl(zfs_handle_t *zhp, zfs_cmd_t *zc)
 	return (0);
 }
 
+static int
+put_stats_zhdl(zfs_handle_t *zhp, zfs_cmd_t *zc)
+{
+	nvlist_t *allprops;
+
+	if (zcmd_read_dst_nvlist(zhp->zfs_hdl, zc, &allprops) != 0) {
+		return (-1);
+	}
+
+	if (put_stats_zhdl_nvl(zhp, &zc->zc_objset_stats, allprops) != 0) {
+		nvlist_free(allprops);
+		return (-1);
+	}
+
+	return (0);
+}
+
 static int
 get_stats(zfs_handle_t *zhp)
 {
@@ -427,15 +443,11 @@ zfs_refresh_properties(zfs_handle_t *zhp)
 }
 
 /*
- * Makes a handle from the given dataset name.  Used by zfs_open() and
- * zfs_iter_* to create child handles on the fly.
+ * Set the types of a handle whose stats have been filled in.
  */
 static int
-make_dataset_handle_common(zfs_handle_t *zhp, zfs_cmd_t *zc)
+make_dataset_handle_type(zfs_handle_t *zhp)
 {
-	if (put_stats_zhdl(zhp, zc) != 0)
-		return (-1);
-
 	/*
 	 * We've managed to open the dataset and gather statistics.  Determine
 	 * the high-level type.
@@ -464,6 +476,19 @@ make_dataset_handle_common(zfs_handle_t *zhp, zfs_cmd_t *zc)
 	return (0);
 }
 
+/*
+ * Makes a handle from the given dataset name.  Used by zfs_open() and
+ * zfs_iter_* to create child handles on the fly.
+ */
+static int
+make_dataset_handle_common(zfs_handle_t *zhp, zfs_cmd_t *zc)
+{
+	if (put_stats_zhdl(zhp, zc) != 0)
+		return (-1);
+
+	return (make_dataset_handle_type(zhp));
+}
+
 zfs_handle_t *
 make_dataset_handle(libzfs_handle_t *hdl, const char *path)
 {
@@ -510,8 +535,52 @@ make_dataset_handle_zc(libzfs_handle_t *hdl, zfs_cmd_t *zc)
 	return (zhp);
 }
 
+/*
+ * Makes a handle from one of the dataset entries returned by
+ * ZFS_IOC_LIST_BATCH.
+ */
 zfs_handle_t *
-make_dataset_simple_handle_zc(zfs_handle_t *pzhp, zfs_cmd_t *zc)
+make_dataset_handle_nvl(libzfs_handle_t *hdl, const char *name,
+    nvlist_t *entry)
+{
+	dmu_objset_stats_t stats;
+	nvlist_t *props;
+	uint8_t *statbuf;
+	uint_t statlen;
+	zfs_handle_t *zhp;
+
+	if (nvlist_lookup_uint8_array(entry, ZFS_LIST_BATCH_STATS,
+	    &statbuf, &statlen) != 0 || statlen != sizeof (stats) ||
+	    nvlist_lookup_nvlist(entry, ZFS_LIST_BATCH_PROPS, &props) != 0)
+		return (NULL);
+	(void) memcpy(&stats, statbuf, sizeof (stats));
+
+	if ((zhp = calloc(sizeof (zfs_handle_t), 1)) == NULL)
+		return (NULL);
+
+	zhp->zfs_hdl = hdl;
+	(void) strlcpy(zhp->zfs_name, name, sizeof (zhp->zfs_name));
+	if (nvlist_dup(props, &props, 0) != 0) {
+		(void) no_memory(hdl);
+		free(zhp);
+		return (NULL);
+	}
+	if (put_stats_zhdl_nvl(zhp, &stats, props) != 0) {
+		nvlist_free(props);
+		free(zhp);
+		return (NULL);
+	}
+	if (make_dataset_handle_type(zhp) != 0) {
+		nvlist_free(zhp->zfs_props);
+		nvlist_free(zhp->zfs_user_props);
+		free(zhp);
+		return (NULL);
+	}
+	return (zhp);
+}
+
+zfs_handle_t *
+make_dataset_simple_handle(zfs_handle_t *pzhp, const char *name)
 {
 	zfs_handle_t *zhp = calloc(sizeof (zfs_handle_t), 1);
 
@@ -519,7 +588,7 @@ make_dataset_simple_handle_zc(zfs_handle_t *pzhp, zfs_cmd_t *zc)
 		return (NULL);
 
 	zhp->zfs_hdl = pzhp->zfs_hdl;
-	(void) strlcpy(zhp->zfs_name, zc->zc_name, sizeof (zhp->zfs_name));
+	(void) strlcpy(zhp->zfs_name, name, sizeof (zhp->zfs_name));
 	zhp->zfs_head_type = pzhp->zfs_type;
 	zhp->zfs_type = ZFS_TYPE_SNAPSHOT;
 	zhp->zpool_hdl = zpool_handle(zhp);
@@ -527,6 +596,12 @@ make_dataset_simple_handle_zc(zfs_handle_t *pzhp, zfs_cmd_t *zc)
 	return (zhp);
 }
 
+zfs_handle_t *
+make_dataset_simple_handle_zc(zfs_handle_t *pzhp, zfs_cmd_t *zc)
+{
+	return (make_dataset_simple_handle(pzhp, zc->zc_name));
+}
+
 zfs_handle_t *
 zfs_handle_dup(zfs_handle_t *zhp_orig)
 {
@@ -851,6 +926,7 @@ libzfs_mnttab_update(libzfs_handle_t *hdl)
 void
 libzfs_mnttab_init(libzfs_handle_t *hdl)
 {
+	pthread_mutex_init(&hdl->libzfs_mnttab_cache_lock, NULL);
 	assert(avl_numnodes(&hdl->libzfs_mnttab_cache) == 0);
 	avl_create(&hdl->libzfs_mnttab_cache, libzfs_mnttab_cache_compare,
 	    sizeof (mnttab_node_t), offsetof(mnttab_node_t, mtn_node));
@@ -885,7 +961,13 @@ libzfs_mnttab_find(libzfs_handle_t *hdl, const char *fsname,
 {
 	mnttab_node_t find;
 	mnttab_node_t *mtn;
+	int ret = ENOENT;
 
+	/*
+	 * The cache is shared by the threads mounting and unmounting
+	 * datasets in parallel (see zpool_enable_datasets()).
+	 */
+	pthread_mutex_lock(&hdl->libzfs_mnttab_cache_lock);
 	if (!hdl->libzfs_mnttab_enable) {
 		struct mnttab srch = { 0 };
 
@@ -895,9 +977,9 @@ libzfs_mnttab_find(libzfs_handle_t *hdl, const char *fsname,
 		//srch.mnt_fstype = MNTTYPE_ZFS;
 		srch.mnt_fstype = NULL; // search for zfs or mimic
 		if (getmntany(hdl->libzfs_mnttab, entry, &srch) == 0)
-			return (0);
-		else
-			return (ENOENT);
+			ret = 0;
+		pthread_mutex_unlock(&hdl->libzfs_mnttab_cache_lock);
+		return (ret);
 	}
 
 	if (avl_numnodes(&hdl->libzfs_mnttab_cache) == 0)
@@ -907,9 +989,10 @@ libzfs_mnttab_find(libzfs_handle_t *hdl, const char *fsname,
 	mtn = avl_find(&hdl->libzfs_mnttab_cache, &find, NULL);
 	if (mtn) {
 		*entry = mtn->mtn_mt;
-		return (0);
+		ret = 0;
 	}
-	return (ENOENT);
+	pthread_mutex_unlock(&hdl->libzfs_mnttab_cache_lock);
+	return (ret);
 }
 
 
@@ -920,8 +1003,11 @@ libzfs_mnttab_add(libzfs_handle_t *hdl, const char *special,
 {
 	mnttab_node_t *mtn;
 
-	if (avl_numnodes(&hdl->libzfs_mnttab_cache) == 0)
+	pthread_mutex_lock(&hdl->libzfs_mnttab_cache_lock);
+	if (avl_numnodes(&hdl->libzfs_mnttab_cache) == 0) {
+		pthread_mutex_unlock(&hdl->libzfs_mnttab_cache_lock);
 		return;
+	}
 	mtn = zfs_alloc(hdl, sizeof (mnttab_node_t));
 	mtn->mtn_mt.mnt_special = zfs_strdup(hdl, special);
 	mtn->mtn_mt.mnt_mountp = zfs_strdup(hdl, mountp);
@@ -929,6 +1015,7 @@ libzfs_mnttab_add(libzfs_handle_t *hdl, const char *special,
 	if (mntopts != NULL)
 		mtn->mtn_mt.mnt_mntopts = zfs_strdup(hdl, mntopts);
 	avl_add(&hdl->libzfs_mnttab_cache, mtn);
+	pthread_mutex_unlock(&hdl->libzfs_mnttab_cache_lock);
 }
 
 void
@@ -938,6 +1025,7 @@ libzfs_mnttab_remove(libzfs_handle_t *hdl, const char *fsname)
 	mnttab_node_t *ret;
 
 	find.mtn_mt.mnt_special = (char *)fsname;
+	pthread_mutex_lock(&hdl->libzfs_mnttab_cache_lock);
 	if ((ret = avl_find(&hdl->libzfs_mnttab_cache, (void *)&find, NULL))) {
 		avl_remove(&hdl->libzfs_mnttab_cache, ret);
 		free(ret->mtn_mt.mnt_special);
@@ -947,6 +1035,7 @@ libzfs_mnttab_remove(libzfs_handle_t *hdl, const char *fsname)
 			free(ret->mtn_mt.mnt_mntopts);
 		free(ret);
 	}
+	pthread_mutex_unlock(&hdl->libzfs_mnttab_cache_lock);
 }
 
 int
@@ -4849,7 +4938,8 @@ zfs_prune_proplist(zfs_handle_t *zhp, uint8_t *props)
 
 	/*
 	 * Keep a reference to the props-table against which we prune the
-	 * properties.
+	 * properties.  zfs_iter_filesystems() and zfs_iter_snapshots() also
+	 * use it to have the kernel prune the properties of the children.
 	 */
 	zhp->zfs_props_table = props;
 
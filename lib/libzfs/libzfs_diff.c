@@ -45,6 +45,7 @@
 #include <pthread.h>
 #include <sys/zfs_ioctl.h>
 #include <libzfs.h>
+#include <libzfs_core.h>
 #include "libzfs_impl.h"
 
 #define	ZDIFF_SNAPDIR		"/.zfs/snapshot/"
@@ -70,6 +71,7 @@ typedef struct differ_info {
 	boolean_t scripted;
 	boolean_t classify;
 	boolean_t timestamped;
+	boolean_t batched;
 	uint64_t shares;
 	int zerr;
 	int cleanupfd;
@@ -78,34 +80,12 @@ typedef struct differ_info {
 } differ_info_t;
 
 /*
- * Given a {dsname, object id}, get the object path
+ * Describe the failure, in di->zerr, to look up an object.
  */
 static int
-get_stats_for_obj(differ_info_t *di, const char *dsname, uint64_t obj,
-    char *pn, int maxlen, zfs_stat_t *sb)
+stats_for_obj_error(differ_info_t *di, const char *dsname, uint64_t obj)
 {
-	zfs_cmd_t zc = {"\0"};
-	int error;
-
-	(void) strlcpy(zc.zc_name, dsname, sizeof (zc.zc_name));
-	zc.zc_obj = obj;
-
-	errno = 0;
-	error = zfs_ioctl(di->zhp->zfs_hdl, ZFS_IOC_OBJ_TO_STATS, &zc);
-	di->zerr = errno;
-
-	/* we can get stats even if we failed to get a path */
-	(void) memcpy(sb, &zc.zc_stat, sizeof (zfs_stat_t));
-	if (error == 0) {
-		ASSERT(di->zerr == 0);
-		(void) strlcpy(pn, zc.zc_value, maxlen);
-		return (0);
-	}
-
-	if (di->zerr == ESTALE) {
-		(void) snprintf(pn, maxlen, "(on_delete_queue)");
-		return (0);
-	} else if (di->zerr == EPERM) {
+	if (di->zerr == EPERM) {
 		(void) snprintf(di->errbuf, sizeof (di->errbuf),
 		    dgettext(TEXT_DOMAIN,
 		    "The sys_config privilege or diff delegated permission "
@@ -125,6 +105,153 @@ get_stats_for_obj(differ_info_t *di, const char *dsname, uint64_t obj,
 	}
 }
 
+/*
+ * Interpret the result of looking up the path and stats of an object.
+ */
+static int
+stats_for_obj_result(differ_info_t *di, const char *dsname, uint64_t obj,
+    int error, const char *path, char *pn, int maxlen)
+{
+	di->zerr = error;
+	if (error == 0) {
+		(void) strlcpy(pn, path, maxlen);
+		return (0);
+	}
+
+	if (di->zerr == ESTALE) {
+		(void) snprintf(pn, maxlen, "(on_delete_queue)");
+		return (0);
+	}
+	return (stats_for_obj_error(di, dsname, obj));
+}
+
+/*
+ * Given a {dsname, object id}, get the object path
+ */
+static int
+get_stats_for_obj(differ_info_t *di, const char *dsname, uint64_t obj,
+    char *pn, int maxlen, zfs_stat_t *sb)
+{
+	zfs_cmd_t zc = {"\0"};
+	int error;
+
+	(void) strlcpy(zc.zc_name, dsname, sizeof (zc.zc_name));
+	zc.zc_obj = obj;
+
+	errno = 0;
+	error = zfs_ioctl(di->zhp->zfs_hdl, ZFS_IOC_OBJ_TO_STATS, &zc);
+
+	/* we can get stats even if we failed to get a path */
+	(void) memcpy(sb, &zc.zc_stat, sizeof (zfs_stat_t));
+	return (stats_for_obj_result(di, dsname, obj,
+	    (error == 0) ? 0 : errno, zc.zc_value, pn, maxlen));
+}
+
+/*
+ * The stats and paths of the allocated objects in a range of a snapshot,
+ * fetched with ZFS_IOC_OBJS_TO_STATS a batch at a time and consumed in
+ * object order.
+ */
+typedef struct differ_objs {
+	const char *do_dsname;
+	uint64_t do_next;	/* first object not yet fetched */
+	uint64_t do_last;	/* last object of the range */
+	boolean_t do_done;	/* the whole range has been fetched */
+	nvlist_t *do_nvl;
+	uint64_t *do_objs;
+	int32_t *do_errs;
+	uint8_t *do_stats;
+	char **do_paths;
+	uint_t do_count;
+	uint_t do_idx;		/* next entry to consume */
+} differ_objs_t;
+
+static void
+differ_objs_init(differ_objs_t *dobjs, const char *dsname, uint64_t first,
+    uint64_t last)
+{
+	(void) memset(dobjs, 0, sizeof (*dobjs));
+	dobjs->do_dsname = dsname;
+	dobjs->do_next = first;
+	dobjs->do_last = last;
+}
+
+static void
+differ_objs_fini(differ_objs_t *dobjs)
+{
+	nvlist_free(dobjs->do_nvl);
+}
+
+/*
+ * Find the next allocated object of the range, fetching another batch if
+ * needed.  Returns 1 once the range is exhausted, and -1 on error.
+ */
+static int
+differ_objs_peek(differ_info_t *di, differ_objs_t *dobjs, uint64_t *objp)
+{
+	uint_t nerrs, nstats, npaths;
+	int err;
+
+	while (dobjs->do_idx == dobjs->do_count) {
+		if (dobjs->do_done)
+			return (1);
+
+		nvlist_free(dobjs->do_nvl);
+		dobjs->do_nvl = NULL;
+		dobjs->do_idx = dobjs->do_count = 0;
+
+		err = lzc_objs_to_stats(dobjs->do_dsname, dobjs->do_next,
+		    dobjs->do_last, &dobjs->do_nvl);
+		if (err != 0) {
+			di->zerr = err;
+			return (stats_for_obj_error(di, dobjs->do_dsname,
+			    dobjs->do_next));
+		}
+
+		if (nvlist_lookup_uint64_array(dobjs->do_nvl,
+		    ZFS_OBJS_TO_STATS_OBJECTS, &dobjs->do_objs,
+		    &dobjs->do_count) != 0 ||
+		    nvlist_lookup_int32_array(dobjs->do_nvl,
+		    ZFS_OBJS_TO_STATS_ERRORS, &dobjs->do_errs, &nerrs) != 0 ||
+		    nvlist_lookup_uint8_array(dobjs->do_nvl,
+		    ZFS_OBJS_TO_STATS_STATS, &dobjs->do_stats, &nstats) != 0 ||
+		    nvlist_lookup_string_array(dobjs->do_nvl,
+		    ZFS_OBJS_TO_STATS_PATHS, &dobjs->do_paths, &npaths) != 0 ||
+		    nerrs != dobjs->do_count || npaths != dobjs->do_count ||
+		    nstats != dobjs->do_count * sizeof (zfs_stat_t)) {
+			dobjs->do_count = 0;
+			di->zerr = EPIPE;
+			(void) snprintf(di->errbuf, sizeof (di->errbuf),
+			    dgettext(TEXT_DOMAIN,
+			    "Internal error: bad data from diff IOCTL"));
+			return (-1);
+		}
+
+		if (nvlist_lookup_uint64(dobjs->do_nvl, ZFS_OBJS_TO_STATS_NEXT,
+		    &dobjs->do_next) != 0)
+			dobjs->do_done = B_TRUE;
+	}
+
+	*objp = dobjs->do_objs[dobjs->do_idx];
+	return (0);
+}
+
+/*
+ * Consume the object found by differ_objs_peek(), returning its stats and
+ * path as get_stats_for_obj() does.
+ */
+static int
+differ_objs_take(differ_info_t *di, differ_objs_t *dobjs, char *pn,
+    int maxlen, zfs_stat_t *sb)
+{
+	uint_t i = dobjs->do_idx++;
+
+	(void) memcpy(sb, dobjs->do_stats + i * sizeof (zfs_stat_t),
+	    sizeof (zfs_stat_t));
+	return (stats_for_obj_result(di, dobjs->do_dsname, dobjs->do_objs[i],
+	    dobjs->do_errs[i], dobjs->do_paths[i], pn, maxlen));
+}
+
 /*
  * stream_bytes
  *
@@ -258,34 +385,19 @@ print_file(FILE *fp, differ_info_t *di, char type, const char *file,
 	(void) fprintf(fp, "\n");
 }
 
+/*
+ * Report the change to an object, given its stats and path (or the failure
+ * to get them) in the from and to snapshots.
+ */
 static int
-write_inuse_diffs_one(FILE *fp, differ_info_t *di, uint64_t dobj)
+write_inuse_diffs_stats(FILE *fp, differ_info_t *di,
+    int fobjerr, char *fobjname, struct zfs_stat *fsbp,
+    int tobjerr, char *tobjname, struct zfs_stat *tsbp)
 {
-	struct zfs_stat fsb, tsb;
+	struct zfs_stat fsb = *fsbp, tsb = *tsbp;
 	mode_t fmode, tmode;
-	char fobjname[MAXPATHLEN], tobjname[MAXPATHLEN];
-	int fobjerr, tobjerr;
 	int change;
 
-	if (dobj == di->shares)
-		return (0);
-
-	/*
-	 * Check the from and to snapshots for info on the object. If
-	 * we get ENOENT, then the object just didn't exist in that
-	 * snapshot.  If we get ENOTSUP, then we tried to get
-	 * info on a non-ZPL object, which we don't care about anyway.
-	 */
-	fobjerr = get_stats_for_obj(di, di->fromsnap, dobj, fobjname,
-	    MAXPATHLEN, &fsb);
-	if (fobjerr && di->zerr != ENOENT && di->zerr != ENOTSUP)
-		return (-1);
-
-	tobjerr = get_stats_for_obj(di, di->tosnap, dobj, tobjname,
-	    MAXPATHLEN, &tsb);
-	if (tobjerr && di->zerr != ENOENT && di->zerr != ENOTSUP)
-		return (-1);
-
 	/*
 	 * Unallocated object sharing the same meta dnode block
 	 */
@@ -346,12 +458,124 @@ write_inuse_diffs_one(FILE *fp, differ_info_t *di, uint64_t dobj)
 	}
 }
 
+static int
+write_inuse_diffs_one(FILE *fp, differ_info_t *di, uint64_t dobj)
+{
+	struct zfs_stat fsb, tsb;
+	char fobjname[MAXPATHLEN], tobjname[MAXPATHLEN];
+	int fobjerr, tobjerr;
+
+	if (dobj == di->shares)
+		return (0);
+
+	/*
+	 * Check the from and to snapshots for info on the object. If
+	 * we get ENOENT, then the object just didn't exist in that
+	 * snapshot.  If we get ENOTSUP, then we tried to get
+	 * info on a non-ZPL object, which we don't care about anyway.
+	 */
+	fobjerr = get_stats_for_obj(di, di->fromsnap, dobj, fobjname,
+	    MAXPATHLEN, &fsb);
+	if (fobjerr && di->zerr != ENOENT && di->zerr != ENOTSUP)
+		return (-1);
+
+	tobjerr = get_stats_for_obj(di, di->tosnap, dobj, tobjname,
+	    MAXPATHLEN, &tsb);
+	if (tobjerr && di->zerr != ENOENT && di->zerr != ENOTSUP)
+		return (-1);
+
+	return (write_inuse_diffs_stats(fp, di, fobjerr, fobjname, &fsb,
+	    tobjerr, tobjname, &tsb));
+}
+
+/*
+ * Take the stats and path of dobj from a batch, if it is the next object of
+ * the batch.  Otherwise dobj is not allocated in that snapshot, which is
+ * reported as ENOENT, as get_stats_for_obj() would.
+ */
+static int
+write_inuse_diffs_take(differ_info_t *di, differ_objs_t *dobjs, int rc,
+    uint64_t obj, uint64_t dobj, char *pn, zfs_stat_t *sb)
+{
+	if (rc == 0 && obj == dobj)
+		return (differ_objs_take(di, dobjs, pn, MAXPATHLEN, sb));
+
+	(void) memset(sb, 0, sizeof (zfs_stat_t));
+	di->zerr = ENOENT;
+	return (-1);
+}
+
+/*
+ * Walk the objects allocated in either snapshot in object order, rather
+ * than asking about each object of the range twice.
+ */
+static int
+write_inuse_diffs_batched(FILE *fp, differ_info_t *di, dmu_diff_record_t *dr)
+{
+	differ_objs_t from, to;
+	struct zfs_stat fsb, tsb;
+	char fobjname[MAXPATHLEN], tobjname[MAXPATHLEN];
+	uint64_t fobj = 0, tobj = 0, dobj;
+	int fobjerr, tobjerr, frc, trc;
+	int err = 0;
+
+	differ_objs_init(&from, di->fromsnap, dr->ddr_first, dr->ddr_last);
+	differ_objs_init(&to, di->tosnap, dr->ddr_first, dr->ddr_last);
+
+	for (;;) {
+		if ((frc = differ_objs_peek(di, &from, &fobj)) < 0 ||
+		    (trc = differ_objs_peek(di, &to, &tobj)) < 0) {
+			err = -1;
+			break;
+		}
+		if (frc != 0 && trc != 0)
+			break;
+
+		if (frc != 0)
+			dobj = tobj;
+		else if (trc != 0)
+			dobj = fobj;
+		else
+			dobj = MIN(fobj, tobj);
+
+		fobjerr = write_inuse_diffs_take(di, &from, frc, fobj, dobj,
+		    fobjname, &fsb);
+		if (fobjerr && di->zerr != ENOENT && di->zerr != ENOTSUP) {
+			err = -1;
+			break;
+		}
+
+		tobjerr = write_inuse_diffs_take(di, &to, trc, tobj, dobj,
+		    tobjname, &tsb);
+		if (tobjerr && di->zerr != ENOENT && di->zerr != ENOTSUP) {
+			err = -1;
+			break;
+		}
+
+		if (dobj == di->shares) {
+			di->zerr = 0;
+			continue;
+		}
+
+		if ((err = write_inuse_diffs_stats(fp, di, fobjerr, fobjname,
+		    &fsb, tobjerr, tobjname, &tsb)) != 0)
+			break;
+	}
+
+	differ_objs_fini(&from);
+	differ_objs_fini(&to);
+	return (err);
+}
+
 static int
 write_inuse_diffs(FILE *fp, differ_info_t *di, dmu_diff_record_t *dr)
 {
 	uint64_t o;
 	int err;
 
+	if (di->batched)
+		return (write_inuse_diffs_batched(fp, di, dr));
+
 	for (o = dr->ddr_first; o <= dr->ddr_last; o++) {
 		if ((err = write_inuse_diffs_one(fp, di, o)))
 			return (err);
@@ -379,6 +603,42 @@ describe_free(FILE *fp, differ_info_t *di, uint64_t object, char *namebuf,
 	return (0);
 }
 
+static int
+write_free_diffs_batched(FILE *fp, differ_info_t *di, dmu_diff_record_t *dr)
+{
+	differ_objs_t from;
+	struct zfs_stat sb;
+	char fobjname[MAXPATHLEN];
+	uint64_t obj;
+	int rc, err = 0;
+
+	ASSERT(di->zerr == 0);
+
+	differ_objs_init(&from, di->fromsnap, dr->ddr_first, dr->ddr_last);
+	while ((rc = differ_objs_peek(di, &from, &obj)) == 0) {
+		err = differ_objs_take(di, &from, fobjname, MAXPATHLEN, &sb);
+		if (obj == di->shares) {
+			di->zerr = 0;
+			continue;
+		}
+		if (err != 0) {
+			/* Let it slide, if in the delete queue on from side */
+			if (di->zerr == ENOENT && sb.zs_links == 0) {
+				di->zerr = 0;
+				err = 0;
+				continue;
+			}
+			break;
+		}
+		print_file(fp, di, ZDIFF_REMOVED, fobjname, &sb);
+	}
+	differ_objs_fini(&from);
+
+	if (rc < 0 || err != 0)
+		return (-1);
+	return (0);
+}
+
 static int
 write_free_diffs(FILE *fp, differ_info_t *di, dmu_diff_record_t *dr)
 {
@@ -386,6 +646,9 @@ write_free_diffs(FILE *fp, differ_info_t *di, dmu_diff_record_t *dr)
 	libzfs_handle_t *lhdl = di->zhp->zfs_hdl;
 	char fobjname[MAXPATHLEN];
 
+	if (di->batched)
+		return (write_free_diffs_batched(fp, di, dr));
+
 	(void) strlcpy(zc.zc_name, di->fromsnap, sizeof (zc.zc_name));
 	zc.zc_obj = dr->ddr_first - 1;
 
@@ -740,6 +1003,8 @@ static int
 setup_differ_info(zfs_handle_t *zhp, const char *fromsnap,
     const char *tosnap, differ_info_t *di)
 {
+	nvlist_t *nvl = NULL;
+
 	di->zhp = zhp;
 
 	di->cleanupfd = open(ZFS_DEV, O_RDWR);
@@ -754,6 +1019,15 @@ setup_differ_info(zfs_handle_t *zhp, const char *fromsnap,
 	if (find_shares_object(di) != 0)
 		return (-1);
 
+	/*
+	 * Look up changed objects a batch at a time, unless the kernel
+	 * predates ZFS_IOC_OBJS_TO_STATS.
+	 */
+	if (lzc_objs_to_stats(di->fromsnap, 0, 0, &nvl) !=
+	    ZFS_ERR_IOC_CMD_UNAVAIL)
+		di->batched = B_TRUE;
+	nvlist_free(nvl);
+
 	return (0);
 }
 
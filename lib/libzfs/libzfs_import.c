@@ -57,9 +57,14 @@
 #include <sys/efi_partition.h>
 
 #include <sys/vdev_impl.h>
+#include <sys/time.h>
+#include <atomic.h>
 #ifdef HAVE_LIBBLKID
 #include <blkid/blkid.h>
 #endif
+#ifdef HAVE_LIO_LISTIO
+#include <aio.h>
+#endif
 
 #include "libzfs.h"
 #include "libzfs_impl.h"
@@ -870,6 +875,103 @@ label_offset(uint64_t size, int l)
 	    0 : size - VDEV_LABELS * sizeof (vdev_label_t)));
 }
 
+/*
+ * The labels of a device and the I/O used to read them.  This is allocated
+ * rather than kept on the stack, since the OS X scan abandons a read that
+ * times out by longjmp()ing out of it.
+ */
+typedef struct label_read {
+	vdev_label_t	lr_label[VDEV_LABELS];
+#ifdef HAVE_LIO_LISTIO
+	struct aiocb	lr_cb[2];
+#endif
+} label_read_t;
+
+#ifdef HAVE_LIO_LISTIO
+/*
+ * Wait for a request submitted by lio_listio() to finish, cancelling it if
+ * it is still in flight, so that its buffer can be reused or freed.  Returns
+ * the number of bytes read, or -1 if the request failed or never ran.
+ */
+static ssize_t
+label_aio_reap(struct aiocb *cb)
+{
+	const struct aiocb *wait[1] = { cb };
+	int err;
+
+	if ((err = aio_error(cb)) == EINPROGRESS) {
+		(void) aio_cancel(cb->aio_fildes, cb);
+		while ((err = aio_error(cb)) == EINPROGRESS)
+			(void) aio_suspend(wait, 1, NULL);
+	}
+
+	/* aio_return() also releases the request. */
+	if (aio_return(cb) == (ssize_t)cb->aio_nbytes && err == 0)
+		return (cb->aio_nbytes);
+	return (-1);
+}
+#endif
+
+/*
+ * Read all labels of a device.  Labels 0 and 1 are adjacent at the front
+ * of the device and labels 2 and 3 at the end, so each pair is fetched with
+ * a single read, and where POSIX AIO is available both pairs are in flight
+ * at once.  A pair that cannot be read that way is retried one label at a
+ * time.  Returns a bitmask of the labels read in full.
+ */
+static int
+label_read_all(int fd, label_read_t *lr, uint64_t size)
+{
+	const size_t pairsz = 2 * sizeof (vdev_label_t);
+	int pair, l, mask = 0;
+
+#ifdef HAVE_LIO_LISTIO
+	struct aiocb *list[2];
+
+	bzero(lr->lr_cb, sizeof (lr->lr_cb));
+	for (pair = 0; pair < 2; pair++) {
+		struct aiocb *cb = &lr->lr_cb[pair];
+
+		cb->aio_fildes = fd;
+		cb->aio_buf = &lr->lr_label[2 * pair];
+		cb->aio_nbytes = pairsz;
+		cb->aio_offset = label_offset(size, 2 * pair);
+		cb->aio_lio_opcode = LIO_READ;
+		list[pair] = cb;
+	}
+
+	/*
+	 * On EIO all requests have completed and some failed.  On other
+	 * errors, such as EAGAIN or EINTR, some may never have been queued
+	 * and others may still be in flight.  Either way, reap every request
+	 * before its buffer is touched again, and fall back to pread() for
+	 * any that did not return the whole pair.
+	 */
+	(void) lio_listio(LIO_WAIT, list, 2, NULL);
+	for (pair = 0; pair < 2; pair++) {
+		if (label_aio_reap(&lr->lr_cb[pair]) == (ssize_t)pairsz)
+			mask |= 3 << (2 * pair);
+	}
+#endif
+
+	for (pair = 0; pair < 2; pair++) {
+		if (mask & (3 << (2 * pair)))
+			continue;
+		if (pread(fd, &lr->lr_label[2 * pair], pairsz,
+		    label_offset(size, 2 * pair)) == pairsz) {
+			mask |= 3 << (2 * pair);
+			continue;
+		}
+		for (l = 2 * pair; l < 2 * pair + 2; l++) {
+			if (pread(fd, &lr->lr_label[l], sizeof (vdev_label_t),
+			    label_offset(size, l)) == sizeof (vdev_label_t))
+				mask |= 1 << l;
+		}
+	}
+
+	return (mask);
+}
+
 /*
  * Given a file descriptor, read the label information and return an nvlist
  * describing the configuration, if there is one.
@@ -879,7 +981,8 @@ int
 zpool_read_label(int fd, nvlist_t **config, int *num_labels)
 {
 	struct stat statbuf;
-	int l, count = 0;
+	int l, mask, count = 0;
+	label_read_t *lr;
 	vdev_label_t *label;
 	nvlist_t *expected_config = NULL;
 	uint64_t expected_guid = 0, size;
@@ -891,15 +994,17 @@ zpool_read_label(int fd, nvlist_t **config, int *num_labels)
 
 	size = P2ALIGN_TYPED(statbuf.st_size, sizeof (vdev_label_t), uint64_t);
 
-	if ((label = malloc(sizeof (vdev_label_t))) == NULL)
+	if ((lr = malloc(sizeof (label_read_t))) == NULL)
 		return (-1);
 
+	mask = label_read_all(fd, lr, size);
+
 	for (l = 0; l < VDEV_LABELS; l++) {
 		uint64_t state, guid, txg;
 
-		if (pread(fd, label, sizeof (vdev_label_t),
-		    label_offset(size, l)) != sizeof (vdev_label_t))
+		if (!(mask & (1 << l)))
 			continue;
+		label = &lr->lr_label[l];
 
 		if (nvlist_unpack(label->vl_vdev_phys.vp_nvlist,
 		    sizeof (label->vl_vdev_phys.vp_nvlist), config, 0) != 0)
@@ -939,12 +1044,15 @@ zpool_read_label(int fd, nvlist_t **config, int *num_labels)
 	if (num_labels != NULL)
 		*num_labels = count;
 
-	free(label);
+	free(lr);
 	*config = expected_config;
 
 	return (0);
 }
 
+/* Identity of a device node, as recorded in the label cache */
+#define	LABEL_CACHE_KEYS	4
+
 typedef struct rdsk_node {
 	char *rn_name;
 	int rn_num_labels;
@@ -954,8 +1062,200 @@ typedef struct rdsk_node {
 	avl_tree_t *rn_avl;
 	avl_node_t rn_node;
 	boolean_t rn_nozpool;
+	boolean_t rn_probed;		/* labels read or found in cache */
+	uint64_t rn_key[LABEL_CACHE_KEYS];
+	nvlist_t *rn_labelcache;	/* label cache for this directory */
+	import_scan_stats_t *rn_stats;
 } rdsk_node_t;
 
+/*
+ * The label cache remembers, for every device node probed by a scan that
+ * holds a pool, the labels that were found on it, so that a later scan only
+ * has to read the configuration of one label rather than all of them.
+ * Entries are grouped by search directory and keyed by node name; an entry
+ * is only considered if the device number, inode, size and modification
+ * time of the node still match.  Writing to a block device does not change
+ * its modification time, so devices without labels are never cached (a pool
+ * may since have been created on them), and a cached entry is only used
+ * once label_cache_verify() has checked it against the device.
+ */
+static const char *label_cache_key[LABEL_CACHE_KEYS] = {
+	"rdev", "ino", "size", "mtime"
+};
+#define	LABEL_CACHE_NUM_LABELS	"num_labels"
+#define	LABEL_CACHE_CONFIG	"config"
+
+static void
+label_cache_setkey(rdsk_node_t *rn, uint64_t rdev, uint64_t ino,
+    uint64_t size, uint64_t mtime)
+{
+	rn->rn_key[0] = rdev;
+	rn->rn_key[1] = ino;
+	rn->rn_key[2] = size;
+	rn->rn_key[3] = mtime;
+}
+
+/*
+ * Check a cached configuration against the first label of the open device.
+ * The vdev and pool guids and the txg of the last label update must match,
+ * so a device that has been relabeled or whose pool configuration changed
+ * is read again in full.
+ */
+static boolean_t
+label_cache_verify(int fd, nvlist_t *cached)
+{
+	static const char *keys[] = {
+		ZPOOL_CONFIG_GUID, ZPOOL_CONFIG_POOL_GUID, ZPOOL_CONFIG_POOL_TXG
+	};
+	vdev_phys_t *vp;
+	nvlist_t *config;
+	boolean_t match = B_FALSE;
+	int i;
+
+	if ((vp = malloc(sizeof (vdev_phys_t))) == NULL)
+		return (B_FALSE);
+
+	/* Label 0 is at the very front of the device. */
+	if (pread(fd, vp, sizeof (vdev_phys_t),
+	    offsetof(vdev_label_t, vl_vdev_phys)) == sizeof (vdev_phys_t) &&
+	    nvlist_unpack(vp->vp_nvlist, sizeof (vp->vp_nvlist),
+	    &config, 0) == 0) {
+		match = B_TRUE;
+		for (i = 0; i < sizeof (keys) / sizeof (keys[0]); i++) {
+			uint64_t found = 0, expected = 0;
+
+			(void) nvlist_lookup_uint64(config, keys[i], &found);
+			(void) nvlist_lookup_uint64(cached, keys[i], &expected);
+			if (found != expected)
+				match = B_FALSE;
+		}
+		nvlist_free(config);
+	}
+
+	free(vp);
+	return (match);
+}
+
+/*
+ * Look the node up in the label cache.  On a hit that still matches the
+ * device the cached labels are used instead of reading all of them.
+ */
+static boolean_t
+label_cache_lookup(rdsk_node_t *rn, int fd)
+{
+	nvlist_t *entry, *config;
+	uint64_t val, num_labels;
+	int i;
+
+	if (rn->rn_labelcache == NULL ||
+	    nvlist_lookup_nvlist(rn->rn_labelcache, rn->rn_name, &entry) != 0)
+		return (B_FALSE);
+
+	for (i = 0; i < LABEL_CACHE_KEYS; i++) {
+		if (nvlist_lookup_uint64(entry, label_cache_key[i],
+		    &val) != 0 || val != rn->rn_key[i])
+			return (B_FALSE);
+	}
+
+	if (nvlist_lookup_uint64(entry, LABEL_CACHE_NUM_LABELS,
+	    &num_labels) != 0 || num_labels == 0 ||
+	    nvlist_lookup_nvlist(entry, LABEL_CACHE_CONFIG, &config) != 0 ||
+	    !label_cache_verify(fd, config) ||
+	    nvlist_dup(config, &rn->rn_config, 0) != 0)
+		return (B_FALSE);
+
+	rn->rn_num_labels = num_labels;
+	rn->rn_probed = B_TRUE;
+	atomic_inc_64(&rn->rn_stats->iss_labeled);
+	atomic_inc_64(&rn->rn_stats->iss_cached);
+
+	return (B_TRUE);
+}
+
+/*
+ * Record what was found on a probed node that holds a pool in the new label
+ * cache.
+ */
+static int
+label_cache_add(nvlist_t *dircache, rdsk_node_t *rn)
+{
+	nvlist_t *entry;
+	int i, err = 0;
+
+	if (rn->rn_config == NULL || rn->rn_num_labels == 0)
+		return (0);
+
+	if (nvlist_alloc(&entry, NV_UNIQUE_NAME, 0) != 0)
+		return (-1);
+
+	for (i = 0; i < LABEL_CACHE_KEYS; i++)
+		err |= nvlist_add_uint64(entry, label_cache_key[i],
+		    rn->rn_key[i]);
+	err |= nvlist_add_uint64(entry, LABEL_CACHE_NUM_LABELS,
+	    rn->rn_num_labels);
+	err |= nvlist_add_nvlist(entry, LABEL_CACHE_CONFIG, rn->rn_config);
+	if (err == 0)
+		err = nvlist_add_nvlist(dircache, rn->rn_name, entry);
+
+	nvlist_free(entry);
+	return (err);
+}
+
+/*
+ * Read the label cache.  A missing or unreadable cache is simply empty.
+ */
+static nvlist_t *
+label_cache_read(const char *path)
+{
+	struct stat statbuf;
+	nvlist_t *cache = NULL;
+	char *buf;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY)) < 0)
+		return (NULL);
+
+	if (fstat(fd, &statbuf) == 0 && statbuf.st_size > 0 &&
+	    (buf = malloc(statbuf.st_size)) != NULL) {
+		if (read(fd, buf, statbuf.st_size) != statbuf.st_size ||
+		    nvlist_unpack(buf, statbuf.st_size, &cache, 0) != 0)
+			cache = NULL;
+		free(buf);
+	}
+
+	(void) close(fd);
+	return (cache);
+}
+
+/*
+ * Replace the label cache, going through a temporary file so that an
+ * interrupted write leaves the previous cache in place.
+ */
+static void
+label_cache_write(const char *path, nvlist_t *cache)
+{
+	char tmp[MAXPATHLEN];
+	char *buf = NULL;
+	size_t len = 0;
+	int fd;
+
+	if (snprintf(tmp, sizeof (tmp), "%s.new", path) >= sizeof (tmp) ||
+	    nvlist_pack(cache, &buf, &len, NV_ENCODE_XDR, 0) != 0)
+		return;
+
+	if ((fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644)) >= 0) {
+		if (write(fd, buf, len) == len && fsync(fd) == 0) {
+			(void) close(fd);
+			(void) rename(tmp, path);
+		} else {
+			(void) close(fd);
+			(void) unlink(tmp);
+		}
+	}
+
+	free(buf);
+}
+
 static int
 slice_cache_compare(const void *arg1, const void *arg2)
 {
@@ -1159,6 +1459,7 @@ zpool_open_func(void *arg)
 	nvlist_t *config;
 	int num_labels;
 	int fd;
+	hrtime_t start;
 
 	if (rn->rn_nozpool)
 		return;
@@ -1217,7 +1518,13 @@ zpool_open_func(void *arg)
 		return;
 #endif
 
-	if ((fd = openat64(rn->rn_dfd, rn->rn_name, O_RDONLY)) < 0) {
+	label_cache_setkey(rn, statbuf.st_rdev, statbuf.st_ino,
+	    statbuf.st_size, statbuf.st_mtime);
+
+	start = gethrtime();
+	fd = openat64(rn->rn_dfd, rn->rn_name, O_RDONLY);
+	atomic_add_64(&rn->rn_stats->iss_open_ns, gethrtime() - start);
+	if (fd < 0) {
 		/* symlink to a device that's no longer there */
 		if (errno == ENOENT)
 			nozpool_all_slices(rn->rn_avl, rn->rn_name);
@@ -1226,7 +1533,10 @@ zpool_open_func(void *arg)
 
 #else /* LINUX, APPLE -> IllumOS */
 
-	if ((fd = openat64(rn->rn_dfd, rn->rn_name, O_RDONLY)) < 0) {
+	start = gethrtime();
+	fd = openat64(rn->rn_dfd, rn->rn_name, O_RDONLY);
+	atomic_add_64(&rn->rn_stats->iss_open_ns, gethrtime() - start);
+	if (fd < 0) {
 		/* symlink to a device that's no longer there */
 		if (errno == ENOENT)
 			nozpool_all_slices(rn->rn_avl, rn->rn_name);
@@ -1243,6 +1553,9 @@ zpool_open_func(void *arg)
 		(void) close(fd);
 		return;
 	}
+
+	label_cache_setkey(rn, statbuf.st_rdev, statbuf.st_ino,
+	    statbuf.st_size, statbuf.st_mtime);
 #endif
 	/* this file is too small to hold a zpool */
 	if (S_ISREG(statbuf.st_mode) &&
@@ -1283,6 +1596,16 @@ zpool_open_func(void *arg)
 	alarm(20);
 #endif
 
+	start = gethrtime();
+	if (label_cache_lookup(rn, fd)) {
+#ifdef __APPLE__
+		alarm(0);
+#endif
+		atomic_add_64(&rn->rn_stats->iss_read_ns, gethrtime() - start);
+		(void) close(fd);
+		return;
+	}
+
 	if ((zpool_read_label(fd, &config, &num_labels)) != 0) {
 #ifdef __APPLE__
 		alarm(0);
@@ -1295,6 +1618,9 @@ zpool_open_func(void *arg)
 #ifdef __APPLE__
 	alarm(0);
 #endif
+	atomic_add_64(&rn->rn_stats->iss_read_ns, gethrtime() - start);
+	atomic_inc_64(&rn->rn_stats->iss_probed);
+	rn->rn_probed = B_TRUE;
 
 	if (num_labels == 0) {
 		(void) close(fd);
@@ -1304,6 +1630,7 @@ zpool_open_func(void *arg)
 
 	(void) close(fd);
 
+	atomic_inc_64(&rn->rn_stats->iss_labeled);
 	rn->rn_config = config;
 	rn->rn_num_labels = num_labels;
 }
@@ -1458,9 +1785,21 @@ zpool_find_import_impl(libzfs_handle_t *hdl, importargs_t *iarg)
 	avl_tree_t slice_cache;
 	rdsk_node_t *slice;
 	void *cookie;
+	import_scan_stats_t stats = { 0 };
+	nvlist_t *labelcache = NULL, *newcache = NULL;
+	hrtime_t start;
 
 	verify(iarg->poolname == NULL || iarg->guid == 0);
 
+	if (iarg->labelcache != NULL) {
+		labelcache = label_cache_read(iarg->labelcache);
+		if (labelcache == NULL)
+			(void) nvlist_alloc(&labelcache, NV_UNIQUE_NAME, 0);
+		if (labelcache != NULL &&
+		    nvlist_dup(labelcache, &newcache, 0) != 0)
+			newcache = NULL;
+	}
+
 	if (dirs == 0) {
 #ifdef HAVE_LIBBLKID
 		/* Use libblkid to scan all device for their type */
@@ -1487,6 +1826,7 @@ zpool_find_import_impl(libzfs_handle_t *hdl, importargs_t *iarg)
 		int dfd;
 		boolean_t config_failed = B_FALSE;
 		DIR *dirp;
+		nvlist_t *dircache = NULL, *newdircache = NULL;
 
 		/* use realpath to normalize the path */
 		if (realpath(dir[i], path) == 0) {
@@ -1529,9 +1869,16 @@ zpool_find_import_impl(libzfs_handle_t *hdl, importargs_t *iarg)
 		avl_create(&slice_cache, slice_cache_compare,
 		    sizeof (rdsk_node_t), offsetof(rdsk_node_t, rn_node));
 
+		if (labelcache != NULL)
+			(void) nvlist_lookup_nvlist(labelcache, rdsk, &dircache);
+		if (newcache != NULL &&
+		    nvlist_alloc(&newdircache, NV_UNIQUE_NAME, 0) != 0)
+			newdircache = NULL;
+
 		/*
 		 * This is not MT-safe, but we have no MT consumers of libzfs
 		 */
+		start = gethrtime();
 		while ((dp = readdir(dirp)) != NULL) {
 			const char *name = dp->d_name;
 			if (name[0] == '.' &&
@@ -1544,8 +1891,13 @@ zpool_find_import_impl(libzfs_handle_t *hdl, importargs_t *iarg)
 			slice->rn_dfd = dfd;
 			slice->rn_hdl = hdl;
 			slice->rn_nozpool = B_FALSE;
+			slice->rn_probed = B_FALSE;
+			slice->rn_labelcache = dircache;
+			slice->rn_stats = &stats;
 			avl_add(&slice_cache, slice);
 		}
+		stats.iss_readdir_ns += gethrtime() - start;
+		stats.iss_devices += avl_numnodes(&slice_cache);
 
 		/*
 		 * create a thread pool to do all of this in parallel;
@@ -1556,6 +1908,7 @@ zpool_find_import_impl(libzfs_handle_t *hdl, importargs_t *iarg)
 		 * locks in the kernel, so going beyond this doesn't
 		 * buy us much.
 		 */
+		start = gethrtime();
 		t = taskq_create("z_import", 2 * max_ncpus, defclsyspri,
 		    2 * max_ncpus, INT_MAX, TASKQ_PREPOPULATE);
 		for (slice = avl_first(&slice_cache); slice;
@@ -1565,10 +1918,13 @@ zpool_find_import_impl(libzfs_handle_t *hdl, importargs_t *iarg)
 			    TQ_SLEEP);
 		taskq_wait(t);
 		taskq_destroy(t);
+		stats.iss_scan_ns += gethrtime() - start;
 
 		cookie = NULL;
 		while ((slice = avl_destroy_nodes(&slice_cache,
 		    &cookie)) != NULL) {
+			if (slice->rn_probed && newdircache != NULL)
+				(void) label_cache_add(newdircache, slice);
 			if (slice->rn_config != NULL && !config_failed) {
 				nvlist_t *config = slice->rn_config;
 				boolean_t matched = B_TRUE;
@@ -1607,16 +1963,35 @@ zpool_find_import_impl(libzfs_handle_t *hdl, importargs_t *iarg)
 
 		(void) closedir(dirp);
 
+		/*
+		 * Only the devices seen by this scan are kept, so that nodes
+		 * that went away do not accumulate in the cache.
+		 */
+		if (newdircache != NULL) {
+			(void) nvlist_add_nvlist(newcache, rdsk, newdircache);
+			nvlist_free(newdircache);
+		}
+
 		if (config_failed)
 			goto error;
 	}
 
+	if (newcache != NULL)
+		label_cache_write(iarg->labelcache, newcache);
+
 #ifdef HAVE_LIBBLKID
 skip_scanning:
 #endif
+	start = gethrtime();
 	ret = get_configs(hdl, &pools, iarg->can_be_active, iarg->policy);
+	stats.iss_config_ns = gethrtime() - start;
 
 error:
+	nvlist_free(labelcache);
+	nvlist_free(newcache);
+	if (iarg->stats != NULL)
+		*iarg->stats = stats;
+
 	for (pe = pools.pools; pe != NULL; pe = penext) {
 		penext = pe->pe_next;
 		for (ve = pe->pe_vdevs; ve != NULL; ve = venext) {
@@ -32,6 +32,7 @@
 #include <stddef.h>
 #include <libintl.h>
 #include <libzfs.h>
+#include <libzfs_core.h>
 
 #include "libzfs_impl.h"
 
@@ -97,6 +98,113 @@ top:
 	return (rc);
 }
 
+/*
+ * Ask for only the native properties in the handle's props-table (if it has
+ * been pruned), so the kernel neither gathers nor copies out the rest.  The
+ * child handles inherit the table.
+ */
+static void
+zfs_list_batch_props(zfs_handle_t *zhp, nvlist_t *args)
+{
+	nvlist_t *props;
+	const char *name;
+	int prop;
+
+	if (zhp->zfs_props_table == NULL)
+		return;
+
+	props = fnvlist_alloc();
+	for (prop = 0; prop < ZFS_NUM_PROPS; prop++) {
+		if (zhp->zfs_props_table[prop] &&
+		    (name = zfs_prop_to_name(prop)) != NULL)
+			fnvlist_add_boolean(props, name);
+	}
+	fnvlist_add_nvlist(args, ZFS_LIST_BATCH_PROPS, props);
+	fnvlist_free(props);
+}
+
+/*
+ * Iterate over the children or snapshots of a dataset, as described by args,
+ * fetching many of them per ZFS_IOC_LIST_BATCH call.  If the kernel does not
+ * support that ioctl, *unavail is set and nothing is iterated, so that the
+ * caller can fall back to the one-at-a-time list ioctls.
+ */
+static int
+zfs_iter_list_batch(zfs_handle_t *zhp, nvlist_t *args, boolean_t simple,
+    zfs_iter_f func, void *data, boolean_t *unavail)
+{
+	libzfs_handle_t *hdl = zhp->zfs_hdl;
+	nvlist_t *result, *datasets;
+	nvpair_t *pair;
+	zfs_handle_t *nzhp;
+	uint64_t cursor;
+	int ret;
+
+	*unavail = B_FALSE;
+
+	for (;;) {
+		if ((ret = lzc_list_batch(zhp->zfs_name, args, &result)) != 0) {
+			nvlist_free(result);
+			switch (ret) {
+			case ZFS_ERR_IOC_CMD_UNAVAIL:
+				*unavail = B_TRUE;
+				return (0);
+			/*
+			 * If ENOENT is returned, then the underlying dataset
+			 * has been removed since we obtained the handle.
+			 */
+			case ESRCH:
+			case ENOENT:
+				return (0);
+			default:
+				return (zfs_standard_error(hdl, ret,
+				    nvlist_exists(args,
+				    ZFS_LIST_BATCH_SNAPSHOTS) ?
+				    dgettext(TEXT_DOMAIN,
+				    "cannot iterate snapshots") :
+				    dgettext(TEXT_DOMAIN,
+				    "cannot iterate filesystems")));
+			}
+		}
+
+		datasets = fnvlist_lookup_nvlist(result,
+		    ZFS_LIST_BATCH_DATASETS);
+		for (pair = nvlist_next_nvpair(datasets, NULL); pair != NULL;
+		    pair = nvlist_next_nvpair(datasets, pair)) {
+			/*
+			 * Silently ignore errors, as the only plausible
+			 * explanation is that the pool has since been removed.
+			 */
+			if (simple) {
+				nzhp = make_dataset_simple_handle(zhp,
+				    nvpair_name(pair));
+			} else {
+				nzhp = make_dataset_handle_nvl(hdl,
+				    nvpair_name(pair),
+				    fnvpair_value_nvlist(pair));
+				if (nzhp != NULL)
+					nzhp->zfs_props_table =
+					    zhp->zfs_props_table;
+			}
+			if (nzhp == NULL)
+				continue;
+
+			if ((ret = func(nzhp, data)) != 0) {
+				nvlist_free(result);
+				return (ret);
+			}
+		}
+
+		if (nvlist_lookup_uint64(result, ZFS_LIST_BATCH_CURSOR,
+		    &cursor) != 0) {
+			nvlist_free(result);
+			return (0);
+		}
+		fnvlist_add_uint64(args, ZFS_LIST_BATCH_CURSOR, cursor);
+		nvlist_free(result);
+	}
+}
+
 /*
  * Iterate over all child filesystems
  */
@@ -105,12 +213,21 @@ zfs_iter_filesystems(zfs_handle_t *zhp, zfs_iter_f func, void *data)
 {
 	zfs_cmd_t zc = {"\0"};
 	zfs_handle_t *nzhp;
+	nvlist_t *args;
+	boolean_t unavail;
 	int ret;
     uint64_t allocated_size;
 
 	if (zhp->zfs_type != ZFS_TYPE_FILESYSTEM)
 		return (0);
 
+	args = fnvlist_alloc();
+	zfs_list_batch_props(zhp, args);
+	ret = zfs_iter_list_batch(zhp, args, B_FALSE, func, data, &unavail);
+	fnvlist_free(args);
+	if (!unavail)
+		return (ret);
+
 	if (zcmd_alloc_dst_nvlist(zhp->zfs_hdl, &zc, 0) != 0)
 		return (-1);
 
@@ -150,11 +267,28 @@ zfs_iter_snapshots(zfs_handle_t *zhp, boolean_t simple, zfs_iter_f func,
 	zfs_handle_t *nzhp;
 	int ret;
 	nvlist_t *range_nvl = NULL;
+	nvlist_t *args;
+	boolean_t unavail;
 
 	if (zhp->zfs_type == ZFS_TYPE_SNAPSHOT ||
 	    zhp->zfs_type == ZFS_TYPE_BOOKMARK)
 		return (0);
 
+	args = fnvlist_alloc();
+	fnvlist_add_boolean(args, ZFS_LIST_BATCH_SNAPSHOTS);
+	if (simple)
+		fnvlist_add_boolean(args, ZFS_LIST_BATCH_SIMPLE);
+	else
+		zfs_list_batch_props(zhp, args);
+	if (min_txg != 0)
+		fnvlist_add_uint64(args, SNAP_ITER_MIN_TXG, min_txg);
+	if (max_txg != 0)
+		fnvlist_add_uint64(args, SNAP_ITER_MAX_TXG, max_txg);
+	ret = zfs_iter_list_batch(zhp, args, simple, func, data, &unavail);
+	fnvlist_free(args);
+	if (!unavail)
+		return (ret);
+
 	zc.zc_simple = simple;
 
 	if (zcmd_alloc_dst_nvlist(zhp->zfs_hdl, &zc, 0) != 0)
@@ -66,6 +66,7 @@
 #include <fcntl.h>
 #include <libgen.h>
 #include <libintl.h>
+#include <atomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <strings.h>
@@ -863,7 +864,12 @@ zfs_mount(zfs_handle_t *zhp, const char *options, int flags)
 #else
 	if (lstat(mountpoint, &buf) != 0) {
 #endif
-		if (mkdirp(mountpoint, 0755) != 0) {
+		/*
+		 * Sibling datasets are mounted in parallel, and may race
+		 * creating a shared intermediate directory.
+		 */
+		if (mkdirp(mountpoint, 0755) != 0 && (errno != EEXIST ||
+		    (mkdirp(mountpoint, 0755) != 0 && errno != EEXIST))) {
 			zfs_error_aux(hdl, dgettext(TEXT_DOMAIN,
 			    "failed to create mountpoint"));
 			return (zfs_error_fmt(hdl, EZFS_MOUNTFAILED,
@@ -1562,6 +1568,48 @@ mount_cb(zfs_handle_t *zhp, void *data)
 	return (0);
 }
 
+/*
+ * Compare two mountpoints, sorting '/' before every other character so that
+ * each mountpoint is immediately followed by all of the mountpoints beneath
+ * it.  (strcmp() would put "/a b" between "/a" and "/a/c".)
+ */
+static int
+mountpoint_path_cmp(const char *a, const char *b)
+{
+	for (; *a != '\0' && *a == *b; a++, b++)
+		;
+
+	if (*a == *b)
+		return (0);
+	if (*a == '\0')
+		return (-1);
+	if (*b == '\0')
+		return (1);
+	if (*a == '/')
+		return (-1);
+	if (*b == '/')
+		return (1);
+	return ((unsigned char)*a < (unsigned char)*b ? -1 : 1);
+}
+
+/*
+ * Returns true if child is parent, or is mounted beneath it.  A dataset
+ * mounted on top of another one at the same path counts as its child.
+ */
+static boolean_t
+mountpoint_contains(const char *parent, const char *child)
+{
+	size_t len = strlen(parent);
+
+	/* "none" and "legacy" don't contain anything. */
+	if (parent[0] != '/' || child[0] != '/')
+		return (B_FALSE);
+	if (strcmp(parent, "/") == 0)
+		return (child[0] == '/');
+	return (strncmp(parent, child, len) == 0 &&
+	    (child[len] == '/' || child[len] == '\0'));
+}
+
 int
 libzfs_dataset_cmp(const void *a, const void *b)
 {
@@ -1579,14 +1627,219 @@ libzfs_dataset_cmp(const void *a, const void *b)
 		    sizeof (mountb), NULL, NULL, 0, B_FALSE) == 0);
 
 	if (gota && gotb)
-		return (strcmp(mounta, mountb));
+		return (mountpoint_path_cmp(mounta, mountb));
 
 	if (gota)
 		return (-1);
 	if (gotb)
 		return (1);
 
-	return (strcmp(zfs_get_name(a), zfs_get_name(b)));
+	return (strcmp(zfs_get_name(*za), zfs_get_name(*zb)));
+}
+
+/*
+ * Mounting and unmounting every dataset of a pool is dominated by waiting
+ * on the mount and unmount commands, so we walk the mountpoint hierarchy
+ * with a pool of threads.  The mountpoints are sorted (mountpoint_path_cmp())
+ * so that each one is followed by everything beneath it.  A dataset is
+ * mounted once its parent mountpoint is, and unmounted once everything
+ * beneath it is; unrelated subtrees proceed independently.
+ *
+ * Setting ZFS_SERIAL_MOUNT in the environment uses a single thread.
+ *
+ * The walk runs with the libzfs mnttab cache turned on.  Without it every
+ * libzfs_mnttab_find() goes to getmntany(), whose entries point into a
+ * buffer that the next call from any thread frees, while the cache hands
+ * out strings that only the thread mounting that dataset changes.
+ */
+#define	MOUNT_TASKQ_THREADS	(2 * max_ncpus)
+#define	MOUNT_NO_PARENT		((size_t)-1)
+
+typedef struct mount_state mount_state_t;
+
+typedef struct mount_task {
+	mount_state_t	*mt_state;
+	size_t		mt_idx;
+} mount_task_t;
+
+struct mount_state {
+	libzfs_handle_t	*ms_hdl;
+	zfs_handle_t	**ms_handles;	/* mount only */
+	char		**ms_mountpoints;
+	size_t		ms_count;
+	const char	*ms_mntopts;
+	int		ms_flags;
+	int		*ms_status;	/* 1 done, -1 failed, 0 not done */
+	size_t		*ms_parent;	/* unmount only */
+	uint32_t	*ms_pending;	/* unmount only */
+	mount_task_t	*ms_tasks;
+	taskq_t		*ms_tq;
+	boolean_t	ms_mnttab_enable;	/* caller's cache setting */
+};
+
+static void
+mount_state_init(mount_state_t *ms, libzfs_handle_t *hdl, char **mountpoints,
+    size_t count, int flags)
+{
+	size_t i;
+	int nthreads = MOUNT_TASKQ_THREADS;
+
+	bzero(ms, sizeof (*ms));
+	ms->ms_hdl = hdl;
+	ms->ms_mountpoints = mountpoints;
+	ms->ms_count = count;
+	ms->ms_flags = flags;
+	ms->ms_status = zfs_alloc(hdl, MAX(count, 1) * sizeof (int));
+	ms->ms_tasks = zfs_alloc(hdl, MAX(count, 1) * sizeof (mount_task_t));
+	for (i = 0; i < count; i++) {
+		ms->ms_tasks[i].mt_state = ms;
+		ms->ms_tasks[i].mt_idx = i;
+	}
+
+	/* Loading keys may prompt, which has to happen one at a time. */
+	if (getenv("ZFS_SERIAL_MOUNT") != NULL || (flags & MS_CRYPT))
+		nthreads = 1;
+	ms->ms_tq = taskq_create("z_mount", nthreads, defclsyspri,
+	    nthreads, INT_MAX, 0);
+
+	ms->ms_mnttab_enable = hdl->libzfs_mnttab_enable;
+	libzfs_mnttab_cache(hdl, B_TRUE);
+}
+
+static void
+mount_state_fini(mount_state_t *ms)
+{
+	taskq_destroy(ms->ms_tq);
+	libzfs_mnttab_cache(ms->ms_hdl, ms->ms_mnttab_enable);
+	free(ms->ms_tasks);
+	free(ms->ms_status);
+	free(ms->ms_parent);
+	free(ms->ms_pending);
+}
+
+/*
+ * Returns the index of the first mountpoint after idx that isn't beneath it.
+ */
+static size_t
+mountpoint_next_sibling(char **mountpoints, size_t count, size_t idx)
+{
+	size_t i;
+
+	for (i = idx + 1; i < count; i++) {
+		if (!mountpoint_contains(mountpoints[idx], mountpoints[i]))
+			break;
+	}
+	return (i);
+}
+
+static void
+zfs_mount_task(void *arg)
+{
+	mount_task_t *mt = arg;
+	mount_state_t *ms = mt->mt_state;
+	size_t idx = mt->mt_idx;
+	size_t i;
+
+	/*
+	 * don't attempt to mount encrypted datasets with
+	 * unloaded keys
+	 */
+	if (zfs_prop_get_int(ms->ms_handles[idx], ZFS_PROP_KEYSTATUS) !=
+	    ZFS_KEYSTATUS_UNAVAILABLE) {
+		if (zfs_mount(ms->ms_handles[idx], ms->ms_mntopts,
+		    ms->ms_flags) != 0) {
+			/*
+			 * Don't mount its children into the directory we
+			 * failed to mount over.
+			 */
+			ms->ms_status[idx] = -1;
+			return;
+		}
+		ms->ms_status[idx] = 1;
+	}
+
+	for (i = idx + 1; i < ms->ms_count &&
+	    mountpoint_contains(ms->ms_mountpoints[idx],
+	    ms->ms_mountpoints[i]);
+	    i = mountpoint_next_sibling(ms->ms_mountpoints, ms->ms_count, i)) {
+		(void) taskq_dispatch(ms->ms_tq, zfs_mount_task,
+		    &ms->ms_tasks[i], TQ_SLEEP);
+	}
+}
+
+static void
+zfs_unmount_task(void *arg)
+{
+	mount_task_t *mt = arg;
+	mount_state_t *ms = mt->mt_state;
+	size_t idx = mt->mt_idx;
+	size_t parent = ms->ms_parent[idx];
+
+	if (unmount_one(ms->ms_hdl, ms->ms_mountpoints[idx],
+	    ms->ms_flags) != 0) {
+		/* Everything above it stays mounted. */
+		ms->ms_status[idx] = -1;
+		return;
+	}
+	ms->ms_status[idx] = 1;
+
+	if (parent != MOUNT_NO_PARENT &&
+	    atomic_dec_32_nv(&ms->ms_pending[parent]) == 0) {
+		(void) taskq_dispatch(ms->ms_tq, zfs_unmount_task,
+		    &ms->ms_tasks[parent], TQ_SLEEP);
+	}
+}
+
+/*
+ * Mount everything in sorted mountpoints, parents before children.
+ */
+static void
+zfs_mount_parallel(mount_state_t *ms)
+{
+	size_t i;
+
+	for (i = 0; i < ms->ms_count;
+	    i = mountpoint_next_sibling(ms->ms_mountpoints, ms->ms_count, i)) {
+		(void) taskq_dispatch(ms->ms_tq, zfs_mount_task,
+		    &ms->ms_tasks[i], TQ_SLEEP);
+	}
+	taskq_wait(ms->ms_tq);
+}
+
+/*
+ * Unmount everything in sorted mountpoints, children before parents.
+ */
+static void
+zfs_unmount_parallel(mount_state_t *ms)
+{
+	size_t *stack;
+	size_t i, depth = 0;
+
+	ms->ms_parent = zfs_alloc(ms->ms_hdl,
+	    MAX(ms->ms_count, 1) * sizeof (size_t));
+	ms->ms_pending = zfs_alloc(ms->ms_hdl,
+	    MAX(ms->ms_count, 1) * sizeof (uint32_t));
+	stack = zfs_alloc(ms->ms_hdl, MAX(ms->ms_count, 1) * sizeof (size_t));
+
+	for (i = 0; i < ms->ms_count; i++) {
+		while (depth > 0 && !mountpoint_contains(
+		    ms->ms_mountpoints[stack[depth - 1]], ms->ms_mountpoints[i]))
+			depth--;
+		ms->ms_parent[i] = depth > 0 ? stack[depth - 1] :
+		    MOUNT_NO_PARENT;
+		if (depth > 0)
+			ms->ms_pending[stack[depth - 1]]++;
+		stack[depth++] = i;
+	}
+	free(stack);
+
+	for (i = 0; i < ms->ms_count; i++) {
+		if (ms->ms_pending[i] == 0) {
+			(void) taskq_dispatch(ms->ms_tq, zfs_unmount_task,
+			    &ms->ms_tasks[i], TQ_SLEEP);
+		}
+	}
+	taskq_wait(ms->ms_tq);
 }
 
 /*
@@ -1594,8 +1847,8 @@ libzfs_dataset_cmp(const void *a, const void *b)
  * datasets within the pool are currently mounted.  Because users can create
  * complicated nested hierarchies of mountpoints, we first gather all the
  * datasets and mountpoints within the pool, and sort them by mountpoint.  Once
- * we have the list of all filesystems, we iterate over them in order and mount
- * and/or share each one.
+ * we have the list of all filesystems, we mount them in parallel, each one
+ * after its parent, and then share each one in order.
  */
 int
 zpool_enable_datasets(zpool_handle_t *zhp, const char *mntopts, int flags)
@@ -1603,8 +1856,10 @@ zpool_enable_datasets(zpool_handle_t *zhp, const char *mntopts, int flags)
 	get_all_cb_t cb = { 0 };
 	libzfs_handle_t *hdl = zhp->zpool_hdl;
 	zfs_handle_t *zfsp;
+	mount_state_t ms;
+	char **mountpoints = NULL;
+	char mountpoint[ZFS_MAXPROPLEN];
 	int i, ret = -1;
-	int *good;
 	/*
 	 * Gather all non-snap datasets within the pool.
 	 */
@@ -1620,58 +1875,66 @@ zpool_enable_datasets(zpool_handle_t *zhp, const char *mntopts, int flags)
 	qsort(cb.cb_handles, cb.cb_used, sizeof (void *),
 	    libzfs_dataset_cmp);
 
+	mountpoints = zfs_alloc(hdl, MAX(cb.cb_used, 1) * sizeof (char *));
+	for (i = 0; i < cb.cb_used; i++) {
+		verify(zfs_prop_get(cb.cb_handles[i], ZFS_PROP_MOUNTPOINT,
+		    mountpoint, sizeof (mountpoint), NULL, NULL, 0,
+		    B_FALSE) == 0);
+		mountpoints[i] = zfs_strdup(hdl, mountpoint);
+	}
+
 	/*
 	 * And mount all the datasets, keeping track of which ones
 	 * succeeded or failed.
 	 */
-	if ((good = zfs_alloc(zhp->zpool_hdl,
-	    cb.cb_used * sizeof (int))) == NULL)
-		goto out;
+	mount_state_init(&ms, hdl, mountpoints, cb.cb_used, flags);
+	ms.ms_handles = cb.cb_handles;
+	ms.ms_mntopts = mntopts;
+	zfs_mount_parallel(&ms);
 
 	ret = 0;
 	for (i = 0; i < cb.cb_used; i++) {
-		/*
-		 * don't attempt to mount encrypted datasets with
-		 * unloaded keys
-		 */
-		if (zfs_prop_get_int(cb.cb_handles[i], ZFS_PROP_KEYSTATUS) ==
-		    ZFS_KEYSTATUS_UNAVAILABLE)
-			continue;
-
-		if (zfs_mount(cb.cb_handles[i], mntopts, flags) != 0)
+		if (ms.ms_status[i] < 0)
 			ret = -1;
-		else
-			good[i] = 1;
 	}
 
 	/*
 	 * Then share all the ones that need to be shared. This needs
 	 * to be a separate pass in order to avoid excessive reloading
-	 * of the configuration. Good should never be NULL since
-	 * zfs_alloc is supposed to exit if memory isn't available.
+	 * of the configuration.  libshare keeps per-process state and
+	 * rewrites the share table on every change, so this stays serial.
 	 */
 	for (i = 0; i < cb.cb_used; i++) {
-		if (good[i] && zfs_share(cb.cb_handles[i]) != 0)
+		if (ms.ms_status[i] > 0 && zfs_share(cb.cb_handles[i]) != 0)
 			ret = -1;
 	}
 
-	free(good);
+	mount_state_fini(&ms);
 
 out:
-	for (i = 0; i < cb.cb_used; i++)
+	for (i = 0; i < cb.cb_used; i++) {
 		zfs_close(cb.cb_handles[i]);
+		if (mountpoints != NULL)
+			free(mountpoints[i]);
+	}
+	free(mountpoints);
 	free(cb.cb_handles);
 
 	return (ret);
 }
 
+typedef struct mount_entry {
+	char		*me_mountpoint;
+	zfs_handle_t	*me_zhp;
+} mount_entry_t;
+
 static int
-mountpoint_compare(const void *a, const void *b)
+mount_entry_compare(const void *a, const void *b)
 {
-	const char *mounta = *((char **)a);
-	const char *mountb = *((char **)b);
+	const mount_entry_t *mea = a;
+	const mount_entry_t *meb = b;
 
-	return (strcmp(mountb, mounta));
+	return (mountpoint_path_cmp(mea->me_mountpoint, meb->me_mountpoint));
 }
 
 
@@ -1732,6 +1995,8 @@ zpool_disable_datasets(zpool_handle_t *zhp, boolean_t force)
 	char **mountpoints = NULL;
 	zfs_handle_t **datasets = NULL;
 	libzfs_handle_t *hdl = zhp->zpool_hdl;
+	mount_state_t ms;
+	boolean_t unmounted;
 	int i;
 	int ret = -1;
 	int flags = (force ? MS_FORCE : 0);
@@ -1812,9 +2077,24 @@ zpool_disable_datasets(zpool_handle_t *zhp, boolean_t force)
 
 	/*
 	 * At this point, we have the entire list of filesystems, so sort it by
-	 * mountpoint.
+	 * mountpoint, keeping each dataset with its mountpoint.
 	 */
-	qsort(mountpoints, used, sizeof (char *), mountpoint_compare);
+	if (used > 0) {
+		mount_entry_t *entries;
+
+		entries = zfs_alloc(hdl, used * sizeof (mount_entry_t));
+		for (i = 0; i < used; i++) {
+			entries[i].me_mountpoint = mountpoints[i];
+			entries[i].me_zhp = datasets[i];
+		}
+		qsort(entries, used, sizeof (mount_entry_t),
+		    mount_entry_compare);
+		for (i = 0; i < used; i++) {
+			mountpoints[i] = entries[i].me_mountpoint;
+			datasets[i] = entries[i].me_zhp;
+		}
+		free(entries);
+	}
 
 	/*
 	 * Walk through and first unshare everything.
@@ -1848,18 +2128,22 @@ zpool_disable_datasets(zpool_handle_t *zhp, boolean_t force)
 	}
 
 	/*
-	 * Now unmount everything, removing the underlying directories as
-	 * appropriate.
+	 * Now unmount everything, children before parents, removing the
+	 * underlying directories as appropriate.
 	 */
-	for (i = 0; i < used; i++) {
-		if (unmount_one(hdl, mountpoints[i], flags) != 0)
-			goto out;
-	}
+	mount_state_init(&ms, hdl, mountpoints, used, flags);
+	zfs_unmount_parallel(&ms);
 
+	unmounted = B_TRUE;
 	for (i = 0; i < used; i++) {
-		if (datasets[i])
+		if (ms.ms_status[i] <= 0)
+			unmounted = B_FALSE;
+		else if (datasets[i])
 			remove_mountpoint(datasets[i]);
 	}
+	mount_state_fini(&ms);
+	if (!unmounted)
+		goto out;
 
     // Surely there exists a better way to iterate a POOL to find its ZVOLs?
     zfs_iter_root(hdl, zpool_disable_volumes, (void *) zpool_get_name(zhp));
@@ -355,6 +355,31 @@ zpool_get_prop(zpool_handle_t *zhp, zpool_prop_t prop, char *buf,
 			}
 			break;
 
+		case ZPOOL_PROP_FREEINGRATE:
+			if (literal) {
+				(void) snprintf(buf, len, "%llu",
+				    (u_longlong_t)intval);
+			} else {
+				char rate[32];
+
+				zfs_nicenum(intval, rate, sizeof (rate));
+				(void) snprintf(buf, len, "%s/s", rate);
+			}
+			break;
+
+		case ZPOOL_PROP_FREEINGTIME:
+			if (intval == 0) {
+				(void) strlcpy(buf, "-", len);
+			} else if (literal) {
+				(void) snprintf(buf, len, "%llu",
+				    (u_longlong_t)intval);
+			} else {
+				(void) snprintf(buf, len, "%lluh%02llum",
+				    (u_longlong_t)(intval / 3600),
+				    (u_longlong_t)(intval % 3600 / 60));
+			}
+			break;
+
 		case ZPOOL_PROP_DEDUPRATIO:
 			(void) snprintf(buf, len, "%llu.%02llux",
 			    (u_longlong_t)(intval / 100),
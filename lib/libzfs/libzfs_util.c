@@ -1099,6 +1099,7 @@ libzfs_fini(libzfs_handle_t *hdl)
 	libzfs_fru_clear(hdl, B_TRUE);
 	namespace_clear(hdl);
 	libzfs_mnttab_fini(hdl);
+	pthread_mutex_destroy(&hdl->libzfs_mnttab_cache_lock);
 	libzfs_core_fini();
 	fletcher_4_fini();
 	free(hdl);
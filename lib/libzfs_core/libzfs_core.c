@@ -1126,6 +1126,95 @@ lzc_get_bookmarks(const char *fsname, nvlist_t *props, nvlist_t **bmarks)
 	return (lzc_ioctl(ZFS_IOC_GET_BOOKMARKS, fsname, props, bmarks));
 }
 
+/*
+ * Retrieve a batch of the children (or, with "snapshots" set in args, the
+ * snapshots) of the given dataset, along with their stats and properties.
+ *
+ * The optional args are:
+ * "snapshots" (boolean) - list snapshots instead of child datasets
+ * "simple" (boolean) - only return snapshot names
+ * "cursor" (uint64) - resume after the previous batch
+ * "count" (uint64) - maximum number of datasets in the batch
+ * "props" (nvlist) - names of the native properties to return; user
+ *     properties are always returned
+ * "snap_iter_min_txg", "snap_iter_max_txg" (uint64) - restrict the
+ *     snapshots to this range of creation txgs
+ *
+ * The format of the returned nvlist is as follows:
+ * "datasets" -> {
+ *     <name of dataset> -> {
+ *         "stats" -> dmu_objset_stats_t (uint8 array)
+ *         "props" -> { <name of property> -> { "value", "source" } }
+ *     }
+ * }
+ * "cursor" -> uint64, present only if more datasets remain
+ *
+ * Returns ZFS_ERR_IOC_CMD_UNAVAIL if the kernel does not support this ioctl.
+ */
+int
+lzc_list_batch(const char *fsname, nvlist_t *args, nvlist_t **result)
+{
+	return (lzc_ioctl(ZFS_IOC_LIST_BATCH, fsname, args, result));
+}
+
+/*
+ * Retrieve the zfs_stat_t and path of the allocated objects numbered from
+ * first to last in the given snapshot, as used by zfs diff.  Objects which
+ * are not returned are not allocated.
+ *
+ * The format of the returned nvlist is as follows:
+ * "objects" -> uint64 array of object numbers
+ * "errors" -> int32 array, the error looking up each object
+ * "stats" -> uint8 array of one zfs_stat_t per object
+ * "paths" -> string array, the path of each object without an error
+ * "next" -> uint64, present only if objects after it remain to be listed
+ *
+ * Returns ZFS_ERR_IOC_CMD_UNAVAIL if the kernel does not support this ioctl.
+ */
+int
+lzc_objs_to_stats(const char *snapname, uint64_t first, uint64_t last,
+    nvlist_t **result)
+{
+	nvlist_t *args;
+	int error;
+
+	args = fnvlist_alloc();
+	fnvlist_add_uint64(args, ZFS_OBJS_TO_STATS_FIRST, first);
+	fnvlist_add_uint64(args, ZFS_OBJS_TO_STATS_LAST, last);
+	error = lzc_ioctl(ZFS_IOC_OBJS_TO_STATS, snapname, args, result);
+	fnvlist_free(args);
+
+	return (error);
+}
+
+/*
+ * Retrieve the stats of every vdev in the pool, without the rest of the
+ * pool config.  With "extended" set, vdev_stat_ex_t is included as well.
+ *
+ * The format of the returned nvlist is as follows:
+ * "generation" -> uint64, the pool config generation
+ * "record_size" -> uint64, the number of uint64 words in each record
+ * "records" -> uint64 array of records, each holding a vdev guid, its
+ *     vdev_stat_t and, if requested, its vdev_stat_ex_t.  Records follow
+ *     the order of the vdev tree, depth first, then the cache devices.
+ *
+ * Returns ZFS_ERR_IOC_CMD_UNAVAIL if the kernel does not support this ioctl.
+ */
+int
+lzc_pool_vdev_stats(const char *pool, boolean_t extended, nvlist_t **result)
+{
+	nvlist_t *args;
+	int error;
+
+	args = fnvlist_alloc();
+	if (extended)
+		fnvlist_add_boolean(args, ZPOOL_VDEV_STATS_EXTENDED);
+	error = lzc_ioctl(ZFS_IOC_POOL_VDEV_STATS, pool, args, result);
+	fnvlist_free(args);
+
+	return (error);
+}
+
 /*
  * Destroys bookmarks.
  *
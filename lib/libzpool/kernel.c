@@ -133,6 +133,24 @@ zk_thread_current(void)
 	return (kt);
 }
 
+/*
+ * There is no portable way to ask which CPU we are on, so CPU_SEQID hands
+ * out sequence numbers to threads instead.  Masking pthread_self(), which
+ * points to a page-aligned structure, would send every thread to the same
+ * aggsum or wmsum bucket.
+ */
+static volatile uint_t zk_thread_seqids;
+static __thread uint_t zk_thread_seqid_cur;	/* seqid + 1, or 0 if unset */
+
+uint_t
+zk_thread_seqid(void)
+{
+	if (zk_thread_seqid_cur == 0)
+		zk_thread_seqid_cur = atomic_inc_uint_nv(&zk_thread_seqids);
+
+	return (zk_thread_seqid_cur - 1);
+}
+
 void *
 zk_thread_helper(void *arg)
 {
@@ -35,6 +35,27 @@
 	(o)->mul((uint64_t *)(void *)(c)->gcm_ghash, (c)->gcm_H, \
 	(uint64_t *)(void *)(t));
 
+/*
+ * Ciphertext is hashed in runs of up to this many blocks, so that the
+ * hardware accelerated implementations only save and restore the FPU
+ * state once per run instead of once per 16-byte block.  The run length
+ * also bounds the time spent with the FPU held.
+ */
+#define	GCM_GHASH_RUN_BLOCKS	32
+
+static void
+gcm_ghash_blocks(gcm_ctx_t *ctx, gcm_impl_ops_t *gops, const uint8_t *data,
+    size_t nblocks, size_t block_size)
+{
+	while (nblocks > 0) {
+		size_t n = MIN(nblocks, GCM_GHASH_RUN_BLOCKS);
+
+		gops->ghash(ctx->gcm_ghash, ctx->gcm_H, data, n);
+		data += n * block_size;
+		nblocks -= n;
+	}
+}
+
 /*
  * Encrypt multiple blocks of data in GCM mode.  Decrypt for GCM mode
  * is done in another function.
@@ -59,6 +80,11 @@ gcm_mode_encrypt_contiguous_blocks(gcm_ctx_t *ctx, char *data, size_t length,
 	size_t out_data_1_len;
 	uint64_t counter;
 	uint64_t counter_mask = ntohll(0x00000000ffffffffULL);
+	uint8_t ghash_run[GCM_GHASH_RUN_BLOCKS * 16];
+	size_t ghash_run_len = 0;
+	int rv = CRYPTO_SUCCESS;
+
+	ASSERT3U(block_size, ==, 16);
 
 	if (length + ctx->gcm_remainder_len < block_size) {
 		/* accumulate bytes here and return */
@@ -80,8 +106,10 @@ gcm_mode_encrypt_contiguous_blocks(gcm_ctx_t *ctx, char *data, size_t length,
 		if (ctx->gcm_remainder_len > 0) {
 			need = block_size - ctx->gcm_remainder_len;
 
-			if (need > remainder)
-				return (CRYPTO_DATA_LEN_RANGE);
+			if (need > remainder) {
+				rv = CRYPTO_DATA_LEN_RANGE;
+				goto out;
+			}
 
 			bcopy(datap, &((uint8_t *)ctx->gcm_remainder)
 			    [ctx->gcm_remainder_len], need);
@@ -134,8 +162,17 @@ gcm_mode_encrypt_contiguous_blocks(gcm_ctx_t *ctx, char *data, size_t length,
 			out->cd_offset += block_size;
 		}
 
-		/* add ciphertext to the hash */
-		GHASH(ctx, ctx->gcm_tmp, ctx->gcm_ghash, gops);
+		/*
+		 * Queue the ciphertext for the hash; it is folded in a run
+		 * of blocks at a time below.
+		 */
+		copy_block(lastp, &ghash_run[ghash_run_len]);
+		ghash_run_len += block_size;
+		if (ghash_run_len == sizeof (ghash_run)) {
+			gcm_ghash_blocks(ctx, gops, ghash_run,
+			    GCM_GHASH_RUN_BLOCKS, block_size);
+			ghash_run_len = 0;
+		}
 
 		/* Update pointer to next block of data to be processed. */
 		if (ctx->gcm_remainder_len != 0) {
@@ -158,7 +195,15 @@ gcm_mode_encrypt_contiguous_blocks(gcm_ctx_t *ctx, char *data, size_t length,
 
 	} while (remainder > 0);
 out:
-	return (CRYPTO_SUCCESS);
+	/*
+	 * Add the remaining queued ciphertext to the hash, on every exit,
+	 * so that gcm_ghash always covers all the ciphertext produced.
+	 */
+	if (ghash_run_len > 0) {
+		gcm_ghash_blocks(ctx, gops, ghash_run,
+		    ghash_run_len / block_size, block_size);
+	}
+	return (rv);
 }
 
 /* ARGSUSED */
@@ -337,6 +382,14 @@ gcm_decrypt_final(gcm_ctx_t *ctx, crypto_data_t *out, size_t block_size,
 	ghash = (uint8_t *)ctx->gcm_ghash;
 	blockp = ctx->gcm_pt_buf;
 	remainder = pt_len;
+
+	/*
+	 * All of the ciphertext is buffered at this point, so hash the whole
+	 * blocks in one go before decrypting them.  The incomplete last
+	 * block, if any, is hashed by gcm_decrypt_incomplete_block().
+	 */
+	gcm_ghash_blocks(ctx, gops, blockp, pt_len / block_size, block_size);
+
 	while (remainder > 0) {
 		/* Incomplete last block */
 		if (remainder < block_size) {
@@ -351,8 +404,6 @@ gcm_decrypt_final(gcm_ctx_t *ctx, crypto_data_t *out, size_t block_size,
 			ctx->gcm_remainder_len = 0;
 			goto out;
 		}
-		/* add ciphertext to the hash */
-		GHASH(ctx, blockp, ghash, gops);
 
 		/*
 		 * Increment counter.
@@ -696,6 +747,67 @@ gcm_impl_get_ops()
 	return (ops);
 }
 
+#if defined(_KERNEL)
+
+#define	GCM_IMPL_BENCH_SIZE	(16 * 1024)		/* 16kiB */
+#define	GCM_IMPL_BENCH_NS	(MSEC2NSEC(10))		/* 10ms */
+
+/*
+ * GHASH a buffer with every supported implementation and return the one
+ * with the highest throughput.
+ */
+static const gcm_impl_ops_t *
+gcm_impl_benchmark(void)
+{
+	const gcm_impl_ops_t *best_impl = &gcm_generic_impl;
+	uint64_t ghash[2], H[2] = { 0x0123456789abcdefULL, 0 };
+	uint64_t run_bw, run_time_ns, best_bw = 0;
+	hrtime_t start;
+	uint8_t *databuf;
+	size_t i;
+	int l;
+
+	databuf = kmem_alloc(GCM_IMPL_BENCH_SIZE, KM_SLEEP);
+	for (i = 0; i < GCM_IMPL_BENCH_SIZE; i++)
+		databuf[i] = (uint8_t)i;
+
+	for (i = 0; i < gcm_supp_impl_cnt; i++) {
+		const gcm_impl_ops_t *impl = gcm_supp_impl[i];
+		uint64_t run_count = 0;
+
+		ghash[0] = ghash[1] = 0;
+
+		kpreempt_disable();
+		start = gethrtime();
+		do {
+			for (l = 0; l < 8; l++, run_count++) {
+				impl->ghash(ghash, H, databuf,
+				    GCM_IMPL_BENCH_SIZE / 16);
+			}
+
+			run_time_ns = gethrtime() - start;
+		} while (run_time_ns < GCM_IMPL_BENCH_NS);
+		kpreempt_enable();
+
+		run_bw = GCM_IMPL_BENCH_SIZE * run_count * NANOSEC;
+		run_bw /= run_time_ns;	/* B/s */
+
+		if (run_bw > best_bw) {
+			best_bw = run_bw;
+			best_impl = impl;
+		}
+#ifdef __APPLE__
+		dprintf("%s: %14s %16llu B/s\n", __func__, impl->name, run_bw);
+#endif
+	}
+
+	kmem_free(databuf, GCM_IMPL_BENCH_SIZE);
+
+	return (best_impl);
+}
+
+#endif
+
 void
 gcm_impl_init(void)
 {
@@ -711,6 +823,11 @@ gcm_impl_init(void)
 	}
 	gcm_supp_impl_cnt = c;
 
+#if defined(_KERNEL)
+	/* benchmark all supported implementations and pick the fastest */
+	memcpy(&gcm_fastest_impl, gcm_impl_benchmark(),
+	    sizeof (gcm_fastest_impl));
+#else
 	/* set fastest implementation. assume hardware accelerated is fastest */
 #if defined(__x86_64) && defined(HAVE_PCLMULQDQ)
 	if (gcm_pclmulqdq_impl.is_supported())
@@ -720,6 +837,7 @@ gcm_impl_init(void)
 #endif
 		memcpy(&gcm_fastest_impl, &gcm_generic_impl,
 		    sizeof (gcm_fastest_impl));
+#endif
 
 	strlcpy(gcm_fastest_impl.name, "fastest", sizeof(gcm_fastest_impl.name));
 
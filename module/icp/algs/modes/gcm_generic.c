@@ -70,6 +70,24 @@ gcm_generic_mul(uint64_t *x_in, uint64_t *y, uint64_t *res)
 	res[1] = htonll(z.b);
 }
 
+/*
+ * GHASH 'nblocks' contiguous 16-byte blocks starting at 'data' into
+ * *ghash, using hash subkey *H.
+ */
+static void
+gcm_generic_ghash(uint64_t *ghash, uint64_t *H, const uint8_t *data,
+    size_t nblocks)
+{
+	uint64_t x[2];
+
+	for (; nblocks > 0; nblocks--, data += 16) {
+		bcopy(data, x, sizeof (x));
+		ghash[0] ^= x[0];
+		ghash[1] ^= x[1];
+		gcm_generic_mul(ghash, H, ghash);
+	}
+}
+
 static boolean_t
 gcm_generic_will_work(void)
 {
@@ -78,6 +96,7 @@ gcm_generic_will_work(void)
 
 const gcm_impl_ops_t gcm_generic_impl = {
 	.mul = &gcm_generic_mul,
+	.ghash = &gcm_generic_ghash,
 	.is_supported = &gcm_generic_will_work,
 	.name = "generic"
 };
@@ -40,6 +40,10 @@
 #define	_SHA2_IMPL
 #include <sys/sha2.h>
 #include <sha2/sha2_consts.h>
+#include <sha2/sha2_impl.h>
+#if defined(__x86_64)
+#include <sys/simd_x86.h>
+#endif
 
 #define	_RESTRICT_KYWD
 
@@ -52,18 +56,17 @@
 static void Encode(uint8_t *, uint32_t *, size_t);
 static void Encode64(uint8_t *, uint64_t *, size_t);
 
-/* userspace only supports the generic version */
-#if	defined(__amd64) && defined(_KERNEL)
-#define	SHA512Transform(ctx, in) SHA512TransformBlocks((ctx), (in), 1)
-#define	SHA256Transform(ctx, in) SHA256TransformBlocks((ctx), (in), 1)
+static void SHA256Transform(SHA2_CTX *, const uint8_t *);
+static void SHA512Transform(SHA2_CTX *, const uint8_t *);
 
+#if defined(__x86_64)
 void SHA512TransformBlocks(SHA2_CTX *ctx, const void *in, size_t num);
 void SHA256TransformBlocks(SHA2_CTX *ctx, const void *in, size_t num);
+#endif
 
-#else
-static void SHA256Transform(SHA2_CTX *, const uint8_t *);
-static void SHA512Transform(SHA2_CTX *, const uint8_t *);
-#endif	/* __amd64 && _KERNEL */
+#if defined(__x86_64) && defined(HAVE_SHA_NI)
+void SHA256TransformBlocks_shani(SHA2_CTX *ctx, const void *in, size_t num);
+#endif
 
 static uint8_t PADDING[128] = { 0x80, /* all zeros */ };
 
@@ -143,7 +146,6 @@ static uint8_t PADDING[128] = { 0x80, /* all zeros */ };
 #endif	/* _BIG_ENDIAN */
 
 
-#if	!defined(__amd64) || !defined(_KERNEL)
 /* SHA256 Transform */
 
 static void
@@ -601,7 +603,24 @@ SHA512Transform(SHA2_CTX *ctx, const uint8_t *blk)
 	ctx->state.s64[7] += h;
 
 }
-#endif	/* !__amd64 || !_KERNEL */
+
+static void
+SHA256TransformBlocks_generic(SHA2_CTX *ctx, const void *in, size_t num)
+{
+	const uint8_t *blk = in;
+
+	for (; num > 0; num--, blk += 64)
+		SHA256Transform(ctx, blk);
+}
+
+static void
+SHA512TransformBlocks_generic(SHA2_CTX *ctx, const void *in, size_t num)
+{
+	const uint8_t *blk = in;
+
+	for (; num > 0; num--, blk += 128)
+		SHA512Transform(ctx, blk);
+}
 
 
 /*
@@ -783,9 +802,8 @@ SHA2Update(SHA2_CTX *ctx, const void *inptr, size_t input_len)
 	uint32_t	i, buf_index, buf_len, buf_limit;
 	const uint8_t	*input = inptr;
 	uint32_t	algotype = ctx->algotype;
-#if !(!defined(__amd64) || !defined(_KERNEL))
 	uint32_t	block_count;
-#endif	/* !__amd64 */
+	sha2_impl_ops_t	*ops;
 
 
 	/* check for noop */
@@ -822,6 +840,7 @@ SHA2Update(SHA2_CTX *ctx, const void *inptr, size_t input_len)
 	/* transform as many times as possible */
 	i = 0;
 	if (input_len >= buf_len) {
+		ops = sha2_impl_get_ops();
 
 		/*
 		 * general optimization:
@@ -835,41 +854,26 @@ SHA2Update(SHA2_CTX *ctx, const void *inptr, size_t input_len)
 		if (buf_index) {
 			bcopy(input, &ctx->buf_un.buf8[buf_index], buf_len);
 			if (algotype <= SHA256_HMAC_GEN_MECH_INFO_TYPE)
-				SHA256Transform(ctx, ctx->buf_un.buf8);
+				ops->sha256_blocks(ctx, ctx->buf_un.buf8, 1);
 			else
-				SHA512Transform(ctx, ctx->buf_un.buf8);
+				ops->sha512_blocks(ctx, ctx->buf_un.buf8, 1);
 
 			i = buf_len;
 		}
 
-#if !defined(__amd64) || !defined(_KERNEL)
-		if (algotype <= SHA256_HMAC_GEN_MECH_INFO_TYPE) {
-			for (; i + buf_limit - 1 < input_len; i += buf_limit) {
-				SHA256Transform(ctx, &input[i]);
-			}
-		} else {
-			for (; i + buf_limit - 1 < input_len; i += buf_limit) {
-				SHA512Transform(ctx, &input[i]);
-			}
-		}
-
-#else
 		if (algotype <= SHA256_HMAC_GEN_MECH_INFO_TYPE) {
 			block_count = (input_len - i) >> 6;
 			if (block_count > 0) {
-				SHA256TransformBlocks(ctx, &input[i],
-				    block_count);
+				ops->sha256_blocks(ctx, &input[i], block_count);
 				i += block_count << 6;
 			}
 		} else {
 			block_count = (input_len - i) >> 7;
 			if (block_count > 0) {
-				SHA512TransformBlocks(ctx, &input[i],
-				    block_count);
+				ops->sha512_blocks(ctx, &input[i], block_count);
 				i += block_count << 7;
 			}
 		}
-#endif	/* !__amd64 || !_KERNEL */
 
 		/*
 		 * general optimization:
@@ -953,6 +957,374 @@ SHA2Final(void *digest, SHA2_CTX *ctx)
 
 
 
+static boolean_t
+sha2_generic_will_work(void)
+{
+	return (B_TRUE);
+}
+
+const sha2_impl_ops_t sha2_generic_impl = {
+	.sha256_blocks = &SHA256TransformBlocks_generic,
+	.sha512_blocks = &SHA512TransformBlocks_generic,
+	.is_supported = &sha2_generic_will_work,
+	.name = "generic"
+};
+
+#if defined(__x86_64)
+const sha2_impl_ops_t sha2_x86_64_impl = {
+	.sha256_blocks = &SHA256TransformBlocks,
+	.sha512_blocks = &SHA512TransformBlocks,
+	.is_supported = &sha2_generic_will_work,
+	.name = "x86_64"
+};
+#endif
+
+#if defined(__x86_64) && defined(HAVE_SHA_NI)
+static void
+SHA256TransformBlocks_shani_fpu(SHA2_CTX *ctx, const void *in, size_t num)
+{
+	kfpu_begin();
+	SHA256TransformBlocks_shani(ctx, in, num);
+	kfpu_end();
+}
+
+static boolean_t
+sha2_shani_will_work(void)
+{
+	return (zfs_shani_available());
+}
+
+/* SHA-NI only covers SHA-256; SHA-384/512 use the integer x86_64 code */
+const sha2_impl_ops_t sha2_shani_impl = {
+	.sha256_blocks = &SHA256TransformBlocks_shani_fpu,
+	.sha512_blocks = &SHA512TransformBlocks,
+	.is_supported = &sha2_shani_will_work,
+	.name = "shani"
+};
+#endif
+
+/*
+ * SHA2 implementation that contains the fastest methods.  It is usable
+ * before sha2_impl_init() is called, since SHA2Update() may be reached
+ * before the ICP is initialized.
+ */
+static sha2_impl_ops_t sha2_fastest_impl = {
+	.sha256_blocks = &SHA256TransformBlocks_generic,
+	.sha512_blocks = &SHA512TransformBlocks_generic,
+	.is_supported = &sha2_generic_will_work,
+	.name = "fastest"
+};
+
+/* All compiled in implementations */
+const sha2_impl_ops_t *sha2_all_impl[] = {
+	&sha2_generic_impl,
+#if defined(__x86_64)
+	&sha2_x86_64_impl,
+#endif
+#if defined(__x86_64) && defined(HAVE_SHA_NI)
+	&sha2_shani_impl,
+#endif
+};
+
+/* Indicate that benchmark has been completed */
+static boolean_t sha2_impl_initialized = B_FALSE;
+
+/* Select sha2 implementation */
+#define	IMPL_FASTEST	(UINT32_MAX)
+#define	IMPL_CYCLE	(UINT32_MAX-1)
+
+#define	SHA2_IMPL_READ(i) (*(volatile uint64_t *) &(i))
+
+static uint64_t icp_sha2_impl = IMPL_FASTEST;
+static uint64_t user_sel_impl = IMPL_FASTEST;
+
+/* Hold all supported implementations */
+static size_t sha2_supp_impl_cnt = 0;
+static sha2_impl_ops_t *sha2_supp_impl[ARRAY_SIZE(sha2_all_impl)];
+
+/*
+ * Selects the sha2 block transforms
+ */
+sha2_impl_ops_t *
+sha2_impl_get_ops()
+{
+	sha2_impl_ops_t *ops = NULL;
+	const uint64_t impl = SHA2_IMPL_READ(icp_sha2_impl);
+
+	switch (impl) {
+	case IMPL_FASTEST:
+		ops = &sha2_fastest_impl;
+		break;
+	case IMPL_CYCLE:
+	{
+		ASSERT(sha2_impl_initialized);
+		ASSERT3U(sha2_supp_impl_cnt, >, 0);
+		/* Cycle through supported implementations */
+		static size_t cycle_impl_idx = 0;
+		size_t idx = (++cycle_impl_idx) % sha2_supp_impl_cnt;
+		ops = sha2_supp_impl[idx];
+	}
+	break;
+	default:
+		ASSERT3U(impl, <, sha2_supp_impl_cnt);
+		ASSERT3U(sha2_supp_impl_cnt, >, 0);
+		if (impl < ARRAY_SIZE(sha2_all_impl))
+			ops = sha2_supp_impl[impl];
+		break;
+	}
+
+	ASSERT3P(ops, !=, NULL);
+
+	return (ops);
+}
+
+#if defined(_KERNEL)
+
+#define	SHA2_IMPL_BENCH_SIZE	(16 * 1024)		/* 16kiB */
+#define	SHA2_IMPL_BENCH_NS	(MSEC2NSEC(10))		/* 10ms */
+
+/*
+ * Run the SHA-256 or SHA-512 block transform of every supported
+ * implementation over a buffer and return the one with the highest
+ * throughput.
+ */
+static const sha2_impl_ops_t *
+sha2_impl_benchmark(const uint8_t *databuf, boolean_t sha512)
+{
+	const sha2_impl_ops_t *best_impl = &sha2_generic_impl;
+	uint64_t run_bw, run_time_ns, best_bw = 0;
+	SHA2_CTX ctx;
+	hrtime_t start;
+	size_t i;
+	int l;
+
+	for (i = 0; i < sha2_supp_impl_cnt; i++) {
+		const sha2_impl_ops_t *impl = sha2_supp_impl[i];
+		uint64_t run_count = 0;
+
+		SHA2Init(sha512 ? SHA512 : SHA256, &ctx);
+
+		kpreempt_disable();
+		start = gethrtime();
+		do {
+			for (l = 0; l < 8; l++, run_count++) {
+				if (sha512)
+					impl->sha512_blocks(&ctx, databuf,
+					    SHA2_IMPL_BENCH_SIZE / 128);
+				else
+					impl->sha256_blocks(&ctx, databuf,
+					    SHA2_IMPL_BENCH_SIZE / 64);
+			}
+
+			run_time_ns = gethrtime() - start;
+		} while (run_time_ns < SHA2_IMPL_BENCH_NS);
+		kpreempt_enable();
+
+		run_bw = SHA2_IMPL_BENCH_SIZE * run_count * NANOSEC;
+		run_bw /= run_time_ns;	/* B/s */
+
+		if (run_bw > best_bw) {
+			best_bw = run_bw;
+			best_impl = impl;
+		}
+#ifdef __APPLE__
+		dprintf("%s: %s %14s %16llu B/s\n", __func__,
+		    sha512 ? "sha512" : "sha256", impl->name, run_bw);
+#endif
+	}
+
+	bzero(&ctx, sizeof (ctx));
+
+	return (best_impl);
+}
+
+#endif
+
+void
+sha2_impl_init(void)
+{
+	sha2_impl_ops_t *curr_impl;
+	const sha2_impl_ops_t *impl256, *impl512;
+	int i, c;
+
+	/* move supported impl into sha2_supp_impls */
+	for (i = 0, c = 0; i < ARRAY_SIZE(sha2_all_impl); i++) {
+		curr_impl = (sha2_impl_ops_t *)sha2_all_impl[i];
+
+		if (curr_impl->is_supported())
+			sha2_supp_impl[c++] = (sha2_impl_ops_t *)curr_impl;
+	}
+	sha2_supp_impl_cnt = c;
+
+#if defined(_KERNEL)
+	{
+		/* benchmark both transforms, the fastest may differ */
+		uint8_t *databuf;
+		size_t j;
+
+		databuf = kmem_alloc(SHA2_IMPL_BENCH_SIZE, KM_SLEEP);
+		for (j = 0; j < SHA2_IMPL_BENCH_SIZE; j++)
+			databuf[j] = (uint8_t)j;
+
+		impl256 = sha2_impl_benchmark(databuf, B_FALSE);
+		impl512 = sha2_impl_benchmark(databuf, B_TRUE);
+
+		kmem_free(databuf, SHA2_IMPL_BENCH_SIZE);
+	}
+#else
+	/* set fastest implementation. assume hardware accelerated is fastest */
+#if defined(__x86_64)
+#if defined(HAVE_SHA_NI)
+	if (sha2_shani_impl.is_supported())
+		impl256 = &sha2_shani_impl;
+	else
+#endif
+		impl256 = &sha2_x86_64_impl;
+	impl512 = &sha2_x86_64_impl;
+#else
+	impl256 = impl512 = &sha2_generic_impl;
+#endif
+#endif
+
+	sha2_fastest_impl.sha256_blocks = impl256->sha256_blocks;
+	sha2_fastest_impl.sha512_blocks = impl512->sha512_blocks;
+
+	/* Finish initialization */
+	atomic_swap_64(&icp_sha2_impl, user_sel_impl);
+	sha2_impl_initialized = B_TRUE;
+}
+
+static const struct {
+	char *name;
+	uint64_t sel;
+} sha2_impl_opts[] = {
+		{ "cycle",	IMPL_CYCLE },
+		{ "fastest",	IMPL_FASTEST },
+};
+
+/*
+ * Function sets desired sha2 implementation.
+ *
+ * If we are called before init(), user preference will be saved in
+ * user_sel_impl, and applied in later init() call. This occurs when module
+ * parameter is specified on module load. Otherwise, directly update
+ * icp_sha2_impl.
+ *
+ * @val		Name of sha2 implementation to use
+ */
+int
+sha2_impl_set(const char *val)
+{
+	int err = -EINVAL;
+	char req_name[SHA2_IMPL_NAME_MAX];
+	uint64_t impl = SHA2_IMPL_READ(user_sel_impl);
+	size_t i;
+
+	/* sanitize input */
+	i = strnlen(val, SHA2_IMPL_NAME_MAX);
+	if (i == 0 || i >= SHA2_IMPL_NAME_MAX)
+		return (err);
+
+	strlcpy(req_name, val, SHA2_IMPL_NAME_MAX);
+	while (i > 0 && isspace(req_name[i-1]))
+		i--;
+	req_name[i] = '\0';
+
+	/* Check mandatory options */
+	for (i = 0; i < ARRAY_SIZE(sha2_impl_opts); i++) {
+		if (strcmp(req_name, sha2_impl_opts[i].name) == 0) {
+			impl = sha2_impl_opts[i].sel;
+			err = 0;
+			break;
+		}
+	}
+
+	/* check all supported impl if init() was already called */
+	if (err != 0 && sha2_impl_initialized) {
+		/* check all supported implementations */
+		for (i = 0; i < sha2_supp_impl_cnt; i++) {
+			if (strcmp(req_name, sha2_supp_impl[i]->name) == 0) {
+				impl = i;
+				err = 0;
+				break;
+			}
+		}
+	}
+
+	if (err == 0) {
+		if (sha2_impl_initialized)
+			atomic_swap_64(&icp_sha2_impl, impl);
+		else
+			atomic_swap_64(&user_sel_impl, impl);
+	}
+
+	return (err);
+}
+
+uint32_t
+sha2_impl_getcnt(void)
+{
+	ASSERT(sha2_impl_initialized);
+	return (sha2_supp_impl_cnt);
+}
+
+const char *
+sha2_impl_getname(uint32_t id)
+{
+	ASSERT3U(id, <, sha2_supp_impl_cnt);
+	return (sha2_supp_impl[id]->name);
+}
+
+uint64_t
+sha2_impl_getid(void)
+{
+	return (SHA2_IMPL_READ(icp_sha2_impl));
+}
+
+void
+sha2_impl_setid(uint64_t id)
+{
+	ASSERT(id == IMPL_FASTEST || id == IMPL_CYCLE ||
+	    id < sha2_supp_impl_cnt);
+	atomic_swap_64(&icp_sha2_impl, id);
+}
+
+#if defined(_KERNEL)
+
+int
+icp_sha2_impl_set(const char *val)
+{
+	return (sha2_impl_set(val));
+}
+
+int
+icp_sha2_impl_get(char *buffer, int max)
+{
+	int i, cnt = 0;
+	char *fmt;
+	const uint64_t impl = SHA2_IMPL_READ(icp_sha2_impl);
+
+	ASSERT(sha2_impl_initialized);
+
+	/* list mandatory options */
+	for (i = 0; i < ARRAY_SIZE(sha2_impl_opts) && cnt < max; i++) {
+		fmt = (impl == sha2_impl_opts[i].sel) ? "[%s] " : "%s ";
+		cnt += snprintf(buffer + cnt, max - cnt, fmt,
+		    sha2_impl_opts[i].name);
+	}
+
+	/* list all supported implementations */
+	for (i = 0; i < sha2_supp_impl_cnt && cnt < max; i++) {
+		fmt = (i == impl) ? "[%s] " : "%s ";
+		cnt += snprintf(buffer + cnt, max - cnt, fmt,
+		    sha2_supp_impl[i]->name);
+	}
+
+	return (MIN(cnt, max));
+}
+
+#endif
+
 #ifdef _KERNEL
 EXPORT_SYMBOL(SHA2Init);
 EXPORT_SYMBOL(SHA2Update);
@@ -40,15 +40,19 @@ extern "C" {
  * Methods used to define gcm implementation
  *
  * @gcm_mul_f Perform carry-less multiplication
+ * @gcm_ghash_f Fold a run of whole blocks into the running GHASH
  * @gcm_will_work_f Function tests whether implementation will function
  */
 typedef void 		(*gcm_mul_f)(uint64_t *, uint64_t *, uint64_t *);
+typedef void		(*gcm_ghash_f)(uint64_t *, uint64_t *,
+    const uint8_t *, size_t);
 typedef boolean_t	(*gcm_will_work_f)(void);
 
 #define	GCM_IMPL_NAME_MAX (16)
 
 typedef struct gcm_impl_ops {
 	gcm_mul_f mul;
+	gcm_ghash_f ghash;
 	gcm_will_work_f is_supported;
 	char name[GCM_IMPL_NAME_MAX];
 } gcm_impl_ops_t;
@@ -57,6 +57,39 @@ typedef struct sha2_hmac_ctx {
 	SHA2_CTX		hc_ocontext;	/* outer SHA2 context */
 } sha2_hmac_ctx_t;
 
+/*
+ * Methods used to define sha2 implementation
+ *
+ * @sha2_blocks_f Transform a run of whole blocks into the context state
+ * @sha2_will_work_f Function tests whether implementation will function
+ */
+typedef void		(*sha2_blocks_f)(SHA2_CTX *, const void *, size_t);
+typedef boolean_t	(*sha2_will_work_f)(void);
+
+#define	SHA2_IMPL_NAME_MAX (16)
+
+typedef struct sha2_impl_ops {
+	sha2_blocks_f sha256_blocks;
+	sha2_blocks_f sha512_blocks;
+	sha2_will_work_f is_supported;
+	char name[SHA2_IMPL_NAME_MAX];
+} sha2_impl_ops_t;
+
+/*
+ * Initializes fastest implementation
+ */
+void sha2_impl_init(void);
+
+/*
+ * Get selected sha2 implementation
+ */
+struct sha2_impl_ops *sha2_impl_get_ops(void);
+
+/*
+ * Set the sha2 implementation by name
+ */
+int sha2_impl_set(const char *);
+
 #ifdef	__cplusplus
 }
 #endif
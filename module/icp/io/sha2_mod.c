@@ -223,6 +223,9 @@ sha2_mod_init(void)
 	if ((ret = mod_install(&modlinkage)) != 0)
 		return (ret);
 
+	/* Determine the fastest available implementation. */
+	sha2_impl_init();
+
 	/*
 	 * Register with KCF. If the registration fails, log an
 	 * error but do not uninstall the module, since the functionality
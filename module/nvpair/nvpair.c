@@ -145,6 +145,18 @@ int nvpair_max_recursion = 20;
 int nvpair_max_recursion = 100;
 #endif
 
+/*
+ * Lists with unique names are indexed by a hash of the pair names once
+ * they hold nvpair_hash_min pairs, so that lookups, removals and the
+ * duplicate check in nvlist_add_common() do not walk the whole list.
+ * The index is only an accelerator: if it cannot be allocated the list
+ * is walked as before.  Lists built on the fixed allocator are never
+ * indexed, since their buffers are sized for the pairs alone.
+ */
+uint_t nvpair_hash_min = 64;
+
+#define	NVP_HASH_MIN_BUCKETS	16
+
 int
 nv_alloc_init(nv_alloc_t *nva, const nv_alloc_ops_t *nvo, /* args */ ...)
 {
@@ -356,6 +368,130 @@ nvp_buf_free(nvlist_t *nvl, nvpair_t *nvp)
 	nv_mem_free(priv, NVPAIR2I_NVP(nvp), nvsize);
 }
 
+/*
+ * nvp_hash - hash an nvpair name (ELF hash).
+ */
+static uint32_t
+nvp_hash(const char *name)
+{
+	uint32_t h = 0, g;
+
+	while (*name != '\0') {
+		h = (h << 4) + (uchar_t)*name++;
+		if ((g = (h & 0xf0000000)) != 0)
+			h ^= g >> 24;
+		h &= ~g;
+	}
+
+	return (h);
+}
+
+/*
+ * nvp_hash_insert - add a pair to the end of its hash bucket.  Buckets
+ * keep list order, so a lookup finds the same pair a list walk would.
+ */
+static void
+nvp_hash_insert(nvpriv_t *priv, i_nvp_t *curr)
+{
+	i_nvp_t **prevp = &priv->nvp_hashtable[
+	    nvp_hash(NVP_NAME(&curr->nvi_nvp)) & (priv->nvp_nbuckets - 1)];
+
+	while (*prevp != NULL)
+		prevp = &(*prevp)->nvi_hashtable_next;
+
+	curr->nvi_hashtable_next = NULL;
+	*prevp = curr;
+}
+
+static void
+nvp_hash_remove(nvpriv_t *priv, i_nvp_t *curr)
+{
+	i_nvp_t **prevp = &priv->nvp_hashtable[
+	    nvp_hash(NVP_NAME(&curr->nvi_nvp)) & (priv->nvp_nbuckets - 1)];
+
+	while (*prevp != NULL && *prevp != curr)
+		prevp = &(*prevp)->nvi_hashtable_next;
+
+	if (*prevp != NULL)
+		*prevp = curr->nvi_hashtable_next;
+}
+
+/*
+ * nvp_hash_resize - rebuild the index with nbuckets buckets.  On failure
+ * the existing index, if any, is left untouched.
+ */
+static int
+nvp_hash_resize(nvpriv_t *priv, uint32_t nbuckets)
+{
+	i_nvp_t **tab, *curr;
+
+	if ((tab = nv_mem_zalloc(priv, nbuckets * sizeof (i_nvp_t *))) == NULL)
+		return (ENOMEM);
+
+	if (priv->nvp_hashtable != NULL) {
+		nv_mem_free(priv, priv->nvp_hashtable,
+		    priv->nvp_nbuckets * sizeof (i_nvp_t *));
+	}
+	priv->nvp_hashtable = tab;
+	priv->nvp_nbuckets = nbuckets;
+
+	for (curr = priv->nvp_list; curr != NULL; curr = curr->nvi_next)
+		nvp_hash_insert(priv, curr);
+
+	return (0);
+}
+
+/*
+ * nvp_hash_link - index a pair just linked onto the nvlist, building or
+ * growing the index as needed to keep buckets short.
+ */
+static void
+nvp_hash_link(nvlist_t *nvl, i_nvp_t *curr)
+{
+	nvpriv_t *priv = (nvpriv_t *)(uintptr_t)nvl->nvl_priv;
+	uint32_t nbuckets = priv->nvp_nbuckets;
+
+	if (!(nvl->nvl_nvflag & (NV_UNIQUE_NAME | NV_UNIQUE_NAME_TYPE)) ||
+	    priv->nvp_nentries < nvpair_hash_min ||
+	    priv->nvp_nva->nva_ops == nv_fixed_ops)
+		return;
+
+	if (nbuckets == 0)
+		nbuckets = NVP_HASH_MIN_BUCKETS;
+	while (priv->nvp_nentries > 2 * (uint64_t)nbuckets)
+		nbuckets <<= 1;
+
+	if (nbuckets != priv->nvp_nbuckets &&
+	    nvp_hash_resize(priv, nbuckets) == 0)
+		return;
+
+	if (priv->nvp_hashtable != NULL)
+		nvp_hash_insert(priv, curr);
+}
+
+/*
+ * nvp_first/nvp_next - walk the pairs that may be named name: its hash
+ * bucket if the nvlist is indexed, otherwise the whole list.
+ */
+static i_nvp_t *
+nvp_first(nvpriv_t *priv, const char *name)
+{
+	if (priv->nvp_hashtable == NULL)
+		return (priv->nvp_list);
+
+	return (priv->nvp_hashtable[nvp_hash(name) &
+	    (priv->nvp_nbuckets - 1)]);
+}
+
+static i_nvp_t *
+nvp_next(nvpriv_t *priv, i_nvp_t *curr)
+{
+	if (priv->nvp_hashtable == NULL)
+		return (curr->nvi_next);
+
+	return (curr->nvi_hashtable_next);
+}
+
 /*
  * nvp_buf_link - link a new nv pair into the nvlist.
  */
@@ -373,6 +509,9 @@ nvp_buf_link(nvlist_t *nvl, nvpair_t *nvp)
 		priv->nvp_last->nvi_next = curr;
 		priv->nvp_last = curr;
 	}
+
+	priv->nvp_nentries++;
+	nvp_hash_link(nvl, curr);
 }
 
 /*
@@ -399,6 +538,10 @@ nvp_buf_unlink(nvlist_t *nvl, nvpair_t *nvp)
 		priv->nvp_last = curr->nvi_prev;
 	else
 		curr->nvi_next->nvi_prev = curr->nvi_prev;
+
+	priv->nvp_nentries--;
+	if (priv->nvp_hashtable != NULL)
+		nvp_hash_remove(priv, curr);
 }
 
 /*
@@ -594,6 +737,11 @@ nvlist_free(nvlist_t *nvl)
 		nvp_buf_free(nvl, nvp);
 	}
 
+	if (priv->nvp_hashtable != NULL) {
+		nv_mem_free(priv, priv->nvp_hashtable,
+		    priv->nvp_nbuckets * sizeof (i_nvp_t *));
+	}
+
 	if (!(priv->nvp_stat & NV_STAT_EMBEDDED))
 		nv_mem_free(priv, nvl, NV_ALIGN(sizeof (nvlist_t)));
 	else
@@ -661,11 +809,11 @@ nvlist_remove_all(nvlist_t *nvl, const char *name)
 	    (priv = (nvpriv_t *)(uintptr_t)nvl->nvl_priv) == NULL)
 		return (EINVAL);
 
-	curr = priv->nvp_list;
+	curr = nvp_first(priv, name);
 	while (curr != NULL) {
 		nvpair_t *nvp = &curr->nvi_nvp;
 
-		curr = curr->nvi_next;
+		curr = nvp_next(priv, curr);
 		if (strcmp(name, NVP_NAME(nvp)) != 0)
 			continue;
 
@@ -692,7 +840,7 @@ nvlist_remove(nvlist_t *nvl, const char *name, data_type_t type)
 	    (priv = (nvpriv_t *)(uintptr_t)nvl->nvl_priv) == NULL)
 		return (EINVAL);
 
-	curr = priv->nvp_list;
+	curr = nvp_first(priv, name);
 	while (curr != NULL) {
 		nvpair_t *nvp = &curr->nvi_nvp;
 
@@ -703,7 +851,7 @@ nvlist_remove(nvlist_t *nvl, const char *name, data_type_t type)
 
 			return (0);
 		}
-		curr = curr->nvi_next;
+		curr = nvp_next(priv, curr);
 	}
 
 	return (ENOENT);
@@ -1352,7 +1500,8 @@ nvlist_lookup_common(nvlist_t *nvl, const char *name, data_type_t type,
 	if (!(nvl->nvl_nvflag & (NV_UNIQUE_NAME | NV_UNIQUE_NAME_TYPE)))
 		return (ENOTSUP);
 
-	for (curr = priv->nvp_list; curr != NULL; curr = curr->nvi_next) {
+	for (curr = nvp_first(priv, name); curr != NULL;
+	    curr = nvp_next(priv, curr)) {
 		nvp = &curr->nvi_nvp;
 
 		if (strcmp(name, NVP_NAME(nvp)) == 0 && NVP_TYPE(nvp) == type)
@@ -1817,7 +1966,8 @@ nvlist_exists(nvlist_t *nvl, const char *name)
 	    (priv = (nvpriv_t *)(uintptr_t)nvl->nvl_priv) == NULL)
 		return (B_FALSE);
 
-	for (curr = priv->nvp_list; curr != NULL; curr = curr->nvi_next) {
+	for (curr = nvp_first(priv, name); curr != NULL;
+	    curr = nvp_next(priv, curr)) {
 		nvp = &curr->nvi_nvp;
 
 		if (strcmp(name, NVP_NAME(nvp)) == 0)
@@ -2471,17 +2621,31 @@ typedef struct {
 	 * It points to the current data that we are decoding.
 	 * The amount of data left in the buffer is equal to n_end - n_curr.
 	 * n_flag is used to recognize a packed embedded list.
+	 *
+	 * When encoding through nvlist_pack_stream(), n_start points to
+	 * the start of the staging buffer.  Whenever the next write does
+	 * not fit, the staged bytes are passed to n_func and encoding
+	 * continues from n_start.  n_error records why a write failed.
 	 */
 	caddr_t n_base;
 	caddr_t n_end;
 	caddr_t n_curr;
 	uint_t  n_flag;
+	caddr_t n_start;
+	nvlist_stream_f *n_func;
+	void	*n_arg;
+	int	n_error;
 } nvs_native_t;
 
 static int
 nvs_native_create(nvstream_t *nvs, nvs_native_t *native, char *buf,
     size_t buflen)
 {
+	native->n_start = NULL;
+	native->n_func = NULL;
+	native->n_arg = NULL;
+	native->n_error = 0;
+
 	switch (nvs->nvs_op) {
 	case NVS_OP_ENCODE:
 	case NVS_OP_DECODE:
@@ -2507,12 +2671,43 @@ nvs_native_destroy(nvstream_t *nvs)
 {
 }
 
+/*
+ * Make sure the next 'size' bytes of the stream fit in the buffer.  A
+ * streamed encode hands the staged bytes to its callback first.  Writes
+ * are never split, so the fixups applied to an nvpair right after it is
+ * copied always find the whole nvpair in the buffer.
+ */
+static int
+native_reserve(nvs_native_t *native, size_t size)
+{
+	if (native->n_curr + size <= native->n_end)
+		return (0);
+
+	if (native->n_func == NULL)
+		return (EFAULT);
+
+	if (native->n_curr > native->n_start) {
+		native->n_error = native->n_func(native->n_arg,
+		    native->n_start, native->n_curr - native->n_start);
+		if (native->n_error != 0)
+			return (EFAULT);
+		native->n_curr = native->n_start;
+	}
+
+	if (native->n_curr + size > native->n_end) {
+		native->n_error = E2BIG;
+		return (EFAULT);
+	}
+
+	return (0);
+}
+
 static int
 native_cp(nvstream_t *nvs, void *buf, size_t size)
 {
 	nvs_native_t *native = (nvs_native_t *)nvs->nvs_private;
 
-	if (native->n_curr + size > native->n_end)
+	if (native_reserve(native, size) != 0)
 		return (EFAULT);
 
 	/*
@@ -2588,7 +2783,7 @@ nvs_native_nvl_fini(nvstream_t *nvs)
 		 * Add 4 zero bytes at end of nvlist. They are used
 		 * for end detection by the decode routine.
 		 */
-		if (native->n_curr + sizeof (int) > native->n_end)
+		if (native_reserve(native, sizeof (int)) != 0)
 			return (EFAULT);
 
 		bzero(native->n_curr, sizeof (int));
@@ -2835,6 +3030,59 @@ nvs_native(nvstream_t *nvs, nvlist_t *nvl, char *buf, size_t *buflen)
 	return (err);
 }
 
+/*
+ * Pack an nvlist in native encoding without building the whole packed
+ * image in memory.  The encoding is staged in 'buf', and 'func' is called
+ * with each filled part of it in order; together the parts are exactly
+ * what nvlist_pack() would produce.  Returns E2BIG if a single nvpair does
+ * not fit in 'buf', or the first error returned by 'func'.
+ */
+int
+nvlist_pack_stream(nvlist_t *nvl, char *buf, size_t buflen,
+    nvlist_stream_f *func, void *arg)
+{
+	nvstream_t nvs;
+	nvs_native_t native;
+	nvs_header_t *nvh = (void *)buf;
+	int err;
+
+	if (nvl == NULL || buf == NULL || func == NULL ||
+	    buflen < sizeof (nvs_header_t) ||
+	    (nvs.nvs_priv = (nvpriv_t *)(uintptr_t)nvl->nvl_priv) == NULL)
+		return (EINVAL);
+
+	nvs.nvs_op = NVS_OP_ENCODE;
+	nvs.nvs_recursion = 0;
+	nvs.nvs_ops = &nvs_native_ops;
+
+	nvh->nvh_encoding = NV_ENCODE_NATIVE;
+#ifdef	_LITTLE_ENDIAN
+	nvh->nvh_endian = 1;
+#else
+	nvh->nvh_endian = 0;
+#endif	/* _LITTLE_ENDIAN */
+	nvh->nvh_reserved1 = 0;
+	nvh->nvh_reserved2 = 0;
+
+	if ((err = nvs_native_create(&nvs, &native,
+	    buf + sizeof (nvs_header_t), buflen - sizeof (nvs_header_t))) != 0)
+		return (err);
+
+	native.n_start = buf;
+	native.n_func = func;
+	native.n_arg = arg;
+
+	err = nvs_operation(&nvs, nvl, &buflen);
+	if (err == 0 && native.n_curr > native.n_start) {
+		native.n_error = func(arg, native.n_start,
+		    native.n_curr - native.n_start);
+	}
+
+	nvs_native_destroy(&nvs);
+
+	return (native.n_error != 0 ? native.n_error : err);
+}
+
 /*
  * XDR encoding functions
  *
@@ -3362,6 +3610,7 @@ EXPORT_SYMBOL(nvlist_merge);
 
 EXPORT_SYMBOL(nvlist_xalloc);
 EXPORT_SYMBOL(nvlist_xpack);
+EXPORT_SYMBOL(nvlist_pack_stream);
 EXPORT_SYMBOL(nvlist_xunpack);
 EXPORT_SYMBOL(nvlist_xdup);
 EXPORT_SYMBOL(nvlist_lookup_nv_alloc);
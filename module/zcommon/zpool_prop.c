@@ -82,6 +82,10 @@ zpool_prop_init(void)
 	    ZFS_TYPE_POOL, "<size>", "FREE");
 	zprop_register_number(ZPOOL_PROP_FREEING, "freeing", 0, PROP_READONLY,
 	    ZFS_TYPE_POOL, "<size>", "FREEING");
+	zprop_register_number(ZPOOL_PROP_FREEINGRATE, "freeingrate", 0,
+	    PROP_READONLY, ZFS_TYPE_POOL, "<blocks per second>", "FRATE");
+	zprop_register_number(ZPOOL_PROP_FREEINGTIME, "freeingtime", 0,
+	    PROP_READONLY, ZFS_TYPE_POOL, "<seconds>", "FTIME");
 	zprop_register_number(ZPOOL_PROP_CHECKPOINT, "checkpoint", 0,
 	    PROP_READONLY, ZFS_TYPE_POOL, "<size>", "CKPOINT");
 	zprop_register_number(ZPOOL_PROP_LEAKED, "leaked", 0, PROP_READONLY,
@@ -111,6 +115,8 @@ zpool_prop_init(void)
 	    PROP_DEFAULT, ZFS_TYPE_POOL, "<version>", "VERSION");
 	zprop_register_number(ZPOOL_PROP_ASHIFT, "ashift", 0, PROP_DEFAULT,
 	    ZFS_TYPE_POOL, "<ashift, 9-16, or 0=default>", "ASHIFT");
+	zprop_register_number(ZPOOL_PROP_SCANLATENCY, "scanlatency", 0,
+	    PROP_DEFAULT, ZFS_TYPE_POOL, "<milliseconds, or 0=off>", "SCANLAT");
 
 	/* default index (boolean) properties */
 	zprop_register_index(ZPOOL_PROP_DELEGATION, "delegation", 1,
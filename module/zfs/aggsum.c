@@ -28,66 +28,73 @@
  * (get value).
  *
  * Aggregate sum counters are comprised of two basic parts, the core and the
- * buckets. The core counter contains a lock for the entire counter, as well
- * as the current upper and lower bounds on the value of the counter. The
- * aggsum_bucket structure contains a per-bucket lock to protect the contents of
- * the bucket, the current amount that this bucket has changed from the global
- * counter (called the delta), and the amount of increment and decrement we have
- * "borrowed" from the core counter.
+ * buckets. The core counter holds the current upper and lower bounds on the
+ * value of the counter. The aggsum_bucket structure contains a per-bucket lock
+ * to protect the contents of the bucket, the current amount that this bucket
+ * has changed from the global counter (called the delta), and the amount of
+ * increment and decrement we have "borrowed" from the core counter.
  *
  * The basic operation of an aggsum is simple. Threads that wish to modify the
  * counter will modify one bucket's counter (determined by their current CPU, to
  * help minimize lock and cache contention). If the bucket already has
  * sufficient capacity borrowed from the core structure to handle their request,
- * they simply modify the delta and return.  If the bucket does not, we clear
- * the bucket's current state (to prevent the borrowed amounts from getting too
- * large), and borrow more from the core counter. Borrowing is done by adding to
- * the upper bound (or subtracting from the lower bound) of the core counter,
- * and setting the borrow value for the bucket to the amount added (or
- * subtracted).  Clearing the bucket is the opposite; we add the current delta
- * to both the lower and upper bounds of the core counter, subtract the borrowed
- * incremental from the upper bound, and add the borrowed decrement from the
- * lower bound.  Note that only borrowing and clearing require access to the
- * core counter; since all other operations access CPU-local resources,
- * performance can be much higher than a traditional counter.
+ * they simply modify the delta and return.  If the bucket does not, we fold
+ * the bucket's delta into the core counter and borrow again. Borrowing is done
+ * by adding to the upper bound and subtracting from the lower bound of the core
+ * counter, and setting the borrow value for the bucket to the amount added.
+ * Folding is the opposite; we add the current delta to both bounds, subtract
+ * the borrowed amount from the upper bound, and add it to the lower bound.
+ *
+ * The bounds are only ever changed with atomic adds while holding the lock of
+ * the bucket being borrowed for, and each of those adds leaves a valid bound
+ * behind.  So there is no lock for the core counter, and buckets never wait
+ * for each other.
  *
  * Threads that wish to read from the counter have a slightly more challenging
- * task. It is fast to determine the upper and lower bounds of the aggum; this
- * does not require grabbing any locks. This suffices for cases where an
- * approximation of the aggsum's value is acceptable. However, if one needs to
- * know whether some specific value is above or below the current value in the
- * aggsum, they invoke aggsum_compare(). This function operates by repeatedly
- * comparing the target value to the upper and lower bounds of the aggsum, and
- * then clearing a bucket. This proceeds until the target is outside of the
- * upper and lower bounds and we return a response, or the last bucket has been
- * cleared and we know that the target is equal to the aggsum's value. Finally,
- * the most expensive operation is determining the precise value of the aggsum.
- * To do this, we clear every bucket and then return the upper bound (which must
- * be equal to the lower bound). What makes aggsum_compare() and aggsum_value()
- * expensive is clearing buckets. This involves grabbing the global lock
- * (serializing against themselves and borrow operations), grabbing a bucket's
- * lock (preventing threads on those CPUs from modifying their delta), and
- * zeroing out the borrowed value (forcing that thread to borrow on its next
- * request, which will also be expensive).  This is what makes aggsums well
- * suited for write-many read-rarely operations.
+ * task. The bounds can be read without any locks, and they never stray further
+ * from the value than the sum of what the buckets have borrowed; this
+ * suffices for threshold checks that can tolerate that error. If one needs to
+ * know exactly whether some specific value is above or below the current value
+ * in the aggsum, they invoke aggsum_compare(). This function locks the buckets
+ * one at a time, replacing each bucket's borrowed range in the bounds with its
+ * actual delta, until the target is outside of the tightened bounds, or every
+ * bucket is locked and the bounds meet at the aggsum's value. It does not
+ * flush any bucket, so frequent compares do not force the writers back onto
+ * the borrow path, but they do briefly stop the writers of every bucket they
+ * have locked.  That is what makes aggsums well suited for write-many
+ * read-rarely operations.
+ *
+ * A bucket only borrows when a request does not fit in what it already has,
+ * so a borrow sized for one large request would otherwise stay in place, and
+ * keep the bounds wide, for as long as the bucket's later requests fit in it.
+ * aggsum_value(), which has to lock every bucket anyway and is meant for
+ * infrequent callers such as kstat updates and the ARC reclaim thread,
+ * therefore also folds every bucket into the core counter and returns what
+ * it borrowed.
+ *
+ * On large machines, a bucket per CPU makes readers walk a lot of buckets
+ * while buying little for the writers, so neighbouring CPUs, which are
+ * usually hardware threads of one core or cores sharing a cache, share a
+ * bucket: from 12 CPUs there is a bucket per 2 CPUs, from 48 per 4, and so on.
  */
 
 /*
- * We will borrow aggsum_borrow_multiplier times the current request, so we will
- * have to get the as_lock approximately every aggsum_borrow_multiplier calls to
- * aggsum_delta().
+ * We will borrow 2^aggsum_borrow_shift times the current request, times the
+ * number of CPUs sharing the bucket, so we will have to fold the bucket into
+ * the core counter approximately every 2^aggsum_borrow_shift calls to
+ * aggsum_add() from each CPU.
  */
-static uint_t aggsum_borrow_multiplier = 10;
+static uint_t aggsum_borrow_shift = 4;
 
 void
 aggsum_init(aggsum_t *as, uint64_t value)
 {
 	bzero(as, sizeof (*as));
 	as->as_lower_bound = as->as_upper_bound = value;
-	mutex_init(&as->as_lock, NULL, MUTEX_DEFAULT, NULL);
-	as->as_numbuckets = max_ncpus;
-	as->as_buckets = kmem_zalloc(max_ncpus * sizeof (aggsum_bucket_t),
-	    KM_SLEEP);
+	as->as_bucketshift = highbit64(max_ncpus / 6) / 2;
+	as->as_numbuckets = ((max_ncpus - 1) >> as->as_bucketshift) + 1;
+	as->as_buckets = kmem_zalloc(as->as_numbuckets *
+	    sizeof (aggsum_bucket_t), KM_SLEEP);
 	for (int i = 0; i < as->as_numbuckets; i++) {
 		mutex_init(&as->as_buckets[i].asc_lock,
 		    NULL, MUTEX_DEFAULT, NULL);
@@ -100,39 +107,42 @@ aggsum_fini(aggsum_t *as)
 	for (int i = 0; i < as->as_numbuckets; i++)
 		mutex_destroy(&as->as_buckets[i].asc_lock);
 	kmem_free(as->as_buckets, as->as_numbuckets * sizeof (aggsum_bucket_t));
-	mutex_destroy(&as->as_lock);
 }
 
 int64_t
 aggsum_lower_bound(aggsum_t *as)
 {
-	return (as->as_lower_bound);
+	return (*(volatile int64_t *)&as->as_lower_bound);
 }
 
 int64_t
 aggsum_upper_bound(aggsum_t *as)
 {
-	return (as->as_upper_bound);
+	return (*(volatile int64_t *)&as->as_upper_bound);
 }
 
-static void
-aggsum_flush_bucket(aggsum_t *as, struct aggsum_bucket *asb)
+/*
+ * Lock every bucket, in order, and return the exact value of the aggsum.
+ * Nothing can change the bounds until aggsum_unlock_all() is called.
+ */
+static int64_t
+aggsum_lock_all(aggsum_t *as)
 {
-	ASSERT(MUTEX_HELD(&as->as_lock));
-	ASSERT(MUTEX_HELD(&asb->asc_lock));
+	int64_t lb = 0;
 
-	/*
-	 * We use atomic instructions for this because we read the upper and
-	 * lower bounds without the lock, so we need stores to be atomic.
-	 */
-	atomic_add_64((volatile uint64_t *)&as->as_lower_bound, asb->asc_delta);
-	atomic_add_64((volatile uint64_t *)&as->as_upper_bound, asb->asc_delta);
-	asb->asc_delta = 0;
-	atomic_add_64((volatile uint64_t *)&as->as_upper_bound,
-	    -asb->asc_borrowed);
-	atomic_add_64((volatile uint64_t *)&as->as_lower_bound,
-	    asb->asc_borrowed);
-	asb->asc_borrowed = 0;
+	for (int i = 0; i < as->as_numbuckets; i++) {
+		struct aggsum_bucket *asb = &as->as_buckets[i];
+		mutex_enter(&asb->asc_lock);
+		lb += asb->asc_delta + (int64_t)asb->asc_borrowed;
+	}
+	return (lb + as->as_lower_bound);
+}
+
+static void
+aggsum_unlock_all(aggsum_t *as, int nlocked)
+{
+	for (int i = nlocked - 1; i >= 0; i--)
+		mutex_exit(&as->as_buckets[i].asc_lock);
 }
 
 uint64_t
@@ -140,63 +150,75 @@ aggsum_value(aggsum_t *as)
 {
 	int64_t rv;
 
-	mutex_enter(&as->as_lock);
-	if (as->as_lower_bound == as->as_upper_bound) {
-		rv = as->as_lower_bound;
-		for (int i = 0; i < as->as_numbuckets; i++) {
-			ASSERT0(as->as_buckets[i].asc_delta);
-			ASSERT0(as->as_buckets[i].asc_borrowed);
-		}
-		mutex_exit(&as->as_lock);
-		return (rv);
-	}
+	rv = aggsum_lock_all(as);
+
+	/*
+	 * Fold each bucket into the core counter and return its borrow.  As
+	 * in aggsum_add(), each atomic add leaves valid bounds behind for the
+	 * lockless readers, and with every bucket locked they end up equal.
+	 */
 	for (int i = 0; i < as->as_numbuckets; i++) {
 		struct aggsum_bucket *asb = &as->as_buckets[i];
-		mutex_enter(&asb->asc_lock);
-		aggsum_flush_bucket(as, asb);
-		mutex_exit(&asb->asc_lock);
+
+		if (asb->asc_borrowed == 0)
+			continue;
+		atomic_add_64((volatile uint64_t *)&as->as_upper_bound,
+		    asb->asc_delta - (int64_t)asb->asc_borrowed);
+		atomic_add_64((volatile uint64_t *)&as->as_lower_bound,
+		    asb->asc_delta + (int64_t)asb->asc_borrowed);
+		asb->asc_delta = 0;
+		asb->asc_borrowed = 0;
 	}
-	VERIFY3U(as->as_lower_bound, ==, as->as_upper_bound);
-	rv = as->as_lower_bound;
-	mutex_exit(&as->as_lock);
+	ASSERT3S(as->as_lower_bound, ==, rv);
+	ASSERT3S(as->as_upper_bound, ==, rv);
+	aggsum_unlock_all(as, as->as_numbuckets);
 
 	return (rv);
 }
 
-static void
-aggsum_borrow(aggsum_t *as, int64_t delta, struct aggsum_bucket *asb)
-{
-	int64_t abs_delta = (delta < 0 ? -delta : delta);
-	mutex_enter(&as->as_lock);
-	mutex_enter(&asb->asc_lock);
-
-	aggsum_flush_bucket(as, asb);
-
-	atomic_add_64((volatile uint64_t *)&as->as_upper_bound, abs_delta);
-	atomic_add_64((volatile uint64_t *)&as->as_lower_bound, -abs_delta);
-	asb->asc_borrowed = abs_delta;
-
-	mutex_exit(&asb->asc_lock);
-	mutex_exit(&as->as_lock);
-}
-
 void
 aggsum_add(aggsum_t *as, int64_t delta)
 {
-	struct aggsum_bucket *asb =
-	    &as->as_buckets[CPU_SEQID % as->as_numbuckets];
+	struct aggsum_bucket *asb = &as->as_buckets[
+	    (CPU_SEQID >> as->as_bucketshift) % as->as_numbuckets];
+	uint64_t borrow;
+	int64_t fold;
 
-	for (;;) {
-		mutex_enter(&asb->asc_lock);
-		if (asb->asc_delta + delta <= (int64_t)asb->asc_borrowed &&
-		    asb->asc_delta + delta >= -(int64_t)asb->asc_borrowed) {
-			asb->asc_delta += delta;
-			mutex_exit(&asb->asc_lock);
-			return;
-		}
+	mutex_enter(&asb->asc_lock);
+	if (asb->asc_delta + delta <= (int64_t)asb->asc_borrowed &&
+	    asb->asc_delta + delta >= -(int64_t)asb->asc_borrowed) {
+		asb->asc_delta += delta;
 		mutex_exit(&asb->asc_lock);
-		aggsum_borrow(as, delta * aggsum_borrow_multiplier, asb);
+		return;
 	}
+
+	/*
+	 * We haven't borrowed enough.  Borrow in proportion to this request,
+	 * but let a borrow that a past large request left behind shrink
+	 * gradually rather than all at once, so a bucket that keeps seeing a
+	 * mix of sizes does not fall back here on every other call.
+	 */
+	borrow = (uint64_t)(delta < 0 ? -delta : delta) <<
+	    (aggsum_borrow_shift + as->as_bucketshift);
+	if (borrow < asb->asc_borrowed)
+		borrow = asb->asc_borrowed - (asb->asc_borrowed - borrow) / 4;
+
+	/*
+	 * Widen the bounds by the new borrow first, so that they hold the
+	 * value both before and after this request, and only then fold our
+	 * old delta and borrow back in; each step leaves valid bounds for
+	 * the lockless readers.
+	 */
+	atomic_add_64((volatile uint64_t *)&as->as_upper_bound, borrow);
+	atomic_add_64((volatile uint64_t *)&as->as_lower_bound, -borrow);
+	fold = asb->asc_delta;
+	atomic_add_64((volatile uint64_t *)&as->as_upper_bound,
+	    fold - (int64_t)asb->asc_borrowed);
+	atomic_add_64((volatile uint64_t *)&as->as_lower_bound,
+	    fold + (int64_t)asb->asc_borrowed);
+	asb->asc_delta = delta;
+	asb->asc_borrowed = borrow;
+	mutex_exit(&asb->asc_lock);
 }
 
 /*
@@ -207,27 +229,43 @@ aggsum_add(aggsum_t *as, int64_t delta)
 int
 aggsum_compare(aggsum_t *as, uint64_t target)
 {
-	if (as->as_upper_bound < target)
+	int64_t lb, ub, lbdelta = 0, ubdelta = 0;
+	int i, rv = 0;
+
+	ub = aggsum_upper_bound(as);
+	if (ub < 0 || (uint64_t)ub < target)
 		return (-1);
-	if (as->as_lower_bound > target)
+	lb = aggsum_lower_bound(as);
+	if (lb > 0 && (uint64_t)lb > target)
 		return (1);
-	mutex_enter(&as->as_lock);
-	for (int i = 0; i < as->as_numbuckets; i++) {
+
+	/*
+	 * The bounds of the buckets we hold locked cannot move, so their
+	 * borrowed ranges can be swapped for their deltas.  The others may
+	 * borrow and fold as we go, which is why the bounds are read again
+	 * after every bucket.
+	 */
+	for (i = 0; i < as->as_numbuckets; i++) {
 		struct aggsum_bucket *asb = &as->as_buckets[i];
 		mutex_enter(&asb->asc_lock);
-		aggsum_flush_bucket(as, asb);
-		mutex_exit(&asb->asc_lock);
-		if (as->as_upper_bound < target) {
-			mutex_exit(&as->as_lock);
-			return (-1);
+		lbdelta += asb->asc_delta + (int64_t)asb->asc_borrowed;
+		ubdelta += asb->asc_delta - (int64_t)asb->asc_borrowed;
+		ub = aggsum_upper_bound(as) + ubdelta;
+		lb = aggsum_lower_bound(as) + lbdelta;
+		if (ub < 0 || (uint64_t)ub < target) {
+			rv = -1;
+			break;
 		}
-		if (as->as_lower_bound > target) {
-			mutex_exit(&as->as_lock);
-			return (1);
+		if (lb > 0 && (uint64_t)lb > target) {
+			rv = 1;
+			break;
 		}
 	}
-	VERIFY3U(as->as_lower_bound, ==, as->as_upper_bound);
-	ASSERT3U(as->as_lower_bound, ==, target);
-	mutex_exit(&as->as_lock);
-	return (0);
+	if (i == as->as_numbuckets) {
+		VERIFY3S(lb, ==, ub);
+		ASSERT3U(lb, ==, target);
+		i--;
+	}
+	aggsum_unlock_all(as, i + 1);
+	return (rv);
 }
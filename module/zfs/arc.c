@@ -312,6 +312,7 @@ void IOSleep(unsigned milliseconds);
 static boolean_t arc_abd_try_move(arc_buf_hdr_t *);
 #endif
 #include <sys/aggsum.h>
+#include <sys/wmsum.h>
 #include <sys/cityhash.h>
 
 #ifndef _KERNEL
@@ -867,15 +868,15 @@ static arc_stats_t arc_stats = {
 #define	ARCSTAT_CONDSTAT(cond1, stat1, notstat1, cond2, stat2, notstat2, stat) \
 	if (cond1) {							\
 		if (cond2) {						\
-			ARCSTAT_BUMP(arcstat_##stat1##_##stat2##_##stat); \
+			ARCSUM_BUMP(arcstat_##stat1##_##stat2##_##stat); \
 		} else {						\
-			ARCSTAT_BUMP(arcstat_##stat1##_##notstat2##_##stat); \
+			ARCSUM_BUMP(arcstat_##stat1##_##notstat2##_##stat); \
 		}							\
 	} else {							\
 		if (cond2) {						\
-			ARCSTAT_BUMP(arcstat_##notstat1##_##stat2##_##stat); \
+			ARCSUM_BUMP(arcstat_##notstat1##_##stat2##_##stat); \
 		} else {						\
-			ARCSTAT_BUMP(arcstat_##notstat1##_##notstat2##_##stat);\
+			ARCSUM_BUMP(arcstat_##notstat1##_##notstat2##_##stat);\
 		}							\
 	}
 
@@ -936,6 +937,53 @@ aggsum_t astat_hdr_size;
 aggsum_t astat_other_size;
 aggsum_t astat_l2_hdr_size;
 
+/*
+ * Likewise, the hit, miss and eviction counters are bumped by every
+ * arc_read() and arc_access() on every CPU, but nothing in the ARC looks at
+ * their values.  Keep them in write-mostly sums, which are only folded into
+ * arc_stats when the kstat is read.  Only bump these with ARCSUM_BUMP and
+ * ARCSUM_INCR; the arc_stats copies are overwritten by arc_kstat_update().
+ */
+typedef struct arc_sums {
+	wmsum_t arcstat_hits;
+	wmsum_t arcstat_misses;
+	wmsum_t arcstat_demand_data_hits;
+	wmsum_t arcstat_demand_data_misses;
+	wmsum_t arcstat_demand_metadata_hits;
+	wmsum_t arcstat_demand_metadata_misses;
+	wmsum_t arcstat_prefetch_data_hits;
+	wmsum_t arcstat_prefetch_data_misses;
+	wmsum_t arcstat_prefetch_metadata_hits;
+	wmsum_t arcstat_prefetch_metadata_misses;
+	wmsum_t arcstat_mru_hits;
+	wmsum_t arcstat_mru_ghost_hits;
+	wmsum_t arcstat_mfu_hits;
+	wmsum_t arcstat_mfu_ghost_hits;
+	wmsum_t arcstat_deleted;
+	wmsum_t arcstat_mutex_miss;
+	wmsum_t arcstat_evict_skip;
+	wmsum_t arcstat_evict_l2_cached;
+	wmsum_t arcstat_evict_l2_eligible;
+	wmsum_t arcstat_evict_l2_ineligible;
+	wmsum_t arcstat_evict_l2_skip;
+	wmsum_t arcstat_hash_collisions;
+	wmsum_t arcstat_l2_hits;
+	wmsum_t arcstat_l2_misses;
+	wmsum_t arcstat_l2_rw_clash;
+	wmsum_t arcstat_l2_read_bytes;
+	wmsum_t arcstat_async_upgrade_sync;
+	wmsum_t arcstat_demand_hit_predictive_prefetch;
+	wmsum_t arcstat_demand_hit_prescient_prefetch;
+} arc_sums_t;
+
+static arc_sums_t arc_sums;
+
+#define	ARCSUM_INCR(stat, val)	wmsum_add(&arc_sums.stat, (val))
+#define	ARCSUM_BUMP(stat)	ARCSUM_INCR(stat, 1)
+
+#define	ARCSUM_SYNC(stat) \
+	(ARCSTAT(stat) = wmsum_value(&arc_sums.stat))
+
 typedef struct arc_write_callback arc_write_callback_t;
 
 #define zfs_dbuf_redirtied ARCSTAT(arcstat_dbuf_redirtied) /* number of invocations of dbuf.c:dbuf_redirty() */
@@ -1255,7 +1303,7 @@ buf_hash_insert(arc_buf_hdr_t *hdr, kmutex_t **lockp)
 
 	/* collect some hash table performance data */
 	if (i > 0) {
-		ARCSTAT_BUMP(arcstat_hash_collisions);
+		ARCSUM_BUMP(arcstat_hash_collisions);
 		if (i == 1)
 			ARCSTAT_BUMP(arcstat_hash_chains);
 
@@ -3988,11 +4036,11 @@ arc_evict_hdr(arc_buf_hdr_t *hdr, kmutex_t *hash_lock)
 		 * done being written to the l2arc.
 		 */
 		if (HDR_HAS_L2HDR(hdr) && HDR_L2_WRITING(hdr)) {
-			ARCSTAT_BUMP(arcstat_evict_l2_skip);
+			ARCSUM_BUMP(arcstat_evict_l2_skip);
 			return (bytes_evicted);
 		}
 
-		ARCSTAT_BUMP(arcstat_deleted);
+		ARCSUM_BUMP(arcstat_deleted);
 		bytes_evicted += HDR_GET_LSIZE(hdr);
 
 		DTRACE_PROBE1(arc__delete, arc_buf_hdr_t *, hdr);
@@ -4025,7 +4073,7 @@ arc_evict_hdr(arc_buf_hdr_t *hdr, kmutex_t *hash_lock)
 	if (HDR_IO_IN_PROGRESS(hdr) ||
 	    ((hdr->b_flags & (ARC_FLAG_PREFETCH | ARC_FLAG_INDIRECT)) &&
 	    ddi_get_lbolt() - hdr->b_l1hdr.b_arc_access < min_lifetime * hz)) {
-		ARCSTAT_BUMP(arcstat_evict_skip);
+		ARCSUM_BUMP(arcstat_evict_skip);
 		return (bytes_evicted);
 	}
 
@@ -4033,7 +4081,7 @@ arc_evict_hdr(arc_buf_hdr_t *hdr, kmutex_t *hash_lock)
 	while (hdr->b_l1hdr.b_buf) {
 		arc_buf_t *buf = hdr->b_l1hdr.b_buf;
 		if (!mutex_tryenter(&buf->b_evict_lock)) {
-			ARCSTAT_BUMP(arcstat_mutex_miss);
+			ARCSUM_BUMP(arcstat_mutex_miss);
 			break;
 		}
 		if (buf->b_data != NULL)
@@ -4043,13 +4091,13 @@ arc_evict_hdr(arc_buf_hdr_t *hdr, kmutex_t *hash_lock)
 	}
 
 	if (HDR_HAS_L2HDR(hdr)) {
-		ARCSTAT_INCR(arcstat_evict_l2_cached, HDR_GET_LSIZE(hdr));
+		ARCSUM_INCR(arcstat_evict_l2_cached, HDR_GET_LSIZE(hdr));
 	} else {
 		if (l2arc_write_eligible(hdr->b_spa, hdr)) {
-			ARCSTAT_INCR(arcstat_evict_l2_eligible,
+			ARCSUM_INCR(arcstat_evict_l2_eligible,
 			    HDR_GET_LSIZE(hdr));
 		} else {
-			ARCSTAT_INCR(arcstat_evict_l2_ineligible,
+			ARCSUM_INCR(arcstat_evict_l2_ineligible,
 			    HDR_GET_LSIZE(hdr));
 		}
 	}
@@ -4128,7 +4176,7 @@ arc_evict_state_impl(multilist_t *ml, int idx, arc_buf_hdr_t *marker,
 
 		/* we're only interested in evicting buffers of a certain spa */
 		if (spa != 0 && hdr->b_spa != spa) {
-			ARCSTAT_BUMP(arcstat_evict_skip);
+			ARCSUM_BUMP(arcstat_evict_skip);
 			continue;
 		}
 
@@ -4182,7 +4230,7 @@ arc_evict_state_impl(multilist_t *ml, int idx, arc_buf_hdr_t *marker,
 				cv_signal(&arc_reclaim_waiters_cv);
 			mutex_exit(&arc_reclaim_lock);
 		} else {
-			ARCSTAT_BUMP(arcstat_mutex_miss);
+			ARCSUM_BUMP(arcstat_mutex_miss);
 		}
 	}
 
@@ -5263,6 +5311,16 @@ arc_reclaim_thread(void *unused)
 	thread_exit();
 }
 
+/*
+ * Exactly whether the aggsum plus bytes reaches limit.  aggsum_compare()
+ * only has to look at the buckets when the limit falls within the aggsum's
+ * bounds, so this is cheap enough to do for every allocation.
+ */
+static boolean_t
+arc_aggsum_reaches(aggsum_t *as, uint64_t bytes, uint64_t limit)
+{
+	return (bytes >= limit || aggsum_compare(as, limit - bytes) >= 0);
+}
 
 /*
  * Adapt arc info given the number of bytes we are trying to add and
@@ -5340,15 +5398,18 @@ arc_adapt(int bytes, arc_state_t *state)
 	 * otherwise, if we are about to exceed our overall ARC target size
 	 * or we are metadata and are about to exceed the max metadata size,
 	 * then arc_no_grow means we should just return now.
+	 *
+	 * This runs for every buffer we allocate, so it compares rather than
+	 * reads the aggsums; see arc_aggsum_reaches().
 	 */
-	if (arc_no_grow && aggsum_value(&arc_size) >= arc_c_min) {
+	if (arc_no_grow && aggsum_compare(&arc_size, arc_c_min) >= 0) {
 		if (buf_is_metadata) {
-			if (aggsum_value(&arc_meta_used) + bytes >= arc_meta_limit) {
+			if (arc_aggsum_reaches(&arc_meta_used, bytes, arc_meta_limit)) {
 				return;
-			} else if (aggsum_value(&arc_size) + bytes >= arc_c) {
+			} else if (arc_aggsum_reaches(&arc_size, bytes, arc_c)) {
 				return;
 			}
-		} else if (!buf_is_metadata && aggsum_value(&arc_size) + bytes >= arc_c) {
+		} else if (!buf_is_metadata && arc_aggsum_reaches(&arc_size, bytes, arc_c)) {
 			return;
 		}
 	}
@@ -5388,7 +5449,7 @@ arc_adapt(int bytes, arc_state_t *state)
 			// early to it
 			uint64_t overflow = MAX(SPA_MAXBLOCKSIZE,
 			    arc_c >> zfs_arc_overflow_shift);
-			boolean_t overflowing = (aggsum_value(&arc_size) + (bytes * 2) >= arc_c + overflow);
+			boolean_t overflowing = arc_aggsum_reaches(&arc_size, bytes * 2, arc_c + overflow);
 			if (!overflowing) {
 				return;
 			} else {
@@ -5454,9 +5515,10 @@ arc_is_overflowing(void)
 	 * primary goals are to make sure that the arc never grows without
 	 * bound, and that it can reach its maximum size. This check
 	 * accomplishes both goals. The maximum amount we could run over by is
-	 * 2 * aggsum_borrow_multiplier * NUM_CPUS * the average size of a block
-	 * in the ARC. In practice, that's in the tens of MB, which is low
-	 * enough to be safe.
+	 * 2^aggsum_borrow_shift * NUM_CPUS * the average size of a block
+	 * in the ARC, and borrows left behind by larger blocks are returned
+	 * whenever the reclaim thread reads arc_size exactly. In practice,
+	 * that's in the tens of MB, which is low enough to be safe.
 	 */
 	return (aggsum_lower_bound(&arc_size) >= (int64_t)arc_c + overflow);
 }
@@ -5707,7 +5769,7 @@ arc_access(arc_buf_hdr_t *hdr, kmutex_t *hash_lock)
 				    ARC_FLAG_PREFETCH |
 				    ARC_FLAG_PRESCIENT_PREFETCH);
 				atomic_inc_32(&hdr->b_l1hdr.b_mru_hits);
-				ARCSTAT_BUMP(arcstat_mru_hits);
+				ARCSUM_BUMP(arcstat_mru_hits);
 			}
 			hdr->b_l1hdr.b_arc_access = now;
 			return;
@@ -5728,7 +5790,7 @@ arc_access(arc_buf_hdr_t *hdr, kmutex_t *hash_lock)
 			DTRACE_PROBE1(new_state__mfu, arc_buf_hdr_t *, hdr);
 			arc_change_state(arc_mfu, hdr, hash_lock);
 		}
-		ARCSTAT_BUMP(arcstat_mru_hits);
+		ARCSUM_BUMP(arcstat_mru_hits);
 	} else if (hdr->b_l1hdr.b_state == arc_mru_ghost) {
 		arc_state_t	*new_state;
 		/*
@@ -5753,7 +5815,7 @@ arc_access(arc_buf_hdr_t *hdr, kmutex_t *hash_lock)
 		hdr->b_l1hdr.b_arc_access = ddi_get_lbolt();
 		arc_change_state(new_state, hdr, hash_lock);
 
-		ARCSTAT_BUMP(arcstat_mru_ghost_hits);
+		ARCSUM_BUMP(arcstat_mru_ghost_hits);
 	} else if (hdr->b_l1hdr.b_state == arc_mfu) {
 		/*
 		 * This buffer has been accessed more than once and is
@@ -5766,7 +5828,7 @@ arc_access(arc_buf_hdr_t *hdr, kmutex_t *hash_lock)
 		 */
 
 		atomic_inc_32(&hdr->b_l1hdr.b_mfu_hits);
-		ARCSTAT_BUMP(arcstat_mfu_hits);
+		ARCSUM_BUMP(arcstat_mfu_hits);
 		hdr->b_l1hdr.b_arc_access = ddi_get_lbolt();
 	} else if (hdr->b_l1hdr.b_state == arc_mfu_ghost) {
 		arc_state_t	*new_state = arc_mfu;
@@ -5788,7 +5850,7 @@ arc_access(arc_buf_hdr_t *hdr, kmutex_t *hash_lock)
 		DTRACE_PROBE1(new_state__mfu, arc_buf_hdr_t *, hdr);
 		arc_change_state(new_state, hdr, hash_lock);
 
-		ARCSTAT_BUMP(arcstat_mfu_ghost_hits);
+		ARCSUM_BUMP(arcstat_mfu_ghost_hits);
 	} else if (hdr->b_l1hdr.b_state == arc_l2c_only) {
 		/*
 		 * This buffer is on the 2nd Level ARC.
@@ -6140,7 +6202,7 @@ top:
 				zio_change_priority(head_zio, priority);
 				DTRACE_PROBE1(arc__async__upgrade__sync,
 				    arc_buf_hdr_t *, hdr);
-				ARCSTAT_BUMP(arcstat_async_upgrade_sync);
+				ARCSUM_BUMP(arcstat_async_upgrade_sync);
 			}
 			if (hdr->b_flags & ARC_FLAG_PREDICTIVE_PREFETCH) {
 				arc_hdr_clear_flags(hdr,
@@ -6193,14 +6255,14 @@ top:
 				DTRACE_PROBE1(
 				    arc__demand__hit__predictive__prefetch,
 				    arc_buf_hdr_t *, hdr);
-				ARCSTAT_BUMP(
+				ARCSUM_BUMP(
 				    arcstat_demand_hit_predictive_prefetch);
 				arc_hdr_clear_flags(hdr,
 				    ARC_FLAG_PREDICTIVE_PREFETCH);
 			}
 
 			if (hdr->b_flags & ARC_FLAG_PRESCIENT_PREFETCH) {
-				ARCSTAT_BUMP(
+				ARCSUM_BUMP(
 				    arcstat_demand_hit_prescient_prefetch);
 				arc_hdr_clear_flags(hdr,
 				    ARC_FLAG_PRESCIENT_PREFETCH);
@@ -6247,7 +6309,7 @@ top:
 		if (*arc_flags & ARC_FLAG_L2CACHE)
 			arc_hdr_set_flags(hdr, ARC_FLAG_L2CACHE);
 		mutex_exit(hash_lock);
-		ARCSTAT_BUMP(arcstat_hits);
+		ARCSUM_BUMP(arcstat_hits);
 		ARCSTAT_CONDSTAT(!HDR_PREFETCH(hdr),
 		    demand, prefetch, !HDR_ISTYPE_METADATA(hdr),
 		    data, metadata, hits);
@@ -6414,7 +6476,7 @@ top:
 
 		DTRACE_PROBE4(arc__miss, arc_buf_hdr_t *, hdr, blkptr_t *, bp,
 		    uint64_t, lsize, zbookmark_phys_t *, zb);
-		ARCSTAT_BUMP(arcstat_misses);
+		ARCSUM_BUMP(arcstat_misses);
 		ARCSTAT_CONDSTAT(!HDR_PREFETCH(hdr),
 		    demand, prefetch, !HDR_ISTYPE_METADATA(hdr),
 		    data, metadata, misses);
@@ -6437,7 +6499,7 @@ top:
 				uint64_t asize;
 
 				DTRACE_PROBE1(l2arc__hit, arc_buf_hdr_t *, hdr);
-				ARCSTAT_BUMP(arcstat_l2_hits);
+				ARCSUM_BUMP(arcstat_l2_hits);
 
 				cb = kmem_zalloc(sizeof (l2arc_read_callback_t),
 				    KM_SLEEP);
@@ -6482,7 +6544,7 @@ top:
 
 				DTRACE_PROBE2(l2arc__read, vdev_t *, vd,
 				    zio_t *, rzio);
-				ARCSTAT_INCR(arcstat_l2_read_bytes, HDR_GET_PSIZE(hdr));
+				ARCSUM_INCR(arcstat_l2_read_bytes, HDR_GET_PSIZE(hdr));
 
 				if (*arc_flags & ARC_FLAG_NOWAIT) {
 					zio_nowait(rzio);
@@ -6499,9 +6561,9 @@ top:
 			} else {
 				DTRACE_PROBE1(l2arc__miss,
 				    arc_buf_hdr_t *, hdr);
-				ARCSTAT_BUMP(arcstat_l2_misses);
+				ARCSUM_BUMP(arcstat_l2_misses);
 				if (HDR_L2_WRITING(hdr))
-					ARCSTAT_BUMP(arcstat_l2_rw_clash);
+					ARCSUM_BUMP(arcstat_l2_rw_clash);
 				spa_config_exit(spa, SCL_L2ARC, vd);
 			}
 		} else {
@@ -6510,7 +6572,7 @@ top:
 			if (l2arc_ndev != 0) {
 				DTRACE_PROBE1(l2arc__miss,
 				    arc_buf_hdr_t *, hdr);
-				ARCSTAT_BUMP(arcstat_l2_misses);
+				ARCSUM_BUMP(arcstat_l2_misses);
 			}
 		}
 
@@ -7395,6 +7457,36 @@ arc_kstat_update(kstat_t *ksp, int rw)
 		ARCSTAT(arcstat_hdr_size) = aggsum_value(&astat_hdr_size);
 		ARCSTAT(arcstat_other_size) = aggsum_value(&astat_other_size);
 		ARCSTAT(arcstat_l2_hdr_size) = aggsum_value(&astat_l2_hdr_size);
+
+		ARCSUM_SYNC(arcstat_hits);
+		ARCSUM_SYNC(arcstat_misses);
+		ARCSUM_SYNC(arcstat_demand_data_hits);
+		ARCSUM_SYNC(arcstat_demand_data_misses);
+		ARCSUM_SYNC(arcstat_demand_metadata_hits);
+		ARCSUM_SYNC(arcstat_demand_metadata_misses);
+		ARCSUM_SYNC(arcstat_prefetch_data_hits);
+		ARCSUM_SYNC(arcstat_prefetch_data_misses);
+		ARCSUM_SYNC(arcstat_prefetch_metadata_hits);
+		ARCSUM_SYNC(arcstat_prefetch_metadata_misses);
+		ARCSUM_SYNC(arcstat_mru_hits);
+		ARCSUM_SYNC(arcstat_mru_ghost_hits);
+		ARCSUM_SYNC(arcstat_mfu_hits);
+		ARCSUM_SYNC(arcstat_mfu_ghost_hits);
+		ARCSUM_SYNC(arcstat_deleted);
+		ARCSUM_SYNC(arcstat_mutex_miss);
+		ARCSUM_SYNC(arcstat_evict_skip);
+		ARCSUM_SYNC(arcstat_evict_l2_cached);
+		ARCSUM_SYNC(arcstat_evict_l2_eligible);
+		ARCSUM_SYNC(arcstat_evict_l2_ineligible);
+		ARCSUM_SYNC(arcstat_evict_l2_skip);
+		ARCSUM_SYNC(arcstat_hash_collisions);
+		ARCSUM_SYNC(arcstat_l2_hits);
+		ARCSUM_SYNC(arcstat_l2_misses);
+		ARCSUM_SYNC(arcstat_l2_rw_clash);
+		ARCSUM_SYNC(arcstat_l2_read_bytes);
+		ARCSUM_SYNC(arcstat_async_upgrade_sync);
+		ARCSUM_SYNC(arcstat_demand_hit_predictive_prefetch);
+		ARCSUM_SYNC(arcstat_demand_hit_prescient_prefetch);
 	}
 
 	return (0);
@@ -7623,6 +7715,9 @@ arc_state_init(void)
 	aggsum_init(&astat_hdr_size, 0);
 	aggsum_init(&astat_other_size, 0);
 	aggsum_init(&astat_l2_hdr_size, 0);
+
+	for (int i = 0; i < sizeof (arc_sums) / sizeof (wmsum_t); i++)
+		wmsum_init(&((wmsum_t *)&arc_sums)[i], 0);
 }
 
 static void
@@ -7865,6 +7960,9 @@ arc_fini(void)
 	aggsum_fini(&astat_other_size);
 	aggsum_fini(&astat_l2_hdr_size);
 
+	for (int i = 0; i < sizeof (arc_sums) / sizeof (wmsum_t); i++)
+		wmsum_fini(&((wmsum_t *)&arc_sums)[i]);
+
 	ASSERT0(arc_loaned_bytes);
 }
 
@@ -378,6 +378,46 @@ bpobj_iterate_nofree(bpobj_t *bpo, bpobj_itor_t func, void *arg, dmu_tx_t *tx)
 	return (bpobj_iterate_impl(bpo, func, arg, tx, B_FALSE));
 }
 
+/*
+ * Iterate the blkptrs stored directly in this bpobj (not its subobjs) in
+ * the index range [start, end), in the order they were enqueued.  The
+ * caller must ensure the range is stable; entries are only ever appended,
+ * so any range below the current bpo_num_blkptrs is.
+ */
+int
+bpobj_iterate_range(bpobj_t *bpo, uint64_t start, uint64_t end,
+    bpobj_itor_t func, void *arg, dmu_tx_t *tx)
+{
+	dmu_buf_t *dbuf = NULL;
+	int err = 0;
+
+	ASSERT(bpobj_is_open(bpo));
+
+	for (uint64_t i = start; i < end; i++) {
+		uint64_t offset = i * sizeof (blkptr_t);
+		blkptr_t *bparray;
+
+		if (dbuf == NULL || offset >= dbuf->db_offset + dbuf->db_size) {
+			if (dbuf != NULL)
+				dmu_buf_rele(dbuf, FTAG);
+			err = dmu_buf_hold(bpo->bpo_os, bpo->bpo_object, offset,
+			    FTAG, &dbuf, 0);
+			if (err != 0) {
+				dbuf = NULL;
+				break;
+			}
+		}
+
+		bparray = dbuf->db_data;
+		err = func(arg, &bparray[P2PHASE(i, bpo->bpo_epb)], tx);
+		if (err != 0)
+			break;
+	}
+	if (dbuf != NULL)
+		dmu_buf_rele(dbuf, FTAG);
+	return (err);
+}
+
 void
 bpobj_enqueue_subobj(bpobj_t *bpo, uint64_t subobj, dmu_tx_t *tx)
 {
@@ -215,6 +215,9 @@ bptree_iterate(objset_t *os, uint64_t obj, boolean_t free, bptree_itor_t func,
 		int flags = TRAVERSE_PREFETCH_METADATA | TRAVERSE_POST |
 		    TRAVERSE_NO_DECRYPT;
 
+		if (free)
+			flags |= TRAVERSE_PREFETCH_AHEAD;
+
 		err = dmu_read(os, obj, i * sizeof (bte), sizeof (bte),
 		    &bte, DMU_READ_NO_PREFETCH);
 		if (err != 0)
@@ -0,0 +1,238 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Per-dataset I/O statistics.
+ *
+ * Every mounted filesystem, other than snapshots, exports a "zfs/<pool>"
+ * kstat named "objset-0x<objset id>" with the number of reads, writes and
+ * ZIL commits it has served, the bytes read and written, and a latency
+ * histogram for each kind of operation.  They are updated from zfs_read(),
+ * zfs_write() and zil_commit(), so they show which datasets are driving
+ * the load on the pool.
+ *
+ * The counters are kept in per-CPU slices so that concurrent I/O to the
+ * same dataset does not bounce a shared cache line between CPUs.  A thread
+ * may be migrated between picking its slice and updating it, so updates
+ * are still atomic, but they are almost always to a line the CPU already
+ * owns.  The slices are only summed when the kstat is read.
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/dmu_objset.h>
+#include <sys/dataset_kstats.h>
+
+/*
+ * Order of the values in dk_values.  The latency histograms follow the
+ * scalar values.
+ */
+enum dataset_kstats_value {
+	DKV_DATASET_NAME,
+	DKV_READS,
+	DKV_NREAD,
+	DKV_WRITES,
+	DKV_NWRITTEN,
+	DKV_SYNCS,
+	DKV_READ_HISTO,
+	DKV_WRITE_HISTO = DKV_READ_HISTO + VDEV_L_HISTO_BUCKETS,
+	DKV_SYNC_HISTO = DKV_WRITE_HISTO + VDEV_L_HISTO_BUCKETS,
+	DKV_COUNT = DKV_SYNC_HISTO + VDEV_L_HISTO_BUCKETS
+};
+
+/*
+ * kmem_zalloc() does not promise cache line alignment, so the slices are
+ * carved out of a buffer with room to align the first one.
+ */
+#define	DK_CPUS_BUFSIZE(ncpus) \
+	((ncpus) * sizeof (dataset_kstats_cpu_t) + DATASET_KSTATS_ALIGN)
+
+static const char *dataset_kstats_names[] = {
+	[DKV_DATASET_NAME] = "dataset_name",
+	[DKV_READS] = "reads",
+	[DKV_NREAD] = "nread",
+	[DKV_WRITES] = "writes",
+	[DKV_NWRITTEN] = "nwritten",
+	[DKV_SYNCS] = "syncs",
+};
+
+static void
+dataset_kstats_init_histo(kstat_named_t *ks, const char *prefix)
+{
+	for (int i = 0; i < VDEV_L_HISTO_BUCKETS; i++) {
+		(void) snprintf(ks[i].name, KSTAT_STRLEN, "%s_lat_%lluns",
+		    prefix, (u_longlong_t)1 << i);
+		ks[i].data_type = KSTAT_DATA_UINT64;
+		ks[i].value.ui64 = 0;
+	}
+}
+
+static int
+dataset_kstats_update(kstat_t *ksp, int rw)
+{
+	dataset_kstats_t *dk = ksp->ks_private;
+	kstat_named_t *ks = dk->dk_values;
+
+	if (rw == KSTAT_WRITE)
+		return (SET_ERROR(EACCES));
+
+	for (int i = DKV_READS; i < DKV_COUNT; i++)
+		ks[i].value.ui64 = 0;
+
+	for (int c = 0; c < dk->dk_ncpus; c++) {
+		dataset_kstats_cpu_t *dkc = &dk->dk_cpus[c];
+
+		ks[DKV_READS].value.ui64 += dkc->dkc_reads;
+		ks[DKV_NREAD].value.ui64 += dkc->dkc_nread;
+		ks[DKV_WRITES].value.ui64 += dkc->dkc_writes;
+		ks[DKV_NWRITTEN].value.ui64 += dkc->dkc_nwritten;
+		ks[DKV_SYNCS].value.ui64 += dkc->dkc_syncs;
+		for (int i = 0; i < VDEV_L_HISTO_BUCKETS; i++) {
+			ks[DKV_READ_HISTO + i].value.ui64 +=
+			    dkc->dkc_read_histo[i];
+			ks[DKV_WRITE_HISTO + i].value.ui64 +=
+			    dkc->dkc_write_histo[i];
+			ks[DKV_SYNC_HISTO + i].value.ui64 +=
+			    dkc->dkc_sync_histo[i];
+		}
+	}
+
+	return (0);
+}
+
+void
+dataset_kstats_create(dataset_kstats_t *dk, objset_t *os)
+{
+	char module[KSTAT_STRLEN];
+	char name[KSTAT_STRLEN];
+	kstat_named_t *ks;
+	kstat_t *ksp;
+
+	/*
+	 * There should not be anything wrong with having kstats for
+	 * snapshots.  Since we are not sure how useful they would be
+	 * though nor how much their memory overhead would matter in
+	 * a filesystem with many snapshots, we skip them for now.
+	 */
+	if (dmu_objset_is_snapshot(os))
+		return;
+
+	mutex_init(&dk->dk_lock, NULL, MUTEX_DEFAULT, NULL);
+	dk->dk_ncpus = max_ncpus;
+	dk->dk_cpus_buf = kmem_zalloc(DK_CPUS_BUFSIZE(dk->dk_ncpus), KM_SLEEP);
+	dk->dk_cpus = (dataset_kstats_cpu_t *)P2ROUNDUP(
+	    (uintptr_t)dk->dk_cpus_buf, DATASET_KSTATS_ALIGN);
+	dk->dk_name = kmem_zalloc(ZFS_MAX_DATASET_NAME_LEN, KM_SLEEP);
+	dmu_objset_name(os, dk->dk_name);
+
+	dk->dk_values = kmem_zalloc(DKV_COUNT * sizeof (kstat_named_t),
+	    KM_SLEEP);
+	ks = dk->dk_values;
+	for (int i = 0; i < DKV_READ_HISTO; i++) {
+		(void) strlcpy(ks[i].name, dataset_kstats_names[i],
+		    KSTAT_STRLEN);
+		ks[i].data_type = KSTAT_DATA_UINT64;
+	}
+	ks[DKV_DATASET_NAME].data_type = KSTAT_DATA_STRING;
+	KSTAT_NAMED_STR_PTR(&ks[DKV_DATASET_NAME]) = dk->dk_name;
+	KSTAT_NAMED_STR_BUFLEN(&ks[DKV_DATASET_NAME]) =
+	    ZFS_MAX_DATASET_NAME_LEN;
+	dataset_kstats_init_histo(&ks[DKV_READ_HISTO], "read");
+	dataset_kstats_init_histo(&ks[DKV_WRITE_HISTO], "write");
+	dataset_kstats_init_histo(&ks[DKV_SYNC_HISTO], "sync");
+
+	(void) snprintf(module, KSTAT_STRLEN, "zfs/%s",
+	    spa_name(dmu_objset_spa(os)));
+	(void) snprintf(name, KSTAT_STRLEN, "objset-0x%llx",
+	    (u_longlong_t)dmu_objset_id(os));
+
+	ksp = kstat_create(module, 0, name, "dataset", KSTAT_TYPE_NAMED,
+	    DKV_COUNT, KSTAT_FLAG_VIRTUAL);
+	dk->dk_kstat = ksp;
+
+	if (ksp) {
+		ksp->ks_lock = &dk->dk_lock;
+		ksp->ks_data = dk->dk_values;
+		ksp->ks_ndata = DKV_COUNT;
+		ksp->ks_data_size = DKV_COUNT * sizeof (kstat_named_t);
+		ksp->ks_private = dk;
+		ksp->ks_update = dataset_kstats_update;
+		kstat_install(ksp);
+	}
+}
+
+void
+dataset_kstats_destroy(dataset_kstats_t *dk)
+{
+	if (dk->dk_cpus == NULL)
+		return;
+
+	if (dk->dk_kstat)
+		kstat_delete(dk->dk_kstat);
+
+	kmem_free(dk->dk_values, DKV_COUNT * sizeof (kstat_named_t));
+	kmem_free(dk->dk_name, ZFS_MAX_DATASET_NAME_LEN);
+	kmem_free(dk->dk_cpus_buf, DK_CPUS_BUFSIZE(dk->dk_ncpus));
+	mutex_destroy(&dk->dk_lock);
+	bzero(dk, sizeof (*dk));
+}
+
+static inline dataset_kstats_cpu_t *
+dataset_kstats_cpu(dataset_kstats_t *dk)
+{
+	return (&dk->dk_cpus[CPU_SEQID % dk->dk_ncpus]);
+}
+
+void
+dataset_kstats_update_read_kstats(dataset_kstats_t *dk, int64_t nread,
+    hrtime_t delta)
+{
+	dataset_kstats_cpu_t *dkc;
+
+	if (dk->dk_cpus == NULL)
+		return;
+
+	dkc = dataset_kstats_cpu(dk);
+	atomic_inc_64(&dkc->dkc_reads);
+	atomic_add_64(&dkc->dkc_nread, nread);
+	atomic_inc_64(&dkc->dkc_read_histo[L_HISTO((uint64_t)delta)]);
+}
+
+void
+dataset_kstats_update_write_kstats(dataset_kstats_t *dk, int64_t nwritten,
+    hrtime_t delta)
+{
+	dataset_kstats_cpu_t *dkc;
+
+	if (dk->dk_cpus == NULL)
+		return;
+
+	dkc = dataset_kstats_cpu(dk);
+	atomic_inc_64(&dkc->dkc_writes);
+	atomic_add_64(&dkc->dkc_nwritten, nwritten);
+	atomic_inc_64(&dkc->dkc_write_histo[L_HISTO((uint64_t)delta)]);
+}
+
+void
+dataset_kstats_update_sync_kstats(dataset_kstats_t *dk, hrtime_t delta)
+{
+	dataset_kstats_cpu_t *dkc;
+
+	if (dk->dk_cpus == NULL)
+		return;
+
+	dkc = dataset_kstats_cpu(dk);
+	atomic_inc_64(&dkc->dkc_syncs);
+	atomic_inc_64(&dkc->dkc_sync_histo[L_HISTO((uint64_t)delta)]);
+}
@@ -37,6 +37,7 @@
 #include <sys/zio_compress.h>
 #include <sys/dsl_scan.h>
 #include <sys/abd.h>
+#include <sys/wmsum.h>
 
 static kmem_cache_t *ddt_cache;
 static kmem_cache_t *ddt_entry_cache;
@@ -46,6 +47,66 @@ static kmem_cache_t *ddt_entry_cache;
  */
 int zfs_dedup_prefetch = 0;
 
+/*
+ * After a writeable import the DDT is read into the ARC in the background,
+ * hottest class first, so that the first dedup writes and frees do not each
+ * wait on a cold ZAP lookup.  The warm-up stops once it has read
+ * zfs_ddt_warmup_max_pct percent of physical memory worth of DDT.
+ */
+uint64_t zfs_ddt_warmup = 1;
+uint64_t zfs_ddt_warmup_max_pct = 10;
+
+/* Size of each read issued by the warm-up thread */
+#define	DDT_WARMUP_CHUNK	(1ULL << 20)
+
+typedef struct ddt_stats {
+	kstat_named_t ddtstat_lookups;
+	kstat_named_t ddtstat_lookups_ondisk;
+	kstat_named_t ddtstat_lookup_ondisk_ns;
+} ddt_stats_t;
+
+static ddt_stats_t ddt_stats = {
+	{ "lookups",			KSTAT_DATA_UINT64 },
+	{ "lookups_ondisk",		KSTAT_DATA_UINT64 },
+	{ "lookup_ondisk_ns",		KSTAT_DATA_UINT64 },
+};
+
+/*
+ * ddt_lookup() runs for every dedup write and free, so the counters are
+ * kept in per-CPU sums and only folded into ddt_stats when the kstat is
+ * read.  The warm-up progress is per pool, see the ddt_warmup pool kstat.
+ */
+typedef struct ddt_sums {
+	wmsum_t ddtstat_lookups;
+	wmsum_t ddtstat_lookups_ondisk;
+	wmsum_t ddtstat_lookup_ondisk_ns;
+} ddt_sums_t;
+
+static ddt_sums_t ddt_sums;
+
+#define	DDTSTAT_BUMP(stat)	wmsum_add(&ddt_sums.stat, 1)
+#define	DDTSTAT_INCR(stat, val)	wmsum_add(&ddt_sums.stat, (val))
+
+static kstat_t *ddt_ksp;
+
+static int
+ddt_kstat_update(kstat_t *ksp, int rw)
+{
+	ddt_stats_t *ds = ksp->ks_data;
+
+	if (rw == KSTAT_WRITE)
+		return (SET_ERROR(EACCES));
+
+	ds->ddtstat_lookups.value.ui64 =
+	    wmsum_value(&ddt_sums.ddtstat_lookups);
+	ds->ddtstat_lookups_ondisk.value.ui64 =
+	    wmsum_value(&ddt_sums.ddtstat_lookups_ondisk);
+	ds->ddtstat_lookup_ondisk_ns.value.ui64 =
+	    wmsum_value(&ddt_sums.ddtstat_lookup_ondisk_ns);
+
+	return (0);
+}
+
 static const ddt_ops_t *ddt_ops[DDT_TYPES] = {
 	&ddt_zap_ops,
 };
@@ -625,11 +686,33 @@ ddt_init(void)
 	    sizeof (ddt_t), 0, NULL, NULL, NULL, NULL, NULL, 0);
 	ddt_entry_cache = kmem_cache_create("ddt_entry_cache",
 	    sizeof (ddt_entry_t), 0, NULL, NULL, NULL, NULL, NULL, 0);
+
+	wmsum_init(&ddt_sums.ddtstat_lookups, 0);
+	wmsum_init(&ddt_sums.ddtstat_lookups_ondisk, 0);
+	wmsum_init(&ddt_sums.ddtstat_lookup_ondisk_ns, 0);
+
+	ddt_ksp = kstat_create("zfs", 0, "ddtstats", "misc",
+	    KSTAT_TYPE_NAMED, sizeof (ddt_stats) / sizeof (kstat_named_t),
+	    KSTAT_FLAG_VIRTUAL);
+	if (ddt_ksp != NULL) {
+		ddt_ksp->ks_data = &ddt_stats;
+		ddt_ksp->ks_update = ddt_kstat_update;
+		kstat_install(ddt_ksp);
+	}
 }
 
 void
 ddt_fini(void)
 {
+	if (ddt_ksp != NULL) {
+		kstat_delete(ddt_ksp);
+		ddt_ksp = NULL;
+	}
+
+	wmsum_fini(&ddt_sums.ddtstat_lookups);
+	wmsum_fini(&ddt_sums.ddtstat_lookups_ondisk);
+	wmsum_fini(&ddt_sums.ddtstat_lookup_ondisk_ns);
+
 	kmem_cache_destroy(ddt_entry_cache);
 	kmem_cache_destroy(ddt_cache);
 }
@@ -681,10 +764,12 @@ ddt_lookup(ddt_t *ddt, const blkptr_t *bp, boolean_t add)
 	enum ddt_type type;
 	enum ddt_class class;
 	avl_index_t where;
+	hrtime_t start;
 	int error;
 
 	ASSERT(MUTEX_HELD(&ddt->ddt_lock));
 
+	DDTSTAT_BUMP(ddtstat_lookups);
 	ddt_key_fill(&dde_search.dde_key, bp);
 
 	dde = avl_find(&ddt->ddt_tree, &dde_search, &where);
@@ -706,6 +791,7 @@ ddt_lookup(ddt_t *ddt, const blkptr_t *bp, boolean_t add)
 	ddt_exit(ddt);
 
 	error = ENOENT;
+	start = gethrtime();
 
 	for (type = 0; type < DDT_TYPES; type++) {
 		for (class = 0; class < DDT_CLASSES; class++) {
@@ -719,6 +805,9 @@ ddt_lookup(ddt_t *ddt, const blkptr_t *bp, boolean_t add)
 			break;
 	}
 
+	DDTSTAT_BUMP(ddtstat_lookups_ondisk);
+	DDTSTAT_INCR(ddtstat_lookup_ondisk_ns, gethrtime() - start);
+
 	ddt_enter(ddt);
 
 	ASSERT(dde->dde_loaded == B_FALSE);
@@ -1193,3 +1282,106 @@ ddt_walk(spa_t *spa, ddt_bookmark_t *ddb, ddt_entry_t *dde)
 
 	return (SET_ERROR(ENOENT));
 }
+
+/*
+ * Step to the next DDT object in warm-up order: all checksums of the
+ * hottest class first, then the next class.
+ */
+static boolean_t
+ddt_warmup_next(enum zio_checksum *c, enum ddt_type *type,
+    enum ddt_class *class)
+{
+	if (++(*c) < ZIO_CHECKSUM_FUNCTIONS)
+		return (B_TRUE);
+	*c = 0;
+	if (++(*type) < DDT_TYPES)
+		return (B_TRUE);
+	*type = 0;
+	return (++(*class) < DDT_CLASSES);
+}
+
+boolean_t
+ddt_warmup_check(void *arg, zthr_t *zthr)
+{
+	spa_t *spa = arg;
+
+	return (zfs_ddt_warmup != 0 && !spa->spa_ddt_warmup_done);
+}
+
+/*
+ * Read the DDT objects into the ARC.  The read offset of each object is
+ * kept in its ddt_t, so a cancelled warm-up (e.g. across spa_async_suspend)
+ * picks up where it left off.  Objects created or destroyed by syncing
+ * context while we run are simply skipped.
+ */
+void
+ddt_warmup_thread(void *arg, zthr_t *zthr)
+{
+	spa_t *spa = arg;
+	objset_t *os = spa->spa_meta_objset;
+	uint64_t max = physmem * PAGESIZE / 100 * zfs_ddt_warmup_max_pct;
+	enum zio_checksum c = 0;
+	enum ddt_type type = 0;
+	enum ddt_class class = 0;
+	dmu_object_info_t doi;
+	void *buf;
+
+	if (spa->spa_ddt_warmup_total == 0) {
+		uint64_t total = 0;
+
+		do {
+			ddt_t *ddt = spa->spa_ddt[c];
+			if (ddt != NULL &&
+			    ddt_object_exists(ddt, type, class) &&
+			    ddt_object_info(ddt, type, class, &doi) == 0)
+				total += doi.doi_max_offset;
+		} while (ddt_warmup_next(&c, &type, &class));
+		spa->spa_ddt_warmup_total = MIN(total, max);
+		spa_ddt_warmup_stats_set(spa, spa->spa_ddt_warmup_total,
+		    spa->spa_ddt_warmup_bytes, B_FALSE);
+		c = 0;
+		type = 0;
+		class = 0;
+	}
+
+	buf = kmem_alloc(DDT_WARMUP_CHUNK, KM_SLEEP);
+
+	do {
+		ddt_t *ddt = spa->spa_ddt[c];
+		uint64_t *offp;
+
+		if (ddt == NULL || !ddt_object_exists(ddt, type, class) ||
+		    ddt_object_info(ddt, type, class, &doi) != 0)
+			continue;
+
+		offp = &ddt->ddt_warmup_offset[type][class];
+		while (*offp < doi.doi_max_offset) {
+			uint64_t len = MIN(DDT_WARMUP_CHUNK,
+			    doi.doi_max_offset - *offp);
+
+			if (zthr_iscancelled(zthr)) {
+				kmem_free(buf, DDT_WARMUP_CHUNK);
+				return;
+			}
+			if (spa->spa_ddt_warmup_bytes >= max)
+				goto done;
+
+			if (dmu_read(os, ddt->ddt_object[type][class], *offp,
+			    len, buf, DMU_READ_NO_PREFETCH) != 0)
+				break;
+
+			*offp += len;
+			spa->spa_ddt_warmup_bytes += len;
+			spa_ddt_warmup_stats_set(spa, spa->spa_ddt_warmup_total,
+			    spa->spa_ddt_warmup_bytes, B_FALSE);
+		}
+	} while (ddt_warmup_next(&c, &type, &class));
+
+done:
+	kmem_free(buf, DDT_WARMUP_CHUNK);
+	spa->spa_ddt_warmup_done = B_TRUE;
+	spa_ddt_warmup_stats_set(spa, spa->spa_ddt_warmup_total,
+	    spa->spa_ddt_warmup_bytes, B_TRUE);
+	zfs_dbgmsg("spa=%s DDT warm-up read %llu bytes", spa_name(spa),
+	    (u_longlong_t)spa->spa_ddt_warmup_bytes);
+}
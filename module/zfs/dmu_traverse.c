@@ -52,6 +52,23 @@ typedef struct prefetch_data {
 	zbookmark_phys_t pd_resume;
 } prefetch_data_t;
 
+/*
+ * State shared by all threads of a parallel traversal.
+ */
+typedef struct traverse_parallel {
+	taskq_t *tp_tq;
+	uint64_t tp_pending;	/* dispatched, not yet finished tasks */
+	uint64_t tp_max_pending;
+	kmutex_t tp_lock;
+	int tp_error;		/* first error reported by a task */
+} traverse_parallel_t;
+
+/*
+ * Bound on queued subtrees per traversal thread; once reached, subtrees
+ * are visited by the thread that found them instead of being queued.
+ */
+#define	TRAVERSE_TASKS_PER_THREAD	32
+
 typedef struct traverse_data {
 	spa_t *td_spa;
 	uint64_t td_objset;
@@ -65,12 +82,29 @@ typedef struct traverse_data {
 	blkptr_cb_t *td_func;
 	void *td_arg;
 	boolean_t td_realloc_possible;
+	traverse_parallel_t *td_tp;
 } traverse_data_t;
 
+typedef struct traverse_task {
+	traverse_data_t tt_td;
+	blkptr_t tt_bp;
+	zbookmark_phys_t tt_zb;
+	dnode_phys_t *tt_dnp;
+	size_t tt_dnsize;
+} traverse_task_t;
+
+typedef struct traverse_ahead {
+	spa_t *ta_spa;
+	uint64_t ta_min_txg;
+	zbookmark_phys_t ta_zb;
+} traverse_ahead_t;
+
 static int traverse_dnode(traverse_data_t *td, const dnode_phys_t *dnp,
     uint64_t objset, uint64_t object);
 static void prefetch_dnode_metadata(traverse_data_t *td, const dnode_phys_t *,
     uint64_t objset, uint64_t object);
+static int traverse_visitbp(traverse_data_t *td, const dnode_phys_t *dnp,
+    const blkptr_t *bp, const zbookmark_phys_t *zb);
 
 static int
 traverse_zil_block(zilog_t *zilog, blkptr_t *bp, void *arg, uint64_t claim_txg)
@@ -202,6 +236,71 @@ traverse_prefetch_metadata(traverse_data_t *td,
 	    ZIO_PRIORITY_ASYNC_READ, zio_flags, &flags, zb);
 }
 
+static void
+traverse_prefetch_ahead_done(zio_t *zio, const zbookmark_phys_t *zb,
+    const blkptr_t *bp, arc_buf_t *abuf, void *private)
+{
+	traverse_ahead_t *ta = private;
+	arc_flags_t flags;
+	zbookmark_phys_t czb;
+	int32_t i, epb;
+
+	if (abuf == NULL) {
+		kmem_free(ta, sizeof (*ta));
+		return;
+	}
+
+	epb = arc_buf_lsize(abuf) >> SPA_BLKPTRSHIFT;
+	for (i = 0; i < epb; i++) {
+		const blkptr_t *cbp = &((blkptr_t *)abuf->b_data)[i];
+
+		if (BP_IS_HOLE(cbp) || cbp->blk_birth <= ta->ta_min_txg)
+			continue;
+
+		SET_BOOKMARK(&czb, ta->ta_zb.zb_objset, ta->ta_zb.zb_object,
+		    ta->ta_zb.zb_level - 1, ta->ta_zb.zb_blkid * epb + i);
+		flags = ARC_FLAG_NOWAIT | ARC_FLAG_PREFETCH;
+		(void) arc_read(NULL, ta->ta_spa, cbp, NULL, NULL,
+		    ZIO_PRIORITY_ASYNC_READ,
+		    ZIO_FLAG_CANFAIL | ZIO_FLAG_SPECULATIVE, &flags, &czb);
+	}
+
+	arc_buf_destroy(abuf, private);
+	kmem_free(ta, sizeof (*ta));
+}
+
+/*
+ * Read the indirect block bp (child blkid of the block at pzb) and prefetch
+ * its children once it arrives.  Only blocks whose children are themselves
+ * indirect blocks are handled; see TRAVERSE_PREFETCH_AHEAD.
+ */
+static void
+traverse_prefetch_ahead(traverse_data_t *td, const zbookmark_phys_t *pzb,
+    const blkptr_t *bp, uint64_t blkid)
+{
+	arc_flags_t flags = ARC_FLAG_NOWAIT | ARC_FLAG_PREFETCH;
+	traverse_ahead_t *ta;
+
+	if (!(td->td_flags & TRAVERSE_PREFETCH_AHEAD))
+		return;
+	if (td->td_resume != NULL && !ZB_IS_ZERO(td->td_resume))
+		return;
+	if (BP_IS_HOLE(bp) || bp->blk_birth <= td->td_min_txg)
+		return;
+	if (BP_GET_LEVEL(bp) < 2)
+		return;
+
+	ta = kmem_alloc(sizeof (*ta), KM_SLEEP);
+	ta->ta_spa = td->td_spa;
+	ta->ta_min_txg = td->td_min_txg;
+	SET_BOOKMARK(&ta->ta_zb, pzb->zb_objset, pzb->zb_object,
+	    pzb->zb_level - 1, blkid);
+
+	(void) arc_read(NULL, td->td_spa, bp, traverse_prefetch_ahead_done, ta,
+	    ZIO_PRIORITY_ASYNC_READ, ZIO_FLAG_CANFAIL | ZIO_FLAG_SPECULATIVE,
+	    &flags, &ta->ta_zb);
+}
+
 static boolean_t
 prefetch_needed(prefetch_data_t *pfd, const blkptr_t *bp)
 {
@@ -212,6 +311,79 @@ prefetch_needed(prefetch_data_t *pfd, const blkptr_t *bp)
 	return (B_TRUE);
 }
 
+static void
+traverse_task_func(void *arg)
+{
+	traverse_task_t *tt = arg;
+	traverse_parallel_t *tp = tt->tt_td.td_tp;
+	int err;
+
+	if (tp->tp_error == 0) {
+		err = traverse_visitbp(&tt->tt_td, tt->tt_dnp, &tt->tt_bp,
+		    &tt->tt_zb);
+		if (err != 0) {
+			mutex_enter(&tp->tp_lock);
+			if (tp->tp_error == 0)
+				tp->tp_error = err;
+			mutex_exit(&tp->tp_lock);
+		}
+	}
+
+	if (tt->tt_dnp != NULL)
+		kmem_free(tt->tt_dnp, tt->tt_dnsize);
+	kmem_free(tt, sizeof (traverse_task_t));
+	atomic_dec_64(&tp->tp_pending);
+}
+
+/*
+ * In a parallel traversal, hand the subtree rooted at bp to another thread.
+ * Subtrees are the dnode blocks below an indirect block of the meta-dnode
+ * and the level 1 indirect blocks of any object, which keeps the tasks
+ * large enough to be worth queueing.  The dnode is copied because the
+ * buffer holding it may be released before the task runs.  Returns B_FALSE
+ * if the caller should visit the subtree itself.
+ */
+static boolean_t
+traverse_dispatch(traverse_data_t *td, const dnode_phys_t *dnp,
+    const blkptr_t *pbp, const blkptr_t *bp, const zbookmark_phys_t *zb)
+{
+	traverse_parallel_t *tp = td->td_tp;
+	traverse_task_t *tt;
+
+	if (tp == NULL || BP_IS_HOLE(bp) || bp->blk_birth <= td->td_min_txg)
+		return (B_FALSE);
+	if (zb->zb_level != 1 &&
+	    !(zb->zb_level == 0 && BP_GET_TYPE(pbp) == DMU_OT_DNODE))
+		return (B_FALSE);
+	if (tp->tp_error != 0 || tp->tp_pending >= tp->tp_max_pending)
+		return (B_FALSE);
+
+	tt = kmem_alloc(sizeof (traverse_task_t), KM_SLEEP);
+	tt->tt_td = *td;
+	tt->tt_td.td_pfd = NULL;
+	tt->tt_bp = *bp;
+	tt->tt_zb = *zb;
+	tt->tt_dnp = NULL;
+	tt->tt_dnsize = 0;
+	if (dnp != NULL) {
+		tt->tt_dnsize = (dnp->dn_extra_slots + 1) << DNODE_SHIFT;
+		tt->tt_dnp = kmem_alloc(tt->tt_dnsize, KM_SLEEP);
+		bcopy(dnp, tt->tt_dnp, tt->tt_dnsize);
+	}
+
+	atomic_inc_64(&tp->tp_pending);
+	if (taskq_dispatch(tp->tp_tq, traverse_task_func, tt,
+	    TQ_NOSLEEP) == 0) {
+		atomic_dec_64(&tp->tp_pending);
+		if (tt->tt_dnp != NULL)
+			kmem_free(tt->tt_dnp, tt->tt_dnsize);
+		kmem_free(tt, sizeof (traverse_task_t));
+		return (B_FALSE);
+	}
+
+	return (B_TRUE);
+}
+
 static int
 traverse_visitbp(traverse_data_t *td, const dnode_phys_t *dnp,
     const blkptr_t *bp, const zbookmark_phys_t *zb)
@@ -315,11 +487,19 @@ traverse_visitbp(traverse_data_t *td, const dnode_phys_t *dnp,
 
 		/* recursively visitbp() blocks below this */
 		for (i = 0; i < epb; i++) {
+			blkptr_t *cbp = &((blkptr_t *)buf->b_data)[i];
+
+			if (i + 1 < epb) {
+				traverse_prefetch_ahead(td, zb, cbp + 1,
+				    zb->zb_blkid * epb + i + 1);
+			}
+
 			SET_BOOKMARK(czb, zb->zb_objset, zb->zb_object,
 			    zb->zb_level - 1,
 			    zb->zb_blkid * epb + i);
-			err = traverse_visitbp(td, dnp,
-			    &((blkptr_t *)buf->b_data)[i], czb);
+			if (traverse_dispatch(td, dnp, bp, cbp, czb))
+				continue;
+			err = traverse_visitbp(td, dnp, cbp, czb);
 			if (err != 0)
 				break;
 		}
@@ -577,7 +757,7 @@ traverse_prefetch_thread(void *arg)
 static int
 traverse_impl(spa_t *spa, dsl_dataset_t *ds, uint64_t objset, blkptr_t *rootbp,
     uint64_t txg_start, zbookmark_phys_t *resume, int flags,
-    blkptr_cb_t func, void *arg)
+    blkptr_cb_t func, void *arg, traverse_parallel_t *tp)
 {
 	traverse_data_t *td;
 	prefetch_data_t *pd;
@@ -586,6 +766,7 @@ traverse_impl(spa_t *spa, dsl_dataset_t *ds, uint64_t objset, blkptr_t *rootbp,
 
 	ASSERT(ds == NULL || objset == ds->ds_object);
 	ASSERT(!(flags & TRAVERSE_PRE) || !(flags & TRAVERSE_POST));
+	ASSERT(tp == NULL || (resume == NULL && !(flags & TRAVERSE_POST)));
 
 	td = kmem_alloc(sizeof (traverse_data_t), KM_SLEEP);
 	pd = kmem_zalloc(sizeof (prefetch_data_t), KM_SLEEP);
@@ -602,6 +783,7 @@ traverse_impl(spa_t *spa, dsl_dataset_t *ds, uint64_t objset, blkptr_t *rootbp,
 	td->td_flags = flags;
 	td->td_paused = B_FALSE;
 	td->td_realloc_possible = (txg_start == 0 ? B_FALSE : B_TRUE);
+	td->td_tp = tp;
 
 	if (spa_feature_is_active(spa, SPA_FEATURE_HOLE_BIRTH)) {
 		VERIFY(spa_feature_enabled_txg(spa,
@@ -640,13 +822,23 @@ traverse_impl(spa_t *spa, dsl_dataset_t *ds, uint64_t objset, blkptr_t *rootbp,
 		arc_buf_destroy(buf, &buf);
 	}
 
-	if (!(flags & TRAVERSE_PREFETCH_DATA) ||
+	/*
+	 * A parallel traversal keeps enough reads in flight on its own, and
+	 * the data prefetcher's accounting assumes a single visiting thread.
+	 */
+	if (!(flags & TRAVERSE_PREFETCH_DATA) || tp != NULL ||
 	    0 == taskq_dispatch(system_taskq, traverse_prefetch_thread,
 	    td, TQ_NOQUEUE))
 		pd->pd_exited = B_TRUE;
 
 	err = traverse_visitbp(td, NULL, rootbp, czb);
 
+	if (tp != NULL) {
+		taskq_wait(tp->tp_tq);
+		if (err == 0)
+			err = tp->tp_error;
+	}
+
 	mutex_enter(&pd->pd_mtx);
 	pd->pd_cancel = B_TRUE;
 	cv_broadcast(&pd->pd_cv);
@@ -674,7 +866,8 @@ traverse_dataset_resume(dsl_dataset_t *ds, uint64_t txg_start,
     int flags, blkptr_cb_t func, void *arg)
 {
 	return (traverse_impl(ds->ds_dir->dd_pool->dp_spa, ds, ds->ds_object,
-	    &dsl_dataset_phys(ds)->ds_bp, txg_start, resume, flags, func, arg));
+	    &dsl_dataset_phys(ds)->ds_bp, txg_start, resume, flags, func, arg,
+	    NULL));
 }
 
 int
@@ -690,15 +883,12 @@ traverse_dataset_destroyed(spa_t *spa, blkptr_t *blkptr,
     blkptr_cb_t func, void *arg)
 {
 	return (traverse_impl(spa, NULL, ZB_DESTROYED_OBJSET,
-	    blkptr, txg_start, resume, flags, func, arg));
+	    blkptr, txg_start, resume, flags, func, arg, NULL));
 }
 
-/*
- * NB: pool must not be changing on-disk (eg, from zdb or sync context).
- */
-int
-traverse_pool(spa_t *spa, uint64_t txg_start, int flags,
-    blkptr_cb_t func, void *arg)
+static int
+traverse_pool_impl(spa_t *spa, uint64_t txg_start, int flags,
+    blkptr_cb_t func, void *arg, traverse_parallel_t *tp)
 {
 	int err;
 	dsl_pool_t *dp = spa_get_dsl(spa);
@@ -707,7 +897,7 @@ traverse_pool(spa_t *spa, uint64_t txg_start, int flags,
 
 	/* visit the MOS */
 	err = traverse_impl(spa, NULL, 0, spa_get_rootblkptr(spa),
-	    txg_start, NULL, flags, func, arg);
+	    txg_start, NULL, flags, func, arg, tp);
 	if (err != 0)
 		return (err);
 
@@ -737,7 +927,9 @@ traverse_pool(spa_t *spa, uint64_t txg_start, int flags,
 			}
 			if (dsl_dataset_phys(ds)->ds_prev_snap_txg > txg)
 				txg = dsl_dataset_phys(ds)->ds_prev_snap_txg;
-			err = traverse_dataset(ds, txg, flags, func, arg);
+			err = traverse_impl(spa, ds, ds->ds_object,
+			    &dsl_dataset_phys(ds)->ds_bp, txg, NULL, flags,
+			    func, arg, tp);
 			dsl_dataset_rele(ds, FTAG);
 			if (err != 0)
 				break;
@@ -747,3 +939,45 @@ traverse_pool(spa_t *spa, uint64_t txg_start, int flags,
 		err = 0;
 	return (err);
 }
+
+/*
+ * NB: pool must not be changing on-disk (eg, from zdb or sync context).
+ */
+int
+traverse_pool(spa_t *spa, uint64_t txg_start, int flags,
+    blkptr_cb_t func, void *arg)
+{
+	return (traverse_pool_impl(spa, txg_start, flags, func, arg, NULL));
+}
+
+/*
+ * Like traverse_pool(), but the subtrees of each dataset are visited by
+ * nthreads threads.  The callback must be safe to call concurrently.  A
+ * block is still visited before the blocks below it, and the blocks below
+ * a level 1 indirect block are visited in order by a single thread, but
+ * there is no ordering between different subtrees.  TRAVERSE_POST is not
+ * supported, and TRAVERSE_PREFETCH_DATA is ignored.
+ */
+int
+traverse_pool_parallel(spa_t *spa, uint64_t txg_start, int flags,
+    blkptr_cb_t func, void *arg, int nthreads)
+{
+	traverse_parallel_t tp = { 0 };
+	int err;
+
+	if (nthreads <= 1)
+		return (traverse_pool(spa, txg_start, flags, func, arg));
+
+	tp.tp_tq = taskq_create("traverse", nthreads, minclsyspri,
+	    nthreads, INT_MAX, TASKQ_PREPOPULATE);
+	tp.tp_max_pending = nthreads * TRAVERSE_TASKS_PER_THREAD;
+	mutex_init(&tp.tp_lock, NULL, MUTEX_DEFAULT, NULL);
+
+	err = traverse_pool_impl(spa, txg_start,
+	    flags | TRAVERSE_PREFETCH_METADATA, func, arg, &tp);
+
+	taskq_destroy(tp.tp_tq);
+	mutex_destroy(&tp.tp_lock);
+
+	return (err);
+}
@@ -31,6 +31,7 @@
 #include <sys/dmu_objset.h>
 #include <sys/dsl_dataset.h>
 #include <sys/dsl_dir.h>
+#include <sys/dsl_livelist.h>
 #include <sys/dsl_prop.h>
 #include <sys/dsl_synctask.h>
 #include <sys/dmu_traverse.h>
@@ -159,6 +160,7 @@ dsl_dataset_block_born(dsl_dataset_t *ds, const blkptr_t *bp, dmu_tx_t *tx)
 		ds->ds_feature_activation_needed[f] = B_TRUE;
 
 	mutex_exit(&ds->ds_lock);
+	dsl_livelist_born(ds->ds_dir, bp);
 	dsl_dir_diduse_space(ds->ds_dir, DD_USED_HEAD, delta,
 	    compressed, uncompressed, tx);
 	dsl_dir_transfer_space(ds->ds_dir, used - delta,
@@ -182,6 +184,8 @@ dsl_dataset_block_remapped(dsl_dataset_t *ds, uint64_t vdev, uint64_t offset,
 	ASSERT(birth <= tx->tx_txg);
 	ASSERT(!ds->ds_is_snapshot);
 
+	dsl_livelist_invalidate(ds->ds_dir);
+
 	if (birth > dsl_dataset_phys(ds)->ds_prev_snap_txg) {
 		spa_vdev_indirect_mark_obsolete(spa, vdev, offset, size, tx);
 	} else {
@@ -238,6 +242,7 @@ dsl_dataset_block_kill(dsl_dataset_t *ds, const blkptr_t *bp, dmu_tx_t *tx,
 
 		dprintf_bp(bp, "freeing ds=%llu", ds->ds_object);
 		dsl_free(tx->tx_pool, tx->tx_txg, bp);
+		dsl_livelist_killed(ds->ds_dir, bp);
 
 		mutex_enter(&ds->ds_lock);
 		ASSERT(dsl_dataset_phys(ds)->ds_unique_bytes >= used ||
@@ -1010,6 +1015,17 @@ dsl_dataset_create_sync_dd(dsl_dir_t *dd, dsl_dataset_t *origin,
 			    dsl_dir_phys(origin->ds_dir)->dd_clones,
 			    dsobj, tx));
 		}
+
+		/*
+		 * Track the blocks of user-visible clones so that they can
+		 * be destroyed without traversing them.  Temporary clones
+		 * made by receive are swapped or destroyed right away.
+		 */
+		if (spa_feature_is_enabled(dp->dp_spa, SPA_FEATURE_LIVELIST) &&
+		    dsl_dir_is_clone(dd) && dd->dd_myname[0] != '%') {
+			dsl_livelist_create(dd,
+			    dsphys->ds_prev_snap_txg, tx);
+		}
 	}
 
 	/* handle encryption */
@@ -1308,6 +1324,25 @@ dsl_dataset_snapshot_check_impl(dsl_dataset_t *ds, const char *snapname,
 	return (0);
 }
 
+/*
+ * The number of new snapshots at and below a dataset, rolled up by
+ * dsl_dataset_snapshot_check() to validate snapshot limits.
+ */
+typedef struct dsl_dataset_snapshot_cnt {
+	avl_node_t	dssc_node;
+	char		*dssc_name;
+	uint64_t	dssc_cnt;
+} dsl_dataset_snapshot_cnt_t;
+
+static int
+dsl_dataset_snapshot_cnt_compare(const void *arg1, const void *arg2)
+{
+	const dsl_dataset_snapshot_cnt_t *dssc1 = arg1;
+	const dsl_dataset_snapshot_cnt_t *dssc2 = arg2;
+
+	return (AVL_ISIGN(strcmp(dssc1->dssc_name, dssc2->dssc_name)));
+}
+
 int
 dsl_dataset_snapshot_check(void *arg, dmu_tx_t *tx)
 {
@@ -1331,7 +1366,7 @@ dsl_dataset_snapshot_check(void *arg, dmu_tx_t *tx)
 	 * at each level up the tree but since it is validating each snapshot
 	 * independently we need to be sure that we are validating the complete
 	 * count for the entire set of snapshots. We do this by rolling up the
-	 * counts for each component of the name into an nvlist and then
+	 * counts for each component of the name into an AVL tree and then
 	 * checking each of those cases with the aggregated count.
 	 *
 	 * This approach properly handles not only the recursive snapshot
@@ -1344,17 +1379,21 @@ dsl_dataset_snapshot_check(void *arg, dmu_tx_t *tx)
 	 */
 	if (dmu_tx_is_syncing(tx)) {
 		char *nm;
-		nvlist_t *cnt_track = NULL;
-		cnt_track = fnvlist_alloc();
+		avl_tree_t cnt_track;
+		dsl_dataset_snapshot_cnt_t *dssc, search;
+		void *cookie = NULL;
+
+		avl_create(&cnt_track, dsl_dataset_snapshot_cnt_compare,
+		    sizeof (dsl_dataset_snapshot_cnt_t),
+		    offsetof(dsl_dataset_snapshot_cnt_t, dssc_node));
 
 		nm = kmem_alloc(MAXPATHLEN, KM_SLEEP);
 
-		/* Rollup aggregated counts into the cnt_track list */
+		/* Rollup aggregated counts into the cnt_track tree */
 		for (pair = nvlist_next_nvpair(ddsa->ddsa_snaps, NULL);
 		    pair != NULL;
 		    pair = nvlist_next_nvpair(ddsa->ddsa_snaps, pair)) {
 			char *pdelim;
-			uint64_t val;
 
 			(void) strlcpy(nm, nvpair_name(pair), MAXPATHLEN);
 			pdelim = strchr(nm, '@');
@@ -1363,14 +1402,20 @@ dsl_dataset_snapshot_check(void *arg, dmu_tx_t *tx)
 			*pdelim = '\0';
 
 			do {
-				if (nvlist_lookup_uint64(cnt_track, nm,
-				    &val) == 0) {
+				avl_index_t where;
+
+				search.dssc_name = nm;
+				dssc = avl_find(&cnt_track, &search, &where);
+				if (dssc != NULL) {
 					/* update existing entry */
-					fnvlist_add_uint64(cnt_track, nm,
-					    val + 1);
+					dssc->dssc_cnt++;
 				} else {
-					/* add to list */
-					fnvlist_add_uint64(cnt_track, nm, 1);
+					/* add to tree */
+					dssc = kmem_alloc(sizeof (*dssc),
+					    KM_SLEEP);
+					dssc->dssc_name = spa_strdup(nm);
+					dssc->dssc_cnt = 1;
+					avl_insert(&cnt_track, dssc, where);
 				}
 
 				pdelim = strrchr(nm, '/');
@@ -1382,35 +1427,38 @@ dsl_dataset_snapshot_check(void *arg, dmu_tx_t *tx)
 		kmem_free(nm, MAXPATHLEN);
 
 		/* Check aggregated counts at each level */
-		for (pair = nvlist_next_nvpair(cnt_track, NULL);
-		    pair != NULL; pair = nvlist_next_nvpair(cnt_track, pair)) {
+		for (dssc = avl_first(&cnt_track); dssc != NULL;
+		    dssc = AVL_NEXT(&cnt_track, dssc)) {
 			int error = 0;
-			char *name;
-			uint64_t cnt = 0;
 			dsl_dataset_t *ds;
 
-			name = nvpair_name(pair);
-			cnt = fnvpair_value_uint64(pair);
-			ASSERT(cnt > 0);
+			ASSERT(dssc->dssc_cnt > 0);
 
-			error = dsl_dataset_hold(dp, name, FTAG, &ds);
+			error = dsl_dataset_hold(dp, dssc->dssc_name, FTAG,
+			    &ds);
 			if (error == 0) {
-				error = dsl_fs_ss_limit_check(ds->ds_dir, cnt,
-				    ZFS_PROP_SNAPSHOT_LIMIT, NULL,
-				    ddsa->ddsa_cr);
+				error = dsl_fs_ss_limit_check(ds->ds_dir,
+				    dssc->dssc_cnt, ZFS_PROP_SNAPSHOT_LIMIT,
+				    NULL, ddsa->ddsa_cr);
 				dsl_dataset_rele(ds, FTAG);
 			}
 
 			if (error != 0) {
 				if (ddsa->ddsa_errors != NULL)
 					fnvlist_add_int32(ddsa->ddsa_errors,
-					    name, error);
+					    dssc->dssc_name, error);
 				rv = error;
 				/* only report one error for this check */
 				break;
 			}
 		}
-		nvlist_free(cnt_track);
+
+		while ((dssc = avl_destroy_nodes(&cnt_track, &cookie)) !=
+		    NULL) {
+			spa_strfree(dssc->dssc_name);
+			kmem_free(dssc, sizeof (*dssc));
+		}
+		avl_destroy(&cnt_track);
 	}
 
 	for (pair = nvlist_next_nvpair(ddsa->ddsa_snaps, NULL);
@@ -1479,6 +1527,12 @@ dsl_dataset_snapshot_sync_impl(dsl_dataset_t *ds, const char *snapname,
 
 	dsl_fs_ss_count_adjust(ds->ds_dir, 1, DD_FIELD_SNAPSHOT_COUNT, tx);
 
+	/*
+	 * A clone with snapshots shares its blocks with them, so it is
+	 * destroyed through the bptree and no longer needs a livelist.
+	 */
+	dsl_livelist_remove(ds->ds_dir, tx);
+
 	/*
 	 * The origin's ds_creation_txg has to be < TXG_INITIAL
 	 */
@@ -1879,6 +1933,7 @@ dsl_dataset_sync_done(dsl_dataset_t *ds, dmu_tx_t *tx)
 
 	bplist_iterate(&ds->ds_pending_deadlist,
 	    deadlist_enqueue_cb, &ds->ds_deadlist, tx);
+	dsl_livelist_sync(ds->ds_dir, tx);
 
 	if (os->os_synced_dnodes != NULL) {
 		multilist_destroy(os->os_synced_dnodes);
@@ -3125,6 +3180,9 @@ dsl_dataset_promote_sync(void *arg, dmu_tx_t *tx)
 
 	dsl_dataset_promote_crypt_sync(hds->ds_dir, odd, tx);
 
+	/* The promoted clone takes over the origin's snapshots. */
+	dsl_livelist_remove(dd, tx);
+
 	/* change origin's next snap */
 	dmu_buf_will_dirty(origin_ds->ds_dbuf, tx);
 	oldnext_obj = dsl_dataset_phys(origin_ds)->ds_next_snap_obj;
@@ -3578,6 +3636,10 @@ dsl_dataset_clone_swap_sync_impl(dsl_dataset_t *clone,
 		DMU_MAX_ACCESS * spa_asize_inflation);
 	ASSERT3P(clone->ds_prev, ==, origin_head->ds_prev);
 
+	/* The block pointers are about to trade places. */
+	dsl_livelist_remove(clone->ds_dir, tx);
+	dsl_livelist_remove(origin_head->ds_dir, tx);
+
 	/*
 	 * Swap per-dataset feature flags.
 	 */
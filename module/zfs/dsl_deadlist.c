@@ -49,6 +49,11 @@
  *     and protecting the dl_tree from being loaded.
  * The locking is provided by dl_lock.  Note that locking on the bpobj_t
  * provides its own locking, and dl_oldfmt is immutable.
+ *
+ * Space queries from open context on a deadlist whose tree hasn't been
+ * loaded are answered from dl_cache, which holds just the space of each
+ * key and doesn't keep the bpobjs open.  Every modification loads the
+ * tree first, which discards the cache, so the cache never goes stale.
  */
 
 static int
@@ -65,9 +70,59 @@ dsl_deadlist_compare(const void *arg1, const void *arg2)
 		return (0);
 }
 
+static int
+dsl_deadlist_cache_compare(const void *arg1, const void *arg2)
+{
+	const dsl_deadlist_cache_entry_t *dce1 = arg1;
+	const dsl_deadlist_cache_entry_t *dce2 = arg2;
+
+	return (AVL_CMP(dce1->dce_mintxg, dce2->dce_mintxg));
+}
+
+/*
+ * Start reading the headers of the bpobjs referenced by the deadlist
+ * object dlobj, so that opening them one after another doesn't wait for
+ * each read in turn.  The empty bpobj is shared and already cached.
+ */
+static void
+dsl_deadlist_prefetch_bpobjs(objset_t *os, uint64_t dlobj)
+{
+	uint64_t empty_bpobj = dmu_objset_pool(os)->dp_empty_bpobj;
+	zap_cursor_t zc;
+	zap_attribute_t za;
+
+	for (zap_cursor_init(&zc, os, dlobj);
+	    zap_cursor_retrieve(&zc, &za) == 0;
+	    zap_cursor_advance(&zc)) {
+		if (za.za_first_integer != empty_bpobj) {
+			dmu_prefetch(os, za.za_first_integer, 0, 0, 0,
+			    ZIO_PRIORITY_ASYNC_READ);
+		}
+	}
+	zap_cursor_fini(&zc);
+}
+
+static void
+dsl_deadlist_unload_cache(dsl_deadlist_t *dl)
+{
+	dsl_deadlist_cache_entry_t *dce;
+	void *cookie = NULL;
+
+	ASSERT(MUTEX_HELD(&dl->dl_lock));
+
+	if (!dl->dl_havecache)
+		return;
+
+	while ((dce = avl_destroy_nodes(&dl->dl_cache, &cookie)) != NULL)
+		kmem_free(dce, sizeof (*dce));
+	avl_destroy(&dl->dl_cache);
+	dl->dl_havecache = B_FALSE;
+}
+
 static void
 dsl_deadlist_load_tree(dsl_deadlist_t *dl)
 {
+	dsl_deadlist_entry_t *dle;
 	zap_cursor_t zc;
 	zap_attribute_t za;
 
@@ -77,14 +132,14 @@ dsl_deadlist_load_tree(dsl_deadlist_t *dl)
 	if (dl->dl_havetree)
 		return;
 
+	dsl_deadlist_prefetch_bpobjs(dl->dl_os, dl->dl_object);
+
 	avl_create(&dl->dl_tree, dsl_deadlist_compare,
 	    sizeof (dsl_deadlist_entry_t),
 	    offsetof(dsl_deadlist_entry_t, dle_node));
 	for (zap_cursor_init(&zc, dl->dl_os, dl->dl_object);
 	    zap_cursor_retrieve(&zc, &za) == 0;
 	    zap_cursor_advance(&zc)) {
-		dsl_deadlist_entry_t *dle;
-
 		dle = kmem_alloc(sizeof (*dle), KM_SLEEP);
 		dle->dle_mintxg = zfs_strtonum(za.za_name, NULL);
 		VERIFY3U(0, ==, bpobj_open(&dle->dle_bpobj, dl->dl_os,
@@ -93,6 +148,54 @@ dsl_deadlist_load_tree(dsl_deadlist_t *dl)
 	}
 	zap_cursor_fini(&zc);
 	dl->dl_havetree = B_TRUE;
+
+	/* The tree is authoritative from now on. */
+	dsl_deadlist_unload_cache(dl);
+}
+
+/*
+ * Load the space of each key, without keeping the bpobjs open.  Keys
+ * still pointing at the empty bpobj, which is what most keys of a dataset
+ * with frequent snapshots look like, need no I/O at all.
+ */
+static void
+dsl_deadlist_load_cache(dsl_deadlist_t *dl)
+{
+	uint64_t empty_bpobj = dmu_objset_pool(dl->dl_os)->dp_empty_bpobj;
+	dsl_deadlist_cache_entry_t *dce;
+	zap_cursor_t zc;
+	zap_attribute_t za;
+
+	ASSERT(MUTEX_HELD(&dl->dl_lock));
+
+	ASSERT(!dl->dl_oldfmt);
+	ASSERT(!dl->dl_havetree);
+	if (dl->dl_havecache)
+		return;
+
+	dsl_deadlist_prefetch_bpobjs(dl->dl_os, dl->dl_object);
+
+	avl_create(&dl->dl_cache, dsl_deadlist_cache_compare,
+	    sizeof (dsl_deadlist_cache_entry_t),
+	    offsetof(dsl_deadlist_cache_entry_t, dce_node));
+	for (zap_cursor_init(&zc, dl->dl_os, dl->dl_object);
+	    zap_cursor_retrieve(&zc, &za) == 0;
+	    zap_cursor_advance(&zc)) {
+		dce = kmem_zalloc(sizeof (*dce), KM_SLEEP);
+		dce->dce_mintxg = zfs_strtonum(za.za_name, NULL);
+		if (za.za_first_integer != empty_bpobj) {
+			bpobj_t bpo;
+
+			VERIFY0(bpobj_open(&bpo, dl->dl_os,
+			    za.za_first_integer));
+			VERIFY0(bpobj_space(&bpo, &dce->dce_bytes,
+			    &dce->dce_comp, &dce->dce_uncomp));
+			bpobj_close(&bpo);
+		}
+		avl_add(&dl->dl_cache, dce);
+	}
+	zap_cursor_fini(&zc);
+	dl->dl_havecache = B_TRUE;
 }
 
 void
@@ -118,6 +221,23 @@ dsl_deadlist_open(dsl_deadlist_t *dl, objset_t *os, uint64_t object)
 	dl->dl_oldfmt = B_FALSE;
 	dl->dl_phys = dl->dl_dbuf->db_data;
 	dl->dl_havetree = B_FALSE;
+	dl->dl_havecache = B_FALSE;
+}
+
+/*
+ * Start reading the bpobjs of this deadlist from open context, ahead of a
+ * sync task (e.g. a snapshot destroy) that is going to open all of them.
+ */
+void
+dsl_deadlist_prefetch(dsl_deadlist_t *dl)
+{
+	if (dl->dl_oldfmt)
+		return;
+
+	mutex_enter(&dl->dl_lock);
+	if (!dl->dl_havetree)
+		dsl_deadlist_prefetch_bpobjs(dl->dl_os, dl->dl_object);
+	mutex_exit(&dl->dl_lock);
 }
 
 boolean_t
@@ -150,6 +270,9 @@ dsl_deadlist_close(dsl_deadlist_t *dl)
 		}
 		avl_destroy(&dl->dl_tree);
 	}
+	mutex_enter(&dl->dl_lock);
+	dsl_deadlist_unload_cache(dl);
+	mutex_exit(&dl->dl_lock);
 	dmu_buf_rele(dl->dl_dbuf, dl);
 	mutex_destroy(&dl->dl_lock);
 	dl->dl_dbuf = NULL;
@@ -415,6 +538,31 @@ dsl_deadlist_space_range(dsl_deadlist_t *dl, uint64_t mintxg, uint64_t maxtxg,
 	*usedp = *compp = *uncompp = 0;
 
 	mutex_enter(&dl->dl_lock);
+	/*
+	 * In syncing context the caller is usually about to modify the
+	 * deadlist, which needs the tree anyway.
+	 */
+	if (!dl->dl_havetree &&
+	    !dsl_pool_sync_context(dmu_objset_pool(dl->dl_os))) {
+		dsl_deadlist_cache_entry_t *dce;
+		dsl_deadlist_cache_entry_t dce_tofind;
+
+		dsl_deadlist_load_cache(dl);
+		dce_tofind.dce_mintxg = mintxg;
+		dce = avl_find(&dl->dl_cache, &dce_tofind, &where);
+		ASSERT(dce != NULL ||
+		    avl_nearest(&dl->dl_cache, where, AVL_AFTER) == NULL);
+
+		for (; dce && dce->dce_mintxg < maxtxg;
+		    dce = AVL_NEXT(&dl->dl_cache, dce)) {
+			*usedp += dce->dce_bytes;
+			*compp += dce->dce_comp;
+			*uncompp += dce->dce_uncomp;
+		}
+		mutex_exit(&dl->dl_lock);
+		return;
+	}
+
 	dsl_deadlist_load_tree(dl);
 	dle_tofind.dle_mintxg = mintxg;
 	dle = avl_find(&dl->dl_tree, &dle_tofind, &where);
@@ -500,6 +648,8 @@ dsl_deadlist_merge(dsl_deadlist_t *dl, uint64_t obj, dmu_tx_t *tx)
 		return;
 	}
 
+	dsl_deadlist_prefetch_bpobjs(dl->dl_os, obj);
+
 	mutex_enter(&dl->dl_lock);
 	for (zap_cursor_init(&zc, dl->dl_os, obj);
 	    zap_cursor_retrieve(&zc, &za) == 0;
@@ -539,6 +689,22 @@ dsl_deadlist_move_bpobj(dsl_deadlist_t *dl, bpobj_t *bpo, uint64_t mintxg,
 	dle = avl_find(&dl->dl_tree, &dle_tofind, &where);
 	if (dle == NULL)
 		dle = avl_nearest(&dl->dl_tree, where, AVL_AFTER);
+
+	/*
+	 * bpobj_enqueue_subobj() looks at the subobj list of each bpobj it
+	 * is handed; get those reads going before we walk the entries.
+	 */
+	for (dsl_deadlist_entry_t *dle_pf = dle; dle_pf != NULL;
+	    dle_pf = AVL_NEXT(&dl->dl_tree, dle_pf)) {
+		bpobj_t *bpo_pf = &dle_pf->dle_bpobj;
+
+		if (bpo_pf->bpo_havesubobj &&
+		    bpo_pf->bpo_phys->bpo_subobjs != 0) {
+			dmu_prefetch(dl->dl_os, bpo_pf->bpo_phys->bpo_subobjs,
+			    0, 0, 0, ZIO_PRIORITY_ASYNC_READ);
+		}
+	}
+
 	while (dle) {
 		uint64_t used, comp, uncomp;
 		dsl_deadlist_entry_t *dle_next;
@@ -565,3 +731,146 @@ dsl_deadlist_move_bpobj(dsl_deadlist_t *dl, bpobj_t *bpo, uint64_t mintxg,
 	}
 	mutex_exit(&dl->dl_lock);
 }
+
+/*
+ * Accessors for callers that walk the sublists themselves (livelists, see
+ * dsl_livelist.c).  The returned entries remain valid until the next change
+ * to the deadlist's keys, so the caller must either be in syncing context
+ * or be the only user of the deadlist.
+ */
+dsl_deadlist_entry_t *
+dsl_deadlist_first(dsl_deadlist_t *dl)
+{
+	dsl_deadlist_entry_t *dle;
+
+	ASSERT(!dl->dl_oldfmt);
+
+	mutex_enter(&dl->dl_lock);
+	dsl_deadlist_load_tree(dl);
+	dle = avl_first(&dl->dl_tree);
+	mutex_exit(&dl->dl_lock);
+	return (dle);
+}
+
+dsl_deadlist_entry_t *
+dsl_deadlist_last(dsl_deadlist_t *dl)
+{
+	dsl_deadlist_entry_t *dle;
+
+	ASSERT(!dl->dl_oldfmt);
+
+	mutex_enter(&dl->dl_lock);
+	dsl_deadlist_load_tree(dl);
+	dle = avl_last(&dl->dl_tree);
+	mutex_exit(&dl->dl_lock);
+	return (dle);
+}
+
+dsl_deadlist_entry_t *
+dsl_deadlist_next(dsl_deadlist_t *dl, dsl_deadlist_entry_t *dle)
+{
+	dsl_deadlist_entry_t *next;
+
+	mutex_enter(&dl->dl_lock);
+	next = AVL_NEXT(&dl->dl_tree, dle);
+	mutex_exit(&dl->dl_lock);
+	return (next);
+}
+
+dsl_deadlist_entry_t *
+dsl_deadlist_find(dsl_deadlist_t *dl, uint64_t mintxg)
+{
+	dsl_deadlist_entry_t dle_tofind;
+	dsl_deadlist_entry_t *dle;
+
+	ASSERT(!dl->dl_oldfmt);
+
+	mutex_enter(&dl->dl_lock);
+	dsl_deadlist_load_tree(dl);
+	dle_tofind.dle_mintxg = mintxg;
+	dle = avl_find(&dl->dl_tree, &dle_tofind, NULL);
+	mutex_exit(&dl->dl_lock);
+	return (dle);
+}
+
+static void
+dsl_deadlist_entry_release(dsl_deadlist_t *dl, dsl_deadlist_entry_t *dle,
+    dmu_tx_t *tx)
+{
+	uint64_t obj = dle->dle_bpobj.bpo_object;
+	uint64_t used, comp, uncomp;
+
+	ASSERT(MUTEX_HELD(&dl->dl_lock));
+
+	VERIFY0(bpobj_space(&dle->dle_bpobj, &used, &comp, &uncomp));
+	dmu_buf_will_dirty(dl->dl_dbuf, tx);
+	dl->dl_phys->dl_used -= MIN(used, dl->dl_phys->dl_used);
+	dl->dl_phys->dl_comp -= MIN(comp, dl->dl_phys->dl_comp);
+	dl->dl_phys->dl_uncomp -= MIN(uncomp, dl->dl_phys->dl_uncomp);
+
+	bpobj_close(&dle->dle_bpobj);
+	if (obj == dmu_objset_pool(dl->dl_os)->dp_empty_bpobj)
+		bpobj_decr_empty(dl->dl_os, tx);
+	else
+		bpobj_free(dl->dl_os, obj, tx);
+}
+
+/*
+ * Remove this key and free its entries, rather than merging them into the
+ * previous key as dsl_deadlist_remove_key() does.
+ */
+void
+dsl_deadlist_discard_key(dsl_deadlist_t *dl, uint64_t mintxg, dmu_tx_t *tx)
+{
+	dsl_deadlist_entry_t dle_tofind;
+	dsl_deadlist_entry_t *dle;
+
+	ASSERT(!dl->dl_oldfmt);
+
+	mutex_enter(&dl->dl_lock);
+	dsl_deadlist_load_tree(dl);
+
+	dle_tofind.dle_mintxg = mintxg;
+	dle = avl_find(&dl->dl_tree, &dle_tofind, NULL);
+	VERIFY3P(dle, !=, NULL);
+
+	dsl_deadlist_entry_release(dl, dle, tx);
+	avl_remove(&dl->dl_tree, dle);
+	kmem_free(dle, sizeof (*dle));
+
+	VERIFY0(zap_remove_int(dl->dl_os, dl->dl_object, mintxg, tx));
+	mutex_exit(&dl->dl_lock);
+}
+
+/*
+ * Replace the entries of this key with the bpobj 'obj', freeing the old
+ * bpobj.  The deadlist takes ownership of 'obj'.
+ */
+void
+dsl_deadlist_replace_key(dsl_deadlist_t *dl, uint64_t mintxg, uint64_t obj,
+    dmu_tx_t *tx)
+{
+	dsl_deadlist_entry_t dle_tofind;
+	dsl_deadlist_entry_t *dle;
+	uint64_t used, comp, uncomp;
+
+	ASSERT(!dl->dl_oldfmt);
+
+	mutex_enter(&dl->dl_lock);
+	dsl_deadlist_load_tree(dl);
+
+	dle_tofind.dle_mintxg = mintxg;
+	dle = avl_find(&dl->dl_tree, &dle_tofind, NULL);
+	VERIFY3P(dle, !=, NULL);
+
+	dsl_deadlist_entry_release(dl, dle, tx);
+	VERIFY0(bpobj_open(&dle->dle_bpobj, dl->dl_os, obj));
+	VERIFY0(bpobj_space(&dle->dle_bpobj, &used, &comp, &uncomp));
+	dl->dl_phys->dl_used += used;
+	dl->dl_phys->dl_comp += comp;
+	dl->dl_phys->dl_uncomp += uncomp;
+
+	VERIFY0(zap_update_int_key(dl->dl_os, dl->dl_object,
+	    mintxg, obj, tx));
+	mutex_exit(&dl->dl_lock);
+}
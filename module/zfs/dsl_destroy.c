@@ -34,6 +34,7 @@
 #include <sys/dmu_tx.h>
 #include <sys/dsl_pool.h>
 #include <sys/dsl_dir.h>
+#include <sys/dsl_livelist.h>
 #include <sys/dmu_traverse.h>
 #include <sys/dsl_scan.h>
 #include <sys/dmu_objset.h>
@@ -43,7 +44,6 @@
 #include <sys/dsl_deleg.h>
 #include <sys/dmu_impl.h>
 #include <sys/zvol.h>
-#include <sys/zcp.h>
 
 int
 dsl_destroy_snapshot_check_impl(dsl_dataset_t *ds, boolean_t defer)
@@ -516,6 +516,152 @@ dsl_destroy_snapshot_sync(void *arg, dmu_tx_t *tx)
 	dsl_dataset_rele(ds, FTAG);
 }
 
+/*
+ * Destroying a snapshot opens every bpobj of its deadlist and of the next
+ * snapshot's deadlist, one after another, in syncing context.  Start those
+ * reads now, so the sync task finds them in the ARC instead of stalling
+ * the txg on each one.  Errors are ignored; the real destroy reports them.
+ */
+static void
+dsl_destroy_snapshots_prefetch(nvlist_t *snaps)
+{
+	for (nvpair_t *pair = nvlist_next_nvpair(snaps, NULL);
+	    pair != NULL; pair = nvlist_next_nvpair(snaps, pair)) {
+		dsl_pool_t *dp;
+		dsl_dataset_t *ds, *ds_next;
+
+		if (dsl_pool_hold(nvpair_name(pair), FTAG, &dp) != 0)
+			continue;
+		if (dsl_dataset_hold(dp, nvpair_name(pair), FTAG, &ds) != 0) {
+			dsl_pool_rele(dp, FTAG);
+			continue;
+		}
+		if (ds->ds_is_snapshot) {
+			dsl_deadlist_prefetch(&ds->ds_deadlist);
+			if (dsl_dataset_hold_obj(dp,
+			    dsl_dataset_phys(ds)->ds_next_snap_obj, FTAG,
+			    &ds_next) == 0) {
+				dsl_deadlist_prefetch(&ds_next->ds_deadlist);
+				dsl_dataset_rele(ds_next, FTAG);
+			}
+		}
+		dsl_dataset_rele(ds, FTAG);
+		dsl_pool_rele(dp, FTAG);
+	}
+}
+
+/*
+ * A snapshot of a batch destroy.  Entries are ordered by dsl_dir and then
+ * newest first, so each run of snapshots in a dataset is destroyed from
+ * the end.  Every destroy in the run then merges into the same surviving
+ * successor, whose deadlist tree is loaded once for the whole run rather
+ * than once for each snapshot that is about to be destroyed anyway.
+ */
+typedef struct dsl_destroy_snapshots_ent {
+	avl_node_t	dsde_node;
+	uint64_t	dsde_dirobj;
+	uint64_t	dsde_txg;
+	uint64_t	dsde_dsobj;
+	const char	*dsde_name;
+} dsl_destroy_snapshots_ent_t;
+
+typedef struct dsl_destroy_snapshots_arg {
+	nvlist_t	*dsda_snaps;
+	boolean_t	dsda_defer;
+	nvlist_t	*dsda_errlist;
+	avl_tree_t	dsda_tree;
+} dsl_destroy_snapshots_arg_t;
+
+static int
+dsl_destroy_snapshots_compare(const void *arg1, const void *arg2)
+{
+	const dsl_destroy_snapshots_ent_t *dsde1 = arg1;
+	const dsl_destroy_snapshots_ent_t *dsde2 = arg2;
+
+	int cmp = AVL_CMP(dsde1->dsde_dirobj, dsde2->dsde_dirobj);
+	if (cmp != 0)
+		return (cmp);
+
+	return (AVL_CMP(dsde2->dsde_txg, dsde1->dsde_txg));
+}
+
+static int
+dsl_destroy_snapshots_check(void *arg, dmu_tx_t *tx)
+{
+	dsl_destroy_snapshots_arg_t *dsda = arg;
+	dsl_pool_t *dp = dmu_tx_pool(tx);
+	int rv = 0;
+
+	/*
+	 * Everything is checked once, in syncing context, where the result
+	 * is also used to order the destroys.
+	 */
+	if (!dmu_tx_is_syncing(tx))
+		return (0);
+
+	for (nvpair_t *pair = nvlist_next_nvpair(dsda->dsda_snaps, NULL);
+	    pair != NULL; pair = nvlist_next_nvpair(dsda->dsda_snaps, pair)) {
+		dsl_destroy_snapshots_ent_t *dsde, search;
+		dsl_dataset_t *ds;
+		avl_index_t where;
+
+		int error = dsl_dataset_hold(dp, nvpair_name(pair), FTAG, &ds);
+
+		/*
+		 * If the snapshot does not exist, silently ignore it
+		 * (it's "already destroyed").
+		 */
+		if (error == ENOENT)
+			continue;
+
+		if (error == 0) {
+			error = dsl_destroy_snapshot_check_impl(ds,
+			    dsda->dsda_defer);
+			if (error != 0)
+				dsl_dataset_rele(ds, FTAG);
+		}
+		if (error != 0) {
+			fnvlist_add_int32(dsda->dsda_errlist,
+			    nvpair_name(pair), error);
+			if (rv == 0)
+				rv = error;
+			continue;
+		}
+
+		/* The same snapshot may be named more than once. */
+		search.dsde_dirobj = ds->ds_dir->dd_object;
+		search.dsde_txg = dsl_dataset_phys(ds)->ds_creation_txg;
+		if (avl_find(&dsda->dsda_tree, &search, &where) == NULL) {
+			dsde = kmem_alloc(sizeof (*dsde), KM_SLEEP);
+			dsde->dsde_dirobj = search.dsde_dirobj;
+			dsde->dsde_txg = search.dsde_txg;
+			dsde->dsde_dsobj = ds->ds_object;
+			dsde->dsde_name = nvpair_name(pair);
+			avl_insert(&dsda->dsda_tree, dsde, where);
+		}
+		dsl_dataset_rele(ds, FTAG);
+	}
+
+	return (rv);
+}
+
+static void
+dsl_destroy_snapshots_sync(void *arg, dmu_tx_t *tx)
+{
+	dsl_destroy_snapshots_arg_t *dsda = arg;
+	dsl_pool_t *dp = dmu_tx_pool(tx);
+
+	for (dsl_destroy_snapshots_ent_t *dsde = avl_first(&dsda->dsda_tree);
+	    dsde != NULL; dsde = AVL_NEXT(&dsda->dsda_tree, dsde)) {
+		dsl_dataset_t *ds;
+
+		VERIFY0(dsl_dataset_hold_obj(dp, dsde->dsde_dsobj, FTAG, &ds));
+		dsl_destroy_snapshot_sync_impl(ds, dsda->dsda_defer, tx);
+		zvol_remove_minors(dp->dp_spa, dsde->dsde_name, B_TRUE);
+		dsl_dataset_rele(ds, FTAG);
+	}
+}
+
 /*
  * The semantics of this function are described in the comment above
  * lzc_destroy_snaps().  To summarize:
@@ -528,92 +674,41 @@ dsl_destroy_snapshot_sync(void *arg, dmu_tx_t *tx)
  * On success, all snaps will be destroyed and this will return 0.
  * On failure, no snaps will be destroyed, the errlist will be filled in,
  * and this will return an errno.
+ *
+ * The whole batch is checked and destroyed in a single sync task, so the
+ * cost of a large batch grows with the number of snapshots rather than
+ * with the number of txgs it takes.
  */
 int
 dsl_destroy_snapshots_nvl(nvlist_t *snaps, boolean_t defer,
     nvlist_t *errlist)
 {
+	dsl_destroy_snapshots_arg_t dsda;
+	dsl_destroy_snapshots_ent_t *dsde;
+	void *cookie = NULL;
+	int error;
+
 	if (nvlist_next_nvpair(snaps, NULL) == NULL)
 		return (0);
 
-	nvlist_t *arg = fnvlist_alloc();
-	nvlist_t *snaps_normalized = fnvlist_alloc();
-	/*
-	 * lzc_destroy_snaps() is documented to take an nvlist whose
-	 * values "don't matter".  We need to convert that nvlist to one
-	 * that we know can be converted to LUA.
-	 */
-	for (nvpair_t *pair = nvlist_next_nvpair(snaps, NULL);
-	    pair != NULL; pair = nvlist_next_nvpair(snaps, pair)) {
-		fnvlist_add_boolean_value(snaps_normalized,
-		    nvpair_name(pair), B_TRUE);
-	}
-	fnvlist_add_nvlist(arg, "snaps", snaps_normalized);
-	fnvlist_free(snaps_normalized);
-	fnvlist_add_boolean_value(arg, "defer", defer);
-
-	nvlist_t *wrapper = fnvlist_alloc();
-	fnvlist_add_nvlist(wrapper, ZCP_ARG_ARGLIST, arg);
-	fnvlist_free(arg);
-
-	const char *program =
-	    "arg = ...\n"
-	    "snaps = arg['snaps']\n"
-	    "defer = arg['defer']\n"
-	    "errors = { }\n"
-	    "has_errors = false\n"
-	    "for snap, v in pairs(snaps) do\n"
-	    "    errno = zfs.check.destroy{snap, defer=defer}\n"
-	    "    zfs.debug('snap: ' .. snap .. ' errno: ' .. errno)\n"
-	    "    if errno == ENOENT then\n"
-	    "        snaps[snap] = nil\n"
-	    "    elseif errno ~= 0 then\n"
-	    "        errors[snap] = errno\n"
-	    "        has_errors = true\n"
-	    "    end\n"
-	    "end\n"
-	    "if has_errors then\n"
-	    "    return errors\n"
-	    "end\n"
-	    "for snap, v in pairs(snaps) do\n"
-	    "    errno = zfs.sync.destroy{snap, defer=defer}\n"
-	    "    assert(errno == 0)\n"
-	    "end\n"
-	    "return { }\n";
-
-	nvlist_t *result = fnvlist_alloc();
-	int error = zcp_eval(nvpair_name(nvlist_next_nvpair(snaps, NULL)),
-	    program,
-	    B_TRUE,
-	    0,
-	    zfs_lua_max_memlimit,
-	    fnvlist_lookup_nvpair(wrapper, ZCP_ARG_ARGLIST), result);
-	if (error != 0) {
-		char *errorstr = NULL;
-		(void) nvlist_lookup_string(result, ZCP_RET_ERROR, &errorstr);
-		if (errorstr != NULL) {
-			zfs_dbgmsg(errorstr);
-		}
-		return (error);
-	}
-	fnvlist_free(wrapper);
+	dsl_destroy_snapshots_prefetch(snaps);
 
-	/*
-	 * lzc_destroy_snaps() is documented to fill the errlist with
-	 * int32 values, so we need to covert the int64 values that are
-	 * returned from LUA.
-	 */
-	int rv = 0;
-	nvlist_t *errlist_raw = fnvlist_lookup_nvlist(result, ZCP_RET_RETURN);
-	for (nvpair_t *pair = nvlist_next_nvpair(errlist_raw, NULL);
-	    pair != NULL; pair = nvlist_next_nvpair(errlist_raw, pair)) {
-		int32_t val = (int32_t)fnvpair_value_int64(pair);
-		if (rv == 0)
-			rv = val;
-		fnvlist_add_int32(errlist, nvpair_name(pair), val);
-	}
-	fnvlist_free(result);
-	return (rv);
+	dsda.dsda_snaps = snaps;
+	dsda.dsda_defer = defer;
+	dsda.dsda_errlist = errlist;
+	avl_create(&dsda.dsda_tree, dsl_destroy_snapshots_compare,
+	    sizeof (dsl_destroy_snapshots_ent_t),
+	    offsetof(dsl_destroy_snapshots_ent_t, dsde_node));
+
+	error = dsl_sync_task(nvpair_name(nvlist_next_nvpair(snaps, NULL)),
+	    dsl_destroy_snapshots_check, dsl_destroy_snapshots_sync, &dsda,
+	    0, ZFS_SPACE_CHECK_DESTROY);
+
+	while ((dsde = avl_destroy_nodes(&dsda.dsda_tree, &cookie)) != NULL)
+		kmem_free(dsde, sizeof (*dsde));
+	avl_destroy(&dsda.dsda_tree);
+
+	return (error);
 }
 
 int
@@ -875,7 +970,27 @@ dsl_destroy_head_sync_impl(dsl_dataset_t *ds, dmu_tx_t *tx)
 	objset_t *os;
 	VERIFY0(dmu_objset_from_ds(ds, &os));
 
-	if (!spa_feature_is_enabled(dp->dp_spa, SPA_FEATURE_ASYNC_DESTROY)) {
+	if (dsl_livelist_exists(ds->ds_dir)) {
+		/*
+		 * Every block this clone still references is on its
+		 * livelist, so hand that to the livelist delete zthr
+		 * instead of traversing the clone.
+		 */
+		uint64_t used, comp, uncomp;
+
+		zil_destroy_sync(dmu_objset_zil(os), tx);
+		dsl_livelist_destroy_sync(ds->ds_dir, tx);
+
+		used = dsl_dir_phys(ds->ds_dir)->dd_used_bytes;
+		comp = dsl_dir_phys(ds->ds_dir)->dd_compressed_bytes;
+		uncomp = dsl_dir_phys(ds->ds_dir)->dd_uncompressed_bytes;
+
+		dsl_dir_diduse_space(ds->ds_dir, DD_USED_HEAD,
+		    -used, -comp, -uncomp, tx);
+		dsl_dir_diduse_space(dp->dp_free_dir, DD_USED_HEAD,
+		    used, comp, uncomp, tx);
+	} else if (!spa_feature_is_enabled(dp->dp_spa,
+	    SPA_FEATURE_ASYNC_DESTROY)) {
 		old_synchronous_dataset_destroy(ds, tx);
 	} else {
 		/*
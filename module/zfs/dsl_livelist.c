@@ -0,0 +1,876 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#include <sys/dsl_livelist.h>
+#include <sys/dsl_dataset.h>
+#include <sys/dsl_dir.h>
+#include <sys/dsl_pool.h>
+#include <sys/dsl_synctask.h>
+#include <sys/dmu_tx.h>
+#include <sys/spa_impl.h>
+#include <sys/zap.h>
+#include <sys/zfeature.h>
+
+/*
+ * Livelists
+ *
+ * Destroying a clone through the bptree has to visit every block the clone
+ * wrote since it was created, which means reading all of the indirect blocks
+ * above them.  After sparse random writes that is most of the tree, even
+ * though only the written blocks are freed.
+ *
+ * A livelist avoids that traversal.  While a clone has no snapshots it
+ * records every block it gives birth to in an "alloc" deadlist and every
+ * block born after the origin that it frees in a "free" deadlist.  Both
+ * deadlists always have the same keys and a block is filed by its birth
+ * txg, so a block and its free end up in the same sublist.  The blocks the
+ * clone still references are then, per sublist, the alloc entries with no
+ * matching free entry.  Destroying the clone hands the two deadlists to the
+ * pool (DMU_POOL_DELETED_CLONES) and the livelist delete zthr frees those
+ * blocks, one sublist per txg.
+ *
+ * A new sublist is started once the newest one holds
+ * zfs_livelist_max_entries allocations; this bounds the memory needed to
+ * process one.  When the frees in a sublist reach
+ * zfs_livelist_condense_free_pct percent of its allocations, the livelist
+ * condense zthr rewrites it with just the surviving blocks, so that a clone
+ * which keeps overwriting its data doesn't grow its livelist forever.
+ *
+ * The livelist is dropped when the clone is snapshotted, promoted or clone
+ * swapped (rollback, receive), and when device removal remaps its blocks.
+ * Such clones are destroyed through the bptree as before.
+ */
+
+/*
+ * Number of allocations in the newest sublist before a new one is started.
+ */
+uint64_t zfs_livelist_max_entries = 500000;
+
+/*
+ * Condense a sublist once its frees reach this percentage of its
+ * allocations.
+ */
+int zfs_livelist_condense_free_pct = 50;
+
+/*
+ * Don't bother condensing sublists with fewer frees than this.
+ */
+#define	LIVELIST_CONDENSE_MIN_FREES	1024
+
+/*
+ * How often the open-context passes check whether the zthr was cancelled.
+ */
+#define	LIVELIST_CANCEL_CHECK_INTERVAL	4096
+
+typedef struct livelist_entry {
+	avl_node_t	le_node;
+	dva_t		le_dva;
+	uint64_t	le_birth;
+	uint64_t	le_count;
+} livelist_entry_t;
+
+typedef struct livelist_sublist {
+	avl_tree_t	ls_frees;
+	bpobj_itor_t	*ls_func;
+	void		*ls_arg;
+	zthr_t		*ls_zthr;
+	uint64_t	ls_visited;
+} livelist_sublist_t;
+
+typedef struct livelist_condense_arg {
+	uint64_t	lca_ddobj;
+	uint64_t	lca_mintxg;
+	uint64_t	lca_aobj;
+	uint64_t	lca_nalloc;
+	uint64_t	lca_fobj;
+	uint64_t	lca_nfree;
+	bplist_t	lca_survivors;
+} livelist_condense_arg_t;
+
+typedef struct livelist_delete_arg {
+	uint64_t	lda_aobj;
+	uint64_t	lda_fobj;
+	uint64_t	lda_mintxg;
+	dsl_deadlist_t	lda_ll;
+	dsl_deadlist_t	lda_llf;
+	bplist_t	lda_to_free;
+} livelist_delete_arg_t;
+
+static int
+livelist_compare(const void *arg1, const void *arg2)
+{
+	const livelist_entry_t *le1 = arg1;
+	const livelist_entry_t *le2 = arg2;
+	int cmp;
+
+	cmp = AVL_CMP(DVA_GET_VDEV(&le1->le_dva), DVA_GET_VDEV(&le2->le_dva));
+	if (cmp != 0)
+		return (cmp);
+	cmp = AVL_CMP(DVA_GET_OFFSET(&le1->le_dva),
+	    DVA_GET_OFFSET(&le2->le_dva));
+	if (cmp != 0)
+		return (cmp);
+	return (AVL_CMP(le1->le_birth, le2->le_birth));
+}
+
+static uint64_t
+livelist_entries(bpobj_t *bpo)
+{
+	return (bpo->bpo_phys->bpo_num_blkptrs);
+}
+
+static int
+livelist_check_cancel(livelist_sublist_t *ls)
+{
+	if (ls->ls_zthr != NULL &&
+	    ++ls->ls_visited % LIVELIST_CANCEL_CHECK_INTERVAL == 0 &&
+	    zthr_iscancelled(ls->ls_zthr))
+		return (SET_ERROR(EINTR));
+	return (0);
+}
+
+/* ARGSUSED */
+static int
+livelist_free_entry_cb(void *arg, const blkptr_t *bp, dmu_tx_t *tx)
+{
+	livelist_sublist_t *ls = arg;
+	livelist_entry_t search, *le;
+	avl_index_t where;
+
+	search.le_dva = bp->blk_dva[0];
+	search.le_birth = bp->blk_birth;
+	le = avl_find(&ls->ls_frees, &search, &where);
+	if (le == NULL) {
+		le = kmem_alloc(sizeof (*le), KM_SLEEP);
+		le->le_dva = bp->blk_dva[0];
+		le->le_birth = bp->blk_birth;
+		le->le_count = 0;
+		avl_insert(&ls->ls_frees, le, where);
+	}
+	le->le_count++;
+
+	return (livelist_check_cancel(ls));
+}
+
+static int
+livelist_alloc_entry_cb(void *arg, const blkptr_t *bp, dmu_tx_t *tx)
+{
+	livelist_sublist_t *ls = arg;
+	livelist_entry_t search, *le;
+	int err;
+
+	search.le_dva = bp->blk_dva[0];
+	search.le_birth = bp->blk_birth;
+	le = avl_find(&ls->ls_frees, &search, NULL);
+	if (le != NULL && le->le_count > 0) {
+		le->le_count--;
+	} else {
+		err = ls->ls_func(ls->ls_arg, bp, tx);
+		if (err != 0)
+			return (err);
+	}
+
+	return (livelist_check_cancel(ls));
+}
+
+/*
+ * Call func on every block of the sublist made up of the first nalloc
+ * entries of 'abpo' and the first nfree entries of 'fbpo' that has not
+ * been freed.
+ */
+static int
+livelist_sublist_iterate(bpobj_t *abpo, uint64_t nalloc, bpobj_t *fbpo,
+    uint64_t nfree, bpobj_itor_t func, void *arg, zthr_t *zthr)
+{
+	livelist_sublist_t ls;
+	livelist_entry_t *le;
+	void *cookie = NULL;
+	int err;
+
+	avl_create(&ls.ls_frees, livelist_compare, sizeof (livelist_entry_t),
+	    offsetof(livelist_entry_t, le_node));
+	ls.ls_func = func;
+	ls.ls_arg = arg;
+	ls.ls_zthr = zthr;
+	ls.ls_visited = 0;
+
+	err = bpobj_iterate_range(fbpo, 0, nfree, livelist_free_entry_cb,
+	    &ls, NULL);
+	if (err == 0) {
+		err = bpobj_iterate_range(abpo, 0, nalloc,
+		    livelist_alloc_entry_cb, &ls, NULL);
+	}
+
+	while ((le = avl_destroy_nodes(&ls.ls_frees, &cookie)) != NULL)
+		kmem_free(le, sizeof (*le));
+	avl_destroy(&ls.ls_frees);
+
+	return (err);
+}
+
+/*
+ * Call func on every block referenced by the livelist (ll, llf).
+ */
+int
+dsl_livelist_iterate(dsl_deadlist_t *ll, dsl_deadlist_t *llf,
+    bpobj_itor_t func, void *arg)
+{
+	dsl_deadlist_entry_t *a, *f;
+	int err = 0;
+
+	for (a = dsl_deadlist_first(ll); a != NULL && err == 0;
+	    a = dsl_deadlist_next(ll, a)) {
+		f = dsl_deadlist_find(llf, a->dle_mintxg);
+		if (f == NULL)
+			return (SET_ERROR(ECKSUM));
+		err = livelist_sublist_iterate(&a->dle_bpobj,
+		    livelist_entries(&a->dle_bpobj), &f->dle_bpobj,
+		    livelist_entries(&f->dle_bpobj), func, arg, NULL);
+	}
+	return (err);
+}
+
+/*
+ * Call func on every block still waiting to be freed by the livelist
+ * delete zthr.
+ */
+int
+dsl_livelist_iterate_deleted(spa_t *spa, bpobj_itor_t func, void *arg)
+{
+	dsl_pool_t *dp = spa_get_dsl(spa);
+	objset_t *mos = dp->dp_meta_objset;
+	zap_cursor_t zc;
+	zap_attribute_t za;
+	int err = 0;
+
+	if (dp->dp_livelists_obj == 0)
+		return (0);
+
+	for (zap_cursor_init(&zc, mos, dp->dp_livelists_obj);
+	    err == 0 && zap_cursor_retrieve(&zc, &za) == 0;
+	    zap_cursor_advance(&zc)) {
+		dsl_deadlist_t ll = { 0 };
+		dsl_deadlist_t llf = { 0 };
+
+		dsl_deadlist_open(&ll, mos, zfs_strtonum(za.za_name, NULL));
+		dsl_deadlist_open(&llf, mos, za.za_first_integer);
+		err = dsl_livelist_iterate(&ll, &llf, func, arg);
+		dsl_deadlist_close(&llf);
+		dsl_deadlist_close(&ll);
+	}
+	zap_cursor_fini(&zc);
+
+	return (err);
+}
+
+boolean_t
+dsl_livelist_delete_pending(spa_t *spa)
+{
+	return (spa_get_dsl(spa)->dp_livelists_obj != 0);
+}
+
+/*
+ * Per-clone maintenance.
+ */
+
+void
+dsl_livelist_open(dsl_dir_t *dd)
+{
+	objset_t *mos = dd->dd_pool->dp_meta_objset;
+	uint64_t obj[2];
+
+	bplist_create(&dd->dd_pending_allocs);
+	bplist_create(&dd->dd_pending_frees);
+
+	if (!dsl_dir_is_clone(dd) || !dsl_dir_is_zapified(dd) ||
+	    zap_lookup(mos, dd->dd_object, DD_FIELD_LIVELIST,
+	    sizeof (uint64_t), 2, obj) != 0)
+		return;
+
+	dsl_deadlist_open(&dd->dd_livelist, mos, obj[0]);
+	dsl_deadlist_open(&dd->dd_livelist_free, mos, obj[1]);
+}
+
+/* ARGSUSED */
+static int
+livelist_discard_cb(void *arg, const blkptr_t *bp, dmu_tx_t *tx)
+{
+	return (0);
+}
+
+static void
+livelist_discard_pending(dsl_dir_t *dd)
+{
+	bplist_iterate(&dd->dd_pending_allocs, livelist_discard_cb, NULL, NULL);
+	bplist_iterate(&dd->dd_pending_frees, livelist_discard_cb, NULL, NULL);
+}
+
+void
+dsl_livelist_close(dsl_dir_t *dd)
+{
+	if (dsl_livelist_exists(dd)) {
+		dsl_deadlist_close(&dd->dd_livelist_free);
+		dsl_deadlist_close(&dd->dd_livelist);
+	}
+	livelist_discard_pending(dd);
+	bplist_destroy(&dd->dd_pending_allocs);
+	bplist_destroy(&dd->dd_pending_frees);
+}
+
+boolean_t
+dsl_livelist_exists(dsl_dir_t *dd)
+{
+	return (dsl_deadlist_is_open(&dd->dd_livelist));
+}
+
+/*
+ * Give a new clone a livelist.  mintxg is the txg of its origin; every
+ * block the clone gives birth to is newer.
+ */
+void
+dsl_livelist_create(dsl_dir_t *dd, uint64_t mintxg, dmu_tx_t *tx)
+{
+	objset_t *mos = dd->dd_pool->dp_meta_objset;
+	uint64_t obj[2];
+
+	ASSERT(dmu_tx_is_syncing(tx));
+	ASSERT(!dsl_livelist_exists(dd));
+
+	obj[0] = dsl_deadlist_alloc(mos, tx);
+	obj[1] = dsl_deadlist_alloc(mos, tx);
+
+	dsl_dir_zapify(dd, tx);
+	VERIFY0(zap_add(mos, dd->dd_object, DD_FIELD_LIVELIST,
+	    sizeof (uint64_t), 2, obj, tx));
+
+	dsl_deadlist_open(&dd->dd_livelist, mos, obj[0]);
+	dsl_deadlist_open(&dd->dd_livelist_free, mos, obj[1]);
+	dsl_deadlist_add_key(&dd->dd_livelist, mintxg, tx);
+	dsl_deadlist_add_key(&dd->dd_livelist_free, mintxg, tx);
+
+	spa_feature_incr(dd->dd_pool->dp_spa, SPA_FEATURE_LIVELIST, tx);
+}
+
+static void
+livelist_condense_cancel(dsl_pool_t *dp, uint64_t ddobj)
+{
+	mutex_enter(&dp->dp_lock);
+	if (dp->dp_condense_ddobj == ddobj) {
+		dp->dp_condense_ddobj = 0;
+		dp->dp_condense_mintxg = 0;
+	}
+	mutex_exit(&dp->dp_lock);
+}
+
+/*
+ * Drop the livelist of a clone that no longer qualifies for one; it will
+ * be destroyed through the bptree.  Must be called with dp_config_rwlock
+ * held as writer, because the condense zthr looks at the livelist under
+ * the reader lock.
+ */
+void
+dsl_livelist_remove(dsl_dir_t *dd, dmu_tx_t *tx)
+{
+	dsl_pool_t *dp = dd->dd_pool;
+	objset_t *mos = dp->dp_meta_objset;
+	uint64_t aobj, fobj;
+
+	ASSERT(dmu_tx_is_syncing(tx));
+	ASSERT(RRW_WRITE_HELD(&dp->dp_config_rwlock));
+
+	if (!dsl_livelist_exists(dd))
+		return;
+
+	livelist_condense_cancel(dp, dd->dd_object);
+	livelist_discard_pending(dd);
+
+	aobj = dd->dd_livelist.dl_object;
+	fobj = dd->dd_livelist_free.dl_object;
+	dsl_deadlist_close(&dd->dd_livelist_free);
+	dsl_deadlist_close(&dd->dd_livelist);
+	dsl_deadlist_free(mos, fobj, tx);
+	dsl_deadlist_free(mos, aobj, tx);
+	VERIFY0(zap_remove(mos, dd->dd_object, DD_FIELD_LIVELIST, tx));
+
+	spa_feature_decr(dp->dp_spa, SPA_FEATURE_LIVELIST, tx);
+}
+
+/*
+ * Called from zio completion, so we can't touch the deadlists here; the
+ * blocks are filed by dsl_livelist_sync().
+ */
+void
+dsl_livelist_born(dsl_dir_t *dd, const blkptr_t *bp)
+{
+	if (dsl_livelist_exists(dd) && !BP_IS_EMBEDDED(bp))
+		bplist_append(&dd->dd_pending_allocs, bp);
+}
+
+void
+dsl_livelist_killed(dsl_dir_t *dd, const blkptr_t *bp)
+{
+	if (dsl_livelist_exists(dd) && !BP_IS_EMBEDDED(bp))
+		bplist_append(&dd->dd_pending_frees, bp);
+}
+
+/*
+ * The clone's block pointers are being remapped away from a removed
+ * device, so the livelist no longer matches them.
+ */
+void
+dsl_livelist_invalidate(dsl_dir_t *dd)
+{
+	mutex_enter(&dd->dd_lock);
+	dd->dd_livelist_invalid = B_TRUE;
+	mutex_exit(&dd->dd_lock);
+}
+
+static int
+livelist_insert_cb(void *arg, const blkptr_t *bp, dmu_tx_t *tx)
+{
+	dsl_deadlist_insert(arg, bp, tx);
+	return (0);
+}
+
+/*
+ * Pick a sublist of this livelist to condense, if none is picked yet.
+ */
+static void
+livelist_condense_select(dsl_dir_t *dd)
+{
+	dsl_pool_t *dp = dd->dd_pool;
+	dsl_deadlist_entry_t *a, *f;
+
+	if (dp->dp_condense_ddobj != 0)
+		return;
+
+	for (a = dsl_deadlist_first(&dd->dd_livelist); a != NULL;
+	    a = dsl_deadlist_next(&dd->dd_livelist, a)) {
+		uint64_t nalloc, nfree;
+
+		f = dsl_deadlist_find(&dd->dd_livelist_free, a->dle_mintxg);
+		ASSERT3P(f, !=, NULL);
+		nalloc = livelist_entries(&a->dle_bpobj);
+		nfree = livelist_entries(&f->dle_bpobj);
+		if (nfree < LIVELIST_CONDENSE_MIN_FREES ||
+		    nfree * 100 < nalloc * zfs_livelist_condense_free_pct)
+			continue;
+
+		mutex_enter(&dp->dp_lock);
+		dp->dp_condense_ddobj = dd->dd_object;
+		dp->dp_condense_mintxg = a->dle_mintxg;
+		mutex_exit(&dp->dp_lock);
+		if (dp->dp_spa->spa_livelist_condense_zthr != NULL)
+			zthr_wakeup(dp->dp_spa->spa_livelist_condense_zthr);
+		break;
+	}
+}
+
+/*
+ * File the blocks born and freed by the clone in this txg.  Called from
+ * dsl_dataset_sync_done(), once all of the clone's writes have completed.
+ */
+void
+dsl_livelist_sync(dsl_dir_t *dd, dmu_tx_t *tx)
+{
+	dsl_pool_t *dp = dd->dd_pool;
+	dsl_deadlist_entry_t *last;
+	boolean_t invalid;
+
+	if (!dsl_livelist_exists(dd))
+		return;
+
+	mutex_enter(&dd->dd_lock);
+	invalid = dd->dd_livelist_invalid;
+	dd->dd_livelist_invalid = B_FALSE;
+	mutex_exit(&dd->dd_lock);
+
+	if (invalid) {
+		rrw_enter(&dp->dp_config_rwlock, RW_WRITER, FTAG);
+		dsl_livelist_remove(dd, tx);
+		rrw_exit(&dp->dp_config_rwlock, FTAG);
+		return;
+	}
+
+	/*
+	 * Start a new sublist once the newest one is full.  Everything
+	 * pending was born in this txg or earlier, so it still sorts into
+	 * the existing sublists.
+	 */
+	last = dsl_deadlist_last(&dd->dd_livelist);
+	if (last->dle_mintxg < tx->tx_txg &&
+	    livelist_entries(&last->dle_bpobj) >= zfs_livelist_max_entries) {
+		rrw_enter(&dp->dp_config_rwlock, RW_WRITER, FTAG);
+		dsl_deadlist_add_key(&dd->dd_livelist, tx->tx_txg, tx);
+		dsl_deadlist_add_key(&dd->dd_livelist_free, tx->tx_txg, tx);
+		rrw_exit(&dp->dp_config_rwlock, FTAG);
+	}
+
+	bplist_iterate(&dd->dd_pending_allocs, livelist_insert_cb,
+	    &dd->dd_livelist, tx);
+	bplist_iterate(&dd->dd_pending_frees, livelist_insert_cb,
+	    &dd->dd_livelist_free, tx);
+
+	livelist_condense_select(dd);
+}
+
+/*
+ * The clone is being destroyed: queue its livelist for the delete zthr.
+ * Its space has been moved to dp_free_dir by the caller.
+ */
+void
+dsl_livelist_destroy_sync(dsl_dir_t *dd, dmu_tx_t *tx)
+{
+	dsl_pool_t *dp = dd->dd_pool;
+	objset_t *mos = dp->dp_meta_objset;
+	uint64_t aobj, fobj;
+
+	ASSERT(dmu_tx_is_syncing(tx));
+	ASSERT(dsl_livelist_exists(dd));
+
+	livelist_condense_cancel(dp, dd->dd_object);
+	livelist_discard_pending(dd);
+
+	if (dp->dp_livelists_obj == 0) {
+		dp->dp_livelists_obj = zap_create(mos,
+		    DMU_OTN_ZAP_METADATA, DMU_OT_NONE, 0, tx);
+		VERIFY0(zap_add(mos, DMU_POOL_DIRECTORY_OBJECT,
+		    DMU_POOL_DELETED_CLONES, sizeof (uint64_t), 1,
+		    &dp->dp_livelists_obj, tx));
+	}
+
+	aobj = dd->dd_livelist.dl_object;
+	fobj = dd->dd_livelist_free.dl_object;
+	VERIFY0(zap_add_int_key(mos, dp->dp_livelists_obj, aobj, fobj, tx));
+
+	dsl_deadlist_close(&dd->dd_livelist_free);
+	dsl_deadlist_close(&dd->dd_livelist);
+	VERIFY0(zap_remove(mos, dd->dd_object, DD_FIELD_LIVELIST, tx));
+
+	if (dp->dp_spa->spa_livelist_delete_zthr != NULL)
+		zthr_wakeup(dp->dp_spa->spa_livelist_delete_zthr);
+}
+
+/*
+ * Livelist delete zthr: frees the blocks of destroyed clones.  If a
+ * livelist can't be read, retrying every txg would only fail again, so
+ * the zthr stops until the pool is imported again; the blocks stay
+ * allocated, which is the safe outcome.
+ */
+
+/* ARGSUSED */
+boolean_t
+dsl_livelist_delete_check(void *arg, zthr_t *zthr)
+{
+	spa_t *spa = arg;
+
+	return (!spa->spa_livelist_delete_failed &&
+	    spa_feature_is_active(spa, SPA_FEATURE_LIVELIST) &&
+	    dsl_livelist_delete_pending(spa));
+}
+
+static int
+livelist_append_cb(void *arg, const blkptr_t *bp, dmu_tx_t *tx)
+{
+	bplist_append(arg, bp);
+	return (0);
+}
+
+static int
+livelist_free_block_cb(void *arg, const blkptr_t *bp, dmu_tx_t *tx)
+{
+	dsl_pool_t *dp = arg;
+
+	dsl_free(dp, tx->tx_txg, bp);
+	dsl_dir_diduse_space(dp->dp_free_dir, DD_USED_HEAD,
+	    -bp_get_dsize_sync(dp->dp_spa, bp),
+	    -BP_GET_PSIZE(bp), -BP_GET_UCSIZE(bp), tx);
+	return (0);
+}
+
+static void
+livelist_delete_sublist_sync(void *arg, dmu_tx_t *tx)
+{
+	livelist_delete_arg_t *lda = arg;
+	dsl_pool_t *dp = dmu_tx_pool(tx);
+
+	bplist_iterate(&lda->lda_to_free, livelist_free_block_cb, dp, tx);
+	dsl_deadlist_discard_key(&lda->lda_llf, lda->lda_mintxg, tx);
+	dsl_deadlist_discard_key(&lda->lda_ll, lda->lda_mintxg, tx);
+}
+
+static void
+livelist_delete_done_sync(void *arg, dmu_tx_t *tx)
+{
+	livelist_delete_arg_t *lda = arg;
+	dsl_pool_t *dp = dmu_tx_pool(tx);
+	objset_t *mos = dp->dp_meta_objset;
+	uint64_t count;
+
+	dsl_deadlist_close(&lda->lda_llf);
+	dsl_deadlist_close(&lda->lda_ll);
+	dsl_deadlist_free(mos, lda->lda_fobj, tx);
+	dsl_deadlist_free(mos, lda->lda_aobj, tx);
+
+	VERIFY0(zap_remove_int(mos, dp->dp_livelists_obj, lda->lda_aobj, tx));
+	VERIFY0(zap_count(mos, dp->dp_livelists_obj, &count));
+	if (count == 0) {
+		VERIFY0(zap_destroy(mos, dp->dp_livelists_obj, tx));
+		VERIFY0(zap_remove(mos, DMU_POOL_DIRECTORY_OBJECT,
+		    DMU_POOL_DELETED_CLONES, tx));
+		dp->dp_livelists_obj = 0;
+	}
+
+	spa_feature_decr(dp->dp_spa, SPA_FEATURE_LIVELIST, tx);
+}
+
+void
+dsl_livelist_delete_thread(void *arg, zthr_t *zthr)
+{
+	spa_t *spa = arg;
+	dsl_pool_t *dp = spa_get_dsl(spa);
+	objset_t *mos = dp->dp_meta_objset;
+	livelist_delete_arg_t lda = { 0 };
+	dsl_deadlist_entry_t *a, *f;
+	zap_cursor_t zc;
+	zap_attribute_t za;
+	int err;
+
+	zap_cursor_init(&zc, mos, dp->dp_livelists_obj);
+	err = zap_cursor_retrieve(&zc, &za);
+	zap_cursor_fini(&zc);
+	if (err != 0)
+		return;
+
+	lda.lda_aobj = zfs_strtonum(za.za_name, NULL);
+	lda.lda_fobj = za.za_first_integer;
+	dsl_deadlist_open(&lda.lda_ll, mos, lda.lda_aobj);
+	dsl_deadlist_open(&lda.lda_llf, mos, lda.lda_fobj);
+	bplist_create(&lda.lda_to_free);
+
+	while ((a = dsl_deadlist_first(&lda.lda_ll)) != NULL) {
+		if (zthr_iscancelled(zthr))
+			break;
+
+		f = dsl_deadlist_find(&lda.lda_llf, a->dle_mintxg);
+		VERIFY3P(f, !=, NULL);
+		lda.lda_mintxg = a->dle_mintxg;
+
+		err = livelist_sublist_iterate(&a->dle_bpobj,
+		    livelist_entries(&a->dle_bpobj), &f->dle_bpobj,
+		    livelist_entries(&f->dle_bpobj), livelist_append_cb,
+		    &lda.lda_to_free, zthr);
+		if (err != 0) {
+			if (err != EINTR) {
+				zfs_panic_recover("zfs: error %d was returned "
+				    "while reading the livelist of a destroyed "
+				    "clone (object %llu)\n", err,
+				    (u_longlong_t)lda.lda_aobj);
+				spa->spa_livelist_delete_failed = B_TRUE;
+			}
+			bplist_iterate(&lda.lda_to_free, livelist_discard_cb,
+			    NULL, NULL);
+			break;
+		}
+
+		VERIFY0(dsl_sync_task(spa_name(spa), NULL,
+		    livelist_delete_sublist_sync, &lda, 0,
+		    ZFS_SPACE_CHECK_NONE));
+	}
+
+	if (a == NULL) {
+		VERIFY0(dsl_sync_task(spa_name(spa), NULL,
+		    livelist_delete_done_sync, &lda, 0, ZFS_SPACE_CHECK_NONE));
+	} else {
+		dsl_deadlist_close(&lda.lda_llf);
+		dsl_deadlist_close(&lda.lda_ll);
+	}
+	bplist_destroy(&lda.lda_to_free);
+}
+
+/*
+ * Livelist condense zthr: rewrites the sublist picked by
+ * livelist_condense_select() with only its surviving blocks.
+ */
+
+/* ARGSUSED */
+boolean_t
+dsl_livelist_condense_check(void *arg, zthr_t *zthr)
+{
+	spa_t *spa = arg;
+
+	return (spa_get_dsl(spa)->dp_condense_ddobj != 0);
+}
+
+static int
+livelist_enqueue_cb(void *arg, const blkptr_t *bp, dmu_tx_t *tx)
+{
+	bpobj_enqueue(arg, bp, tx);
+	return (0);
+}
+
+static void
+livelist_condense_sync(void *arg, dmu_tx_t *tx)
+{
+	livelist_condense_arg_t *lca = arg;
+	dsl_pool_t *dp = dmu_tx_pool(tx);
+	objset_t *mos = dp->dp_meta_objset;
+	dsl_deadlist_entry_t *a, *f;
+	dsl_dir_t *dd;
+	uint64_t newa, newf;
+	boolean_t current;
+	bpobj_t bpo;
+
+	mutex_enter(&dp->dp_lock);
+	current = (dp->dp_condense_ddobj == lca->lca_ddobj &&
+	    dp->dp_condense_mintxg == lca->lca_mintxg);
+	dp->dp_condense_ddobj = 0;
+	dp->dp_condense_mintxg = 0;
+	mutex_exit(&dp->dp_lock);
+
+	/* The livelist changed under us; it will be picked again. */
+	if (!current ||
+	    dsl_dir_hold_obj(dp, lca->lca_ddobj, NULL, FTAG, &dd) != 0)
+		return;
+	if (!dsl_livelist_exists(dd) ||
+	    (a = dsl_deadlist_find(&dd->dd_livelist,
+	    lca->lca_mintxg)) == NULL ||
+	    (f = dsl_deadlist_find(&dd->dd_livelist_free,
+	    lca->lca_mintxg)) == NULL ||
+	    a->dle_bpobj.bpo_object != lca->lca_aobj ||
+	    f->dle_bpobj.bpo_object != lca->lca_fobj) {
+		dsl_dir_rele(dd, FTAG);
+		return;
+	}
+
+	/*
+	 * The new alloc sublist is the survivors plus whatever was
+	 * allocated since they were computed; the new free sublist is
+	 * whatever was freed since then.
+	 */
+	newa = bpobj_alloc(mos, SPA_OLD_MAXBLOCKSIZE, tx);
+	VERIFY0(bpobj_open(&bpo, mos, newa));
+	bplist_iterate(&lca->lca_survivors, livelist_enqueue_cb, &bpo, tx);
+	VERIFY0(bpobj_iterate_range(&a->dle_bpobj, lca->lca_nalloc,
+	    livelist_entries(&a->dle_bpobj), livelist_enqueue_cb, &bpo, tx));
+	bpobj_close(&bpo);
+
+	newf = bpobj_alloc(mos, SPA_OLD_MAXBLOCKSIZE, tx);
+	VERIFY0(bpobj_open(&bpo, mos, newf));
+	VERIFY0(bpobj_iterate_range(&f->dle_bpobj, lca->lca_nfree,
+	    livelist_entries(&f->dle_bpobj), livelist_enqueue_cb, &bpo, tx));
+	bpobj_close(&bpo);
+
+	zfs_dbgmsg("condensed livelist of dir %llu sublist %llu: "
+	    "%llu allocs, %llu frees", (u_longlong_t)lca->lca_ddobj,
+	    (u_longlong_t)lca->lca_mintxg, (u_longlong_t)lca->lca_nalloc,
+	    (u_longlong_t)lca->lca_nfree);
+
+	dsl_deadlist_replace_key(&dd->dd_livelist, lca->lca_mintxg, newa, tx);
+	dsl_deadlist_replace_key(&dd->dd_livelist_free, lca->lca_mintxg,
+	    newf, tx);
+	dsl_dir_rele(dd, FTAG);
+}
+
+void
+dsl_livelist_condense_thread(void *arg, zthr_t *zthr)
+{
+	spa_t *spa = arg;
+	dsl_pool_t *dp = spa_get_dsl(spa);
+	objset_t *mos = dp->dp_meta_objset;
+	livelist_condense_arg_t lca = { 0 };
+	dsl_deadlist_entry_t *a, *f;
+	bpobj_t abpo, fbpo;
+	dsl_dir_t *dd;
+	int err;
+
+	mutex_enter(&dp->dp_lock);
+	lca.lca_ddobj = dp->dp_condense_ddobj;
+	lca.lca_mintxg = dp->dp_condense_mintxg;
+	mutex_exit(&dp->dp_lock);
+	if (lca.lca_ddobj == 0)
+		return;
+
+	/*
+	 * Note the sublist's bpobjs and how many entries they have now.
+	 * Entries are only appended, so that prefix can be read without
+	 * any locks; the sync task checks that the bpobjs are still the
+	 * livelist's before replacing them.
+	 */
+	dsl_pool_config_enter(dp, FTAG);
+	err = dsl_dir_hold_obj(dp, lca.lca_ddobj, NULL, FTAG, &dd);
+	if (err == 0) {
+		if (dsl_livelist_exists(dd) &&
+		    (a = dsl_deadlist_find(&dd->dd_livelist,
+		    lca.lca_mintxg)) != NULL &&
+		    (f = dsl_deadlist_find(&dd->dd_livelist_free,
+		    lca.lca_mintxg)) != NULL) {
+			lca.lca_aobj = a->dle_bpobj.bpo_object;
+			lca.lca_nalloc = livelist_entries(&a->dle_bpobj);
+			lca.lca_fobj = f->dle_bpobj.bpo_object;
+			lca.lca_nfree = livelist_entries(&f->dle_bpobj);
+		} else {
+			err = SET_ERROR(ENOENT);
+		}
+		dsl_dir_rele(dd, FTAG);
+	}
+	dsl_pool_config_exit(dp, FTAG);
+
+	if (err != 0) {
+		livelist_condense_cancel(dp, lca.lca_ddobj);
+		return;
+	}
+
+	bplist_create(&lca.lca_survivors);
+	err = bpobj_open(&abpo, mos, lca.lca_aobj);
+	if (err == 0) {
+		err = bpobj_open(&fbpo, mos, lca.lca_fobj);
+		if (err == 0) {
+			err = livelist_sublist_iterate(&abpo, lca.lca_nalloc,
+			    &fbpo, lca.lca_nfree, livelist_append_cb,
+			    &lca.lca_survivors, zthr);
+			bpobj_close(&fbpo);
+		}
+		bpobj_close(&abpo);
+	}
+
+	if (err == 0) {
+		VERIFY0(dsl_sync_task(spa_name(spa), NULL,
+		    livelist_condense_sync, &lca, 0, ZFS_SPACE_CHECK_NONE));
+	} else if (err != EINTR) {
+		/* Most likely the livelist was freed while we read it. */
+		livelist_condense_cancel(dp, lca.lca_ddobj);
+	}
+
+	bplist_iterate(&lca.lca_survivors, livelist_discard_cb, NULL, NULL);
+	bplist_destroy(&lca.lca_survivors);
+}
+
+#if defined(_KERNEL) && defined(HAVE_SPL)
+/* CSTYLED */
+module_param(zfs_livelist_max_entries, ulong, 0644);
+MODULE_PARM_DESC(zfs_livelist_max_entries,
+	"Allocations per livelist sublist before a new one is started");
+
+module_param(zfs_livelist_condense_free_pct, int, 0644);
+MODULE_PARM_DESC(zfs_livelist_condense_free_pct,
+	"Percentage of a livelist sublist freed before it is condensed");
+#endif
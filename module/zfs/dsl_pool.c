@@ -344,6 +344,17 @@ dsl_pool_open(dsl_pool_t *dp)
 			goto out;
 	}
 
+	if (spa_feature_is_active(dp->dp_spa, SPA_FEATURE_LIVELIST)) {
+		/* Only present while destroyed clones remain to be freed. */
+		err = zap_lookup(dp->dp_meta_objset, DMU_POOL_DIRECTORY_OBJECT,
+		    DMU_POOL_DELETED_CLONES, sizeof (uint64_t), 1,
+		    &dp->dp_livelists_obj);
+		if (err == ENOENT)
+			err = 0;
+		if (err != 0)
+			goto out;
+	}
+
 	if (spa_feature_is_active(dp->dp_spa, SPA_FEATURE_EMPTY_BPOBJ)) {
 		err = zap_lookup(dp->dp_meta_objset, DMU_POOL_DIRECTORY_OBJECT,
 		    DMU_POOL_EMPTY_BPOBJ, sizeof (uint64_t), 1,
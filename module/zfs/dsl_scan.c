@@ -32,6 +32,7 @@
 #include <sys/dsl_dataset.h>
 #include <sys/dsl_prop.h>
 #include <sys/dsl_dir.h>
+#include <sys/dsl_livelist.h>
 #include <sys/dsl_synctask.h>
 #include <sys/dnode.h>
 #include <sys/dmu_tx.h>
@@ -172,6 +173,18 @@ int zfs_resilver_min_time_ms = 3000; /* min millisecs to resilver per txg */
 int zfs_scan_checkpoint_intval = 7200; /* in seconds */
 int zfs_no_scrub_io = B_FALSE; /* set to disable scrub i/o */
 int zfs_no_scrub_prefetch = B_FALSE; /* set to disable scrub prefetch */
+
+/*
+ * Metadata prefetches are taken from the front of the prefetch queue in
+ * windows of up to zfs_scan_meta_window blocks and issued in LBA order.
+ * A new window is started once the in-flight scan I/O has dropped to half
+ * of its limit, so that each window is large enough for the vdev queue to
+ * aggregate neighbouring metadata blocks.  A window of 1 issues the blocks
+ * one at a time in bookmark order.
+ */
+uint64_t zfs_scan_meta_window = 1024;	/* blocks */
+/* memory for queued prefetches; beyond it the furthest ones are dropped */
+uint64_t zfs_scan_meta_mem_lim = 32 << 20;	/* bytes */
 enum ddt_class zfs_scrub_ddt_class_max = DDT_CLASS_DUPLICATE;
 /* max number of blocks to free in a single TXG */
 uint64_t zfs_async_block_max_blocks = UINT64_MAX;
@@ -199,6 +212,25 @@ int zfs_resilver_disable_defer = 0; /* set to disable resilver deferring */
  */
 int64_t zfs_free_bpobj_enabled = 1;
 
+/*
+ * Free the blocks of the free_bpobj and of async destroys from the
+ * dp_sync_taskq threads, in batches of SCAN_FREE_BATCH_SIZE.  The sync
+ * thread only walks the bpobj/bptree and decides when to pause.
+ */
+int zfs_async_free_parallel = 1;
+
+#define	SCAN_FREE_BATCH_SIZE	256
+
+typedef struct scan_free_batch {
+	dsl_scan_t	*sfb_scn;
+	uint64_t	sfb_txg;
+	int		sfb_count;
+	blkptr_t	sfb_bps[SCAN_FREE_BATCH_SIZE];
+} scan_free_batch_t;
+
+/* window over which the freeing rate reported to userland is measured */
+#define	SCAN_FREE_RATE_INTERVAL_MS	10000
+
 /* the order has to match pool_scan_type */
 static scan_cb_t *scan_funcs[POOL_SCAN_FUNCS] = {
 	NULL,
@@ -1425,6 +1457,27 @@ scan_prefetch_queue_compare(const void *a, const void *b)
 	    spc_b->spc_indblkshift, &spic_a->spic_zb, &spic_b->spic_zb));
 }
 
+/*
+ * Comparator for a window of prefetches about to be issued: by top-level
+ * vdev and offset of the first DVA, which is the copy that will be read.
+ */
+static int
+scan_prefetch_window_compare(const void *a, const void *b)
+{
+	const scan_prefetch_issue_ctx_t *spic_a = a, *spic_b = b;
+	const dva_t *dva_a = &spic_a->spic_bp.blk_dva[0];
+	const dva_t *dva_b = &spic_b->spic_bp.blk_dva[0];
+	int cmp;
+
+	cmp = AVL_CMP(DVA_GET_VDEV(dva_a), DVA_GET_VDEV(dva_b));
+	if (cmp != 0)
+		return (cmp);
+	cmp = AVL_CMP(DVA_GET_OFFSET(dva_a), DVA_GET_OFFSET(dva_b));
+	if (cmp != 0)
+		return (cmp);
+	return (AVL_PCMP(spic_a, spic_b));
+}
+
 static void
 scan_prefetch_ctx_rele(scan_prefetch_ctx_t *spc, void *tag)
 {
@@ -1539,6 +1592,28 @@ dsl_scan_prefetch(scan_prefetch_ctx_t *spc, blkptr_t *bp, zbookmark_phys_t *zb)
 		return;
 	}
 
+	/*
+	 * Prefetching is only advisory, so when the queue is over its memory
+	 * limit we drop whichever block the traversal will need last; the
+	 * traversal reads it itself when it gets there.
+	 */
+	if (avl_numnodes(&scn->scn_prefetch_queue) *
+	    sizeof (scan_prefetch_issue_ctx_t) >= zfs_scan_meta_mem_lim) {
+		scan_prefetch_issue_ctx_t *last =
+		    avl_last(&scn->scn_prefetch_queue);
+
+		if (scan_prefetch_queue_compare(spic, last) > 0) {
+			kmem_free(spic, sizeof (scan_prefetch_issue_ctx_t));
+			scan_prefetch_ctx_rele(spc, scn);
+			mutex_exit(&spa->spa_scrub_lock);
+			return;
+		}
+		avl_remove(&scn->scn_prefetch_queue, last);
+		scan_prefetch_ctx_rele(last->spic_spc, scn);
+		kmem_free(last, sizeof (scan_prefetch_issue_ctx_t));
+		(void) avl_find(&scn->scn_prefetch_queue, spic, &idx);
+	}
+
 	avl_insert(&scn->scn_prefetch_queue, spic, idx);
 	cv_broadcast(&spa->spa_scrub_io_cv);
 	mutex_exit(&spa->spa_scrub_lock);
@@ -1644,22 +1719,29 @@ dsl_scan_prefetch_thread(void *arg)
 	dsl_scan_t *scn = arg;
 	spa_t *spa = scn->scn_dp->dp_spa;
 	scan_prefetch_issue_ctx_t *spic;
+	avl_tree_t window;
+
+	avl_create(&window, scan_prefetch_window_compare,
+	    sizeof (scan_prefetch_issue_ctx_t),
+	    offsetof(scan_prefetch_issue_ctx_t, spic_avl_node));
 
 	/* loop until we are told to stop */
 	while (!scn->scn_prefetch_stop) {
-		arc_flags_t flags = ARC_FLAG_NOWAIT |
-		    ARC_FLAG_PRESCIENT_PREFETCH | ARC_FLAG_PREFETCH;
-		int zio_flags = ZIO_FLAG_CANFAIL | ZIO_FLAG_SCAN_THREAD;
+		uint64_t window_max = MAX(zfs_scan_meta_window, 1);
+		uint64_t inflight_max = scn->scn_maxinflight_bytes;
 
 		mutex_enter(&spa->spa_scrub_lock);
 
 		/*
 		 * Wait until we have an IO to issue and are not above our
-		 * maximum in flight limit.
+		 * maximum in flight limit, or below half of it when issuing
+		 * in windows.
 		 */
+		if (window_max > 1)
+			inflight_max = MAX(inflight_max / 2, 1);
 		while (!scn->scn_prefetch_stop &&
 		    (avl_numnodes(&scn->scn_prefetch_queue) == 0 ||
-		    spa->spa_scrub_inflight >= scn->scn_maxinflight_bytes)) {
+		    spa->spa_scrub_inflight >= inflight_max)) {
 			cv_wait(&spa->spa_scrub_io_cv, &spa->spa_scrub_lock);
 		}
 
@@ -1669,27 +1751,44 @@ dsl_scan_prefetch_thread(void *arg)
 			break;
 		}
 
-		/* remove the prefetch IO from the tree */
-		spic = avl_first(&scn->scn_prefetch_queue);
-		spa->spa_scrub_inflight += BP_GET_PSIZE(&spic->spic_bp);
-		avl_remove(&scn->scn_prefetch_queue, spic);
+		/* move the blocks needed next from the queue to the window */
+		do {
+			spic = avl_first(&scn->scn_prefetch_queue);
+			spa->spa_scrub_inflight += BP_GET_PSIZE(&spic->spic_bp);
+			avl_remove(&scn->scn_prefetch_queue, spic);
+			avl_add(&window, spic);
+		} while (avl_numnodes(&window) < window_max &&
+		    avl_numnodes(&scn->scn_prefetch_queue) != 0 &&
+		    spa->spa_scrub_inflight < scn->scn_maxinflight_bytes);
 
 		mutex_exit(&spa->spa_scrub_lock);
 
-		if (BP_IS_PROTECTED(&spic->spic_bp)) {
-			ASSERT(BP_GET_TYPE(&spic->spic_bp) == DMU_OT_DNODE ||
-			    BP_GET_TYPE(&spic->spic_bp) == DMU_OT_OBJSET);
-			ASSERT3U(BP_GET_LEVEL(&spic->spic_bp), ==, 0);
-			zio_flags |= ZIO_FLAG_RAW;
-		}
+		/* issue the prefetches asynchronously, in LBA order */
+		while ((spic = avl_first(&window)) != NULL) {
+			arc_flags_t flags = ARC_FLAG_NOWAIT |
+			    ARC_FLAG_PRESCIENT_PREFETCH | ARC_FLAG_PREFETCH;
+			int zio_flags = ZIO_FLAG_CANFAIL | ZIO_FLAG_SCAN_THREAD;
+
+			avl_remove(&window, spic);
+
+			if (BP_IS_PROTECTED(&spic->spic_bp)) {
+				ASSERT(BP_GET_TYPE(&spic->spic_bp) ==
+				    DMU_OT_DNODE ||
+				    BP_GET_TYPE(&spic->spic_bp) ==
+				    DMU_OT_OBJSET);
+				ASSERT3U(BP_GET_LEVEL(&spic->spic_bp), ==, 0);
+				zio_flags |= ZIO_FLAG_RAW;
+			}
 
-		/* issue the prefetch asynchronously */
-		(void) arc_read(scn->scn_zio_root, scn->scn_dp->dp_spa,
-		    &spic->spic_bp, dsl_scan_prefetch_cb, spic->spic_spc,
-		    ZIO_PRIORITY_SCRUB, zio_flags, &flags, &spic->spic_zb);
+			(void) arc_read(scn->scn_zio_root, scn->scn_dp->dp_spa,
+			    &spic->spic_bp, dsl_scan_prefetch_cb,
+			    spic->spic_spc, ZIO_PRIORITY_SCRUB, zio_flags,
+			    &flags, &spic->spic_zb);
 
-		kmem_free(spic, sizeof (scan_prefetch_issue_ctx_t));
+			kmem_free(spic, sizeof (scan_prefetch_issue_ctx_t));
+		}
 	}
+	avl_destroy(&window);
 
 	ASSERT(scn->scn_prefetch_stop);
 
@@ -3026,10 +3125,37 @@ dsl_scan_async_block_should_pause(dsl_scan_t *scn)
 	    spa_shutting_down(scn->scn_dp->dp_spa));
 }
 
+static void
+dsl_scan_free_batch_func(void *arg)
+{
+	scan_free_batch_t *sfb = arg;
+	dsl_scan_t *scn = sfb->sfb_scn;
+
+	for (int i = 0; i < sfb->sfb_count; i++) {
+		zio_nowait(zio_free_sync(scn->scn_zio_root,
+		    scn->scn_dp->dp_spa, sfb->sfb_txg, &sfb->sfb_bps[i], 0));
+	}
+	kmem_free(sfb, sizeof (scan_free_batch_t));
+}
+
+static void
+dsl_scan_free_batch_dispatch(dsl_scan_t *scn)
+{
+	scan_free_batch_t *sfb = scn->scn_free_batch;
+
+	if (sfb == NULL)
+		return;
+
+	scn->scn_free_batch = NULL;
+	VERIFY(taskq_dispatch(scn->scn_dp->dp_sync_taskq,
+	    dsl_scan_free_batch_func, sfb, TQ_SLEEP) != 0);
+}
+
 static int
 dsl_scan_free_block_cb(void *arg, const blkptr_t *bp, dmu_tx_t *tx)
 {
 	dsl_scan_t *scn = arg;
+	spa_t *spa = scn->scn_dp->dp_spa;
 
 	if (!scn->scn_is_bptree ||
 	    (BP_GET_LEVEL(bp) == 0 && BP_GET_TYPE(bp) != DMU_OT_OBJSET)) {
@@ -3037,15 +3163,115 @@ dsl_scan_free_block_cb(void *arg, const blkptr_t *bp, dmu_tx_t *tx)
 			return (SET_ERROR(ERESTART));
 	}
 
-	zio_nowait(zio_free_sync(scn->scn_zio_root, scn->scn_dp->dp_spa,
-	    dmu_tx_get_txg(tx), bp, 0));
-	dsl_dir_diduse_space(tx->tx_pool->dp_free_dir, DD_USED_HEAD,
-	    -bp_get_dsize_sync(scn->scn_dp->dp_spa, bp),
-	    -BP_GET_PSIZE(bp), -BP_GET_UCSIZE(bp), tx);
+	if (zfs_async_free_parallel) {
+		scan_free_batch_t *sfb = scn->scn_free_batch;
+
+		if (sfb == NULL) {
+			sfb = kmem_alloc(sizeof (scan_free_batch_t), KM_SLEEP);
+			sfb->sfb_scn = scn;
+			sfb->sfb_txg = dmu_tx_get_txg(tx);
+			sfb->sfb_count = 0;
+			scn->scn_free_batch = sfb;
+		}
+		sfb->sfb_bps[sfb->sfb_count++] = *bp;
+		if (sfb->sfb_count == SCAN_FREE_BATCH_SIZE)
+			dsl_scan_free_batch_dispatch(scn);
+	} else {
+		zio_nowait(zio_free_sync(scn->scn_zio_root, spa,
+		    dmu_tx_get_txg(tx), bp, 0));
+	}
+
+	/* charged to dp_free_dir in one go by dsl_scan_free_wait() */
+	scn->scn_free_used -= bp_get_dsize_sync(spa, bp);
+	scn->scn_free_comp -= BP_GET_PSIZE(bp);
+	scn->scn_free_uncomp -= BP_GET_UCSIZE(bp);
 	scn->scn_visited_this_txg++;
 	return (0);
 }
 
+/*
+ * Wait for the frees issued by dsl_scan_free_block_cb() and update the
+ * space accounting of dp_free_dir.
+ */
+static void
+dsl_scan_free_wait(dsl_scan_t *scn, dmu_tx_t *tx)
+{
+	dsl_pool_t *dp = scn->scn_dp;
+
+	dsl_scan_free_batch_dispatch(scn);
+	taskq_wait(dp->dp_sync_taskq);
+	VERIFY0(zio_wait(scn->scn_zio_root));
+	scn->scn_zio_root = NULL;
+
+	if (scn->scn_free_used != 0 || scn->scn_free_comp != 0 ||
+	    scn->scn_free_uncomp != 0) {
+		dsl_dir_diduse_space(dp->dp_free_dir, DD_USED_HEAD,
+		    scn->scn_free_used, scn->scn_free_comp,
+		    scn->scn_free_uncomp, tx);
+		scn->scn_free_rate_bytes -= scn->scn_free_used;
+	}
+	scn->scn_free_used = 0;
+	scn->scn_free_comp = 0;
+	scn->scn_free_uncomp = 0;
+}
+
+/*
+ * Fold the blocks freed in this txg into the freeing rate.  The rate is
+ * recomputed every SCAN_FREE_RATE_INTERVAL_MS of wall clock time, so it
+ * includes the time between txgs and not only the time spent freeing.
+ */
+static void
+dsl_scan_free_rate_update(dsl_scan_t *scn, uint64_t blocks)
+{
+	hrtime_t now = gethrtime();
+	uint64_t elapsed_ms;
+
+	if (scn->scn_free_rate_ts == 0)
+		scn->scn_free_rate_ts = now;
+	scn->scn_free_rate_blocks += blocks;
+
+	elapsed_ms = NSEC2MSEC(now - scn->scn_free_rate_ts);
+	if (elapsed_ms < SCAN_FREE_RATE_INTERVAL_MS)
+		return;
+
+	scn->scn_freeing_blocks_rate =
+	    scn->scn_free_rate_blocks * MILLISEC / elapsed_ms;
+	scn->scn_freeing_bytes_rate =
+	    scn->scn_free_rate_bytes * MILLISEC / elapsed_ms;
+	scn->scn_free_rate_ts = now;
+	scn->scn_free_rate_blocks = 0;
+	scn->scn_free_rate_bytes = 0;
+}
+
+/*
+ * Blocks per second freed by background destroys, or 0 if nothing is
+ * being freed.
+ */
+uint64_t
+dsl_scan_freeing_rate(dsl_scan_t *scn)
+{
+	dsl_dir_t *dd = scn->scn_dp->dp_free_dir;
+
+	if (dd == NULL || dsl_dir_phys(dd)->dd_used_bytes == 0)
+		return (0);
+	return (scn->scn_freeing_blocks_rate);
+}
+
+/*
+ * Estimated seconds until the space in dp_free_dir has been freed at the
+ * current rate, or 0 if unknown.
+ */
+uint64_t
+dsl_scan_freeing_time(dsl_scan_t *scn)
+{
+	dsl_dir_t *dd = scn->scn_dp->dp_free_dir;
+
+	if (dd == NULL || scn->scn_freeing_bytes_rate == 0)
+		return (0);
+	return (dsl_dir_phys(dd)->dd_used_bytes /
+	    scn->scn_freeing_bytes_rate);
+}
+
 static int
 dsl_scan_obsolete_block_cb(void *arg, const blkptr_t *bp, dmu_tx_t *tx)
 {
@@ -3213,8 +3439,7 @@ dsl_process_async_destroys(dsl_pool_t *dp, dmu_tx_t *tx)
 		    NULL, ZIO_FLAG_MUSTSUCCEED);
 		err = bpobj_iterate(&dp->dp_free_bpobj,
 		    dsl_scan_free_block_cb, scn, tx);
-		VERIFY0(zio_wait(scn->scn_zio_root));
-		scn->scn_zio_root = NULL;
+		dsl_scan_free_wait(scn, tx);
 
 		if (err != 0 && err != ERESTART)
 			zfs_panic_recover("error %u from bpobj_iterate()", err);
@@ -3227,8 +3452,7 @@ dsl_process_async_destroys(dsl_pool_t *dp, dmu_tx_t *tx)
 		    NULL, ZIO_FLAG_MUSTSUCCEED);
 		err = bptree_iterate(dp->dp_meta_objset,
 		    dp->dp_bptree_obj, B_TRUE, dsl_scan_free_block_cb, scn, tx);
-		VERIFY0(zio_wait(scn->scn_zio_root));
-		scn->scn_zio_root = NULL;
+		dsl_scan_free_wait(scn, tx);
 
 		if (err == EIO || err == ECKSUM) {
 			err = 0;
@@ -3263,6 +3487,7 @@ dsl_process_async_destroys(dsl_pool_t *dp, dmu_tx_t *tx)
 			    (scn->scn_visited_this_txg == 0);
 		}
 	}
+	dsl_scan_free_rate_update(scn, scn->scn_visited_this_txg);
 	if (scn->scn_visited_this_txg) {
 		zfs_dbgmsg("freed %llu blocks in %llums from "
 		    "free_bpobj/bptree txg %llu; err=%u",
@@ -3282,7 +3507,7 @@ dsl_process_async_destroys(dsl_pool_t *dp, dmu_tx_t *tx)
 	if (err != 0)
 		return (err);
 	if (dp->dp_free_dir != NULL && !scn->scn_async_destroying &&
-	    zfs_free_leak_on_eio &&
+	    !dsl_livelist_delete_pending(spa) && zfs_free_leak_on_eio &&
 	    (dsl_dir_phys(dp->dp_free_dir)->dd_used_bytes != 0 ||
 	    dsl_dir_phys(dp->dp_free_dir)->dd_compressed_bytes != 0 ||
 	    dsl_dir_phys(dp->dp_free_dir)->dd_uncompressed_bytes != 0)) {
@@ -3309,7 +3534,8 @@ dsl_process_async_destroys(dsl_pool_t *dp, dmu_tx_t *tx)
 		    -dsl_dir_phys(dp->dp_free_dir)->dd_uncompressed_bytes, tx);
 	}
 
-	if (dp->dp_free_dir != NULL && !scn->scn_async_destroying) {
+	if (dp->dp_free_dir != NULL && !scn->scn_async_destroying &&
+	    !dsl_livelist_delete_pending(spa)) {
 		/* finished; verify that space accounting went to zero */
 		ASSERT0(dsl_dir_phys(dp->dp_free_dir)->dd_used_bytes);
 		ASSERT0(dsl_dir_phys(dp->dp_free_dir)->dd_compressed_bytes);
@@ -3602,6 +3828,8 @@ dsl_scan_sync(dsl_pool_t *dp, dmu_tx_t *tx)
 static void
 count_block(dsl_scan_t *scn, zfs_all_blkstats_t *zab, const blkptr_t *bp)
 {
+	spa_t *spa = scn->scn_dp->dp_spa;
+	uint64_t issued = 0;
 	int i;
 
 	/*
@@ -3619,16 +3847,14 @@ count_block(dsl_scan_t *scn, zfs_all_blkstats_t *zab, const blkptr_t *bp)
 	 * Therefore, we should only count the first DVA for these IOs.
 	 */
 	if (scn->scn_is_sorted) {
-		atomic_add_64(&scn->scn_dp->dp_spa->spa_scan_pass_issued,
-		    DVA_GET_ASIZE(&bp->blk_dva[0]));
+		issued = DVA_GET_ASIZE(&bp->blk_dva[0]);
 	} else {
-		spa_t *spa = scn->scn_dp->dp_spa;
-
-		for (i = 0; i < BP_GET_NDVAS(bp); i++) {
-			atomic_add_64(&spa->spa_scan_pass_issued,
-			    DVA_GET_ASIZE(&bp->blk_dva[i]));
-		}
+		for (i = 0; i < BP_GET_NDVAS(bp); i++)
+			issued += DVA_GET_ASIZE(&bp->blk_dva[i]);
 	}
+	atomic_add_64(&spa->spa_scan_pass_issued, issued);
+	if (BP_GET_LEVEL(bp) > 0 || DMU_OT_IS_METADATA(BP_GET_TYPE(bp)))
+		atomic_add_64(&spa->spa_scan_pass_meta_issued, issued);
 
 	/*
 	 * If we resume after a reboot, zab will be NULL; don't record
@@ -4175,6 +4401,16 @@ MODULE_PARM_DESC(zfs_no_scrub_io, "Set to disable scrub I/O");
 module_param(zfs_no_scrub_prefetch, int, 0644);
 MODULE_PARM_DESC(zfs_no_scrub_prefetch, "Set to disable scrub prefetching");
 
+/* CSTYLED */
+module_param(zfs_scan_meta_window, ulong, 0644);
+MODULE_PARM_DESC(zfs_scan_meta_window,
+	"Max metadata prefetches issued together in LBA order");
+
+/* CSTYLED */
+module_param(zfs_scan_meta_mem_lim, ulong, 0644);
+MODULE_PARM_DESC(zfs_scan_meta_mem_lim,
+	"Max memory for queued scan metadata prefetches");
+
 /* CSTYLED */
 module_param(zfs_free_max_blocks, ulong, 0644);
 MODULE_PARM_DESC(zfs_free_max_blocks, "Max number of blocks freed in one txg");
@@ -4182,6 +4418,10 @@ MODULE_PARM_DESC(zfs_free_max_blocks, "Max number of blocks freed in one txg");
 module_param(zfs_free_bpobj_enabled, int, 0644);
 MODULE_PARM_DESC(zfs_free_bpobj_enabled, "Enable processing of the free_bpobj");
 
+module_param(zfs_async_free_parallel, int, 0644);
+MODULE_PARM_DESC(zfs_async_free_parallel,
+	"Free async destroy blocks from the sync taskq threads");
+
 module_param(zfs_scan_mem_lim_fact, int, 0644);
 MODULE_PARM_DESC(zfs_scan_mem_lim_fact, "Fraction of RAM for scan hard limit");
 
@@ -73,6 +73,7 @@
 #include <sys/dsl_pool.h>
 #include <sys/dsl_dataset.h>
 #include <sys/dsl_dir.h>
+#include <sys/dsl_livelist.h>
 #include <sys/dsl_prop.h>
 #include <sys/dsl_synctask.h>
 #include <sys/fs/zfs.h>
@@ -136,7 +137,7 @@ typedef struct zio_taskq_info {
 } zio_taskq_info_t;
 
 static const char *const zio_taskq_types[ZIO_TASKQ_TYPES] = {
-	"issue", "issue_high", "intr", "intr_high"
+	"issue", "issue_high", "intr", "intr_high", "cmp", "cmp_high"
 };
 
 /*
@@ -155,16 +156,31 @@ static const char *const zio_taskq_types[ZIO_TASKQ_TYPES] = {
  * The different taskq priorities are to handle the different contexts (issue
  * and interrupt) and then to reserve threads for ZIO_PRIORITY_NOW I/Os that
  * need to be handled with minimum delay.
+ *
+ * The compute taskqs take read checksum verification, and the decompression
+ * and decryption done when the zio completes, off the interrupt threads
+ * (see zio_compute_offload).  Sync reads use the high priority one so they
+ * are not queued behind scrub and prefetch work.
  */
 const zio_taskq_info_t zio_taskqs[ZIO_TYPES][ZIO_TASKQ_TYPES] = {
-	/* ISSUE	ISSUE_HIGH	INTR		INTR_HIGH */
-	{ ZTI_ONE,	ZTI_NULL,	ZTI_ONE,	ZTI_NULL }, /* NULL */
-	{ ZTI_N(8),	ZTI_NULL,	ZTI_P(12, 8),	ZTI_NULL }, /* READ */
-	{ ZTI_BATCH,	ZTI_N(5),	ZTI_P(12, 8),	ZTI_N(5) }, /* WRITE */
-	{ ZTI_P(12, 8),	ZTI_NULL,	ZTI_ONE,	ZTI_NULL }, /* FREE */
-	{ ZTI_ONE,	ZTI_NULL,	ZTI_ONE,	ZTI_NULL }, /* CLAIM */
-	{ ZTI_ONE,	ZTI_NULL,	ZTI_ONE,	ZTI_NULL }, /* IOCTL */
-	{ ZTI_N(4),	ZTI_NULL,	ZTI_ONE,	ZTI_NULL }, /* TRIM */
+	/*
+	 * ISSUE	ISSUE_HIGH	INTR		INTR_HIGH	CMP
+	 *     CMP_HIGH
+	 */
+	{ ZTI_ONE,	ZTI_NULL,	ZTI_ONE,	ZTI_NULL,	ZTI_NULL,
+	    ZTI_NULL },		/* NULL */
+	{ ZTI_N(8),	ZTI_NULL,	ZTI_P(12, 8),	ZTI_NULL,	ZTI_BATCH,
+	    ZTI_BATCH },	/* READ */
+	{ ZTI_BATCH,	ZTI_N(5),	ZTI_P(12, 8),	ZTI_N(5),	ZTI_NULL,
+	    ZTI_NULL },		/* WRITE */
+	{ ZTI_P(12, 8),	ZTI_NULL,	ZTI_ONE,	ZTI_NULL,	ZTI_NULL,
+	    ZTI_NULL },		/* FREE */
+	{ ZTI_ONE,	ZTI_NULL,	ZTI_ONE,	ZTI_NULL,	ZTI_NULL,
+	    ZTI_NULL },		/* CLAIM */
+	{ ZTI_ONE,	ZTI_NULL,	ZTI_ONE,	ZTI_NULL,	ZTI_NULL,
+	    ZTI_NULL },		/* IOCTL */
+	{ ZTI_N(4),	ZTI_NULL,	ZTI_ONE,	ZTI_NULL,	ZTI_NULL,
+	    ZTI_NULL },		/* TRIM */
 };
 
 static void spa_sync_version(void *arg, dmu_tx_t *tx);
@@ -345,6 +361,13 @@ spa_prop_get_config(spa_t *spa, nvlist_t **nvp)
 			    NULL, 0, src);
 		}
 
+		if (pool->dp_scan != NULL) {
+			spa_prop_add_list(*nvp, ZPOOL_PROP_FREEINGRATE, NULL,
+			    dsl_scan_freeing_rate(pool->dp_scan), src);
+			spa_prop_add_list(*nvp, ZPOOL_PROP_FREEINGTIME, NULL,
+			    dsl_scan_freeing_time(pool->dp_scan), src);
+		}
+
 		if (pool->dp_leak_dir != NULL) {
 			spa_prop_add_list(*nvp, ZPOOL_PROP_LEAKED, NULL,
 			    dsl_dir_phys(pool->dp_leak_dir)->dd_used_bytes,
@@ -582,6 +605,12 @@ spa_prop_validate(spa_t *spa, nvlist_t *props)
 
 			break;
 
+		case ZPOOL_PROP_SCANLATENCY:
+			error = nvpair_value_uint64(elem, &intval);
+			if (!error && intval > MILLISEC * 60)
+				error = SET_ERROR(EINVAL);
+			break;
+
 		case ZPOOL_PROP_BOOTFS:
 			/*
 			 * If the pool version is less than SPA_VERSION_BOOTFS,
@@ -1031,7 +1060,8 @@ spa_taskqs_init(spa_t *spa, zio_type_t t, zio_taskq_type_t q)
 			 * means incrementing the priority value on platforms
 			 * like IllumOS/OsX it should be decremented.
 			 */
-			if (t == ZIO_TYPE_WRITE && q == ZIO_TASKQ_ISSUE)
+			if ((t == ZIO_TYPE_WRITE && q == ZIO_TASKQ_ISSUE) ||
+			    q == ZIO_TASKQ_COMPUTE)
 				pri--;
 
 			tq = taskq_create_proc(name, value, pri, 50,
@@ -1517,6 +1547,26 @@ spa_unload(spa_t *spa)
 		spa->spa_checkpoint_discard_zthr = NULL;
 	}
 
+	if (spa->spa_ddt_warmup_zthr != NULL) {
+		zthr_destroy(spa->spa_ddt_warmup_zthr);
+		spa->spa_ddt_warmup_zthr = NULL;
+	}
+
+	if (spa->spa_livelist_delete_zthr != NULL) {
+		zthr_destroy(spa->spa_livelist_delete_zthr);
+		spa->spa_livelist_delete_zthr = NULL;
+	}
+	spa->spa_livelist_delete_failed = B_FALSE;
+
+	if (spa->spa_livelist_condense_zthr != NULL) {
+		zthr_destroy(spa->spa_livelist_condense_zthr);
+		spa->spa_livelist_condense_zthr = NULL;
+	}
+	spa->spa_ddt_warmup_total = 0;
+	spa->spa_ddt_warmup_bytes = 0;
+	spa->spa_ddt_warmup_done = B_FALSE;
+	spa_ddt_warmup_stats_set(spa, 0, 0, B_FALSE);
+
 	spa_condense_fini(spa);
 
 	bpobj_close(&spa->spa_deferred_bpobj);
@@ -2304,6 +2354,20 @@ spa_spawn_aux_threads(spa_t *spa)
 	spa->spa_checkpoint_discard_zthr =
 	    zthr_create(spa_checkpoint_discard_thread_check,
 	    spa_checkpoint_discard_thread, spa);
+
+	ASSERT3P(spa->spa_ddt_warmup_zthr, ==, NULL);
+	spa->spa_ddt_warmup_zthr =
+	    zthr_create(ddt_warmup_check, ddt_warmup_thread, spa);
+
+	ASSERT3P(spa->spa_livelist_delete_zthr, ==, NULL);
+	spa->spa_livelist_delete_zthr =
+	    zthr_create(dsl_livelist_delete_check,
+	    dsl_livelist_delete_thread, spa);
+
+	ASSERT3P(spa->spa_livelist_condense_zthr, ==, NULL);
+	spa->spa_livelist_condense_zthr =
+	    zthr_create(dsl_livelist_condense_check,
+	    dsl_livelist_condense_thread, spa);
 }
 
 /*
@@ -3535,6 +3599,8 @@ spa_ld_get_props(spa_t *spa)
 		spa_prop_find(spa, ZPOOL_PROP_AUTOEXPAND, &spa->spa_autoexpand);
 		spa_prop_find(spa, ZPOOL_PROP_MULTIHOST, &spa->spa_multihost);
 		spa_prop_find(spa, ZPOOL_PROP_AUTOTRIM, &spa->spa_autotrim);
+		spa_prop_find(spa, ZPOOL_PROP_SCANLATENCY,
+		    &spa->spa_scan_latency);
 		spa->spa_autoreplace = (autoreplace != 0);
 	}
 
@@ -4044,6 +4110,27 @@ spa_ld_mos_with_trusted_config(spa_t *spa, spa_import_type_t type,
 	return (0);
 }
 
+static const char *spa_load_phase_name[SPA_LOAD_PHASES] = {
+	"MOS", "metadata", "vdev metadata", "dedup tables", "verify logs",
+	"verify pool data", "finish", "total"
+};
+
+/*
+ * Record the duration of a spa_load_impl() phase in the pool's "load"
+ * kstat and the debug log, and return the start time of the next one.
+ */
+static hrtime_t
+spa_load_phase_done(spa_t *spa, spa_load_phase_t phase, hrtime_t start)
+{
+	hrtime_t now = gethrtime();
+
+	spa_load_stats_set(spa, phase, now - start);
+	spa_load_note(spa, "%s took %llu ms", spa_load_phase_name[phase],
+	    (u_longlong_t)NSEC2MSEC(now - start));
+
+	return (now);
+}
+
 /*
  * Load an existing storage pool, using the config provided. This config
  * describes which vdevs are part of the pool and is later validated against
@@ -4058,11 +4145,14 @@ spa_load_impl(spa_t *spa, spa_import_type_t type, char **ereport)
 	boolean_t checkpoint_rewind =
 	    (spa->spa_import_flags & ZFS_IMPORT_CHECKPOINT);
 	boolean_t update_config_cache = B_FALSE;
+	hrtime_t load_start = gethrtime();
+	hrtime_t phase_start = load_start;
 
 	ASSERT(MUTEX_HELD(&spa_namespace_lock));
 	ASSERT(spa->spa_config_source != SPA_CONFIG_SRC_NONE);
 
 	spa_load_note(spa, "LOADING");
+	spa_load_stats_reset(spa);
 
 	error = spa_ld_mos_with_trusted_config(spa, type, &update_config_cache);
 	if (error != 0)
@@ -4102,6 +4192,9 @@ spa_load_impl(spa_t *spa, spa_import_type_t type, char **ereport)
 			return (error);
 	}
 
+	phase_start = spa_load_phase_done(spa, SPA_LOAD_PHASE_MOS,
+	    phase_start);
+
 	/*
 	 * Retrieve the checkpoint txg if the pool has a checkpoint.
 	 */
@@ -4152,6 +4245,9 @@ spa_load_impl(spa_t *spa, spa_import_type_t type, char **ereport)
 	if (error != 0)
 		return (error);
 
+	phase_start = spa_load_phase_done(spa, SPA_LOAD_PHASE_METADATA,
+	    phase_start);
+
 	/*
 	 * Load the metadata for all vdevs. Also check if unopenable devices
 	 * should be autoreplaced.
@@ -4160,10 +4256,16 @@ spa_load_impl(spa_t *spa, spa_import_type_t type, char **ereport)
 	if (error != 0)
 		return (error);
 
+	phase_start = spa_load_phase_done(spa, SPA_LOAD_PHASE_VDEV_METADATA,
+	    phase_start);
+
 	error = spa_ld_load_dedup_tables(spa);
 	if (error != 0)
 		return (error);
 
+	phase_start = spa_load_phase_done(spa, SPA_LOAD_PHASE_DEDUP_TABLES,
+	    phase_start);
+
 	/*
 	 * Verify the logs now to make sure we don't have any unexpected errors
 	 * when we claim log blocks later.
@@ -4172,6 +4274,9 @@ spa_load_impl(spa_t *spa, spa_import_type_t type, char **ereport)
 	if (error != 0)
 		return (error);
 
+	phase_start = spa_load_phase_done(spa, SPA_LOAD_PHASE_VERIFY_LOGS,
+	    phase_start);
+
 	if (missing_feat_write) {
 		ASSERT(spa->spa_load_state == SPA_LOAD_TRYIMPORT);
 
@@ -4193,6 +4298,9 @@ spa_load_impl(spa_t *spa, spa_import_type_t type, char **ereport)
 	if (error != 0)
 		return (error);
 
+	phase_start = spa_load_phase_done(spa, SPA_LOAD_PHASE_VERIFY_POOL_DATA,
+	    phase_start);
+
 	/*
 	 * Calculate the deflated space for the pool. This must be done before
 	 * we write anything to the pool because we'd need to update the space
@@ -4286,6 +4394,8 @@ spa_load_impl(spa_t *spa, spa_import_type_t type, char **ereport)
 		spa_config_exit(spa, SCL_CONFIG, FTAG);
 	}
 
+	(void) spa_load_phase_done(spa, SPA_LOAD_PHASE_FINISH, phase_start);
+	(void) spa_load_phase_done(spa, SPA_LOAD_PHASE_TOTAL, load_start);
 	spa_load_note(spa, "LOADED");
 
 	return (0);
@@ -4849,6 +4959,113 @@ spa_get_stats(const char *name, nvlist_t **config,
 	return (error);
 }
 
+/*
+ * Fill in one spa_get_vdev_stats() record for the given vdev, returning a
+ * pointer to the next record.
+ */
+static uint64_t *
+spa_vdev_stats_record(vdev_t *vd, uint64_t *rec, boolean_t extended)
+{
+	vdev_stat_t *vs = (vdev_stat_t *)&rec[1];
+	vdev_stat_ex_t *vsx = (vdev_stat_ex_t *)(vs + 1);
+
+	rec[0] = vd->vdev_guid;
+	vdev_get_stats_ex(vd, vs, extended ? vsx : NULL);
+
+	return (rec + ZPOOL_VDEV_STATS_WORDS(extended));
+}
+
+static uint64_t *
+spa_vdev_stats_tree(vdev_t *vd, uint64_t *rec, boolean_t extended)
+{
+	rec = spa_vdev_stats_record(vd, rec, extended);
+	for (uint64_t c = 0; c < vd->vdev_children; c++)
+		rec = spa_vdev_stats_tree(vd->vdev_child[c], rec, extended);
+
+	return (rec);
+}
+
+static uint64_t
+spa_vdev_stats_count(vdev_t *vd)
+{
+	uint64_t count = 1;
+
+	for (uint64_t c = 0; c < vd->vdev_children; c++)
+		count += spa_vdev_stats_count(vd->vdev_child[c]);
+
+	return (count);
+}
+
+/*
+ * Return the statistics of every vdev in the pool as an array of fixed
+ * size records, without generating the pool config.  This is meant for
+ * callers such as 'zpool iostat' that poll the stats of large pools at
+ * short intervals.  The records follow the order in which spa_get_stats()
+ * lists the vdevs: the vdev tree depth first, then the level 2 cache
+ * devices.  The config generation is returned alongside so that callers
+ * can tell when the layout has changed.
+ */
+int
+spa_get_vdev_stats(const char *name, boolean_t extended, nvlist_t *outnvl)
+{
+	nvlist_t **l2cache = NULL;
+	uint_t i, j, nl2cache = 0;
+	uint64_t *recs, *rec, count, guid;
+	size_t size;
+	spa_t *spa;
+	vdev_t *vd;
+	int error;
+
+	if ((error = spa_open(name, &spa, FTAG)) != 0)
+		return (error);
+
+	spa_config_enter(spa, SCL_CONFIG, FTAG, RW_READER);
+
+	count = spa_vdev_stats_count(spa->spa_root_vdev);
+	if (spa->spa_l2cache.sav_count != 0) {
+		VERIFY0(nvlist_lookup_nvlist_array(spa->spa_l2cache.sav_config,
+		    ZPOOL_CONFIG_L2CACHE, &l2cache, &nl2cache));
+		count += nl2cache;
+	}
+
+	size = count * ZPOOL_VDEV_STATS_WORDS(extended) * sizeof (uint64_t);
+	recs = kmem_zalloc(size, KM_SLEEP);
+
+	rec = spa_vdev_stats_tree(spa->spa_root_vdev, recs, extended);
+	for (i = 0; i < nl2cache; i++) {
+		guid = fnvlist_lookup_uint64(l2cache[i], ZPOOL_CONFIG_GUID);
+
+		vd = NULL;
+		for (j = 0; j < spa->spa_l2cache.sav_count; j++) {
+			if (guid == spa->spa_l2cache.sav_vdevs[j]->vdev_guid) {
+				vd = spa->spa_l2cache.sav_vdevs[j];
+				break;
+			}
+		}
+		ASSERT(vd != NULL);
+
+		if (vd != NULL) {
+			rec = spa_vdev_stats_record(vd, rec, extended);
+		} else {
+			rec[0] = guid;
+			rec += ZPOOL_VDEV_STATS_WORDS(extended);
+		}
+	}
+
+	fnvlist_add_uint64(outnvl, ZPOOL_VDEV_STATS_GENERATION,
+	    spa->spa_config_generation);
+	spa_config_exit(spa, SCL_CONFIG, FTAG);
+	spa_close(spa, FTAG);
+
+	fnvlist_add_uint64(outnvl, ZPOOL_VDEV_STATS_RECORD_SIZE,
+	    ZPOOL_VDEV_STATS_WORDS(extended));
+	fnvlist_add_uint64_array(outnvl, ZPOOL_VDEV_STATS_RECORDS, recs,
+	    count * ZPOOL_VDEV_STATS_WORDS(extended));
+	kmem_free(recs, size);
+
+	return (0);
+}
+
 /*
  * Validate that the auxiliary device array is well formed.  We must have an
  * array of nvlists, each which describes a valid leaf vdev.  If this is an
@@ -5297,6 +5514,8 @@ spa_create(const char *pool, nvlist_t *nvroot, nvlist_t *props,
 	spa->spa_autoexpand = zpool_prop_default_numeric(ZPOOL_PROP_AUTOEXPAND);
 	spa->spa_multihost = zpool_prop_default_numeric(ZPOOL_PROP_MULTIHOST);
 	spa->spa_autotrim = zpool_prop_default_numeric(ZPOOL_PROP_AUTOTRIM);
+	spa->spa_scan_latency =
+	    zpool_prop_default_numeric(ZPOOL_PROP_SCANLATENCY);
 
 	if (props != NULL) {
 		spa_configfile_set(spa, props, B_FALSE);
@@ -7721,6 +7940,18 @@ spa_async_suspend(spa_t *spa)
 	zthr_t *discard_thread = spa->spa_checkpoint_discard_zthr;
 	if (discard_thread != NULL)
 		zthr_cancel(discard_thread);
+
+	zthr_t *warmup_thread = spa->spa_ddt_warmup_zthr;
+	if (warmup_thread != NULL)
+		zthr_cancel(warmup_thread);
+
+	zthr_t *ll_delete_thread = spa->spa_livelist_delete_zthr;
+	if (ll_delete_thread != NULL)
+		zthr_cancel(ll_delete_thread);
+
+	zthr_t *ll_condense_thread = spa->spa_livelist_condense_zthr;
+	if (ll_condense_thread != NULL)
+		zthr_cancel(ll_condense_thread);
 }
 
 void
@@ -7739,6 +7970,18 @@ spa_async_resume(spa_t *spa)
 	zthr_t *discard_thread = spa->spa_checkpoint_discard_zthr;
 	if (discard_thread != NULL)
 		zthr_resume(discard_thread);
+
+	zthr_t *warmup_thread = spa->spa_ddt_warmup_zthr;
+	if (warmup_thread != NULL)
+		zthr_resume(warmup_thread);
+
+	zthr_t *ll_delete_thread = spa->spa_livelist_delete_zthr;
+	if (ll_delete_thread != NULL)
+		zthr_resume(ll_delete_thread);
+
+	zthr_t *ll_condense_thread = spa->spa_livelist_condense_zthr;
+	if (ll_condense_thread != NULL)
+		zthr_resume(ll_condense_thread);
 }
 
 static void
@@ -8186,6 +8429,9 @@ spa_sync_props(void *arg, dmu_tx_t *tx)
 			case ZPOOL_PROP_MULTIHOST:
 				spa->spa_multihost = intval;
 				break;
+			case ZPOOL_PROP_SCANLATENCY:
+				spa->spa_scan_latency = intval;
+				break;
 			default:
 				break;
 			}
@@ -628,6 +628,7 @@ spa_add(const char *name, nvlist_t *config, const char *altroot)
 	mutex_init(&spa->spa_suspend_lock, NULL, MUTEX_DEFAULT, NULL);
 	mutex_init(&spa->spa_feat_stats_lock, NULL, MUTEX_DEFAULT, NULL);
 	mutex_init(&spa->spa_vdev_top_lock, NULL, MUTEX_DEFAULT, NULL);
+	mutex_init(&spa->spa_vdev_load_lock, NULL, MUTEX_DEFAULT, NULL);
 
 	cv_init(&spa->spa_async_cv, NULL, CV_DEFAULT, NULL);
 	cv_init(&spa->spa_evicting_os_cv, NULL, CV_DEFAULT, NULL);
@@ -790,6 +791,7 @@ spa_remove(spa_t *spa)
 	mutex_destroy(&spa->spa_scrub_lock);
 	mutex_destroy(&spa->spa_suspend_lock);
 	mutex_destroy(&spa->spa_vdev_top_lock);
+	mutex_destroy(&spa->spa_vdev_load_lock);
 	mutex_destroy(&spa->spa_feat_stats_lock);
 
 	kmem_free(spa, sizeof (spa_t));
@@ -2092,7 +2094,9 @@ spa_init(int mode)
 	dmu_init();
 	zil_init();
 	fletcher_4_init();
+	chksum_init();
 	vdev_cache_stat_init();
+	vdev_queue_stat_init();
 	vdev_raidz_math_init();
 	zfs_prop_init();
 	zpool_prop_init();
@@ -2109,8 +2113,10 @@ spa_fini(void)
 
 	spa_evict_all();
 
+	vdev_queue_stat_fini();
 	vdev_cache_stat_fini();
 	vdev_raidz_math_fini();
+	chksum_fini();
 	fletcher_4_fini();
 	zil_fini();
 	dmu_fini();
@@ -2224,6 +2230,7 @@ spa_scan_stat_init(spa_t *spa)
 	spa->spa_scan_pass_scrub_spent_paused = 0;
 	spa->spa_scan_pass_exam = 0;
 	spa->spa_scan_pass_issued = 0;
+	spa->spa_scan_pass_meta_issued = 0;
 	vdev_scan_stat_init(spa->spa_root_vdev);
 }
 
@@ -2256,6 +2263,7 @@ spa_scan_get_stats(spa_t *spa, pool_scan_stat_t *ps)
 	ps->pss_pass_start = spa->spa_scan_pass_start;
 	ps->pss_pass_exam = spa->spa_scan_pass_exam;
 	ps->pss_pass_issued = spa->spa_scan_pass_issued;
+	ps->pss_pass_meta_issued = spa->spa_scan_pass_meta_issued;
 	ps->pss_pass_scrub_pause = spa->spa_scan_pass_scrub_pause;
 	ps->pss_pass_scrub_spent_paused = spa->spa_scan_pass_scrub_spent_paused;
 
@@ -1045,6 +1045,160 @@ spa_iostats_destroy(spa_t *spa)
 	mutex_destroy(&shk->lock);
 }
 
+static spa_load_stats_t spa_load_stats_template = {
+	{ "mos_ns",				KSTAT_DATA_UINT64 },
+	{ "metadata_ns",			KSTAT_DATA_UINT64 },
+	{ "vdev_metadata_ns",			KSTAT_DATA_UINT64 },
+	{ "dedup_tables_ns",			KSTAT_DATA_UINT64 },
+	{ "verify_logs_ns",			KSTAT_DATA_UINT64 },
+	{ "verify_pool_data_ns",		KSTAT_DATA_UINT64 },
+	{ "finish_ns",				KSTAT_DATA_UINT64 },
+	{ "total_ns",				KSTAT_DATA_UINT64 },
+};
+
+/*
+ * Clear the phase durations at the start of each spa_load() attempt, so
+ * that the kstat always describes the most recent one.
+ */
+void
+spa_load_stats_reset(spa_t *spa)
+{
+	spa_stats_history_t *shk = &spa->spa_stats.load_stats;
+	kstat_t *ksp = shk->kstat;
+
+	if (ksp == NULL)
+		return;
+
+	mutex_enter(&shk->lock);
+	memcpy(ksp->ks_data, &spa_load_stats_template,
+	    sizeof (spa_load_stats_t));
+	mutex_exit(&shk->lock);
+}
+
+void
+spa_load_stats_set(spa_t *spa, spa_load_phase_t phase, hrtime_t duration)
+{
+	spa_stats_history_t *shk = &spa->spa_stats.load_stats;
+	kstat_t *ksp = shk->kstat;
+	kstat_named_t *kn;
+
+	ASSERT3U(phase, <, SPA_LOAD_PHASES);
+	if (ksp == NULL)
+		return;
+
+	kn = (kstat_named_t *)ksp->ks_data;
+	mutex_enter(&shk->lock);
+	kn[phase].value.ui64 = duration;
+	mutex_exit(&shk->lock);
+}
+
+static void
+spa_load_stats_init(spa_t *spa)
+{
+	spa_stats_history_t *shk = &spa->spa_stats.load_stats;
+
+	mutex_init(&shk->lock, NULL, MUTEX_DEFAULT, NULL);
+
+	char *name = kmem_asprintf("zfs/%s", spa_name(spa));
+	kstat_t *ksp = kstat_create(name, 0, "load", "misc",
+	    KSTAT_TYPE_NAMED,
+	    sizeof (spa_load_stats_t) / sizeof (kstat_named_t),
+	    KSTAT_FLAG_VIRTUAL);
+
+	shk->kstat = ksp;
+	if (ksp) {
+		int size = sizeof (spa_load_stats_t);
+		ksp->ks_lock = &shk->lock;
+		ksp->ks_private = spa;
+		ksp->ks_data = kmem_alloc(size, KM_SLEEP);
+		memcpy(ksp->ks_data, &spa_load_stats_template, size);
+		kstat_install(ksp);
+	}
+
+	strfree(name);
+}
+
+static void
+spa_load_stats_destroy(spa_t *spa)
+{
+	spa_stats_history_t *shk = &spa->spa_stats.load_stats;
+	kstat_t *ksp = shk->kstat;
+	if (ksp) {
+		kmem_free(ksp->ks_data, sizeof (spa_load_stats_t));
+		kstat_delete(ksp);
+	}
+
+	mutex_destroy(&shk->lock);
+}
+
+static spa_ddt_warmup_stats_t spa_ddt_warmup_stats_template = {
+	{ "bytes_total",			KSTAT_DATA_UINT64 },
+	{ "bytes_read",				KSTAT_DATA_UINT64 },
+	{ "done",				KSTAT_DATA_UINT64 },
+};
+
+/*
+ * Publish the DDT warm-up progress.  The warm-up thread calls this after
+ * every chunk it reads, and spa_unload() clears it when the pool goes away.
+ */
+void
+spa_ddt_warmup_stats_set(spa_t *spa, uint64_t total, uint64_t read,
+    boolean_t done)
+{
+	spa_stats_history_t *shk = &spa->spa_stats.ddt_warmup;
+	kstat_t *ksp = shk->kstat;
+	spa_ddt_warmup_stats_t *dws;
+
+	if (ksp == NULL)
+		return;
+
+	dws = ksp->ks_data;
+	mutex_enter(&shk->lock);
+	dws->bytes_total.value.ui64 = total;
+	dws->bytes_read.value.ui64 = read;
+	dws->done.value.ui64 = done;
+	mutex_exit(&shk->lock);
+}
+
+static void
+spa_ddt_warmup_stats_init(spa_t *spa)
+{
+	spa_stats_history_t *shk = &spa->spa_stats.ddt_warmup;
+
+	mutex_init(&shk->lock, NULL, MUTEX_DEFAULT, NULL);
+
+	char *name = kmem_asprintf("zfs/%s", spa_name(spa));
+	kstat_t *ksp = kstat_create(name, 0, "ddt_warmup", "misc",
+	    KSTAT_TYPE_NAMED,
+	    sizeof (spa_ddt_warmup_stats_t) / sizeof (kstat_named_t),
+	    KSTAT_FLAG_VIRTUAL);
+
+	shk->kstat = ksp;
+	if (ksp) {
+		int size = sizeof (spa_ddt_warmup_stats_t);
+		ksp->ks_lock = &shk->lock;
+		ksp->ks_private = spa;
+		ksp->ks_data = kmem_alloc(size, KM_SLEEP);
+		memcpy(ksp->ks_data, &spa_ddt_warmup_stats_template, size);
+		kstat_install(ksp);
+	}
+
+	strfree(name);
+}
+
+static void
+spa_ddt_warmup_stats_destroy(spa_t *spa)
+{
+	spa_stats_history_t *shk = &spa->spa_stats.ddt_warmup;
+	kstat_t *ksp = shk->kstat;
+	if (ksp) {
+		kmem_free(ksp->ks_data, sizeof (spa_ddt_warmup_stats_t));
+		kstat_delete(ksp);
+	}
+
+	mutex_destroy(&shk->lock);
+}
+
 void
 spa_stats_init(spa_t *spa)
 {
@@ -1054,11 +1208,15 @@ spa_stats_init(spa_t *spa)
 	spa_io_history_init(spa);
 	spa_mmp_history_init(spa);
 	spa_iostats_init(spa);
+	spa_load_stats_init(spa);
+	spa_ddt_warmup_stats_init(spa);
 }
 
 void
 spa_stats_destroy(spa_t *spa)
 {
+	spa_ddt_warmup_stats_destroy(spa);
+	spa_load_stats_destroy(spa);
 	spa_iostats_destroy(spa);
 	spa_tx_assign_destroy(spa);
 	spa_txg_history_destroy(spa);
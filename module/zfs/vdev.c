@@ -1198,14 +1198,17 @@ vdev_metaslab_group_create(vdev_t *vd)
 		/*
 		 * The spa ashift values currently only reflect the
 		 * general vdev classes. Class destination is late
-		 * binding so ashift checking had to wait until now
+		 * binding so ashift checking had to wait until now.
+		 * vdev_load() gets here for several top-level vdevs at once.
 		 */
 		if (vd->vdev_top == vd && vd->vdev_ashift != 0 &&
 		    mc == spa_normal_class(spa) && vd->vdev_aux == NULL) {
+			mutex_enter(&spa->spa_vdev_load_lock);
 			if (vd->vdev_ashift > spa->spa_max_ashift)
 				spa->spa_max_ashift = vd->vdev_ashift;
 			if (vd->vdev_ashift < spa->spa_min_ashift)
 				spa->spa_min_ashift = vd->vdev_ashift;
+			mutex_exit(&spa->spa_vdev_load_lock);
 		}
 	}
 }
@@ -1219,6 +1222,8 @@ vdev_metaslab_init(vdev_t *vd, uint64_t txg)
 	uint64_t oldc = vd->vdev_ms_count;
 	uint64_t newc = vd->vdev_asize >> vd->vdev_ms_shift;
 	metaslab_t **mspp;
+	uint64_t *objects = NULL;
+	size_t objsize;
 	int error;
 	boolean_t expanding = (oldc != 0);
 
@@ -1243,24 +1248,42 @@ vdev_metaslab_init(vdev_t *vd, uint64_t txg)
 
 	vd->vdev_ms = mspp;
 	vd->vdev_ms_count = newc;
+
+	/*
+	 * vdev_ms_array may be 0 if we are creating the "fake"
+	 * metaslabs for an indirect vdev for zdb's leak detection.
+	 * See zdb_leak_init().
+	 *
+	 * Read the space map object numbers of all new metaslabs in a
+	 * single request and prefetch their dnodes, so that opening the
+	 * space maps below does not issue one dependent read per metaslab.
+	 */
+	objsize = (newc - oldc) * sizeof (uint64_t);
+	if (txg == 0 && vd->vdev_ms_array != 0 && objsize != 0) {
+		objects = kmem_alloc(objsize, KM_SLEEP);
+		error = dmu_read(mos, vd->vdev_ms_array,
+		    oldc * sizeof (uint64_t), objsize, objects,
+		    DMU_READ_PREFETCH);
+		if (error != 0) {
+			vdev_dbgmsg(vd, "unable to read the metaslab "
+			    "array [error=%d]", error);
+			kmem_free(objects, objsize);
+			return (error);
+		}
+		for (m = oldc; m < newc; m++) {
+			/* Metaslabs without a space map yet have object 0 */
+			if (objects[m - oldc] == 0)
+				continue;
+			dmu_prefetch(mos, objects[m - oldc], 0, 0, 0,
+			    ZIO_PRIORITY_SYNC_READ);
+		}
+	}
+
 	for (m = oldc; m < newc; m++) {
 		uint64_t object = 0;
 
-		/*
-		 * vdev_ms_array may be 0 if we are creating the "fake"
-		 * metaslabs for an indirect vdev for zdb's leak detection.
-		 * See zdb_leak_init().
-		 */
-		if (txg == 0 && vd->vdev_ms_array != 0) {
-			error = dmu_read(mos, vd->vdev_ms_array,
-			    m * sizeof (uint64_t), sizeof (uint64_t), &object,
-			    DMU_READ_PREFETCH);
-			if (error != 0) {
-				vdev_dbgmsg(vd, "unable to read the metaslab "
-				    "array [error=%d]", error);
-				return (error);
-			}
-		}
+		if (objects != NULL)
+			object = objects[m - oldc];
 
 #ifndef _KERNEL
 		/*
@@ -1278,10 +1301,15 @@ vdev_metaslab_init(vdev_t *vd, uint64_t txg)
 		if (error != 0) {
 			vdev_dbgmsg(vd, "metaslab_init failed [error=%d]",
 			    error);
+			if (objects != NULL)
+				kmem_free(objects, objsize);
 			return (error);
 		}
 	}
 
+	if (objects != NULL)
+		kmem_free(objects, objsize);
+
 	if (txg == 0)
 		spa_config_enter(spa, SCL_ALLOC, FTAG, RW_WRITER);
 
@@ -2908,20 +2936,72 @@ vdev_checkpoint_sm_object(vdev_t *vd)
 	return (sm_obj);
 }
 
+/*
+ * Mark a vdev that failed to load as corrupt.  The top-level vdevs load in
+ * parallel and the new state propagates up to the root vdev they share, so
+ * this is serialized.
+ */
+static void
+vdev_load_set_corrupt(vdev_t *vd)
+{
+	spa_t *spa = vd->vdev_spa;
+
+	mutex_enter(&spa->spa_vdev_load_lock);
+	vdev_set_state(vd, B_FALSE, VDEV_STATE_CANT_OPEN,
+	    VDEV_AUX_CORRUPT_DATA);
+	mutex_exit(&spa->spa_vdev_load_lock);
+}
+
+static void
+vdev_load_child(void *arg)
+{
+	vdev_t *vd = arg;
+
+	vd->vdev_load_error = vdev_load(vd);
+}
+
 int
 vdev_load(vdev_t *vd)
 {
+	int children = vd->vdev_children;
 	int error = 0;
+	taskq_t *tq = NULL;
+
+	/*
+	 * Most of the time spent here goes to the dependent MOS reads done
+	 * by vdev_metaslab_init() for each top-level vdev, so load the
+	 * top-level vdevs in parallel.  Unlike vdev_open_children() no
+	 * devices are opened here, so this also applies to zvol backed
+	 * pools.
+	 */
+	if (vd == vd->vdev_spa->spa_root_vdev && children > 1) {
+		tq = taskq_create("vdev_load", children, minclsyspri,
+		    children, children, TASKQ_PREPOPULATE);
+	}
+
 	/*
 	 * Recursively load all children.
 	 */
-	for (int c = 0; c < vd->vdev_children; c++) {
-		error = vdev_load(vd->vdev_child[c]);
-		if (error != 0) {
-			return (error);
+	for (int c = 0; c < children; c++) {
+		vdev_t *cvd = vd->vdev_child[c];
+
+		if (tq == NULL) {
+			cvd->vdev_load_error = vdev_load(cvd);
+		} else {
+			VERIFY(taskq_dispatch(tq, vdev_load_child, cvd,
+			    TQ_SLEEP) != 0);
 		}
 	}
 
+	if (tq != NULL)
+		taskq_destroy(tq);
+
+	for (int c = 0; c < children; c++) {
+		error = vd->vdev_child[c]->vdev_load_error;
+		if (error != 0)
+			return (error);
+	}
+
 	vdev_set_deflate_ratio(vd);
 
 	/*
@@ -2946,8 +3026,7 @@ vdev_load(vdev_t *vd)
 		vdev_metaslab_group_create(vd);
 
 		if (vd->vdev_ashift == 0 || vd->vdev_asize == 0) {
-			vdev_set_state(vd, B_FALSE, VDEV_STATE_CANT_OPEN,
-			    VDEV_AUX_CORRUPT_DATA);
+			vdev_load_set_corrupt(vd);
 			vdev_dbgmsg(vd, "vdev_load: invalid size. ashift=%llu, "
 			    "asize=%llu", (u_longlong_t)vd->vdev_ashift,
 			    (u_longlong_t)vd->vdev_asize);
@@ -2955,8 +3034,7 @@ vdev_load(vdev_t *vd)
 		} else if ((error = vdev_metaslab_init(vd, 0)) != 0) {
 			vdev_dbgmsg(vd, "vdev_load: metaslab_init failed "
 			    "[error=%d]", error);
-			vdev_set_state(vd, B_FALSE, VDEV_STATE_CANT_OPEN,
-			    VDEV_AUX_CORRUPT_DATA);
+			vdev_load_set_corrupt(vd);
 			return (error);
 		}
 
@@ -2985,8 +3063,9 @@ vdev_load(vdev_t *vd)
 			 */
 			vd->vdev_stat.vs_checkpoint_space =
 			    -space_map_allocated(vd->vdev_checkpoint_sm);
-			vd->vdev_spa->spa_checkpoint_info.sci_dspace +=
-			    vd->vdev_stat.vs_checkpoint_space;
+			atomic_add_64(
+			    &vd->vdev_spa->spa_checkpoint_info.sci_dspace,
+			    vd->vdev_stat.vs_checkpoint_space);
 		}
 	}
 
@@ -2994,8 +3073,7 @@ vdev_load(vdev_t *vd)
 	 * If this is a leaf vdev, load its DTL.
 	 */
 	if (vd->vdev_ops->vdev_op_leaf && (error = vdev_dtl_load(vd)) != 0) {
-		vdev_set_state(vd, B_FALSE, VDEV_STATE_CANT_OPEN,
-		    VDEV_AUX_CORRUPT_DATA);
+		vdev_load_set_corrupt(vd);
 		vdev_dbgmsg(vd, "vdev_load: vdev_dtl_load failed "
 		    "[error=%d]", error);
 		return (error);
@@ -3010,8 +3088,7 @@ vdev_load(vdev_t *vd)
 
 		if ((error = space_map_open(&vd->vdev_obsolete_sm, mos,
 		    obsolete_sm_object, 0, vd->vdev_asize, 0))) {
-			vdev_set_state(vd, B_FALSE, VDEV_STATE_CANT_OPEN,
-			    VDEV_AUX_CORRUPT_DATA);
+			vdev_load_set_corrupt(vd);
 			vdev_dbgmsg(vd, "vdev_load: space_map_open failed for "
 			    "obsolete spacemap (obj %llu) [error=%d]",
 			    (u_longlong_t)obsolete_sm_object, error);
@@ -161,6 +161,43 @@ uint32_t zfs_vdev_initializing_max_active = 1;
 uint32_t zfs_vdev_trim_min_active = 1;
 uint32_t zfs_vdev_trim_max_active = 2;
 
+/*
+ * When the pool's scanlatency property is set, each leaf vdev adapts the
+ * number of scrub/resilver i/os it keeps active between
+ * zfs_vdev_scrub_min_active and zfs_vdev_scrub_throttle_max_active (or
+ * zfs_vdev_scrub_max_active, if that is larger).  The default scrub range of
+ * 1 to 2 leaves a throttle nothing to work with, so a latency target trades
+ * the fixed limit for a wider, adaptive one.  Every
+ * zfs_vdev_scrub_throttle_interval_ms the moving average of sync read
+ * latency on the device is compared with the target: above it the limit is
+ * halved, below it (or when no sync reads completed in the interval) the
+ * limit grows by one.  The latency is measured from when the logical read
+ * was issued, so it includes the time spent queued behind scan i/o and not
+ * just the device's service time.  Completions drive the adjustments, so a
+ * device with no i/o in flight keeps its last limit until i/o resumes.
+ */
+uint32_t zfs_vdev_scrub_throttle_interval_ms = 100;
+uint32_t zfs_vdev_scrub_throttle_max_active = 16;
+
+typedef struct vdev_scan_throttle_stats {
+	kstat_named_t vsts_backoffs;
+	kstat_named_t vsts_increases;
+	kstat_named_t vsts_vdevs_throttled;
+} vdev_scan_throttle_stats_t;
+
+static vdev_scan_throttle_stats_t vdev_scan_throttle_stats = {
+	{ "backoffs",		KSTAT_DATA_UINT64 },
+	{ "increases",		KSTAT_DATA_UINT64 },
+	{ "vdevs_throttled",	KSTAT_DATA_UINT64 }
+};
+
+#define	VSTSTAT_BUMP(stat)	\
+	atomic_inc_64(&vdev_scan_throttle_stats.stat.value.ui64)
+#define	VSTSTAT_BUMPDOWN(stat)	\
+	atomic_dec_64(&vdev_scan_throttle_stats.stat.value.ui64)
+
+static kstat_t *vdev_scan_throttle_ksp;
+
 /*
  * When the pool has less than zfs_vdev_async_write_active_min_dirty_percent
  * dirty data, use zfs_vdev_async_write_min_active.  When it has more than
@@ -344,9 +381,24 @@ vdev_queue_max_async_writes(spa_t *spa)
 	return (writes);
 }
 
+/*
+ * The most scrub/resilver i/os a leaf vdev may keep active.  See
+ * zfs_vdev_scrub_throttle_max_active.
+ */
+static uint32_t
+vdev_queue_scan_max_active(spa_t *spa)
+{
+	if (spa->spa_scan_latency == 0)
+		return (zfs_vdev_scrub_max_active);
+	return (MAX(zfs_vdev_scrub_max_active,
+	    zfs_vdev_scrub_throttle_max_active));
+}
+
 static int
-vdev_queue_class_max_active(spa_t *spa, zio_priority_t p)
+vdev_queue_class_max_active(vdev_queue_t *vq, zio_priority_t p)
 {
+	spa_t *spa = vq->vq_vdev->vdev_spa;
+
 	switch (p) {
 	case ZIO_PRIORITY_SYNC_READ:
 		return (zfs_vdev_sync_read_max_active);
@@ -357,7 +409,8 @@ vdev_queue_class_max_active(spa_t *spa, zio_priority_t p)
 	case ZIO_PRIORITY_ASYNC_WRITE:
 		return (vdev_queue_max_async_writes(spa));
 	case ZIO_PRIORITY_SCRUB:
-		return (zfs_vdev_scrub_max_active);
+		return (MIN(vq->vq_scan_max_active,
+		    vdev_queue_scan_max_active(spa)));
     case ZIO_PRIORITY_REMOVAL:
 		return (zfs_vdev_removal_max_active);
 	case ZIO_PRIORITY_INITIALIZING:
@@ -377,7 +430,6 @@ vdev_queue_class_max_active(spa_t *spa, zio_priority_t p)
 static zio_priority_t
 vdev_queue_class_to_issue(vdev_queue_t *vq)
 {
-	spa_t *spa = vq->vq_vdev->vdev_spa;
 	zio_priority_t p;
 
 	if (avl_numnodes(&vq->vq_active_tree) >= zfs_vdev_max_active)
@@ -398,7 +450,7 @@ vdev_queue_class_to_issue(vdev_queue_t *vq)
 	for (p = 0; p < ZIO_PRIORITY_NUM_QUEUEABLE; p++) {
 		if (avl_numnodes(vdev_queue_class_tree(vq, p)) > 0 &&
 		    vq->vq_class[p].vqc_active <
-		    vdev_queue_class_max_active(spa, p))
+		    vdev_queue_class_max_active(vq, p))
 			return (p);
 	}
 
@@ -448,6 +500,11 @@ vdev_queue_init(vdev_t *vd)
 	}
 
 	vq->vq_lastoffset = 0;
+	vq->vq_scan_max_active = zfs_vdev_scrub_max_active;
+	vq->vq_scan_throttled = B_FALSE;
+	vq->vq_fg_lat = 0;
+	vq->vq_fg_ts = 0;
+	vq->vq_scan_adjust_ts = 0;
 }
 
 void
@@ -463,9 +520,79 @@ vdev_queue_fini(vdev_t *vd)
 	avl_destroy(vdev_queue_type_tree(vq, ZIO_TYPE_WRITE));
 	avl_destroy(vdev_queue_type_tree(vq, ZIO_TYPE_TRIM));
 
+	if (vq->vq_scan_throttled)
+		VSTSTAT_BUMPDOWN(vsts_vdevs_throttled);
+
 	mutex_destroy(&vq->vq_lock);
 }
 
+void
+vdev_queue_stat_init(void)
+{
+	vdev_scan_throttle_ksp = kstat_create("zfs", 0, "vdev_scan_throttle",
+	    "misc", KSTAT_TYPE_NAMED, sizeof (vdev_scan_throttle_stats) /
+	    sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL);
+	if (vdev_scan_throttle_ksp != NULL) {
+		vdev_scan_throttle_ksp->ks_data = &vdev_scan_throttle_stats;
+		kstat_install(vdev_scan_throttle_ksp);
+	}
+}
+
+void
+vdev_queue_stat_fini(void)
+{
+	if (vdev_scan_throttle_ksp != NULL) {
+		kstat_delete(vdev_scan_throttle_ksp);
+		vdev_scan_throttle_ksp = NULL;
+	}
+}
+
+/*
+ * Adjust the scrub/resilver i/o limit of a leaf vdev against the pool's
+ * target foreground latency.  See zfs_vdev_scrub_throttle_interval_ms.
+ */
+static void
+vdev_queue_scan_throttle(vdev_queue_t *vq, hrtime_t now)
+{
+	spa_t *spa = vq->vq_vdev->vdev_spa;
+	hrtime_t target = MSEC2NSEC(spa->spa_scan_latency);
+	hrtime_t interval = MSEC2NSEC(zfs_vdev_scrub_throttle_interval_ms);
+	uint32_t max_active = vdev_queue_scan_max_active(spa);
+	uint32_t limit = MIN(vq->vq_scan_max_active, max_active);
+	boolean_t scanning, throttled;
+
+	ASSERT(MUTEX_HELD(&vq->vq_lock));
+
+	scanning = (vq->vq_class[ZIO_PRIORITY_SCRUB].vqc_active > 0 ||
+	    avl_numnodes(vdev_queue_class_tree(vq, ZIO_PRIORITY_SCRUB)) > 0);
+
+	if (target == 0) {
+		limit = max_active;
+	} else if (scanning && now - vq->vq_scan_adjust_ts >= interval) {
+		vq->vq_scan_adjust_ts = now;
+		if (now - vq->vq_fg_ts < interval && vq->vq_fg_lat > target) {
+			if (limit > zfs_vdev_scrub_min_active) {
+				limit = MAX(limit / 2,
+				    zfs_vdev_scrub_min_active);
+				VSTSTAT_BUMP(vsts_backoffs);
+			}
+		} else if (limit < max_active) {
+			limit++;
+			VSTSTAT_BUMP(vsts_increases);
+		}
+	}
+	vq->vq_scan_max_active = limit;
+
+	throttled = (limit < max_active);
+	if (throttled != vq->vq_scan_throttled) {
+		vq->vq_scan_throttled = throttled;
+		if (throttled)
+			VSTSTAT_BUMP(vsts_vdevs_throttled);
+		else
+			VSTSTAT_BUMPDOWN(vsts_vdevs_throttled);
+	}
+}
+
 static void
 vdev_queue_io_add(vdev_queue_t *vq, zio_t *zio)
 {
@@ -889,6 +1016,22 @@ vdev_queue_io_done(zio_t *zio)
 	vq->vq_io_complete_ts = gethrtime();
 	vq->vq_io_delta_ts = vq->vq_io_complete_ts - zio->io_timestamp;
 
+	if (zio->io_priority == ZIO_PRIORITY_SYNC_READ) {
+		zio_t *lio = zio->io_logical;
+		hrtime_t lat = zio->io_delta;
+
+		/*
+		 * What the reader waits for: from the logical read being
+		 * issued through the vdev queue to the device completing it.
+		 */
+		if (lio != NULL && lio->io_queued_timestamp != 0 &&
+		    lio->io_queued_timestamp < zio->io_timestamp)
+			lat = vq->vq_io_complete_ts - lio->io_queued_timestamp;
+		vq->vq_fg_lat = (7 * vq->vq_fg_lat + lat) / 8;
+		vq->vq_fg_ts = vq->vq_io_complete_ts;
+	}
+	vdev_queue_scan_throttle(vq, vq->vq_io_complete_ts);
+
 	while ((nio = vdev_queue_io_to_issue(vq)) != NULL) {
 		mutex_exit(&vq->vq_lock);
 		if (nio->io_done == vdev_queue_agg_io_done) {
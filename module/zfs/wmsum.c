@@ -0,0 +1,58 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/wmsum.h>
+
+/*
+ * Write-mostly sums trade memory and read cost for update cost: each one
+ * takes a cache line per CPU, and wmsum_value() has to touch all of them.
+ * Use them for counters that are bumped from many CPUs at once and only
+ * read when exported, such as the ARC hit and miss counters.  Counters whose
+ * value is checked by the code itself want an aggsum instead.
+ *
+ * A zeroed wmsum_t, or one that has been through wmsum_fini(), reads as
+ * zero, so kstat update callbacks do not need to care whether the owning
+ * subsystem has been initialized.
+ */
+
+void
+wmsum_init(wmsum_t *ws, uint64_t value)
+{
+	ws->wms_numbuckets = max_ncpus;
+	ws->wms_buckets = kmem_zalloc(ws->wms_numbuckets *
+	    sizeof (wmsum_bucket_t), KM_SLEEP);
+	ws->wms_buckets[0].wmsb_value = value;
+}
+
+void
+wmsum_fini(wmsum_t *ws)
+{
+	kmem_free(ws->wms_buckets, ws->wms_numbuckets *
+	    sizeof (wmsum_bucket_t));
+	ws->wms_buckets = NULL;
+	ws->wms_numbuckets = 0;
+}
+
+uint64_t
+wmsum_value(wmsum_t *ws)
+{
+	uint64_t value = 0;
+
+	for (int i = 0; i < ws->wms_numbuckets; i++)
+		value += ws->wms_buckets[i].wmsb_value;
+
+	return (value);
+}
@@ -0,0 +1,402 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Throughput of the cryptographic checksums.
+ *
+ * When the module is loaded every implementation of edonr, skein, sha256
+ * and sha512 is run through the zio_checksum entry points over a range of
+ * block sizes.  The results are published in the "chksum_bench" kstat,
+ * one row per algorithm and implementation, so the cost of picking one of
+ * these checksums for a dataset can be judged on the machine at hand.
+ * The sha2 transform used outside of the benchmark is the one selected by
+ * the ICP, see the icp_sha2_impl tunable.
+ *
+ * The "compress_cksum_bench" kstat covers the compressed write path for
+ * 128k to 1m records: lz4 alone, lz4 followed by a separate fletcher4 pass
+ * over the compressed abd, and lz4 with fletcher4 taken on the compressed
+ * buffer as zio_write_compress() does.
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/zio.h>
+#include <sys/zio_checksum.h>
+#include <sys/zio_compress.h>
+#include <sys/abd.h>
+#include <sys/sha2.h>
+
+#if defined(_KERNEL)
+
+/* Block sizes measured, 1k to 128k */
+#define	CHKSUM_BENCH_SIZES	5
+#define	CHKSUM_BENCH_MAXSIZE	(1 << SPA_OLD_MAXBLOCKSHIFT)
+#define	CHKSUM_BENCH_NS		(MSEC2NSEC(1))		/* 1ms per size */
+
+static const int chksum_bench_shift[CHKSUM_BENCH_SIZES] = {
+	10, 12, 14, 16, 17
+};
+
+typedef struct chksum_stat {
+	const char	*name;		/* checksum algorithm */
+	const char	*impl;		/* implementation */
+	zio_checksum_t	*func;
+	zio_checksum_tmpl_init_t *init;
+	zio_checksum_tmpl_free_t *free;
+	uint64_t	bw[CHKSUM_BENCH_SIZES];	/* B/s */
+} chksum_stat_t;
+
+static kstat_t *chksum_kstat = NULL;
+static chksum_stat_t *chksum_stat_data = NULL;
+static int chksum_stat_cnt = 0;
+
+static int
+chksum_kstat_headers(char *buf, size_t size)
+{
+	ssize_t off = 0;
+	int i;
+
+	off += snprintf(buf + off, size - off, "%-23s", "implementation");
+	for (i = 0; i < CHKSUM_BENCH_SIZES; i++)
+		off += snprintf(buf + off, size - off, "%8dk",
+		    1 << (chksum_bench_shift[i] - 10));
+	(void) snprintf(buf + off, size - off, "\n");
+
+	return (0);
+}
+
+static int
+chksum_kstat_data(char *buf, size_t size, void *data)
+{
+	chksum_stat_t *cs = (chksum_stat_t *)data;
+	char name[24];
+	ssize_t off = 0;
+	int i;
+
+	(void) snprintf(name, sizeof (name), "%s-%s", cs->name, cs->impl);
+	off += snprintf(buf + off, size - off, "%-23s", name);
+	/* report MiB/s */
+	for (i = 0; i < CHKSUM_BENCH_SIZES; i++)
+		off += snprintf(buf + off, size - off, "%9llu",
+		    (u_longlong_t)(cs->bw[i] >> 20));
+	(void) snprintf(buf + off, size - off, "\n");
+
+	return (0);
+}
+
+static void *
+chksum_kstat_addr(kstat_t *ksp, int64_t n)
+{
+	if (n < chksum_stat_cnt)
+		ksp->ks_private = (void *)(chksum_stat_data + n);
+	else
+		ksp->ks_private = NULL;
+
+	return (ksp->ks_private);
+}
+
+static void
+chksum_run(chksum_stat_t *cs, abd_t *abd)
+{
+	zio_cksum_salt_t salt;
+	zio_cksum_t zcp;
+	void *ctx = NULL;
+	hrtime_t start;
+	uint64_t run_bw, run_time_ns, run_count;
+	uint64_t size;
+	int i, l;
+
+	bzero(&salt, sizeof (salt));
+	if (cs->init != NULL)
+		ctx = cs->init(&salt);
+
+	for (i = 0; i < CHKSUM_BENCH_SIZES; i++) {
+		size = 1ULL << chksum_bench_shift[i];
+		run_count = 0;
+
+		kpreempt_disable();
+		start = gethrtime();
+		do {
+			for (l = 0; l < 4; l++, run_count++)
+				cs->func(abd, size, ctx, &zcp);
+
+			run_time_ns = gethrtime() - start;
+		} while (run_time_ns < CHKSUM_BENCH_NS);
+		kpreempt_enable();
+
+		run_bw = size * run_count * NANOSEC;
+		run_bw /= run_time_ns;	/* B/s */
+		cs->bw[i] = run_bw;
+	}
+
+	if (cs->free != NULL)
+		cs->free(ctx);
+
+#ifdef __APPLE__
+	dprintf("%s: %8s %-10s %16llu B/s\n", __func__, cs->name, cs->impl,
+	    cs->bw[CHKSUM_BENCH_SIZES - 1]);
+#endif
+}
+
+static void
+chksum_stat_add(const char *name, const char *impl, zio_checksum_t *func,
+    zio_checksum_tmpl_init_t *init, zio_checksum_tmpl_free_t *free)
+{
+	chksum_stat_t *cs = &chksum_stat_data[chksum_stat_cnt++];
+
+	cs->name = name;
+	cs->impl = impl;
+	cs->func = func;
+	cs->init = init;
+	cs->free = free;
+}
+
+static void
+chksum_benchmark(void)
+{
+	uint32_t sha2_cnt = sha2_impl_getcnt();
+	uint64_t sha2_sel = sha2_impl_getid();
+	abd_t *abd;
+	char *databuf;
+	int i, rows;
+	uint32_t id;
+
+	/* edonr and skein have a single implementation */
+	rows = 2 + 2 * sha2_cnt;
+	chksum_stat_data = kmem_zalloc(rows * sizeof (chksum_stat_t),
+	    KM_SLEEP);
+
+	chksum_stat_add("edonr", "generic", abd_checksum_edonr_native,
+	    abd_checksum_edonr_tmpl_init, abd_checksum_edonr_tmpl_free);
+	chksum_stat_add("skein", "generic", abd_checksum_skein_native,
+	    abd_checksum_skein_tmpl_init, abd_checksum_skein_tmpl_free);
+	for (id = 0; id < sha2_cnt; id++)
+		chksum_stat_add("sha256", sha2_impl_getname(id),
+		    abd_checksum_SHA256, NULL, NULL);
+	for (id = 0; id < sha2_cnt; id++)
+		chksum_stat_add("sha512", sha2_impl_getname(id),
+		    abd_checksum_SHA512_native, NULL, NULL);
+	ASSERT3S(chksum_stat_cnt, ==, rows);
+
+	databuf = kmem_alloc(CHKSUM_BENCH_MAXSIZE, KM_SLEEP);
+	for (i = 0; i < CHKSUM_BENCH_MAXSIZE / sizeof (uint64_t); i++)
+		((uint64_t *)databuf)[i] = (uintptr_t)(databuf + i);
+	abd = abd_get_from_buf(databuf, CHKSUM_BENCH_MAXSIZE);
+
+	chksum_run(&chksum_stat_data[0], abd);
+	chksum_run(&chksum_stat_data[1], abd);
+
+	/*
+	 * Measure each sha2 transform by temporarily selecting it.  This
+	 * runs before any pool is imported, so no other consumer observes
+	 * the change.
+	 */
+	for (i = 2; i < rows; i++) {
+		sha2_impl_setid((i - 2) % sha2_cnt);
+		chksum_run(&chksum_stat_data[i], abd);
+	}
+	sha2_impl_setid(sha2_sel);
+
+	abd_put(abd);
+	kmem_free(databuf, CHKSUM_BENCH_MAXSIZE);
+}
+
+/* Record sizes measured for the compressed write path, 128k to 1m */
+#define	CCK_BENCH_SIZES		4
+#define	CCK_BENCH_MAXSIZE	(1 << 20)
+#define	CCK_BENCH_MODES		3
+
+static const int cck_bench_shift[CCK_BENCH_SIZES] = {
+	17, 18, 19, 20
+};
+
+static const char *cck_bench_mode[CCK_BENCH_MODES] = {
+	"lz4", "lz4+fletcher4-twopass", "lz4+fletcher4-oncopy"
+};
+
+static kstat_t *cck_kstat = NULL;
+static uint64_t cck_bw[CCK_BENCH_MODES][CCK_BENCH_SIZES];	/* B/s */
+
+static int
+cck_kstat_headers(char *buf, size_t size)
+{
+	ssize_t off = 0;
+	int i;
+
+	off += snprintf(buf + off, size - off, "%-23s", "implementation");
+	for (i = 0; i < CCK_BENCH_SIZES; i++)
+		off += snprintf(buf + off, size - off, "%8dk",
+		    1 << (cck_bench_shift[i] - 10));
+	(void) snprintf(buf + off, size - off, "\n");
+
+	return (0);
+}
+
+static int
+cck_kstat_data(char *buf, size_t size, void *data)
+{
+	uint64_t *bw = (uint64_t *)data;
+	int mode = (bw - &cck_bw[0][0]) / CCK_BENCH_SIZES;
+	ssize_t off = 0;
+	int i;
+
+	off += snprintf(buf + off, size - off, "%-23s", cck_bench_mode[mode]);
+	/* report MiB/s of uncompressed data */
+	for (i = 0; i < CCK_BENCH_SIZES; i++)
+		off += snprintf(buf + off, size - off, "%9llu",
+		    (u_longlong_t)(bw[i] >> 20));
+	(void) snprintf(buf + off, size - off, "\n");
+
+	return (0);
+}
+
+static void *
+cck_kstat_addr(kstat_t *ksp, int64_t n)
+{
+	if (n < CCK_BENCH_MODES)
+		ksp->ks_private = (void *)&cck_bw[n][0];
+	else
+		ksp->ks_private = NULL;
+
+	return (ksp->ks_private);
+}
+
+static void
+cck_benchmark(void)
+{
+	zio_checksum_t *cksum_func =
+	    zio_checksum_table[ZIO_CHECKSUM_FLETCHER_4].ci_func[0];
+	hrtime_t start;
+	uint64_t run_bw, run_time_ns, run_count;
+	uint64_t size, psize;
+	zio_cksum_t zcp;
+	abd_t *src, *cabd;
+	char *databuf, *cbuf;
+	int i, mode;
+
+	/* Half of each word is zero, lz4 compresses this roughly 2:1 */
+	databuf = kmem_alloc(CCK_BENCH_MAXSIZE, KM_SLEEP);
+	for (i = 0; i < CCK_BENCH_MAXSIZE / sizeof (uint32_t); i++)
+		((uint32_t *)databuf)[i] = (i & 1) ? 0 :
+		    (uint32_t)((uintptr_t)(databuf + i) * 2654435761U);
+	cbuf = kmem_alloc(CCK_BENCH_MAXSIZE, KM_SLEEP);
+
+	for (mode = 0; mode < CCK_BENCH_MODES; mode++) {
+		for (i = 0; i < CCK_BENCH_SIZES; i++) {
+			size = 1ULL << cck_bench_shift[i];
+			src = abd_get_from_buf(databuf, size);
+			cabd = abd_get_from_buf(cbuf, size);
+			run_count = 0;
+
+			kpreempt_disable();
+			start = gethrtime();
+			do {
+				psize = zio_compress_data(ZIO_COMPRESS_LZ4,
+				    src, cbuf, size);
+				if (psize == 0)
+					psize = size;
+				psize = P2ROUNDUP(psize, sizeof (uint64_t));
+				if (mode == 1)
+					cksum_func(cabd, psize, NULL, &zcp);
+				else if (mode == 2)
+					fletcher_4_native(cbuf, psize, NULL,
+					    &zcp);
+				run_count++;
+
+				run_time_ns = gethrtime() - start;
+			} while (run_time_ns < CHKSUM_BENCH_NS);
+			kpreempt_enable();
+
+			abd_put(cabd);
+			abd_put(src);
+
+			run_bw = size * run_count * NANOSEC;
+			run_bw /= run_time_ns;	/* B/s */
+			cck_bw[mode][i] = run_bw;
+		}
+
+#ifdef __APPLE__
+		dprintf("%s: %-23s %16llu B/s\n", __func__,
+		    cck_bench_mode[mode], cck_bw[mode][CCK_BENCH_SIZES - 1]);
+#endif
+	}
+
+	kmem_free(cbuf, CCK_BENCH_MAXSIZE);
+	kmem_free(databuf, CCK_BENCH_MAXSIZE);
+}
+
+#endif /* _KERNEL */
+
+void
+chksum_init(void)
+{
+#if defined(_KERNEL)
+	chksum_benchmark();
+
+	chksum_kstat = kstat_create("zfs", 0, "chksum_bench", "misc",
+	    KSTAT_TYPE_RAW, 0, KSTAT_FLAG_VIRTUAL);
+	if (chksum_kstat != NULL) {
+		chksum_kstat->ks_data = NULL;
+		chksum_kstat->ks_ndata = UINT32_MAX;
+		kstat_set_raw_ops(chksum_kstat,
+		    chksum_kstat_headers,
+		    chksum_kstat_data,
+		    chksum_kstat_addr);
+		kstat_install(chksum_kstat);
+	}
+
+	cck_benchmark();
+
+	cck_kstat = kstat_create("zfs", 0, "compress_cksum_bench", "misc",
+	    KSTAT_TYPE_RAW, 0, KSTAT_FLAG_VIRTUAL);
+	if (cck_kstat != NULL) {
+		cck_kstat->ks_data = NULL;
+		cck_kstat->ks_ndata = UINT32_MAX;
+		kstat_set_raw_ops(cck_kstat,
+		    cck_kstat_headers,
+		    cck_kstat_data,
+		    cck_kstat_addr);
+		kstat_install(cck_kstat);
+	}
+#endif
+}
+
+void
+chksum_fini(void)
+{
+#if defined(_KERNEL)
+	if (cck_kstat != NULL) {
+		kstat_delete(cck_kstat);
+		cck_kstat = NULL;
+	}
+
+	if (chksum_kstat != NULL) {
+		kstat_delete(chksum_kstat);
+		chksum_kstat = NULL;
+	}
+
+	if (chksum_stat_data != NULL) {
+		kmem_free(chksum_stat_data,
+		    chksum_stat_cnt * sizeof (chksum_stat_t));
+		chksum_stat_data = NULL;
+		chksum_stat_cnt = 0;
+	}
+#endif
+}
@@ -1462,6 +1462,29 @@ nvlist_smush(nvlist_t *errors, size_t max)
 	return (0);
 }
 
+/*
+ * Size of the staging buffer put_nvlist() packs large nvlists through.
+ */
+#define	ZFS_PUT_NVLIST_CHUNK	(128 * 1024)
+
+typedef struct put_nvlist_arg {
+	uint64_t	pna_dst;
+	int		pna_iflags;
+} put_nvlist_arg_t;
+
+static int
+put_nvlist_cb(void *arg, const char *buf, size_t len)
+{
+	put_nvlist_arg_t *pna = arg;
+
+	if (ddi_copyout(buf, (void *)(uintptr_t)pna->pna_dst, len,
+	    pna->pna_iflags) != 0)
+		return (SET_ERROR(EFAULT));
+
+	pna->pna_dst += len;
+	return (0);
+}
+
 static int
 put_nvlist(zfs_cmd_t *zc, nvlist_t *nvl)
 {
@@ -1474,11 +1497,35 @@ put_nvlist(zfs_cmd_t *zc, nvlist_t *nvl)
 	if (size > zc->zc_nvlist_dst_size) {
 		error = SET_ERROR(ENOMEM);
 	} else {
-		packed = fnvlist_pack(nvl, &size);
-		if (ddi_copyout(packed, (void *)(uintptr_t)zc->zc_nvlist_dst,
-						size, zc->zc_iflags) != 0)
+		/*
+		 * Large nvlists, such as the config of a wide pool, are
+		 * encoded straight out to the caller's buffer in chunks.
+		 * If one nvpair is larger than a chunk, pack it whole.
+		 */
+		if (size > ZFS_PUT_NVLIST_CHUNK) {
+			put_nvlist_arg_t pna;
+
+			pna.pna_dst = zc->zc_nvlist_dst;
+			pna.pna_iflags = zc->zc_iflags;
+			packed = kmem_alloc(ZFS_PUT_NVLIST_CHUNK, KM_SLEEP);
+			error = nvlist_pack_stream(nvl, packed,
+			    ZFS_PUT_NVLIST_CHUNK, put_nvlist_cb, &pna);
+			kmem_free(packed, ZFS_PUT_NVLIST_CHUNK);
+			packed = NULL;
+		}
+
+		if (size <= ZFS_PUT_NVLIST_CHUNK || error == E2BIG) {
+			/* the size is known, so pack without sizing again */
+			packed = kmem_alloc(size, KM_SLEEP);
+			VERIFY0(nvlist_pack(nvl, &packed, &size,
+			    NV_ENCODE_NATIVE, KM_SLEEP));
+			error = ddi_copyout(packed,
+			    (void *)(uintptr_t)zc->zc_nvlist_dst, size,
+			    zc->zc_iflags);
+			kmem_free(packed, size);
+		}
+		if (error != 0)
 			error = SET_ERROR(EFAULT);
-		fnvlist_pack_free(packed, size);
 	}
 
 	zc->zc_nvlist_dst_size = size;
@@ -1760,6 +1807,32 @@ zfs_ioc_pool_stats(zfs_cmd_t *zc)
 	return (ret);
 }
 
+/*
+ * Return the stats of every vdev in the pool, without the rest of the config.
+ *
+ * innvl: {
+ *     (optional) "extended" -> (value ignored)
+ *         presence indicates vdev_stat_ex_t should be included
+ * }
+ *
+ * outnvl: {
+ *     "generation" -> pool config generation
+ *     "record_size" -> number of uint64_t words in each record
+ *     "records" -> uint64_t array of records, see spa_get_vdev_stats()
+ * }
+ */
+static const zfs_ioc_key_t zfs_keys_pool_vdev_stats[] = {
+	{ZPOOL_VDEV_STATS_EXTENDED,	DATA_TYPE_BOOLEAN,	ZK_OPTIONAL},
+};
+
+static int
+zfs_ioc_pool_vdev_stats(const char *pool, nvlist_t *innvl, nvlist_t *outnvl)
+{
+	boolean_t extended = nvlist_exists(innvl, ZPOOL_VDEV_STATS_EXTENDED);
+
+	return (spa_get_vdev_stats(pool, extended, outnvl));
+}
+
 /*
  * Try to import the given pool, returning pool stats as appropriate so that
  * user land knows which devices are available and overall pool health.
@@ -1963,6 +2036,143 @@ zfs_ioc_obj_to_stats(zfs_cmd_t *zc)
 	return (error);
 }
 
+/*
+ * Upper bound on the size of the results returned by a single
+ * ZFS_IOC_OBJS_TO_STATS call, so they normally fit the default destination
+ * buffer of libzfs_core.
+ */
+#define	ZFS_OBJS_TO_STATS_MAX_BYTES	(96 * 1024)
+
+/*
+ * Batched form of ZFS_IOC_NEXT_OBJ and ZFS_IOC_OBJ_TO_STATS: find the
+ * allocated objects in [first, last] and return the stats and path of each.
+ * Objects which are not returned were not allocated.  The per-object error is
+ * that of ZFS_IOC_OBJ_TO_STATS; the path is empty unless it is zero.
+ *
+ * innvl: {
+ *     "first" -> first object of the range
+ *     "last" -> last object of the range
+ *     "count" -> (optional) maximum number of objects to return
+ * }
+ *
+ * outnvl: {
+ *     "objects" -> object numbers (uint64 array)
+ *     "errors" -> error for each object (int32 array)
+ *     "stats" -> zfs_stat_t for each object (uint8 array)
+ *     "paths" -> path of each object (string array)
+ *     "next" -> first object of the rest of the range, absent when done
+ * }
+ */
+static const zfs_ioc_key_t zfs_keys_objs_to_stats[] = {
+	{ZFS_OBJS_TO_STATS_FIRST,	DATA_TYPE_UINT64,	0},
+	{ZFS_OBJS_TO_STATS_LAST,	DATA_TYPE_UINT64,	0},
+	{ZFS_OBJS_TO_STATS_COUNT,	DATA_TYPE_UINT64,	ZK_OPTIONAL},
+};
+
+static int
+zfs_ioc_objs_to_stats(const char *dsname, nvlist_t *innvl, nvlist_t *outnvl)
+{
+	objset_t *os;
+	uint64_t first, last, obj;
+	uint64_t count = ZFS_OBJS_TO_STATS_MAX_COUNT;
+	uint64_t *objs;
+	int32_t *errs;
+	zfs_stat_t *stats;
+	char **paths;
+	size_t bytes = 0;
+	boolean_t done = B_FALSE;
+	uint_t i, n = 0, nret;
+	int error;
+
+	first = fnvlist_lookup_uint64(innvl, ZFS_OBJS_TO_STATS_FIRST);
+	last = fnvlist_lookup_uint64(innvl, ZFS_OBJS_TO_STATS_LAST);
+	(void) nvlist_lookup_uint64(innvl, ZFS_OBJS_TO_STATS_COUNT, &count);
+	if (first > last || count == 0)
+		return (SET_ERROR(EINVAL));
+	count = MIN(count, ZFS_OBJS_TO_STATS_MAX_COUNT);
+
+	/* XXX reading from objset not owned */
+	if ((error = dmu_objset_hold_flags(dsname, B_TRUE, FTAG, &os)) != 0)
+		return (error);
+	if (dmu_objset_type(os) != DMU_OST_ZFS) {
+		dmu_objset_rele_flags(os, B_TRUE, FTAG);
+		return (SET_ERROR(EINVAL));
+	}
+
+	objs = kmem_alloc(count * sizeof (uint64_t), KM_SLEEP);
+	errs = kmem_alloc(count * sizeof (int32_t), KM_SLEEP);
+	stats = kmem_zalloc(count * sizeof (zfs_stat_t), KM_SLEEP);
+	paths = kmem_zalloc(count * sizeof (char *), KM_SLEEP);
+
+	/* dmu_object_next() returns the first object after obj */
+	obj = (first == 0) ? 0 : first - 1;
+	while (n < count) {
+		if (issig(JUSTLOOKING) && issig(FORREAL)) {
+			error = SET_ERROR(EINTR);
+			break;
+		}
+
+		error = dmu_object_next(os, &obj, B_FALSE, 0);
+		if (error == ESRCH || (error == 0 && obj > last)) {
+			error = 0;
+			done = B_TRUE;
+			break;
+		} else if (error != 0) {
+			break;
+		}
+
+		objs[n++] = obj;
+		if (obj == last) {
+			done = B_TRUE;
+			break;
+		}
+	}
+
+	if (error == 0)
+		zfs_obj_to_stats_batch(os, objs, n, stats, errs, paths);
+	dmu_objset_rele_flags(os, B_TRUE, FTAG);
+
+	if (error == 0) {
+		/*
+		 * Return no more than fits in the budget, and resume from the
+		 * first object left out.
+		 */
+		for (nret = 0; nret < n; nret++) {
+			bytes += sizeof (uint64_t) + sizeof (int32_t) +
+			    sizeof (zfs_stat_t) + strlen(paths[nret]) + 1;
+			if (nret > 0 && bytes > ZFS_OBJS_TO_STATS_MAX_BYTES)
+				break;
+		}
+
+		fnvlist_add_uint64_array(outnvl, ZFS_OBJS_TO_STATS_OBJECTS,
+		    objs, nret);
+		fnvlist_add_int32_array(outnvl, ZFS_OBJS_TO_STATS_ERRORS,
+		    errs, nret);
+		fnvlist_add_uint8_array(outnvl, ZFS_OBJS_TO_STATS_STATS,
+		    (uint8_t *)stats, nret * sizeof (zfs_stat_t));
+		fnvlist_add_string_array(outnvl, ZFS_OBJS_TO_STATS_PATHS,
+		    paths, nret);
+		if (nret < n) {
+			fnvlist_add_uint64(outnvl, ZFS_OBJS_TO_STATS_NEXT,
+			    objs[nret]);
+		} else if (!done) {
+			fnvlist_add_uint64(outnvl, ZFS_OBJS_TO_STATS_NEXT,
+			    obj + 1);
+		}
+	}
+
+	for (i = 0; i < n; i++) {
+		if (paths[i] != NULL)
+			spa_strfree(paths[i]);
+	}
+	kmem_free(paths, count * sizeof (char *));
+	kmem_free(stats, count * sizeof (zfs_stat_t));
+	kmem_free(errs, count * sizeof (int32_t));
+	kmem_free(objs, count * sizeof (uint64_t));
+
+	return (error);
+}
+
 static int
 zfs_ioc_vdev_add(zfs_cmd_t *zc)
 {
@@ -2156,6 +2366,41 @@ zfs_ioc_vdev_setfru(zfs_cmd_t *zc)
 	return (error);
 }
 
+/*
+ * Gather the property nvlist of an objset whose stats have already been
+ * filled in by dmu_objset_fast_stat().
+ */
+static int
+zfs_objset_props(objset_t *os, dmu_objset_stats_t *stat, nvlist_t **nvp)
+{
+	int error;
+	nvlist_t *nv;
+
+	if ((error = dsl_prop_get_all(os, &nv)) != 0)
+		return (error);
+
+	dmu_objset_stats(os, nv);
+	/*
+	 * NB: zvol_get_stats() will read the objset contents,
+	 * which we aren't supposed to do with a
+	 * DS_MODE_USER hold, because it could be
+	 * inconsistent.  So this is a bit of a workaround...
+	 * XXX reading with out owning
+	 */
+	if (!stat->dds_inconsistent &&
+	    dmu_objset_type(os) == DMU_OST_ZVOL) {
+		error = zvol_get_stats(os, nv);
+		if (error == EIO) {
+			nvlist_free(nv);
+			return (error);
+		}
+		VERIFY0(error);
+	}
+
+	*nvp = nv;
+	return (0);
+}
+
 static int
 zfs_ioc_objset_stats_impl(zfs_cmd_t *zc, objset_t *os)
 {
@@ -2165,26 +2410,8 @@ zfs_ioc_objset_stats_impl(zfs_cmd_t *zc, objset_t *os)
 	dmu_objset_fast_stat(os, &zc->zc_objset_stats);
 
 	if (zc->zc_nvlist_dst != 0 &&
-	    (error = dsl_prop_get_all(os, &nv)) == 0) {
-		dmu_objset_stats(os, nv);
-		/*
-		 * NB: zvol_get_stats() will read the objset contents,
-		 * which we aren't supposed to do with a
-		 * DS_MODE_USER hold, because it could be
-		 * inconsistent.  So this is a bit of a workaround...
-		 * XXX reading with out owning
-		 */
-		if (!zc->zc_objset_stats.dds_inconsistent &&
-		    dmu_objset_type(os) == DMU_OST_ZVOL) {
-			error = zvol_get_stats(os, nv);
-			if (error == EIO) {
-				nvlist_free(nv);
-				return (error);
-			}
-			VERIFY0(error);
-		}
-		if (error == 0)
-			error = put_nvlist(zc, nv);
+	    (error = zfs_objset_props(os, &zc->zc_objset_stats, &nv)) == 0) {
+		error = put_nvlist(zc, nv);
 		nvlist_free(nv);
 	}
 
@@ -2474,6 +2701,266 @@ zfs_ioc_snapshot_list_next(zfs_cmd_t *zc)
 	return (error);
 }
 
+/*
+ * Upper bound on the packed size of the dataset entries returned by a
+ * single ZFS_IOC_LIST_BATCH call.  This keeps a batch within the default
+ * destination buffer of libzfs_core, so a call rarely has to be repeated
+ * with a larger buffer.
+ */
+#define	ZFS_LIST_BATCH_MAX_BYTES	(96 * 1024)
+
+/*
+ * Add the entry for dataset "name" to the "datasets" list of a
+ * ZFS_IOC_LIST_BATCH result.  When "os" is NULL, only the name is added.
+ * Native properties which are not in "filter" are dropped here, rather than
+ * in userland, so they are neither packed nor copied out.  User properties
+ * and properties unknown to this kernel are always returned.
+ */
+static int
+zfs_list_batch_add(objset_t *os, const char *name, nvlist_t *filter,
+    nvlist_t *datasets, size_t *bytes)
+{
+	dmu_objset_stats_t stat;
+	nvlist_t *entry, *props;
+	nvpair_t *pair, *next;
+	int error;
+
+	entry = fnvlist_alloc();
+	if (os != NULL) {
+		dmu_objset_fast_stat(os, &stat);
+		if ((error = zfs_objset_props(os, &stat, &props)) != 0) {
+			fnvlist_free(entry);
+			return (error);
+		}
+
+		for (pair = nvlist_next_nvpair(props, NULL); pair != NULL;
+		    pair = next) {
+			next = nvlist_next_nvpair(props, pair);
+			if (filter != NULL &&
+			    zfs_name_to_prop(nvpair_name(pair)) != ZPROP_INVAL &&
+			    !nvlist_exists(filter, nvpair_name(pair)))
+				fnvlist_remove_nvpair(props, pair);
+		}
+
+		fnvlist_add_uint8_array(entry, ZFS_LIST_BATCH_STATS,
+		    (uint8_t *)&stat, sizeof (stat));
+		fnvlist_add_nvlist(entry, ZFS_LIST_BATCH_PROPS, props);
+		fnvlist_free(props);
+	}
+
+	*bytes += fnvlist_size(entry) + strlen(name);
+	fnvlist_add_nvlist(datasets, name, entry);
+	fnvlist_free(entry);
+	return (0);
+}
+
+/*
+ * Add the next child of "fsname" after "cursor" to a ZFS_IOC_LIST_BATCH
+ * result.  Returns ESRCH when there are no more children.
+ */
+static int
+zfs_list_batch_child(const char *fsname, uint64_t *cursor, nvlist_t *filter,
+    nvlist_t *datasets, size_t *bytes)
+{
+	char name[ZFS_MAX_DATASET_NAME_LEN];
+	objset_t *os;
+	char *p;
+	int error;
+
+top:
+	if ((error = dmu_objset_hold(fsname, FTAG, &os)) != 0)
+		return (error);
+
+	(void) strlcpy(name, fsname, sizeof (name));
+	if (strlcat(name, "/", sizeof (name)) >= sizeof (name)) {
+		dmu_objset_rele(os, FTAG);
+		return (SET_ERROR(ESRCH));
+	}
+	p = name + strlen(name);
+
+	do {
+		error = dmu_dir_list_next(os, sizeof (name) - (p - name), p,
+		    NULL, cursor);
+		if (error == ENOENT)
+			error = SET_ERROR(ESRCH);
+	} while (error == 0 && dataset_name_hidden(name));
+	dmu_objset_rele(os, FTAG);
+
+	if (error != 0)
+		return (error);
+
+	/*
+	 * Each child is held on its own, so that the pool configuration
+	 * lock is not held across the whole batch.
+	 */
+	if ((error = dmu_objset_hold(name, FTAG, &os)) == 0) {
+		error = zfs_list_batch_add(os, name, filter, datasets, bytes);
+		dmu_objset_rele(os, FTAG);
+	}
+	if (error == ENOENT) {
+		/* We lost a race with destroy, get the next one. */
+		goto top;
+	}
+	return (error);
+}
+
+/*
+ * Add the next snapshot of "fsname" after "cursor" whose creation txg lies
+ * within [min_txg, max_txg] to a ZFS_IOC_LIST_BATCH result.  Returns ESRCH
+ * when there are no more snapshots.
+ */
+static int
+zfs_list_batch_snapshot(const char *fsname, uint64_t *cursor,
+    uint64_t min_txg, uint64_t max_txg, boolean_t simple, nvlist_t *filter,
+    nvlist_t *datasets, size_t *bytes)
+{
+	char name[ZFS_MAX_DATASET_NAME_LEN];
+	objset_t *os, *ossnap;
+	dsl_dataset_t *ds;
+	uint64_t obj;
+	char *p;
+	int error;
+
+	if ((error = dmu_objset_hold(fsname, FTAG, &os)) != 0)
+		return (error);
+
+	/*
+	 * A dataset name of maximum length cannot have any snapshots,
+	 * so exit immediately.
+	 */
+	(void) strlcpy(name, fsname, sizeof (name));
+	if (strlcat(name, "@", sizeof (name)) >= ZFS_MAX_DATASET_NAME_LEN) {
+		dmu_objset_rele(os, FTAG);
+		return (SET_ERROR(ESRCH));
+	}
+	p = name + strlen(name);
+
+	for (;;) {
+		if (issig(JUSTLOOKING) && issig(FORREAL)) {
+			error = SET_ERROR(EINTR);
+			break;
+		}
+
+		error = dmu_snapshot_list_next(os, sizeof (name) - (p - name),
+		    p, &obj, cursor, NULL);
+		if (error == ENOENT) {
+			error = SET_ERROR(ESRCH);
+			break;
+		} else if (error != 0) {
+			break;
+		}
+
+		error = dsl_dataset_hold_obj(dmu_objset_pool(os), obj,
+		    FTAG, &ds);
+		if (error != 0)
+			break;
+
+		if ((min_txg != 0 && dsl_get_creationtxg(ds) < min_txg) ||
+		    (max_txg != 0 && dsl_get_creationtxg(ds) > max_txg)) {
+			dsl_dataset_rele(ds, FTAG);
+			continue;
+		}
+
+		if (simple) {
+			error = zfs_list_batch_add(NULL, name, filter,
+			    datasets, bytes);
+		} else if ((error = dmu_objset_from_ds(ds, &ossnap)) == 0) {
+			error = zfs_list_batch_add(ossnap, name, filter,
+			    datasets, bytes);
+		}
+		dsl_dataset_rele(ds, FTAG);
+		break;
+	}
+
+	dmu_objset_rele(os, FTAG);
+	return (error);
+}
+
+/*
+ * List the children (or snapshots) of a dataset, along with their stats and
+ * properties, several per call.  This replaces a round trip through
+ * ZFS_IOC_DATASET_LIST_NEXT or ZFS_IOC_SNAPSHOT_LIST_NEXT per dataset.
+ *
+ * innvl: {
+ *     "snapshots" -> (optional) list snapshots rather than children
+ *     "simple" -> (optional) only return snapshot names
+ *     "cursor" -> (optional) cursor returned by the previous call
+ *     "count" -> (optional) maximum number of datasets to return
+ *     "props" -> (optional) { native property names to return }
+ *     "snap_iter_min_txg" -> (optional) lowest snapshot creation txg
+ *     "snap_iter_max_txg" -> (optional) highest snapshot creation txg
+ * }
+ *
+ * outnvl: {
+ *     "datasets" -> {
+ *         dataset name -> {
+ *             "stats" -> dmu_objset_stats_t (uint8 array)
+ *             "props" -> { property name -> { "value", "source" } }
+ *         }
+ *     }
+ *     "cursor" -> cursor for the next call, absent when the list is done
+ * }
+ */
+static const zfs_ioc_key_t zfs_keys_list_batch[] = {
+	{ZFS_LIST_BATCH_SNAPSHOTS,	DATA_TYPE_BOOLEAN,	ZK_OPTIONAL},
+	{ZFS_LIST_BATCH_SIMPLE,		DATA_TYPE_BOOLEAN,	ZK_OPTIONAL},
+	{ZFS_LIST_BATCH_CURSOR,		DATA_TYPE_UINT64,	ZK_OPTIONAL},
+	{ZFS_LIST_BATCH_COUNT,		DATA_TYPE_UINT64,	ZK_OPTIONAL},
+	{ZFS_LIST_BATCH_PROPS,		DATA_TYPE_NVLIST,	ZK_OPTIONAL},
+	{SNAP_ITER_MIN_TXG,		DATA_TYPE_UINT64,	ZK_OPTIONAL},
+	{SNAP_ITER_MAX_TXG,		DATA_TYPE_UINT64,	ZK_OPTIONAL},
+};
+
+static int
+zfs_ioc_list_batch(const char *fsname, nvlist_t *innvl, nvlist_t *outnvl)
+{
+	boolean_t snapshots, simple;
+	uint64_t cursor = 0, count = ZFS_LIST_BATCH_DEFAULT_COUNT;
+	uint64_t min_txg = 0, max_txg = 0, n;
+	nvlist_t *filter = NULL, *datasets;
+	size_t bytes = 0;
+	int error = 0;
+
+	snapshots = nvlist_exists(innvl, ZFS_LIST_BATCH_SNAPSHOTS);
+	simple = nvlist_exists(innvl, ZFS_LIST_BATCH_SIMPLE);
+	(void) nvlist_lookup_uint64(innvl, ZFS_LIST_BATCH_CURSOR, &cursor);
+	(void) nvlist_lookup_uint64(innvl, ZFS_LIST_BATCH_COUNT, &count);
+	(void) nvlist_lookup_nvlist(innvl, ZFS_LIST_BATCH_PROPS, &filter);
+	(void) nvlist_lookup_uint64(innvl, SNAP_ITER_MIN_TXG, &min_txg);
+	(void) nvlist_lookup_uint64(innvl, SNAP_ITER_MAX_TXG, &max_txg);
+
+	if (count == 0 || (simple && !snapshots))
+		return (SET_ERROR(EINVAL));
+
+	datasets = fnvlist_alloc();
+	for (n = 0; n < count && bytes < ZFS_LIST_BATCH_MAX_BYTES; n++) {
+		if (issig(JUSTLOOKING) && issig(FORREAL)) {
+			error = SET_ERROR(EINTR);
+			break;
+		}
+
+		if (snapshots) {
+			error = zfs_list_batch_snapshot(fsname, &cursor,
+			    min_txg, max_txg, simple, filter, datasets, &bytes);
+		} else {
+			error = zfs_list_batch_child(fsname, &cursor, filter,
+			    datasets, &bytes);
+		}
+		if (error != 0)
+			break;
+	}
+
+	if (error == 0 || error == ESRCH) {
+		fnvlist_add_nvlist(outnvl, ZFS_LIST_BATCH_DATASETS, datasets);
+		if (error == 0)
+			fnvlist_add_uint64(outnvl, ZFS_LIST_BATCH_CURSOR, cursor);
+		error = 0;
+	}
+	fnvlist_free(datasets);
+
+	return (error);
+}
+
 static int
 zfs_prop_set_userquota(const char *dsname, nvpair_t *pair)
 {
@@ -3531,13 +4018,41 @@ static const zfs_ioc_key_t zfs_keys_snapshot[] = {
 	{"props",	DATA_TYPE_NVLIST,	ZK_OPTIONAL},
 };
 
+/*
+ * The filesystem part of a snapshot name, used by zfs_ioc_snapshot() to
+ * find two snapshots of the same filesystem without comparing every pair.
+ */
+typedef struct zfs_snap_fs {
+	avl_node_t	zsf_node;
+	const char	*zsf_name;
+	size_t		zsf_len;
+} zfs_snap_fs_t;
+
+static int
+zfs_snap_fs_compare(const void *arg1, const void *arg2)
+{
+	const zfs_snap_fs_t *zsf1 = arg1;
+	const zfs_snap_fs_t *zsf2 = arg2;
+
+	int cmp = memcmp(zsf1->zsf_name, zsf2->zsf_name,
+	    MIN(zsf1->zsf_len, zsf2->zsf_len));
+	if (cmp != 0)
+		return (AVL_ISIGN(cmp));
+
+	return (AVL_CMP(zsf1->zsf_len, zsf2->zsf_len));
+}
+
 static int
 zfs_ioc_snapshot(const char *poolname, nvlist_t *innvl, nvlist_t *outnvl)
 {
 	nvlist_t *snaps;
 	nvlist_t *props = NULL;
 	int error, poollen;
-	nvpair_t *pair, *pair2;
+	nvpair_t *pair;
+	avl_tree_t fs_tree;
+	zfs_snap_fs_t *zsf;
+	size_t nsnaps, i;
+	void *cookie = NULL;
 
 	(void) nvlist_lookup_nvlist(innvl, "props", &props);
 	if ((error = zfs_check_userprops(poolname, props)) != 0)
@@ -3548,38 +4063,57 @@ zfs_ioc_snapshot(const char *poolname, nvlist_t *innvl, nvlist_t *outnvl)
 		return (SET_ERROR(ENOTSUP));
 
 	snaps = fnvlist_lookup_nvlist(innvl, "snaps");
+	nsnaps = fnvlist_num_pairs(snaps);
+	if (nsnaps == 0)
+		return (dsl_dataset_snapshot(snaps, props, outnvl));
+
+	zsf = kmem_alloc(nsnaps * sizeof (zfs_snap_fs_t), KM_SLEEP);
+	avl_create(&fs_tree, zfs_snap_fs_compare, sizeof (zfs_snap_fs_t),
+	    offsetof(zfs_snap_fs_t, zsf_node));
+
 	poollen = strlen(poolname);
-	for (pair = nvlist_next_nvpair(snaps, NULL); pair != NULL;
-		 pair = nvlist_next_nvpair(snaps, pair)) {
+	for (pair = nvlist_next_nvpair(snaps, NULL), i = 0; pair != NULL;
+	    pair = nvlist_next_nvpair(snaps, pair), i++) {
 		const char *name = nvpair_name(pair);
 		const char *cp = strchr(name, '@');
+		avl_index_t where;
 
 		/*
 		 * The snap name must contain an @, and the part after it must
 		 * contain only valid characters.
 		 */
 		if (cp == NULL ||
-		    zfs_component_namecheck(cp + 1, NULL, NULL) != 0)
-			return (SET_ERROR(EINVAL));
+		    zfs_component_namecheck(cp + 1, NULL, NULL) != 0) {
+			error = SET_ERROR(EINVAL);
+			break;
+		}
 
 		/*
 		 * The snap must be in the specified pool.
 		 */
 		if (strncmp(name, poolname, poollen) != 0 ||
-		    (name[poollen] != '/' && name[poollen] != '@'))
-			return (SET_ERROR(EXDEV));
+		    (name[poollen] != '/' && name[poollen] != '@')) {
+			error = SET_ERROR(EXDEV);
+			break;
+		}
 
 		/* This must be the only snap of this fs. */
-		for (pair2 = nvlist_next_nvpair(snaps, pair);
-			 pair2 != NULL; pair2 = nvlist_next_nvpair(snaps, pair2)) {
-			if (strncmp(name, nvpair_name(pair2), cp - name + 1)
-			    == 0) {
-				return (SET_ERROR(EXDEV));
-			}
+		zsf[i].zsf_name = name;
+		zsf[i].zsf_len = cp - name;
+		if (avl_find(&fs_tree, &zsf[i], &where) != NULL) {
+			error = SET_ERROR(EXDEV);
+			break;
 		}
+		avl_insert(&fs_tree, &zsf[i], where);
 	}
 
-	error = dsl_dataset_snapshot(snaps, props, outnvl);
+	while (avl_destroy_nodes(&fs_tree, &cookie) != NULL)
+		;
+	avl_destroy(&fs_tree);
+	kmem_free(zsf, nsnaps * sizeof (zfs_snap_fs_t));
+
+	if (error == 0)
+		error = dsl_dataset_snapshot(snaps, props, outnvl);
 
 	return (error);
 }
@@ -6876,6 +7410,21 @@ zfs_ioctl_init(void)
 	    POOL_CHECK_SUSPENDED | POOL_CHECK_READONLY, B_TRUE, B_TRUE,
 	    zfs_keys_pool_trim, ARRAY_SIZE(zfs_keys_pool_trim));
 
+	zfs_ioctl_register("list_batch", ZFS_IOC_LIST_BATCH,
+	    zfs_ioc_list_batch, zfs_secpolicy_read, DATASET_NAME,
+	    POOL_CHECK_SUSPENDED, B_FALSE, B_FALSE,
+	    zfs_keys_list_batch, ARRAY_SIZE(zfs_keys_list_batch));
+
+	zfs_ioctl_register("objs_to_stats", ZFS_IOC_OBJS_TO_STATS,
+	    zfs_ioc_objs_to_stats, zfs_secpolicy_diff, DATASET_NAME,
+	    POOL_CHECK_SUSPENDED, B_FALSE, B_FALSE,
+	    zfs_keys_objs_to_stats, ARRAY_SIZE(zfs_keys_objs_to_stats));
+
+	zfs_ioctl_register("pool_vdev_stats", ZFS_IOC_POOL_VDEV_STATS,
+	    zfs_ioc_pool_vdev_stats, zfs_secpolicy_read, POOL_NAME,
+	    POOL_CHECK_NONE, B_FALSE, B_FALSE,
+	    zfs_keys_pool_vdev_stats, ARRAY_SIZE(zfs_keys_pool_vdev_stats));
+
 	/* IOCTLS that use the legacy function signature */
 
 	zfs_ioctl_register_legacy(ZFS_IOC_POOL_FREEZE, zfs_ioc_pool_freeze,
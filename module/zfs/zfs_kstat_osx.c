@@ -178,9 +178,22 @@ osx_kstat_t osx_kstat = {
 	{"zfs_send_unmodified_spill_blocks",		KSTAT_DATA_UINT64  },
 	{"zfs_special_class_metadata_reserve_pct",		KSTAT_DATA_UINT64  },
 
+	{"zfs_ddt_warmup",			KSTAT_DATA_UINT64  },
+	{"zfs_ddt_warmup_max_pct",		KSTAT_DATA_UINT64  },
+
+	{"zfs_scan_meta_window",		KSTAT_DATA_UINT64  },
+	{"zfs_scan_meta_mem_lim",		KSTAT_DATA_UINT64  },
+	{"zfs_vdev_scrub_throttle_interval_ms",	KSTAT_DATA_UINT64  },
+	{"zfs_vdev_scrub_throttle_max_active",	KSTAT_DATA_UINT64  },
+	{"zio_compute_offload",			KSTAT_DATA_UINT64  },
+	{"zfs_async_free_parallel",		KSTAT_DATA_UINT64  },
+	{"zfs_livelist_max_entries",		KSTAT_DATA_UINT64  },
+	{"zfs_livelist_condense_free_pct",	KSTAT_DATA_UINT64  },
+
 	{"zfs_vdev_raidz_impl",		KSTAT_DATA_STRING  },
 	{"icp_gcm_impl",		KSTAT_DATA_STRING  },
 	{"icp_aes_impl",		KSTAT_DATA_STRING  },
+	{"icp_sha2_impl",		KSTAT_DATA_STRING  },
 	{"zfs_fletcher_4_impl",		KSTAT_DATA_STRING  },
 
 };
@@ -193,12 +206,15 @@ extern int icp_gcm_impl_set(const char *val);
 extern int icp_gcm_impl_get(char *buffer, int max);
 extern int icp_aes_impl_set(const char *val);
 extern int icp_aes_impl_get(char *buffer, int max);
+extern int icp_sha2_impl_set(const char *val);
+extern int icp_sha2_impl_get(char *buffer, int max);
 extern int zfs_fletcher_4_impl_set(const char *val);
 extern int zfs_fletcher_4_impl_get(char *buffer, int max);
 
 static char vdev_raidz_string[80] = { 0 };
 static char icp_gcm_string[80] = { 0 };
 static char icp_aes_string[80] = { 0 };
+static char icp_sha2_string[80] = { 0 };
 static char zfs_fletcher_4_string[80] = { 0 };
 
 static kstat_t		*osx_kstat_ksp;
@@ -397,6 +413,28 @@ static int osx_kstat_update(kstat_t *ksp, int rw)
 		zfs_special_class_metadata_reserve_pct =
 			ks->zfs_special_class_metadata_reserve_pct.value.ui64;
 
+		zfs_ddt_warmup =
+			ks->zfs_ddt_warmup.value.ui64;
+		zfs_ddt_warmup_max_pct =
+			ks->zfs_ddt_warmup_max_pct.value.ui64;
+
+		zfs_scan_meta_window =
+			ks->zfs_scan_meta_window.value.ui64;
+		zfs_scan_meta_mem_lim =
+			ks->zfs_scan_meta_mem_lim.value.ui64;
+		zfs_vdev_scrub_throttle_interval_ms =
+			ks->zfs_vdev_scrub_throttle_interval_ms.value.ui64;
+		zfs_vdev_scrub_throttle_max_active =
+			ks->zfs_vdev_scrub_throttle_max_active.value.ui64;
+		zio_compute_offload =
+			ks->zio_compute_offload.value.ui64;
+		zfs_async_free_parallel =
+			ks->zfs_async_free_parallel.value.ui64;
+		zfs_livelist_max_entries =
+			ks->zfs_livelist_max_entries.value.ui64;
+		zfs_livelist_condense_free_pct =
+			ks->zfs_livelist_condense_free_pct.value.ui64;
+
 		// Check if string has changed (from KREAD), if so, update.
 		if (strcmp(vdev_raidz_string,
 				ks->zfs_vdev_raidz_impl.value.string.addr.ptr) != 0)
@@ -408,6 +446,9 @@ static int osx_kstat_update(kstat_t *ksp, int rw)
 		if (strcmp(icp_aes_string, ks->icp_aes_impl.value.string.addr.ptr) != 0)
 			icp_aes_impl_set(ks->icp_aes_impl.value.string.addr.ptr);
 
+		if (strcmp(icp_sha2_string, ks->icp_sha2_impl.value.string.addr.ptr) != 0)
+			icp_sha2_impl_set(ks->icp_sha2_impl.value.string.addr.ptr);
+
 		if (strcmp(zfs_fletcher_4_string,
 				ks->zfs_fletcher_4_impl.value.string.addr.ptr) != 0)
 			zfs_fletcher_4_impl_set(ks->zfs_fletcher_4_impl.value.string.addr.ptr);
@@ -596,6 +637,28 @@ static int osx_kstat_update(kstat_t *ksp, int rw)
 		ks->zfs_special_class_metadata_reserve_pct.value.ui64 =
 			zfs_special_class_metadata_reserve_pct;
 
+		ks->zfs_ddt_warmup.value.ui64 =
+			zfs_ddt_warmup;
+		ks->zfs_ddt_warmup_max_pct.value.ui64 =
+			zfs_ddt_warmup_max_pct;
+
+		ks->zfs_scan_meta_window.value.ui64 =
+			zfs_scan_meta_window;
+		ks->zfs_scan_meta_mem_lim.value.ui64 =
+			zfs_scan_meta_mem_lim;
+		ks->zfs_vdev_scrub_throttle_interval_ms.value.ui64 =
+			zfs_vdev_scrub_throttle_interval_ms;
+		ks->zfs_vdev_scrub_throttle_max_active.value.ui64 =
+			zfs_vdev_scrub_throttle_max_active;
+		ks->zio_compute_offload.value.ui64 =
+			zio_compute_offload;
+		ks->zfs_async_free_parallel.value.ui64 =
+			zfs_async_free_parallel;
+		ks->zfs_livelist_max_entries.value.ui64 =
+			zfs_livelist_max_entries;
+		ks->zfs_livelist_condense_free_pct.value.ui64 =
+			zfs_livelist_condense_free_pct;
+
 		zfs_vdev_raidz_impl_get(vdev_raidz_string, sizeof(vdev_raidz_string));
 		kstat_named_setstr(&ks->zfs_vdev_raidz_impl, vdev_raidz_string);
 
@@ -605,6 +668,9 @@ static int osx_kstat_update(kstat_t *ksp, int rw)
 		icp_aes_impl_get(icp_aes_string, sizeof(icp_aes_string));
 		kstat_named_setstr(&ks->icp_aes_impl, icp_aes_string);
 
+		icp_sha2_impl_get(icp_sha2_string, sizeof(icp_sha2_string));
+		kstat_named_setstr(&ks->icp_sha2_impl, icp_sha2_string);
+
 		zfs_fletcher_4_impl_get(zfs_fletcher_4_string,
 			sizeof(zfs_fletcher_4_string));
 		kstat_named_setstr(&ks->zfs_fletcher_4_impl, zfs_fletcher_4_string);
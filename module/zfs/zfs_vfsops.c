@@ -1302,7 +1302,8 @@ zfsvfs_setup(zfsvfs_t *zfsvfs, boolean_t mounting)
 	mutex_enter(&zfsvfs->z_os->os_user_ptr_lock);
 	dmu_objset_set_user(zfsvfs->z_os, zfsvfs);
 	mutex_exit(&zfsvfs->z_os->os_user_ptr_lock);
-	zfsvfs->z_log = zil_open(zfsvfs->z_os, zfs_get_data);
+	zfsvfs->z_log = zil_open(zfsvfs->z_os, zfs_get_data,
+	    &zfsvfs->z_kstat);
 
 	/*
 	 * If we are not mounting (ie: online recv), then we don't
@@ -1392,6 +1393,7 @@ zfsvfs_free(zfsvfs_t *zfsvfs)
 	//rw_exit(&zfsvfs_lock);
 
 	zfs_fuid_destroy(zfsvfs);
+	dataset_kstats_destroy(&zfsvfs->z_kstat);
 
     cv_destroy(&zfsvfs->z_drain_cv);
     mutex_destroy(&zfsvfs->z_drain_lock);
@@ -1471,6 +1473,7 @@ zfs_domount(struct mount *vfsp, dev_t mount_dev, char *osname, char *options,
 	if (error)
 		return (error);
 	zfsvfs->z_vfs = vfsp;
+	dataset_kstats_create(&zfsvfs->z_kstat, zfsvfs->z_os);
 
 	error = zfsvfs_parse_options(options, zfsvfs->z_vfs);
 	if (error)
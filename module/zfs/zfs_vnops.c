@@ -603,7 +603,8 @@ zfs_read(vnode_t *vp, uio_t *uio, int ioflag, cred_t *cr, caller_context_t *ct)
 	znode_t		*zp = VTOZ(vp);
 	zfsvfs_t	*zfsvfs = zp->z_zfsvfs;
 	objset_t	*os;
-	ssize_t		n, nbytes;
+	ssize_t		n, nbytes, start_resid;
+	hrtime_t	start = gethrtime();
 	int		error = 0;
 #ifndef __APPLE__
 	xuio_t		*xuio = NULL;
@@ -674,6 +675,7 @@ zfs_read(vnode_t *vp, uio_t *uio, int ioflag, cred_t *cr, caller_context_t *ct)
 
 	ASSERT(uio_offset(uio) < zp->z_size);
 	n = MIN(uio_resid(uio), zp->z_size - uio_offset(uio));
+	start_resid = n;
 
 #ifdef sun
 	if ((uio->uio_extflg == UIO_XUIO) &&
@@ -729,6 +731,9 @@ zfs_read(vnode_t *vp, uio_t *uio, int ioflag, cred_t *cr, caller_context_t *ct)
 
 		n -= nbytes;
 	}
+
+	dataset_kstats_update_read_kstats(&zfsvfs->z_kstat, start_resid - n,
+	    gethrtime() - start);
 out:
 	rangelock_exit(lr);
 
@@ -764,6 +769,7 @@ zfs_write(vnode_t *vp, uio_t *uio, int ioflag, cred_t *cr, caller_context_t *ct)
 	znode_t		*zp = VTOZ(vp);
 	rlim64_t	limit = MAXOFFSET_T;
 	ssize_t		start_resid = uio_resid(uio);
+	hrtime_t	start = gethrtime();
 	ssize_t		tx_bytes;
 	uint64_t	end_size;
 	dmu_tx_t	*tx;
@@ -1186,6 +1192,9 @@ zfs_write(vnode_t *vp, uio_t *uio, int ioflag, cred_t *cr, caller_context_t *ct)
 	    zfsvfs->z_os->os_sync == ZFS_SYNC_ALWAYS)
 		zil_commit(zilog, zp->z_id);
 
+	dataset_kstats_update_write_kstats(&zfsvfs->z_kstat,
+	    start_resid - uio_resid(uio), gethrtime() - start);
+
 	ZFS_EXIT(zfsvfs);
 	return (0);
 }
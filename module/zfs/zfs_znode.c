@@ -2492,6 +2492,26 @@ zfs_obj_to_stats_impl(sa_handle_t *hdl, sa_attr_type_t *sa_table,
 	return (sa_bulk_lookup(hdl, bulk, count));
 }
 
+/*
+ * Returns ESTALE if the object is on the delete queue, as it then has no
+ * path.
+ */
+static int
+zfs_obj_unlinked(objset_t *osp, uint64_t obj)
+{
+	uint64_t deleteq_obj;
+	int error;
+
+	VERIFY0(zap_lookup(osp, MASTER_NODE_OBJ,
+	    ZFS_UNLINKED_SET, sizeof (uint64_t), 1, &deleteq_obj));
+	error = zap_lookup_int(osp, deleteq_obj, obj);
+	if (error == 0)
+		return (ESTALE);
+	else if (error != ENOENT)
+		return (error);
+	return (0);
+}
+
 static int
 zfs_obj_to_path_impl(objset_t *osp, uint64_t obj, sa_handle_t *hdl,
 				sa_attr_type_t *sa_table, char *buf, int len)
@@ -2506,17 +2526,6 @@ zfs_obj_to_path_impl(objset_t *osp, uint64_t obj, sa_handle_t *hdl,
 	*path = '\0';
 	sa_hdl = hdl;
 
-	uint64_t deleteq_obj;
-	VERIFY0(zap_lookup(osp, MASTER_NODE_OBJ,
-	    ZFS_UNLINKED_SET, sizeof (uint64_t), 1, &deleteq_obj));
-	error = zap_lookup_int(osp, deleteq_obj, obj);
-	if (error == 0) {
-		return (ESTALE);
-	} else if (error != ENOENT) {
-		return (error);
-	}
-	error = 0;
-
 	for (;;) {
 		uint64_t pobj = 0;
 		char component[MAXNAMELEN + 2];
@@ -2593,7 +2602,8 @@ zfs_obj_to_path(objset_t *osp, uint64_t obj, char *buf, int len)
 	if (error != 0)
 		return (error);
 
-	error = zfs_obj_to_path_impl(osp, obj, hdl, sa_table, buf, len);
+	if ((error = zfs_obj_unlinked(osp, obj)) == 0)
+		error = zfs_obj_to_path_impl(osp, obj, hdl, sa_table, buf, len);
 
 	zfs_release_sa_handle(hdl, db, FTAG);
 	return (error);
@@ -2625,8 +2635,233 @@ zfs_obj_to_stats(objset_t *osp, uint64_t obj, zfs_stat_t *sb,
 		return (error);
 	}
 
-	error = zfs_obj_to_path_impl(osp, obj, hdl, sa_table, buf, len);
+	if ((error = zfs_obj_unlinked(osp, obj)) == 0)
+		error = zfs_obj_to_path_impl(osp, obj, hdl, sa_table, buf, len);
 
 	zfs_release_sa_handle(hdl, db, FTAG);
 	return (error);
 }
+
+typedef struct zfs_obj_batch_ent {
+	avl_node_t	zbe_node;
+	uint64_t	zbe_parent;	/* directory the object is named in */
+	uint64_t	zbe_obj;
+	uint_t		zbe_idx;	/* index in the caller's arrays */
+	int		zbe_xattrdir;
+	int		zbe_error;	/* error finding zbe_name */
+	char		*zbe_name;	/* name within zbe_parent */
+} zfs_obj_batch_ent_t;
+
+static int
+zfs_obj_batch_compare(const void *x1, const void *x2)
+{
+	const zfs_obj_batch_ent_t *e1 = x1;
+	const zfs_obj_batch_ent_t *e2 = x2;
+	int cmp;
+
+	cmp = AVL_CMP(e1->zbe_parent, e2->zbe_parent);
+	if (cmp != 0)
+		return (cmp);
+	return (AVL_CMP(e1->zbe_obj, e2->zbe_obj));
+}
+
+/*
+ * Find the names of the "count" entries starting at "first", which all have
+ * the same parent directory.  A single entry is looked up the same way as by
+ * zfs_obj_to_path_impl(); several are found with one pass over the directory
+ * instead of one zap_value_search() each.
+ */
+static void
+zfs_obj_batch_names(objset_t *osp, avl_tree_t *tree,
+    zfs_obj_batch_ent_t *first, uint_t count)
+{
+	zfs_obj_batch_ent_t search, *e;
+	zap_attribute_t *za;
+	zap_cursor_t zc;
+	char *name;
+	uint_t i, left = 0;
+	int error = ENOENT;
+
+	for (e = first, i = 0; i < count; e = AVL_NEXT(tree, e), i++) {
+		if (e->zbe_xattrdir)
+			e->zbe_name = spa_strdup("<xattrdir>");
+		else
+			left++;
+	}
+
+	if (left == 1) {
+		for (e = first; e->zbe_xattrdir; e = AVL_NEXT(tree, e))
+			;
+		name = kmem_alloc(MAXNAMELEN, KM_SLEEP);
+		e->zbe_error = zap_value_search(osp, e->zbe_parent, e->zbe_obj,
+		    ZFS_DIRENT_OBJ(-1ULL), name);
+		if (e->zbe_error == 0)
+			e->zbe_name = spa_strdup(name);
+		kmem_free(name, MAXNAMELEN);
+		return;
+	} else if (left == 0) {
+		return;
+	}
+
+	search.zbe_parent = first->zbe_parent;
+	za = kmem_alloc(sizeof (*za), KM_SLEEP);
+	for (zap_cursor_init(&zc, osp, first->zbe_parent);
+	    left > 0 && (error = zap_cursor_retrieve(&zc, za)) == 0;
+	    zap_cursor_advance(&zc)) {
+		search.zbe_obj = ZFS_DIRENT_OBJ(za->za_first_integer);
+		e = avl_find(tree, &search, NULL);
+		if (e != NULL && e->zbe_name == NULL) {
+			e->zbe_name = spa_strdup(za->za_name);
+			left--;
+		}
+	}
+	zap_cursor_fini(&zc);
+	kmem_free(za, sizeof (*za));
+
+	if (left == 0)
+		return;
+	/* as zap_value_search(), ENOENT if the directory has no such entry */
+	for (e = first, i = 0; i < count; e = AVL_NEXT(tree, e), i++) {
+		if (e->zbe_name == NULL)
+			e->zbe_error = error;
+	}
+}
+
+/*
+ * Batched form of zfs_obj_to_stats() for zfs diff.  The objects of the
+ * batch which are named in the same directory share a single pass over that
+ * directory and a single walk from it to the root, rather than doing both
+ * for each object, which is quadratic in the size of large directories.
+ *
+ * The objects must be distinct.  On return errs[i] is what
+ * zfs_obj_to_stats() would have returned for objs[i], and paths[i] is its
+ * path (allocated with spa_strdup()), or an empty string if errs[i] is set.
+ */
+void
+zfs_obj_to_stats_batch(objset_t *osp, const uint64_t *objs, uint_t n,
+    zfs_stat_t *sbs, int32_t *errs, char **paths)
+{
+	zfs_obj_batch_ent_t *ents, *e, *next;
+	sa_attr_type_t *sa_table;
+	sa_handle_t *hdl;
+	dmu_buf_t *db;
+	avl_tree_t tree;
+	char *buf;
+	uint_t i, count;
+	int error;
+
+	for (i = 0; i < n; i++)
+		paths[i] = NULL;
+
+	if ((error = zfs_sa_setup(osp, &sa_table)) != 0) {
+		for (i = 0; i < n; i++) {
+			errs[i] = error;
+			paths[i] = spa_strdup("");
+		}
+		return;
+	}
+
+	ents = kmem_zalloc(n * sizeof (zfs_obj_batch_ent_t), KM_SLEEP);
+	avl_create(&tree, zfs_obj_batch_compare, sizeof (zfs_obj_batch_ent_t),
+	    offsetof(zfs_obj_batch_ent_t, zbe_node));
+
+	/*
+	 * Gather the stats and parent of each object.
+	 */
+	for (i = 0; i < n; i++) {
+		uint64_t pobj;
+		int is_xattrdir;
+
+		error = zfs_grab_sa_handle(osp, objs[i], &hdl, &db, FTAG);
+		if (error != 0) {
+			errs[i] = error;
+			continue;
+		}
+
+		error = zfs_obj_to_stats_impl(hdl, sa_table, &sbs[i]);
+		if (error == 0)
+			error = zfs_obj_unlinked(osp, objs[i]);
+		if (error == 0)
+			error = zfs_obj_to_pobj(osp, hdl, sa_table, &pobj,
+			    &is_xattrdir);
+		zfs_release_sa_handle(hdl, db, FTAG);
+
+		if (error != 0) {
+			errs[i] = error;
+		} else if (pobj == objs[i]) {
+			/* the root directory */
+			errs[i] = 0;
+			paths[i] = spa_strdup("/");
+		} else {
+			e = &ents[i];
+			e->zbe_parent = pobj;
+			e->zbe_obj = objs[i];
+			e->zbe_idx = i;
+			e->zbe_xattrdir = is_xattrdir;
+			avl_add(&tree, e);
+		}
+	}
+
+	/*
+	 * Then name the objects, a parent directory at a time.
+	 */
+	buf = kmem_alloc(MAXPATHLEN, KM_SLEEP);
+	for (e = avl_first(&tree); e != NULL; e = next) {
+		size_t plen;
+
+		count = 0;
+		for (next = e; next != NULL &&
+		    next->zbe_parent == e->zbe_parent;
+		    next = AVL_NEXT(&tree, next))
+			count++;
+
+		zfs_obj_batch_names(osp, &tree, e, count);
+
+		error = zfs_grab_sa_handle(osp, e->zbe_parent, &hdl, &db,
+		    FTAG);
+		if (error == 0) {
+			error = zfs_obj_to_path_impl(osp, e->zbe_parent, hdl,
+			    sa_table, buf, MAXPATHLEN);
+			zfs_release_sa_handle(hdl, db, FTAG);
+		}
+		/* the root directory is "/", and its children "/name" */
+		plen = (error != 0 || strcmp(buf, "/") == 0) ? 0 : strlen(buf);
+
+		for (; e != next; e = AVL_NEXT(&tree, e)) {
+			i = e->zbe_idx;
+			if (e->zbe_name == NULL) {
+				errs[i] = e->zbe_error;
+				continue;
+			}
+			if (error != 0) {
+				errs[i] = error;
+			} else if (plen + strlen(e->zbe_name) + 2 >
+			    MAXPATHLEN) {
+				errs[i] = SET_ERROR(ENAMETOOLONG);
+			} else {
+				char *path;
+
+				path = kmem_alloc(MAXPATHLEN, KM_SLEEP);
+				(void) snprintf(path, MAXPATHLEN, "%.*s/%s",
+				    (int)plen, buf, e->zbe_name);
+				errs[i] = 0;
+				paths[i] = spa_strdup(path);
+				kmem_free(path, MAXPATHLEN);
+			}
+		}
+	}
+	kmem_free(buf, MAXPATHLEN);
+
+	while ((e = avl_first(&tree)) != NULL) {
+		avl_remove(&tree, e);
+		if (e->zbe_name != NULL)
+			spa_strfree(e->zbe_name);
+	}
+	avl_destroy(&tree);
+	kmem_free(ents, n * sizeof (zfs_obj_batch_ent_t));
+
+	for (i = 0; i < n; i++) {
+		if (paths[i] == NULL)
+			paths[i] = spa_strdup("");
+	}
+}
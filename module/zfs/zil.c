@@ -2904,7 +2904,14 @@ zil_commit(zilog_t *zilog, uint64_t foid)
 		return;
 	}
 
+	hrtime_t start = gethrtime();
+
 	zil_commit_impl(zilog, foid);
+
+	if (zilog->zl_kstats != NULL) {
+		dataset_kstats_update_sync_kstats(zilog->zl_kstats,
+		    gethrtime() - start);
+	}
 }
 
 void
@@ -3191,7 +3198,7 @@ zil_free(zilog_t *zilog)
  * Open an intent log.
  */
 zilog_t *
-zil_open(objset_t *os, zil_get_data_t *get_data)
+zil_open(objset_t *os, zil_get_data_t *get_data, dataset_kstats_t *dk)
 {
 	zilog_t *zilog = dmu_objset_zil(os);
 
@@ -3200,6 +3207,7 @@ zil_open(objset_t *os, zil_get_data_t *get_data)
 	ASSERT(list_is_empty(&zilog->zl_lwb_list));
 
 	zilog->zl_get_data = get_data;
+	zilog->zl_kstats = dk;
 
 	return (zilog);
 }
@@ -3243,6 +3251,7 @@ zil_close(zilog_t *zilog)
 		VERIFY(!zilog_is_dirty(zilog));
 
 	zilog->zl_get_data = NULL;
+	zilog->zl_kstats = NULL;
 
 	/*
 	 * We should have only one lwb left on the list; remove it now.
@@ -50,6 +50,7 @@
 #include <sys/abd.h>
 #include <sys/dsl_crypt.h>
 #include <sys/cityhash.h>
+#include <sys/wmsum.h>
 
 /*
  * ==========================================================================
@@ -107,6 +108,65 @@ int zfs_sync_pass_rewrite = 2; /* rewrite new bps starting in this pass */
 
 int zio_requeue_io_start_cut_in_line = B_TRUE;
 
+/*
+ * Run read checksum verification, and the decompression and decryption
+ * that follow it, in the compute taskqs instead of the interrupt taskq
+ * that completed the i/o.
+ */
+int zio_compute_offload = B_TRUE;
+
+typedef struct zio_compute_stats {
+	kstat_named_t zcs_dispatched;
+	kstat_named_t zcs_wait_ns;
+	kstat_named_t zcs_high_dispatched;
+	kstat_named_t zcs_high_wait_ns;
+} zio_compute_stats_t;
+
+static zio_compute_stats_t zio_compute_stats = {
+	{ "dispatched",		KSTAT_DATA_UINT64 },
+	{ "wait_ns",		KSTAT_DATA_UINT64 },
+	{ "high_dispatched",	KSTAT_DATA_UINT64 },
+	{ "high_wait_ns",	KSTAT_DATA_UINT64 }
+};
+
+/*
+ * Every read zio handed to the compute taskqs bumps these from whichever
+ * CPU runs it, so they are kept in per-CPU sums and only folded into
+ * zio_compute_stats when the kstat is read.
+ */
+typedef struct zio_compute_sums {
+	wmsum_t zcs_dispatched;
+	wmsum_t zcs_wait_ns;
+	wmsum_t zcs_high_dispatched;
+	wmsum_t zcs_high_wait_ns;
+} zio_compute_sums_t;
+
+static zio_compute_sums_t zio_compute_sums;
+
+#define	ZCSTAT_INCR(stat, val)	wmsum_add(&zio_compute_sums.stat, (val))
+
+static kstat_t *zio_compute_ksp;
+
+static int
+zio_compute_kstat_update(kstat_t *ksp, int rw)
+{
+	zio_compute_stats_t *zcs = ksp->ks_data;
+
+	if (rw == KSTAT_WRITE)
+		return (SET_ERROR(EACCES));
+
+	zcs->zcs_dispatched.value.ui64 =
+	    wmsum_value(&zio_compute_sums.zcs_dispatched);
+	zcs->zcs_wait_ns.value.ui64 =
+	    wmsum_value(&zio_compute_sums.zcs_wait_ns);
+	zcs->zcs_high_dispatched.value.ui64 =
+	    wmsum_value(&zio_compute_sums.zcs_high_dispatched);
+	zcs->zcs_high_wait_ns.value.ui64 =
+	    wmsum_value(&zio_compute_sums.zcs_high_wait_ns);
+
+	return (0);
+}
+
 #ifdef ZFS_DEBUG
 int zio_buf_debug_limit = 16384;
 #else
@@ -215,6 +275,19 @@ zio_init(void)
 
 	lz4_init();
 
+	wmsum_init(&zio_compute_sums.zcs_dispatched, 0);
+	wmsum_init(&zio_compute_sums.zcs_wait_ns, 0);
+	wmsum_init(&zio_compute_sums.zcs_high_dispatched, 0);
+	wmsum_init(&zio_compute_sums.zcs_high_wait_ns, 0);
+
+	zio_compute_ksp = kstat_create("zfs", 0, "zio_compute", "misc",
+	    KSTAT_TYPE_NAMED, sizeof (zio_compute_stats) /
+	    sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL);
+	if (zio_compute_ksp != NULL) {
+		zio_compute_ksp->ks_data = &zio_compute_stats;
+		zio_compute_ksp->ks_update = zio_compute_kstat_update;
+		kstat_install(zio_compute_ksp);
+	}
 }
 
 void
@@ -249,6 +322,16 @@ zio_fini(void)
 	kmem_cache_destroy(zio_link_cache);
 	kmem_cache_destroy(zio_cache);
 
+	if (zio_compute_ksp != NULL) {
+		kstat_delete(zio_compute_ksp);
+		zio_compute_ksp = NULL;
+	}
+
+	wmsum_fini(&zio_compute_sums.zcs_dispatched);
+	wmsum_fini(&zio_compute_sums.zcs_wait_ns);
+	wmsum_fini(&zio_compute_sums.zcs_high_dispatched);
+	wmsum_fini(&zio_compute_sums.zcs_high_wait_ns);
+
 	zio_inject_fini();
 
 	lz4_fini();
@@ -1573,6 +1656,8 @@ zio_write_compress(zio_t *zio)
 		return (NULL);
 	}
 
+	zio->io_precksum_size = 0;
+
 	if (!IO_IS_ALLOCATING(zio))
 		return (zio);
 
@@ -1663,6 +1748,24 @@ zio_write_compress(zio_t *zio)
 					abd_zero_off(cdata, psize, rounded - psize);
 				}
 				psize = rounded;
+
+				/*
+				 * Checksum the compressed block now, while
+				 * it is still in the cache, so that
+				 * zio_checksum_generate() does not have to
+				 * walk it a second time.  Encrypted blocks
+				 * are checksummed after encryption, and
+				 * dedup and nopwrite need a strong checksum,
+				 * so this only applies to plain fletcher4.
+				 */
+				if (zp->zp_checksum ==
+				    ZIO_CHECKSUM_FLETCHER_4 &&
+				    !zp->zp_encrypt && !zp->zp_dedup &&
+				    !zp->zp_nopwrite) {
+					fletcher_4_native(cbuf, psize, NULL,
+					    &zio->io_precksum);
+					zio->io_precksum_size = psize;
+				}
 				zio_push_transform(zio, cdata,
 				    psize, lsize, NULL);
 			}
@@ -1832,6 +1935,63 @@ zio_taskq_member(zio_t *zio, zio_taskq_type_t q)
 	return (B_FALSE);
 }
 
+/*
+ * Sync reads have a caller waiting on them; keep their checksum and
+ * decompression work ahead of scrub and prefetch reads.
+ */
+static boolean_t
+zio_compute_high(zio_t *zio)
+{
+	return (zio->io_priority == ZIO_PRIORITY_SYNC_READ ||
+	    zio->io_priority == ZIO_PRIORITY_NOW);
+}
+
+/*
+ * Hand a zio that is about to verify its checksum to a compute taskq.
+ * Returns B_FALSE if there is no compute taskq for it, in which case the
+ * caller carries on in the current thread.
+ */
+static boolean_t
+zio_compute_dispatch(zio_t *zio)
+{
+	spa_t *spa = zio->io_spa;
+	zio_type_t t = zio->io_type;
+	zio_taskq_type_t q;
+
+	if (zio->io_flags & (ZIO_FLAG_CONFIG_WRITER | ZIO_FLAG_PROBE))
+		return (B_FALSE);
+
+	q = zio_compute_high(zio) ? ZIO_TASKQ_COMPUTE_HIGH : ZIO_TASKQ_COMPUTE;
+	if (spa->spa_zio_taskq[t][q].stqs_count == 0)
+		return (B_FALSE);
+
+#ifdef __linux__
+	ASSERT(taskq_empty_ent(&zio->io_tqent));
+#endif
+	zio->io_compute_ts = gethrtime();
+	spa_taskq_dispatch_ent(spa, t, q, (task_func_t *)__zio_execute, zio,
+	    0, &zio->io_tqent);
+	return (B_TRUE);
+}
+
+/*
+ * Account the time a zio spent queued for a compute taskq.
+ */
+static void
+zio_compute_start(zio_t *zio)
+{
+	hrtime_t wait = gethrtime() - zio->io_compute_ts;
+
+	zio->io_compute_ts = 0;
+	if (zio_compute_high(zio)) {
+		ZCSTAT_INCR(zcs_high_dispatched, 1);
+		ZCSTAT_INCR(zcs_high_wait_ns, wait);
+	} else {
+		ZCSTAT_INCR(zcs_dispatched, 1);
+		ZCSTAT_INCR(zcs_wait_ns, wait);
+	}
+}
+
 static zio_t *
 zio_issue_async(zio_t *zio)
 {
@@ -1963,12 +2123,34 @@ __zio_execute(zio_t *zio)
 		 *
 		 * For VDEV_IO_START, we cut in line so that the io will
 		 * be sent to disk promptly.
+		 *
+		 * The compute taskqs complete reads for the interrupt
+		 * threads, so they are subject to the same rule.
 		 */
 		if ((stage & ZIO_BLOCKING_STAGES) && zio->io_vd == NULL &&
-		    zio_taskq_member(zio, ZIO_TASKQ_INTERRUPT)) {
+		    (zio_taskq_member(zio, ZIO_TASKQ_INTERRUPT) ||
+		    zio_taskq_member(zio, ZIO_TASKQ_COMPUTE) ||
+		    zio_taskq_member(zio, ZIO_TASKQ_COMPUTE_HIGH))) {
 			zio_taskq_dispatch(zio, ZIO_TASKQ_ISSUE, cut);
 			return;
 		}
+
+		/*
+		 * Checksum verification, and the decompression and
+		 * decryption done when the zio completes, are CPU bound.
+		 * Move them off the interrupt threads so that other i/o
+		 * completions are not queued behind them.
+		 */
+		if (stage == ZIO_STAGE_CHECKSUM_VERIFY) {
+			if (zio->io_compute_ts != 0) {
+				zio_compute_start(zio);
+			} else if (zio_compute_offload &&
+			    (zio_taskq_member(zio, ZIO_TASKQ_INTERRUPT) ||
+			    zio_taskq_member(zio, ZIO_TASKQ_INTERRUPT_HIGH)) &&
+			    zio_compute_dispatch(zio)) {
+				return;
+			}
+		}
 #if 0
 #ifdef _KERNEL
 		/*
@@ -3984,6 +4166,20 @@ zio_checksum_generate(zio_t *zio)
 		} else {
 			checksum = BP_GET_CHECKSUM(bp);
 		}
+
+		/* Use the checksum taken by zio_write_compress(), if any */
+		if (zio->io_precksum_size != 0) {
+			boolean_t valid =
+			    (checksum == ZIO_CHECKSUM_FLETCHER_4 &&
+			    zio->io_precksum_size == zio->io_size &&
+			    !BP_USES_CRYPT(bp));
+
+			zio->io_precksum_size = 0;
+			if (valid) {
+				bp->blk_cksum = zio->io_precksum;
+				return (zio);
+			}
+		}
 	}
 
 	zio_checksum_compute(zio, checksum, zio->io_abd, zio->io_size);
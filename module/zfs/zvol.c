@@ -2407,7 +2407,7 @@ zvol_write(dev_t dev, struct uio *uio, int p)
 		mutex_enter(&zfsdev_state_lock);
 		if (zv->zv_zilog == NULL) {
 			zv->zv_zilog = zil_open(zv->zv_objset,
-				zvol_get_data);
+				zvol_get_data, NULL);
 			zv->zv_flags |= ZVOL_WRITTEN_TO;
 		}
 		mutex_exit(&zfsdev_state_lock);
@@ -0,0 +1,177 @@
+#!/bin/bash
+#
+# Wrapper script for measuring how fast a long chain of snapshots with
+# overlapping deadlists can be destroyed in an existing pool.
+#
+
+basedir="$(dirname $0)"
+
+SCRIPT_COMMON=common.sh
+if [ -f "${basedir}/${SCRIPT_COMMON}" ]; then
+. "${basedir}/${SCRIPT_COMMON}"
+else
+echo "Missing helper script ${SCRIPT_COMMON}" && exit 1
+fi
+
+PROG=zfs-deadlist-survey.sh
+
+usage() {
+cat << EOF
+USAGE:
+$0 [hvk] <-p pool> [-c snapshots] [-b blocks] [-m mountpoint] [-l log]
+
+DESCRIPTION:
+        Helper script for benchmarking snapshot destruction along a
+        chain.  A filesystem <pool>/zfs-deadlist-survey is created with
+        a single file, a run of its blocks is overwritten before each
+        snapshot, and every snapshot but the first and the last is then
+        destroyed with a single 'zfs destroy' range.  Each destroy merges
+        its deadlist into its successor's, so the reported snapshots per
+        second is dominated by deadlist work.  Run it with -c 1000 and
+        -c 10000 to compare chain lengths.
+
+OPTIONS:
+        -h      Show this message
+        -v      Verbose
+        -k      Keep the filesystem after the survey
+        -p      Pool to create the filesystem in
+        -c      Number of snapshots in the chain (default 1000)
+        -b      Blocks overwritten between snapshots (default 256)
+        -m      Mountpoint (default /var/tmp/zfs-deadlist-survey)
+        -l      Survey log (default /dev/null)
+
+EOF
+}
+
+print_header() {
+tee -a ${SURVEY_LOG} << EOF
+
+================================================================
+Test: $1
+EOF
+}
+
+# Create the filesystem and a file of SURVEY_RECORDS 8K records.
+survey_populate() {
+	${ZFS} create -o mountpoint=${SURVEY_MNT} -o recordsize=8k \
+	    -o compression=off ${SURVEY_FS} || \
+		die "Unable to create ${SURVEY_FS}"
+
+	dd if=/dev/urandom of=${SURVEY_FILE} bs=8k \
+	    count=${SURVEY_RECORDS} 2>/dev/null || \
+		die "Unable to write ${SURVEY_FILE}"
+}
+
+survey_cleanup() {
+	${ZFS} destroy -r ${SURVEY_FS} || \
+		die "Unable to destroy ${SURVEY_FS}"
+}
+
+# Overwrite SURVEY_BLOCKS records at a random offset and snapshot, once
+# for every snapshot in the chain, so that consecutive deadlists overlap.
+survey_chain() {
+	local i seek
+
+	for (( i=0; i<${SURVEY_SNAPSHOTS}; i++ )); do
+		seek=$(( (RANDOM * 32768 + RANDOM) % \
+		    (SURVEY_RECORDS - SURVEY_BLOCKS) ))
+		dd if=/dev/urandom of=${SURVEY_FILE} bs=8k \
+		    count=${SURVEY_BLOCKS} seek=${seek} conv=notrunc \
+		    2>/dev/null || return 1
+		${ZFS} snapshot ${SURVEY_FS}@chain${i} || return 1
+	done
+}
+
+# Time a single command, discarding its output, and report how many of
+# the given number of snapshots it handled per second.
+survey_rate() {
+	local count=$1
+	local TIMEFORMAT="%R"
+	local elapsed
+
+	shift
+	print_header "$*"
+	elapsed=$( { time "$@" >/dev/null ; } 2>&1 ) || die "'$*' failed"
+	awk -v c=${count} -v e=${elapsed} 'BEGIN { printf("Elapsed: %s " \
+	    "seconds (%d snapshots, %.0f snapshots/sec)\n", e, c, \
+	    e > 0 ? c / e : 0) }' | tee -a ${SURVEY_LOG}
+}
+
+SURVEY_POOL=
+SURVEY_SNAPSHOTS=1000
+SURVEY_BLOCKS=256
+SURVEY_MNT=/var/tmp/zfs-deadlist-survey
+SURVEY_LOG=/dev/null
+SURVEY_KEEP=
+
+while getopts 'hvkp:c:b:m:l:' OPTION; do
+	case $OPTION in
+	h)
+		usage
+		exit 1
+		;;
+	v)
+		VERBOSE=1
+		;;
+	k)
+		SURVEY_KEEP=1
+		;;
+	p)
+		SURVEY_POOL=${OPTARG}
+		;;
+	c)
+		SURVEY_SNAPSHOTS=${OPTARG}
+		;;
+	b)
+		SURVEY_BLOCKS=${OPTARG}
+		;;
+	m)
+		SURVEY_MNT=${OPTARG}
+		;;
+	l)
+		SURVEY_LOG=${OPTARG}
+		;;
+	?)
+		usage
+		exit 1
+		;;
+	esac
+done
+
+if [ $(id -u) != 0 ]; then
+	die "Must run as root"
+fi
+
+if [ -z "${SURVEY_POOL}" ]; then
+	usage
+	exit 1
+fi
+
+if [ ${SURVEY_SNAPSHOTS} -lt 3 ]; then
+	die "A chain needs at least 3 snapshots"
+fi
+
+SURVEY_FS=${SURVEY_POOL}/zfs-deadlist-survey
+SURVEY_FILE=${SURVEY_MNT}/data
+SURVEY_RECORDS=$(( SURVEY_BLOCKS * 64 ))
+
+${ZPOOL} list ${SURVEY_POOL} >/dev/null 2>&1 || \
+	die "Pool '${SURVEY_POOL}' does not exist"
+${ZFS} list ${SURVEY_FS} >/dev/null 2>&1 && \
+	die "Dataset '${SURVEY_FS}' already exists"
+
+msg "Creating ${SURVEY_FS}"
+survey_populate
+
+msg "Creating a chain of ${SURVEY_SNAPSHOTS} snapshots"
+survey_chain || die "Unable to create the snapshot chain"
+
+survey_rate $(( SURVEY_SNAPSHOTS - 2 )) ${ZFS} destroy \
+    ${SURVEY_FS}@chain1%chain$(( SURVEY_SNAPSHOTS - 2 ))
+
+if [ -z "${SURVEY_KEEP}" ]; then
+	msg "Destroying ${SURVEY_FS}"
+	survey_cleanup
+fi
+
+exit 0
@@ -0,0 +1,163 @@
+#!/bin/bash
+#
+# Wrapper script for measuring 'zfs diff' throughput on an existing pool.
+#
+
+basedir="$(dirname $0)"
+
+SCRIPT_COMMON=common.sh
+if [ -f "${basedir}/${SCRIPT_COMMON}" ]; then
+. "${basedir}/${SCRIPT_COMMON}"
+else
+echo "Missing helper script ${SCRIPT_COMMON}" && exit 1
+fi
+
+PROG=zfs-diff-survey.sh
+
+usage() {
+cat << EOF
+USAGE:
+$0 [hvk] <-p pool> [-d directories] [-f files] [-l log]
+
+DESCRIPTION:
+        Helper script for benchmarking zfs diff.  A filesystem is created
+        as <pool>/zfs-diff-survey and populated with the requested number
+        of directories and files per directory.  A snapshot is taken, every
+        file is then modified, renamed, removed or re-created in turn, and
+        'zfs diff' between that snapshot and a second one is timed.
+
+OPTIONS:
+        -h      Show this message
+        -v      Verbose
+        -k      Keep the filesystem after the survey
+        -p      Pool to create the filesystem in
+        -d      Number of directories (default 10)
+        -f      Number of files per directory (default 10000)
+        -l      Survey log (default /dev/null)
+
+EOF
+}
+
+print_header() {
+tee -a ${SURVEY_LOG} << EOF
+
+================================================================
+Test: $1
+EOF
+}
+
+# Create SURVEY_DIRS directories of SURVEY_FILES files each.
+survey_populate() {
+	local d f
+
+	for (( d=0; d<${SURVEY_DIRS}; d++ )); do
+		mkdir ${SURVEY_MNT}/dir${d} || \
+			die "Unable to create ${SURVEY_MNT}/dir${d}"
+		for (( f=0; f<${SURVEY_FILES}; f++ )); do
+			echo ${f} >${SURVEY_MNT}/dir${d}/file${f}
+		done
+	done
+}
+
+# Touch every file with one of the four kinds of change zfs diff reports.
+survey_change() {
+	local d f
+
+	for (( d=0; d<${SURVEY_DIRS}; d++ )); do
+		for (( f=0; f<${SURVEY_FILES}; f++ )); do
+			local file=${SURVEY_MNT}/dir${d}/file${f}
+
+			case $(( f % 4 )) in
+			0) echo modified >>${file} ;;
+			1) mv ${file} ${file}.renamed ;;
+			2) rm ${file} ;;
+			3) rm ${file} && echo ${f} >${file} ;;
+			esac
+		done
+	done
+}
+
+# Time a single command, discarding its output.
+survey_time() {
+	local TIMEFORMAT="Elapsed: %R seconds (user %U, sys %S)"
+
+	print_header "$*"
+	{ time "$@" >/dev/null ; } 2>&1 | tee -a ${SURVEY_LOG}
+	[ ${PIPESTATUS[0]} -eq 0 ] || die "'$*' failed"
+}
+
+SURVEY_POOL=
+SURVEY_DIRS=10
+SURVEY_FILES=10000
+SURVEY_LOG=/dev/null
+SURVEY_KEEP=
+
+while getopts 'hvkp:d:f:l:' OPTION; do
+	case $OPTION in
+	h)
+		usage
+		exit 1
+		;;
+	v)
+		VERBOSE=1
+		;;
+	k)
+		SURVEY_KEEP=1
+		;;
+	p)
+		SURVEY_POOL=${OPTARG}
+		;;
+	d)
+		SURVEY_DIRS=${OPTARG}
+		;;
+	f)
+		SURVEY_FILES=${OPTARG}
+		;;
+	l)
+		SURVEY_LOG=${OPTARG}
+		;;
+	?)
+		usage
+		exit 1
+		;;
+	esac
+done
+
+if [ $(id -u) != 0 ]; then
+	die "Must run as root"
+fi
+
+if [ -z "${SURVEY_POOL}" ]; then
+	usage
+	exit 1
+fi
+
+SURVEY_FS=${SURVEY_POOL}/zfs-diff-survey
+
+${ZPOOL} list ${SURVEY_POOL} >/dev/null 2>&1 || \
+	die "Pool '${SURVEY_POOL}' does not exist"
+${ZFS} list ${SURVEY_FS} >/dev/null 2>&1 && \
+	die "Dataset '${SURVEY_FS}' already exists"
+
+${ZFS} create ${SURVEY_FS} || die "Unable to create ${SURVEY_FS}"
+SURVEY_MNT=$(${ZFS} get -H -o value mountpoint ${SURVEY_FS})
+
+msg "Creating ${SURVEY_DIRS} directories of ${SURVEY_FILES} files"
+survey_populate
+${ZFS} snapshot ${SURVEY_FS}@before || die "Unable to snapshot ${SURVEY_FS}"
+
+msg "Changing every file"
+survey_change
+${ZFS} snapshot ${SURVEY_FS}@after || die "Unable to snapshot ${SURVEY_FS}"
+
+survey_time ${ZFS} diff ${SURVEY_FS}@before ${SURVEY_FS}@after
+survey_time ${ZFS} diff -FHt ${SURVEY_FS}@before ${SURVEY_FS}@after
+echo "Changes: $(${ZFS} diff -H ${SURVEY_FS}@before ${SURVEY_FS}@after | \
+	wc -l)" | tee -a ${SURVEY_LOG}
+
+if [ -z "${SURVEY_KEEP}" ]; then
+	msg "Destroying ${SURVEY_FS}"
+	${ZFS} destroy -r ${SURVEY_FS} || die "Unable to destroy ${SURVEY_FS}"
+fi
+
+exit 0
@@ -0,0 +1,152 @@
+#!/bin/bash
+#
+# Wrapper script for timing 'zfs list' and 'zfs get' against a large number
+# of filesystems and snapshots in an existing pool.
+#
+
+basedir="$(dirname $0)"
+
+SCRIPT_COMMON=common.sh
+if [ -f "${basedir}/${SCRIPT_COMMON}" ]; then
+. "${basedir}/${SCRIPT_COMMON}"
+else
+echo "Missing helper script ${SCRIPT_COMMON}" && exit 1
+fi
+
+PROG=zfs-list-survey.sh
+
+usage() {
+cat << EOF
+USAGE:
+$0 [hvk] <-p pool> [-f filesystems] [-s snapshots] [-l log]
+
+DESCRIPTION:
+        Helper script for benchmarking dataset listing at scale.  A tree
+        of filesystems, each with the requested number of snapshots, is
+        created under <pool>/zfs-list-survey and a set of 'zfs list' and
+        'zfs get' commands is timed against it.
+
+OPTIONS:
+        -h      Show this message
+        -v      Verbose
+        -k      Keep the datasets after the survey
+        -p      Pool to create the datasets in
+        -f      Number of filesystems (default 100)
+        -s      Number of snapshots per filesystem (default 100)
+        -l      Survey log (default /dev/null)
+
+EOF
+}
+
+print_header() {
+tee -a ${SURVEY_LOG} << EOF
+
+================================================================
+Test: $1
+EOF
+}
+
+# Create SURVEY_FILESYSTEMS filesystems below SURVEY_ROOT, then take
+# SURVEY_SNAPSHOTS recursive snapshots of the whole tree.
+survey_populate() {
+	local i
+
+	${ZFS} create -o mountpoint=none ${SURVEY_ROOT} || \
+		die "Unable to create ${SURVEY_ROOT}"
+
+	for (( i=0; i<${SURVEY_FILESYSTEMS}; i++ )); do
+		${ZFS} create ${SURVEY_ROOT}/fs${i} || \
+			die "Unable to create ${SURVEY_ROOT}/fs${i}"
+	done
+
+	for (( i=0; i<${SURVEY_SNAPSHOTS}; i++ )); do
+		${ZFS} snapshot -r ${SURVEY_ROOT}@snap${i} || \
+			die "Unable to snapshot ${SURVEY_ROOT}@snap${i}"
+	done
+}
+
+survey_cleanup() {
+	${ZFS} destroy -r ${SURVEY_ROOT} || \
+		die "Unable to destroy ${SURVEY_ROOT}"
+}
+
+# Time a single command, discarding its output.
+survey_time() {
+	local TIMEFORMAT="Elapsed: %R seconds (user %U, sys %S)"
+
+	print_header "$*"
+	{ time "$@" >/dev/null ; } 2>&1 | tee -a ${SURVEY_LOG}
+	[ ${PIPESTATUS[0]} -eq 0 ] || die "'$*' failed"
+}
+
+SURVEY_POOL=
+SURVEY_FILESYSTEMS=100
+SURVEY_SNAPSHOTS=100
+SURVEY_LOG=/dev/null
+SURVEY_KEEP=
+
+while getopts 'hvkp:f:s:l:' OPTION; do
+	case $OPTION in
+	h)
+		usage
+		exit 1
+		;;
+	v)
+		VERBOSE=1
+		;;
+	k)
+		SURVEY_KEEP=1
+		;;
+	p)
+		SURVEY_POOL=${OPTARG}
+		;;
+	f)
+		SURVEY_FILESYSTEMS=${OPTARG}
+		;;
+	s)
+		SURVEY_SNAPSHOTS=${OPTARG}
+		;;
+	l)
+		SURVEY_LOG=${OPTARG}
+		;;
+	?)
+		usage
+		exit 1
+		;;
+	esac
+done
+
+if [ $(id -u) != 0 ]; then
+	die "Must run as root"
+fi
+
+if [ -z "${SURVEY_POOL}" ]; then
+	usage
+	exit 1
+fi
+
+SURVEY_ROOT=${SURVEY_POOL}/zfs-list-survey
+
+${ZPOOL} list ${SURVEY_POOL} >/dev/null 2>&1 || \
+	die "Pool '${SURVEY_POOL}' does not exist"
+${ZFS} list ${SURVEY_ROOT} >/dev/null 2>&1 && \
+	die "Dataset '${SURVEY_ROOT}' already exists"
+
+msg "Creating ${SURVEY_FILESYSTEMS} filesystems with" \
+    "${SURVEY_SNAPSHOTS} snapshots each"
+survey_populate
+
+survey_time ${ZFS} list -r ${SURVEY_ROOT}
+survey_time ${ZFS} list -H -r -o name ${SURVEY_ROOT}
+survey_time ${ZFS} list -H -r -t all -o name,used,refer ${SURVEY_ROOT}
+survey_time ${ZFS} list -H -r -t snapshot -o name ${SURVEY_ROOT}
+survey_time ${ZFS} list -H -r -t snapshot -o name -s createtxg ${SURVEY_ROOT}
+survey_time ${ZFS} get -H -r -t all -o name,value used ${SURVEY_ROOT}
+survey_time ${ZFS} get -H -r -t all all ${SURVEY_ROOT}
+
+if [ -z "${SURVEY_KEEP}" ]; then
+	msg "Destroying ${SURVEY_ROOT}"
+	survey_cleanup
+fi
+
+exit 0
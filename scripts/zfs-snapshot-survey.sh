@@ -0,0 +1,160 @@
+#!/bin/bash
+#
+# Wrapper script for measuring snapshot creation and destruction rates
+# across a large number of filesystems in an existing pool.
+#
+
+basedir="$(dirname $0)"
+
+SCRIPT_COMMON=common.sh
+if [ -f "${basedir}/${SCRIPT_COMMON}" ]; then
+. "${basedir}/${SCRIPT_COMMON}"
+else
+echo "Missing helper script ${SCRIPT_COMMON}" && exit 1
+fi
+
+PROG=zfs-snapshot-survey.sh
+
+usage() {
+cat << EOF
+USAGE:
+$0 [hvk] <-p pool> [-f filesystems] [-s snapshots] [-l log]
+
+DESCRIPTION:
+        Helper script for benchmarking batched snapshot operations.  The
+        requested number of filesystems is created under
+        <pool>/zfs-snapshot-survey, every filesystem is snapshotted with
+        'zfs snapshot -r' once per round, and all of the snapshots are
+        then destroyed with a single 'zfs destroy -r' range.  Each step
+        reports the number of snapshots handled per second.  Run it with
+        -f 1000, 10000 and 100000 to compare batch sizes.
+
+OPTIONS:
+        -h      Show this message
+        -v      Verbose
+        -k      Keep the filesystems after the survey
+        -p      Pool to create the filesystems in
+        -f      Number of filesystems (default 1000)
+        -s      Number of snapshot rounds (default 10)
+        -l      Survey log (default /dev/null)
+
+EOF
+}
+
+print_header() {
+tee -a ${SURVEY_LOG} << EOF
+
+================================================================
+Test: $1
+EOF
+}
+
+# Create SURVEY_FILESYSTEMS unmounted filesystems below SURVEY_ROOT.
+survey_populate() {
+	local i
+
+	${ZFS} create -o mountpoint=none ${SURVEY_ROOT} || \
+		die "Unable to create ${SURVEY_ROOT}"
+
+	for (( i=0; i<${SURVEY_FILESYSTEMS}; i++ )); do
+		${ZFS} create ${SURVEY_ROOT}/fs${i} || \
+			die "Unable to create ${SURVEY_ROOT}/fs${i}"
+	done
+}
+
+survey_cleanup() {
+	${ZFS} destroy -r ${SURVEY_ROOT} || \
+		die "Unable to destroy ${SURVEY_ROOT}"
+}
+
+# Take SURVEY_SNAPSHOTS recursive snapshots of the whole tree.
+survey_snapshot() {
+	local i
+
+	for (( i=0; i<${SURVEY_SNAPSHOTS}; i++ )); do
+		${ZFS} snapshot -r ${SURVEY_ROOT}@snap${i} || return 1
+	done
+}
+
+# Time a single command, discarding its output, and report how many of
+# the given number of snapshots it handled per second.
+survey_rate() {
+	local count=$1
+	local TIMEFORMAT="%R"
+	local elapsed
+
+	shift
+	print_header "$*"
+	elapsed=$( { time "$@" >/dev/null ; } 2>&1 ) || die "'$*' failed"
+	awk -v c=${count} -v e=${elapsed} 'BEGIN { printf("Elapsed: %s " \
+	    "seconds (%d snapshots, %.0f snapshots/sec)\n", e, c, \
+	    e > 0 ? c / e : 0) }' | tee -a ${SURVEY_LOG}
+}
+
+SURVEY_POOL=
+SURVEY_FILESYSTEMS=1000
+SURVEY_SNAPSHOTS=10
+SURVEY_LOG=/dev/null
+SURVEY_KEEP=
+
+while getopts 'hvkp:f:s:l:' OPTION; do
+	case $OPTION in
+	h)
+		usage
+		exit 1
+		;;
+	v)
+		VERBOSE=1
+		;;
+	k)
+		SURVEY_KEEP=1
+		;;
+	p)
+		SURVEY_POOL=${OPTARG}
+		;;
+	f)
+		SURVEY_FILESYSTEMS=${OPTARG}
+		;;
+	s)
+		SURVEY_SNAPSHOTS=${OPTARG}
+		;;
+	l)
+		SURVEY_LOG=${OPTARG}
+		;;
+	?)
+		usage
+		exit 1
+		;;
+	esac
+done
+
+if [ $(id -u) != 0 ]; then
+	die "Must run as root"
+fi
+
+if [ -z "${SURVEY_POOL}" ]; then
+	usage
+	exit 1
+fi
+
+SURVEY_ROOT=${SURVEY_POOL}/zfs-snapshot-survey
+SURVEY_TOTAL=$(( (SURVEY_FILESYSTEMS + 1) * SURVEY_SNAPSHOTS ))
+
+${ZPOOL} list ${SURVEY_POOL} >/dev/null 2>&1 || \
+	die "Pool '${SURVEY_POOL}' does not exist"
+${ZFS} list ${SURVEY_ROOT} >/dev/null 2>&1 && \
+	die "Dataset '${SURVEY_ROOT}' already exists"
+
+msg "Creating ${SURVEY_FILESYSTEMS} filesystems"
+survey_populate
+
+survey_rate ${SURVEY_TOTAL} survey_snapshot
+survey_rate ${SURVEY_TOTAL} ${ZFS} destroy -r \
+    ${SURVEY_ROOT}@snap0%snap$(( SURVEY_SNAPSHOTS - 1 ))
+
+if [ -z "${SURVEY_KEEP}" ]; then
+	msg "Destroying ${SURVEY_ROOT}"
+	survey_cleanup
+fi
+
+exit 0
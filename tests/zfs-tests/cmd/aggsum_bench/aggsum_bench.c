@@ -0,0 +1,220 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Contention benchmark for aggsum, wmsum and plain atomic counters.
+ *
+ * Each writer thread adds and then removes a block-sized amount, the way
+ * the ARC accounts buffers in arc_size, and the run reports the updates per
+ * second for each counter type as the thread count doubles.  The aggsum is
+ * run twice, the second time with a reader thread calling aggsum_compare()
+ * against a target right at the counter's value, which is the worst case
+ * for arc_is_overflowing()-style threshold checks; the rate of compares is
+ * reported along with the spread between the aggsum's bounds.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/zfs_context.h>
+#include <sys/aggsum.h>
+#include <sys/wmsum.h>
+
+#define	AGGSUM_BENCH_BASE	(1ULL << 30)
+
+typedef enum aggsum_bench_type {
+	ABT_ATOMIC,
+	ABT_WMSUM,
+	ABT_AGGSUM,
+	ABT_AGGSUM_READ,
+	ABT_COUNT
+} aggsum_bench_type_t;
+
+static const char *aggsum_bench_names[ABT_COUNT] = {
+	"atomic", "wmsum", "aggsum", "aggsum+rd"
+};
+
+static int ab_threads = 16;
+static int ab_seconds = 1;
+
+static aggsum_bench_type_t ab_type;
+static uint64_t ab_atomic;
+static wmsum_t ab_wmsum;
+static aggsum_t ab_aggsum;
+static volatile boolean_t ab_start;
+static volatile boolean_t ab_stop;
+static uint64_t ab_ops;
+static uint64_t ab_compares;
+static uint64_t ab_spread;
+
+static void
+usage(void)
+{
+	(void) fprintf(stderr, "Usage: aggsum_bench [-t max threads] "
+	    "[-s seconds per run]\n");
+	exit(2);
+}
+
+static void *
+writer(void *arg)
+{
+	uint64_t ops = 0;
+	int i = (int)(uintptr_t)arg;
+
+	while (!ab_start)
+		continue;
+
+	while (!ab_stop) {
+		/* Mix block sizes from 4k to 128k. */
+		int64_t delta = 4096 << (i++ % 6);
+
+		switch (ab_type) {
+		case ABT_ATOMIC:
+			atomic_add_64(&ab_atomic, delta);
+			atomic_add_64(&ab_atomic, -delta);
+			break;
+		case ABT_WMSUM:
+			wmsum_add(&ab_wmsum, delta);
+			wmsum_add(&ab_wmsum, -delta);
+			break;
+		default:
+			aggsum_add(&ab_aggsum, delta);
+			aggsum_add(&ab_aggsum, -delta);
+			break;
+		}
+		ops += 2;
+	}
+
+	atomic_add_64(&ab_ops, ops);
+
+	return (NULL);
+}
+
+static void *
+reader(void *arg)
+{
+	uint64_t compares = 0, spread = 0;
+
+	while (!ab_start)
+		continue;
+
+	while (!ab_stop) {
+		(void) aggsum_compare(&ab_aggsum, AGGSUM_BENCH_BASE);
+		spread = MAX(spread, aggsum_upper_bound(&ab_aggsum) -
+		    aggsum_lower_bound(&ab_aggsum));
+		compares++;
+	}
+
+	ab_compares = compares;
+	ab_spread = spread;
+
+	return (NULL);
+}
+
+static double
+run(aggsum_bench_type_t type, int nthreads)
+{
+	pthread_t *tids = calloc(nthreads + 1, sizeof (pthread_t));
+	hrtime_t start, elapsed;
+	int i;
+
+	if (tids == NULL) {
+		perror("calloc");
+		exit(1);
+	}
+
+	ab_type = type;
+	ab_ops = 0;
+	ab_start = ab_stop = B_FALSE;
+	for (i = 0; i < nthreads; i++) {
+		VERIFY0(pthread_create(&tids[i], NULL, writer,
+		    (void *)(uintptr_t)i));
+	}
+	if (type == ABT_AGGSUM_READ)
+		VERIFY0(pthread_create(&tids[i++], NULL, reader, NULL));
+
+	start = gethrtime();
+	ab_start = B_TRUE;
+	(void) sleep(ab_seconds);
+	ab_stop = B_TRUE;
+	while (--i >= 0)
+		VERIFY0(pthread_join(tids[i], NULL));
+	elapsed = gethrtime() - start;
+	free(tids);
+
+	return ((double)ab_ops * NANOSEC / elapsed);
+}
+
+static void
+report(int nthreads)
+{
+	aggsum_bench_type_t type;
+
+	(void) printf("%8d", nthreads);
+	for (type = 0; type < ABT_COUNT; type++)
+		(void) printf(" %12.0f", run(type, nthreads));
+	(void) printf(" %12.0f %12llu\n", (double)ab_compares / ab_seconds,
+	    (u_longlong_t)ab_spread);
+}
+
+int
+main(int argc, char **argv)
+{
+	aggsum_bench_type_t type;
+	int c, n;
+
+	while ((c = getopt(argc, argv, "t:s:")) != -1) {
+		switch (c) {
+		case 't':
+			ab_threads = atoi(optarg);
+			break;
+		case 's':
+			ab_seconds = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (ab_threads <= 0 || ab_seconds <= 0)
+		usage();
+
+	kernel_init(FREAD);
+	ab_atomic = AGGSUM_BENCH_BASE;
+	wmsum_init(&ab_wmsum, AGGSUM_BENCH_BASE);
+	aggsum_init(&ab_aggsum, AGGSUM_BENCH_BASE);
+
+	(void) printf("%8s", "threads");
+	for (type = 0; type < ABT_COUNT; type++)
+		(void) printf(" %12s", aggsum_bench_names[type]);
+	(void) printf(" %12s %12s\n", "compares", "spread");
+
+	for (n = 1; n <= ab_threads; n *= 2)
+		report(n);
+	if (n / 2 != ab_threads)
+		report(ab_threads);
+
+	/* Every writer put back what it took. */
+	VERIFY3U(ab_atomic, ==, AGGSUM_BENCH_BASE);
+	VERIFY3U(wmsum_value(&ab_wmsum), ==, AGGSUM_BENCH_BASE);
+	VERIFY3U(aggsum_value(&ab_aggsum), ==, AGGSUM_BENCH_BASE);
+	VERIFY0(aggsum_compare(&ab_aggsum, AGGSUM_BENCH_BASE));
+
+	aggsum_fini(&ab_aggsum);
+	wmsum_fini(&ab_wmsum);
+	kernel_fini();
+
+	return (0);
+}
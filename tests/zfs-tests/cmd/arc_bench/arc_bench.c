@@ -0,0 +1,242 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Microbenchmark for arc_read() hit throughput across thread counts.
+ *
+ * A throwaway pool is created on a file vdev with libzpool, and every
+ * thread then reads the pool's root block pointer through the ARC over and
+ * over.  After the first read each arc_read() is a hit on the same buffer,
+ * so the run measures the cost of the hit path, including the ARC hit and
+ * access statistics, as more CPUs pile onto it.  Ideally the ops/sec per
+ * thread stay flat as the thread count doubles.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/zfs_context.h>
+#include <sys/dmu_objset.h>
+#include <sys/spa.h>
+#include <sys/spa_impl.h>
+#include <sys/txg.h>
+#include <sys/arc.h>
+#include <sys/zio.h>
+#include <sys/fs/zfs.h>
+
+#define	ARC_BENCH_VDEV_SIZE	(128ULL << 20)
+
+static char *ab_dir = "/tmp";
+static int ab_threads = 16;
+static int ab_seconds = 2;
+
+static spa_t *ab_spa;
+static blkptr_t ab_bp;
+static volatile boolean_t ab_start;
+static volatile boolean_t ab_stop;
+static uint64_t ab_ops;
+static uint64_t ab_errors;
+
+static void
+usage(void)
+{
+	(void) fprintf(stderr, "Usage: arc_bench [-d directory] "
+	    "[-t max threads] [-s seconds per run]\n");
+	exit(2);
+}
+
+static int
+read_root(void)
+{
+	arc_flags_t aflags = ARC_FLAG_WAIT;
+	arc_buf_t *abuf = NULL;
+	zbookmark_phys_t zb;
+	int err;
+
+	SET_BOOKMARK(&zb, DMU_META_OBJSET, ZB_ROOT_OBJECT, ZB_ROOT_LEVEL,
+	    ZB_ROOT_BLKID);
+
+	err = arc_read(NULL, ab_spa, &ab_bp, arc_getbuf_func, &abuf,
+	    ZIO_PRIORITY_SYNC_READ, ZIO_FLAG_CANFAIL, &aflags, &zb);
+	if (err == 0 && abuf == NULL)
+		err = SET_ERROR(EIO);
+	if (abuf != NULL)
+		arc_buf_destroy(abuf, &abuf);
+
+	return (err);
+}
+
+static void *
+reader(void *arg)
+{
+	uint64_t ops = 0, errors = 0;
+
+	while (!ab_start)
+		continue;
+
+	while (!ab_stop) {
+		if (read_root() != 0)
+			errors++;
+		else
+			ops++;
+	}
+
+	atomic_add_64(&ab_ops, ops);
+	atomic_add_64(&ab_errors, errors);
+
+	return (NULL);
+}
+
+static void
+run(int nthreads)
+{
+	pthread_t *tids = calloc(nthreads, sizeof (pthread_t));
+	hrtime_t start, elapsed;
+	double rate;
+	int i;
+
+	if (tids == NULL) {
+		perror("calloc");
+		exit(1);
+	}
+
+	ab_ops = 0;
+	ab_start = ab_stop = B_FALSE;
+	for (i = 0; i < nthreads; i++)
+		VERIFY0(pthread_create(&tids[i], NULL, reader, NULL));
+
+	start = gethrtime();
+	ab_start = B_TRUE;
+	(void) sleep(ab_seconds);
+	ab_stop = B_TRUE;
+	for (i = 0; i < nthreads; i++)
+		VERIFY0(pthread_join(tids[i], NULL));
+	elapsed = gethrtime() - start;
+
+	rate = (double)ab_ops * NANOSEC / elapsed;
+	(void) printf("%8d %14.0f %14.0f\n", nthreads, rate, rate / nthreads);
+	free(tids);
+}
+
+static nvlist_t *
+make_vdev_root(const char *path)
+{
+	nvlist_t *root, *file;
+
+	file = fnvlist_alloc();
+	fnvlist_add_string(file, ZPOOL_CONFIG_TYPE, VDEV_TYPE_FILE);
+	fnvlist_add_string(file, ZPOOL_CONFIG_PATH, path);
+	fnvlist_add_uint64(file, ZPOOL_CONFIG_IS_LOG, 0);
+
+	root = fnvlist_alloc();
+	fnvlist_add_string(root, ZPOOL_CONFIG_TYPE, VDEV_TYPE_ROOT);
+	fnvlist_add_nvlist_array(root, ZPOOL_CONFIG_CHILDREN, &file, 1);
+	fnvlist_free(file);
+
+	return (root);
+}
+
+int
+main(int argc, char **argv)
+{
+	char pool[64], path[MAXPATHLEN], cache[MAXPATHLEN];
+	nvlist_t *nvroot;
+	int c, fd, n, err;
+
+	while ((c = getopt(argc, argv, "d:t:s:")) != -1) {
+		switch (c) {
+		case 'd':
+			ab_dir = optarg;
+			break;
+		case 't':
+			ab_threads = atoi(optarg);
+			break;
+		case 's':
+			ab_seconds = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (ab_threads <= 0 || ab_seconds <= 0)
+		usage();
+
+	(void) snprintf(pool, sizeof (pool), "arc_bench_%d", (int)getpid());
+	(void) snprintf(path, sizeof (path), "%s/%s.vdev", ab_dir, pool);
+	(void) snprintf(cache, sizeof (cache), "%s/%s.cache", ab_dir, pool);
+
+	if ((fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0666)) == -1 ||
+	    ftruncate(fd, ARC_BENCH_VDEV_SIZE) != 0) {
+		(void) fprintf(stderr, "can't create %s: %s\n", path,
+		    strerror(errno));
+		return (1);
+	}
+	(void) close(fd);
+
+	spa_config_path = cache;
+	kernel_init(FREAD | FWRITE);
+
+	nvroot = make_vdev_root(path);
+	err = spa_create(pool, nvroot, NULL, NULL, NULL);
+	fnvlist_free(nvroot);
+	if (err != 0) {
+		(void) fprintf(stderr, "can't create pool %s: %s\n", pool,
+		    strerror(err));
+		kernel_fini();
+		(void) unlink(path);
+		return (1);
+	}
+	VERIFY0(spa_open(pool, &ab_spa, FTAG));
+
+	/*
+	 * The pool is idle from here on, so the root block pointer stays
+	 * valid for the whole run.  One read up front brings it into the
+	 * ARC so that every timed read is a hit.
+	 */
+	txg_wait_synced(spa_get_dsl(ab_spa), 0);
+	ab_bp = *spa_get_rootblkptr(ab_spa);
+	if ((err = read_root()) != 0) {
+		(void) fprintf(stderr, "can't read the root block: %s\n",
+		    strerror(err));
+		ab_errors++;
+		goto out;
+	}
+
+	(void) printf("%8s %14s %14s\n", "threads", "hits/sec",
+	    "hits/sec/thr");
+	for (n = 1; n <= ab_threads; n *= 2)
+		run(n);
+	if (n / 2 != ab_threads)
+		run(ab_threads);
+
+out:
+	spa_close(ab_spa, FTAG);
+	VERIFY0(spa_destroy(pool));
+	kernel_fini();
+	(void) unlink(path);
+	(void) unlink(cache);
+
+	if (ab_errors != 0) {
+		(void) fprintf(stderr, "%llu reads failed\n",
+		    (u_longlong_t)ab_errors);
+		return (1);
+	}
+
+	return (0);
+}
@@ -300,6 +300,18 @@ test_pool_sync(const char *pool)
 	nvlist_free(required);
 }
 
+static void
+test_pool_vdev_stats(const char *pool)
+{
+	nvlist_t *optional = fnvlist_alloc();
+
+	fnvlist_add_boolean(optional, ZPOOL_VDEV_STATS_EXTENDED);
+
+	IOC_INPUT_TEST(ZFS_IOC_POOL_VDEV_STATS, pool, NULL, optional, 0);
+
+	nvlist_free(optional);
+}
+
 static void
 test_pool_reopen(const char *pool)
 {
@@ -393,6 +405,22 @@ test_space_snaps(const char *snapshot)
 	nvlist_free(required);
 }
 
+static void
+test_objs_to_stats(const char *snapshot)
+{
+	nvlist_t *required = fnvlist_alloc();
+	nvlist_t *optional = fnvlist_alloc();
+
+	fnvlist_add_uint64(required, ZFS_OBJS_TO_STATS_FIRST, 0);
+	fnvlist_add_uint64(required, ZFS_OBJS_TO_STATS_LAST, 64);
+	fnvlist_add_uint64(optional, ZFS_OBJS_TO_STATS_COUNT, 16);
+
+	IOC_INPUT_TEST(ZFS_IOC_OBJS_TO_STATS, snapshot, required, optional, 0);
+
+	nvlist_free(optional);
+	nvlist_free(required);
+}
+
 static void
 test_destroy_snaps(const char *pool, const char *snapshot)
 {
@@ -435,6 +463,26 @@ test_get_bookmarks(const char *dataset)
 	nvlist_free(optional);
 }
 
+static void
+test_list_batch(const char *dataset)
+{
+	nvlist_t *optional = fnvlist_alloc();
+	nvlist_t *props = fnvlist_alloc();
+
+	fnvlist_add_boolean(props, "used");
+	fnvlist_add_boolean(optional, ZFS_LIST_BATCH_SNAPSHOTS);
+	fnvlist_add_uint64(optional, ZFS_LIST_BATCH_CURSOR, 0);
+	fnvlist_add_uint64(optional, ZFS_LIST_BATCH_COUNT, 16);
+	fnvlist_add_nvlist(optional, ZFS_LIST_BATCH_PROPS, props);
+	fnvlist_add_uint64(optional, SNAP_ITER_MIN_TXG, 1);
+	fnvlist_add_uint64(optional, SNAP_ITER_MAX_TXG, UINT64_MAX);
+
+	IOC_INPUT_TEST(ZFS_IOC_LIST_BATCH, dataset, NULL, optional, 0);
+
+	nvlist_free(props);
+	nvlist_free(optional);
+}
+
 static void
 test_destroy_bookmarks(const char *pool, const char *bookmark)
 {
@@ -763,6 +811,7 @@ zfs_ioc_input_tests(const char *pool)
 	 * Note that some test build on previous test operations
 	 */
 	test_pool_sync(pool);
+	test_pool_vdev_stats(pool);
 	test_pool_reopen(pool);
 	test_pool_checkpoint(pool);
 	test_pool_discard_checkpoint(pool);
@@ -773,12 +822,14 @@ zfs_ioc_input_tests(const char *pool)
 	test_snapshot(pool, snapshot);
 
 	test_space_snaps(snapshot);
+	test_objs_to_stats(snapshot);
 	test_send_space(snapbase, snapshot);
 	test_send_new(snapshot, tmpfd);
 	test_recv_new(backup, tmpfd);
 
 	test_bookmark(pool, snapshot, bookmark);
 	test_get_bookmarks(dataset);
+	test_list_batch(dataset);
 	test_destroy_bookmarks(pool, bookmark);
 
 	test_hold(pool, snapshot);
@@ -946,6 +997,9 @@ validate_ioc_values(void)
 	    ZFS_IOC_BASE + 78 == ZFS_IOC_POOL_SYNC &&
 	    ZFS_IOC_BASE + 79 == ZFS_IOC_POOL_TRIM &&
 	    ZFS_IOC_BASE + 80 == ZFS_IOC_RECV_NEW &&
+	    ZFS_IOC_BASE + 81 == ZFS_IOC_LIST_BATCH &&
+	    ZFS_IOC_BASE + 82 == ZFS_IOC_OBJS_TO_STATS &&
+	    ZFS_IOC_BASE + 83 == ZFS_IOC_POOL_VDEV_STATS &&
 	    LINUX_IOC_BASE + 1 == ZFS_IOC_EVENTS_NEXT &&
 	    LINUX_IOC_BASE + 2 == ZFS_IOC_EVENTS_CLEAR &&
 	    LINUX_IOC_BASE + 3 == ZFS_IOC_EVENTS_SEEK);
@@ -0,0 +1,380 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Microbenchmark for nvlist size, pack, unpack and lookup throughput.
+ *
+ * The nvlist is shaped like the config spa_config_generate() returns for
+ * a wide pool: a vdev tree of raidz top-level vdevs, each with a number
+ * of leaf disks, and the usual per-vdev properties and statistics.  The
+ * streamed encoding is also checked against nvlist_pack(), so a non-zero
+ * exit status means the two disagree.
+ *
+ * A second pass times lookups and unique-name adds on flat lists of
+ * snapshot names, with and without the name index, to show the list size
+ * at which the index starts to pay off.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/nvpair.h>
+#include <sys/fs/zfs.h>
+
+#ifdef __APPLE__
+// Why does our libuutil pull in zfs_flags?
+int zfs_flags = 0;
+#endif
+
+#define	NVLIST_BENCH_CHUNK	(128 * 1024)
+#define	NVLIST_BENCH_LOOKUPS	10000
+
+extern uint_t nvpair_hash_min;
+
+static int nb_top = 16;
+static int nb_children = 12;
+static int nb_iters = 100;
+static int nb_pairs = 16384;
+
+typedef struct nvlist_bench_stream {
+	char	*nbs_buf;
+	size_t	nbs_off;
+	size_t	nbs_len;
+} nvlist_bench_stream_t;
+
+static void
+usage(void)
+{
+	(void) fprintf(stderr, "Usage: nvlist_bench [-t top-level vdevs] "
+	    "[-c children per vdev] [-i iterations] [-n max pairs]\n");
+	exit(2);
+}
+
+static nvlist_t *
+make_vdev(const char *type, uint64_t id, uint64_t guid)
+{
+	nvlist_t *nv = fnvlist_alloc();
+	uint64_t stats[sizeof (vdev_stat_t) / sizeof (uint64_t)];
+	int i;
+
+	for (i = 0; i < sizeof (stats) / sizeof (stats[0]); i++)
+		stats[i] = guid * (i + 1);
+
+	fnvlist_add_string(nv, ZPOOL_CONFIG_TYPE, type);
+	fnvlist_add_uint64(nv, ZPOOL_CONFIG_ID, id);
+	fnvlist_add_uint64(nv, ZPOOL_CONFIG_GUID, guid);
+	fnvlist_add_uint64(nv, ZPOOL_CONFIG_CREATE_TXG, 4);
+	fnvlist_add_uint64_array(nv, ZPOOL_CONFIG_VDEV_STATS, stats,
+	    sizeof (stats) / sizeof (stats[0]));
+
+	return (nv);
+}
+
+static nvlist_t *
+make_config(void)
+{
+	nvlist_t *config = fnvlist_alloc();
+	nvlist_t *root = make_vdev(VDEV_TYPE_ROOT, 0, 1);
+	nvlist_t **top = calloc(nb_top, sizeof (nvlist_t *));
+	nvlist_t **leaf = calloc(nb_children, sizeof (nvlist_t *));
+	char buf[128];
+	int t, c;
+
+	if (top == NULL || leaf == NULL) {
+		perror("calloc");
+		exit(1);
+	}
+
+	fnvlist_add_uint64(config, ZPOOL_CONFIG_VERSION, SPA_VERSION_5000);
+	fnvlist_add_string(config, ZPOOL_CONFIG_POOL_NAME, "tank");
+	fnvlist_add_uint64(config, ZPOOL_CONFIG_POOL_STATE, 0);
+	fnvlist_add_uint64(config, ZPOOL_CONFIG_POOL_TXG, 1234567);
+	fnvlist_add_uint64(config, ZPOOL_CONFIG_POOL_GUID, 0x1234abcd);
+	fnvlist_add_uint64(config, ZPOOL_CONFIG_ERRCOUNT, 0);
+	fnvlist_add_string(config, ZPOOL_CONFIG_HOSTNAME, "localhost");
+
+	for (t = 0; t < nb_top; t++) {
+		top[t] = make_vdev(VDEV_TYPE_RAIDZ, t, 1000 + t);
+		fnvlist_add_uint64(top[t], ZPOOL_CONFIG_NPARITY, 2);
+		fnvlist_add_uint64(top[t], ZPOOL_CONFIG_METASLAB_ARRAY, 37 + t);
+		fnvlist_add_uint64(top[t], ZPOOL_CONFIG_METASLAB_SHIFT, 34);
+		fnvlist_add_uint64(top[t], ZPOOL_CONFIG_ASHIFT, 12);
+		fnvlist_add_uint64(top[t], ZPOOL_CONFIG_ASIZE, 1ULL << 44);
+		fnvlist_add_uint64(top[t], ZPOOL_CONFIG_IS_LOG, 0);
+
+		for (c = 0; c < nb_children; c++) {
+			uint64_t guid = 100000 + t * nb_children + c;
+
+			leaf[c] = make_vdev(VDEV_TYPE_DISK, c, guid);
+			(void) snprintf(buf, sizeof (buf), "/dev/disk%d",
+			    t * nb_children + c);
+			fnvlist_add_string(leaf[c], ZPOOL_CONFIG_PATH, buf);
+			(void) snprintf(buf, sizeof (buf),
+			    "media-%016llx-0000-0000-0000-000000000000",
+			    (u_longlong_t)guid);
+			fnvlist_add_string(leaf[c], ZPOOL_CONFIG_DEVID, buf);
+			(void) snprintf(buf, sizeof (buf),
+			    "PCI0@0-SATA@1F,2-PRT%d@%d", t, c);
+			fnvlist_add_string(leaf[c], ZPOOL_CONFIG_PHYS_PATH, buf);
+			fnvlist_add_uint64(leaf[c], ZPOOL_CONFIG_WHOLE_DISK, 1);
+			fnvlist_add_uint64(leaf[c], ZPOOL_CONFIG_DTL, 200 + c);
+		}
+		fnvlist_add_nvlist_array(top[t], ZPOOL_CONFIG_CHILDREN, leaf,
+		    nb_children);
+		for (c = 0; c < nb_children; c++)
+			fnvlist_free(leaf[c]);
+	}
+	fnvlist_add_nvlist_array(root, ZPOOL_CONFIG_CHILDREN, top, nb_top);
+	fnvlist_add_nvlist(config, ZPOOL_CONFIG_VDEV_TREE, root);
+
+	for (t = 0; t < nb_top; t++)
+		fnvlist_free(top[t]);
+	fnvlist_free(root);
+	free(leaf);
+	free(top);
+
+	return (config);
+}
+
+static int
+stream_cb(void *arg, const char *buf, size_t len)
+{
+	nvlist_bench_stream_t *nbs = arg;
+
+	if (nbs->nbs_off + len > nbs->nbs_len)
+		return (ENOSPC);
+
+	bcopy(buf, nbs->nbs_buf + nbs->nbs_off, len);
+	nbs->nbs_off += len;
+	return (0);
+}
+
+/*
+ * Look up the properties zpool status reads for every vdev in the tree.
+ */
+static uint64_t
+lookup_config(nvlist_t *config)
+{
+	nvlist_t *root, **top, **leaf;
+	uint_t ntop, nleaf, nstats, t, c;
+	uint64_t *stats, sum = 0;
+
+	root = fnvlist_lookup_nvlist(config, ZPOOL_CONFIG_VDEV_TREE);
+	VERIFY0(nvlist_lookup_nvlist_array(root, ZPOOL_CONFIG_CHILDREN,
+	    &top, &ntop));
+	for (t = 0; t < ntop; t++) {
+		sum += fnvlist_lookup_uint64(top[t], ZPOOL_CONFIG_GUID);
+		VERIFY0(nvlist_lookup_uint64_array(top[t],
+		    ZPOOL_CONFIG_VDEV_STATS, &stats, &nstats));
+		sum += stats[0];
+		VERIFY0(nvlist_lookup_nvlist_array(top[t],
+		    ZPOOL_CONFIG_CHILDREN, &leaf, &nleaf));
+		for (c = 0; c < nleaf; c++) {
+			sum += fnvlist_lookup_uint64(leaf[c],
+			    ZPOOL_CONFIG_GUID);
+			sum += strlen(fnvlist_lookup_string(leaf[c],
+			    ZPOOL_CONFIG_PATH));
+			VERIFY0(nvlist_lookup_uint64_array(leaf[c],
+			    ZPOOL_CONFIG_VDEV_STATS, &stats, &nstats));
+			sum += stats[0];
+		}
+	}
+
+	return (sum);
+}
+
+static void
+report(const char *name, hrtime_t elapsed, size_t bytes)
+{
+	double secs = (double)elapsed / NANOSEC;
+
+	(void) printf("%-12s %10.0f ops/sec %10.1f MB/sec\n", name,
+	    nb_iters / secs, (double)bytes * nb_iters / secs / (1024 * 1024));
+}
+
+/*
+ * Build a flat list of n pairs and look NVLIST_BENCH_LOOKUPS of them up,
+ * returning the average cost of an add and of a lookup in nanoseconds.
+ */
+static void
+bench_flat(char **names, int n, double *add_ns, double *lookup_ns)
+{
+	nvlist_t *nvl = fnvlist_alloc();
+	hrtime_t start;
+	int i, j;
+
+	start = gethrtime();
+	for (i = 0; i < n; i++)
+		fnvlist_add_uint64(nvl, names[i], i);
+	*add_ns = (double)(gethrtime() - start) / n;
+
+	start = gethrtime();
+	for (i = 0; i < NVLIST_BENCH_LOOKUPS; i++) {
+		j = (i * 7919) % n;
+		if (fnvlist_lookup_uint64(nvl, names[j]) != j) {
+			(void) fprintf(stderr, "lookup of %s returned the "
+			    "wrong pair\n", names[j]);
+			exit(1);
+		}
+	}
+	*lookup_ns = (double)(gethrtime() - start) / NVLIST_BENCH_LOOKUPS;
+
+	fnvlist_free(nvl);
+}
+
+static void
+bench_index(void)
+{
+	uint_t hash_min = nvpair_hash_min;
+	double add[2], lookup[2];
+	char **names, buf[64];
+	int i, n;
+
+	if ((names = calloc(nb_pairs, sizeof (char *))) == NULL) {
+		perror("calloc");
+		exit(1);
+	}
+	for (i = 0; i < nb_pairs; i++) {
+		(void) snprintf(buf, sizeof (buf), "tank/fs%d@snap%d",
+		    i % 1000, i / 1000);
+		if ((names[i] = strdup(buf)) == NULL) {
+			perror("strdup");
+			exit(1);
+		}
+	}
+
+	(void) printf("\n%8s %12s %12s %12s %12s\n", "pairs", "add ns",
+	    "indexed", "lookup ns", "indexed");
+	for (n = 1; n <= nb_pairs; n *= 2) {
+		nvpair_hash_min = UINT_MAX;
+		bench_flat(names, n, &add[0], &lookup[0]);
+		nvpair_hash_min = 1;
+		bench_flat(names, n, &add[1], &lookup[1]);
+		(void) printf("%8d %12.0f %12.0f %12.0f %12.0f\n", n,
+		    add[0], add[1], lookup[0], lookup[1]);
+	}
+	nvpair_hash_min = hash_min;
+
+	for (i = 0; i < nb_pairs; i++)
+		free(names[i]);
+	free(names);
+}
+
+int
+main(int argc, char **argv)
+{
+	nvlist_bench_stream_t nbs;
+	nvlist_t *config, *unpacked;
+	char *packed = NULL, *chunk;
+	size_t size, len;
+	uint64_t sum = 0;
+	hrtime_t start;
+	int c, i;
+
+	while ((c = getopt(argc, argv, "t:c:i:n:")) != -1) {
+		switch (c) {
+		case 't':
+			nb_top = atoi(optarg);
+			break;
+		case 'c':
+			nb_children = atoi(optarg);
+			break;
+		case 'i':
+			nb_iters = atoi(optarg);
+			break;
+		case 'n':
+			nb_pairs = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (nb_top <= 0 || nb_children <= 0 || nb_iters <= 0 || nb_pairs <= 0)
+		usage();
+
+	config = make_config();
+	size = fnvlist_size(config);
+	(void) printf("config: %d top-level vdevs of %d disks, %llu bytes "
+	    "packed, %d iterations\n", nb_top, nb_children,
+	    (u_longlong_t)size, nb_iters);
+
+	chunk = malloc(NVLIST_BENCH_CHUNK);
+	nbs.nbs_buf = malloc(size);
+	nbs.nbs_len = size;
+	if (chunk == NULL || nbs.nbs_buf == NULL) {
+		perror("malloc");
+		return (1);
+	}
+
+	/* The streamed encoding must match nvlist_pack() byte for byte. */
+	packed = fnvlist_pack(config, &len);
+	nbs.nbs_off = 0;
+	if (nvlist_pack_stream(config, chunk, NVLIST_BENCH_CHUNK, stream_cb,
+	    &nbs) != 0 || nbs.nbs_off != len ||
+	    bcmp(packed, nbs.nbs_buf, len) != 0) {
+		(void) fprintf(stderr, "nvlist_pack_stream() output differs "
+		    "from nvlist_pack()\n");
+		return (1);
+	}
+
+	start = gethrtime();
+	for (i = 0; i < nb_iters; i++)
+		(void) fnvlist_size(config);
+	report("size", gethrtime() - start, size);
+
+	start = gethrtime();
+	for (i = 0; i < nb_iters; i++) {
+		char *buf = fnvlist_pack(config, &len);
+		fnvlist_pack_free(buf, len);
+	}
+	report("pack", gethrtime() - start, size);
+
+	start = gethrtime();
+	for (i = 0; i < nb_iters; i++) {
+		nbs.nbs_off = 0;
+		VERIFY0(nvlist_pack_stream(config, chunk, NVLIST_BENCH_CHUNK,
+		    stream_cb, &nbs));
+	}
+	report("pack_stream", gethrtime() - start, size);
+
+	start = gethrtime();
+	for (i = 0; i < nb_iters; i++) {
+		unpacked = fnvlist_unpack(packed, len);
+		fnvlist_free(unpacked);
+	}
+	report("unpack", gethrtime() - start, size);
+
+	unpacked = fnvlist_unpack(packed, len);
+	start = gethrtime();
+	for (i = 0; i < nb_iters; i++)
+		sum += lookup_config(unpacked);
+	report("lookup", gethrtime() - start, size);
+	fnvlist_free(unpacked);
+
+	fnvlist_pack_free(packed, len);
+	free(nbs.nbs_buf);
+	free(chunk);
+	fnvlist_free(config);
+
+	bench_index();
+
+	return (sum == 0);
+}
@@ -43,6 +43,17 @@
 typedef enum boolean { B_FALSE, B_TRUE } boolean_t;
 typedef	unsigned long long	u_longlong_t;
 
+extern void sha2_impl_init(void);
+extern int sha2_impl_set(const char *);
+
+/*
+ * Block transform implementations to test.  Those that are not compiled in
+ * or not supported by this CPU are skipped.
+ */
+static const char *sha2_impls[] = { "generic", "x86_64", "shani" };
+
+#define	SHA2_CROSS_SIZE	(128 * 1024 + 37)
+
 
 /*
  * Test messages from:
@@ -192,10 +203,19 @@ main(int argc, char *argv[])
 {
 	boolean_t	failed = B_FALSE;
 	uint64_t	cpu_mhz = 0;
+	uint8_t		*crossbuf;
+	size_t		impl, i;
 
 	if (argc == 2)
 		cpu_mhz = atoi(argv[1]);
 
+	/* fill the cross-implementation buffer with a repeatable pattern */
+	crossbuf = malloc(SHA2_CROSS_SIZE);
+	if (crossbuf == NULL)
+		return (1);
+	for (i = 0; i < SHA2_CROSS_SIZE; i++)
+		crossbuf[i] = (uint8_t)((i * 2654435761U) >> 13);
+
 #define	SHA2_ALGO_TEST(_m, mode, diglen, testdigest)			\
 	do {								\
 		SHA2_CTX		ctx;				\
@@ -214,6 +234,41 @@ main(int argc, char *argv[])
 		NOTE(CONSTCOND)						\
 	} while (0)
 
+/*
+ * Hash an unaligned buffer in uneven pieces, so both the buffered and the
+ * multi-block paths of SHA2Update() are used, and compare the digest with
+ * the one computed by the generic implementation in a single update.
+ */
+#define	SHA2_CROSS_TEST(mode, diglen)					\
+	do {								\
+		SHA2_CTX	ctx;					\
+		uint8_t		digest[diglen / 8];			\
+		uint8_t		refdigest[diglen / 8];			\
+		size_t		off, len;				\
+		(void) sha2_impl_set("generic");			\
+		SHA2Init(SHA ## mode ## _MECH_INFO_TYPE, &ctx);		\
+		SHA2Update(&ctx, crossbuf + 1, SHA2_CROSS_SIZE - 1);	\
+		SHA2Final(refdigest, &ctx);				\
+		(void) sha2_impl_set(sha2_impls[impl]);			\
+		SHA2Init(SHA ## mode ## _MECH_INFO_TYPE, &ctx);		\
+		for (off = 1, len = 1; off < SHA2_CROSS_SIZE;		\
+		    off += len, len = len * 3 + 7) {			\
+			if (len > SHA2_CROSS_SIZE - off)		\
+				len = SHA2_CROSS_SIZE - off;		\
+			SHA2Update(&ctx, crossbuf + off, len);		\
+		}							\
+		SHA2Final(digest, &ctx);				\
+		(void) printf("SHA%-9s%u bytes\tResult: ", #mode,	\
+		    (unsigned)(SHA2_CROSS_SIZE - 1));			\
+		if (bcmp(digest, refdigest, diglen / 8) == 0) {		\
+			(void) printf("OK\n");				\
+		} else {						\
+			(void) printf("FAILED!\n");			\
+			failed = B_TRUE;				\
+		}							\
+		NOTE(CONSTCOND)						\
+	} while (0)
+
 #define	SHA2_PERF_TEST(mode, diglen)					\
 	do {								\
 		SHA2_CTX	ctx;					\
@@ -241,25 +296,52 @@ main(int argc, char *argv[])
 		NOTE(CONSTCOND)						\
 	} while (0)
 
-	(void) printf("Running algorithm correctness tests:\n");
-	SHA2_ALGO_TEST(test_msg0, 256, 256, sha256_test_digests[0]);
-	SHA2_ALGO_TEST(test_msg1, 256, 256, sha256_test_digests[1]);
-	SHA2_ALGO_TEST(test_msg0, 384, 384, sha384_test_digests[0]);
-	SHA2_ALGO_TEST(test_msg2, 384, 384, sha384_test_digests[2]);
-	SHA2_ALGO_TEST(test_msg0, 512, 512, sha512_test_digests[0]);
-	SHA2_ALGO_TEST(test_msg2, 512, 512, sha512_test_digests[2]);
-	SHA2_ALGO_TEST(test_msg0, 512_224, 224, sha512_224_test_digests[0]);
-	SHA2_ALGO_TEST(test_msg2, 512_224, 224, sha512_224_test_digests[2]);
-	SHA2_ALGO_TEST(test_msg0, 512_256, 256, sha512_256_test_digests[0]);
-	SHA2_ALGO_TEST(test_msg2, 512_256, 256, sha512_256_test_digests[2]);
+	sha2_impl_init();
+
+	for (impl = 0; impl < sizeof (sha2_impls) / sizeof (char *); impl++) {
+		if (sha2_impl_set(sha2_impls[impl]) != 0) {
+			(void) printf("Skipping %s implementation: not "
+			    "supported\n", sha2_impls[impl]);
+			continue;
+		}
+
+		(void) printf("Running algorithm correctness tests (%s):\n",
+		    sha2_impls[impl]);
+		SHA2_ALGO_TEST(test_msg0, 256, 256, sha256_test_digests[0]);
+		SHA2_ALGO_TEST(test_msg1, 256, 256, sha256_test_digests[1]);
+		SHA2_ALGO_TEST(test_msg0, 384, 384, sha384_test_digests[0]);
+		SHA2_ALGO_TEST(test_msg2, 384, 384, sha384_test_digests[2]);
+		SHA2_ALGO_TEST(test_msg0, 512, 512, sha512_test_digests[0]);
+		SHA2_ALGO_TEST(test_msg2, 512, 512, sha512_test_digests[2]);
+		SHA2_ALGO_TEST(test_msg0, 512_224, 224,
+		    sha512_224_test_digests[0]);
+		SHA2_ALGO_TEST(test_msg2, 512_224, 224,
+		    sha512_224_test_digests[2]);
+		SHA2_ALGO_TEST(test_msg0, 512_256, 256,
+		    sha512_256_test_digests[0]);
+		SHA2_ALGO_TEST(test_msg2, 512_256, 256,
+		    sha512_256_test_digests[2]);
+
+		(void) printf("Running cross-implementation tests (%s):\n",
+		    sha2_impls[impl]);
+		SHA2_CROSS_TEST(256, 256);
+		SHA2_CROSS_TEST(512, 512);
+	}
+
+	free(crossbuf);
 
 	if (failed)
 		return (1);
 
-	(void) printf("Running performance tests (hashing 1024 MiB of "
-	    "data):\n");
-	SHA2_PERF_TEST(256, 256);
-	SHA2_PERF_TEST(512, 512);
+	for (impl = 0; impl < sizeof (sha2_impls) / sizeof (char *); impl++) {
+		if (sha2_impl_set(sha2_impls[impl]) != 0)
+			continue;
+
+		(void) printf("Running performance tests (%s, hashing "
+		    "1024 MiB of data):\n", sha2_impls[impl]);
+		SHA2_PERF_TEST(256, 256);
+		SHA2_PERF_TEST(512, 512);
+	}
 
 	return (0);
 }
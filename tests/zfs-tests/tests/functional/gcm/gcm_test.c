@@ -0,0 +1,359 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <sys/crypto/icp.h>
+#include <sys/crypto/api.h>
+
+#define	NELEMS(x)  (sizeof (x) / sizeof ((x)[0]))
+
+#define	GCM_TAG_LEN		16
+#define	GCM_IV_LEN		12
+#define	GCM_RANDOM_SIZE		(128 * 1024)
+
+/* from module/icp/algs/modes/gcm.c */
+extern int gcm_impl_set(const char *);
+
+/*
+ * Byte arrays are given as char pointers so that they
+ * can be specified as strings.
+ */
+typedef struct gcm_tv {
+	/* test vector input values */
+	char		*key;
+	char		*iv;
+	char		*aad;
+	uint_t		aad_len;
+	char		*pt;
+	uint_t		pt_len;
+
+	/* expected output */
+	char		*ct;
+	char		*tag;
+} gcm_tv_t;
+
+/*
+ * Test cases 1 - 4 (AES-128, 96-bit IV) from "The Galois/Counter Mode of
+ * Operation (GCM)", McGrew and Viega.
+ */
+static gcm_tv_t test_vectors[] = {
+	{
+		.key =	"\x00\x00\x00\x00\x00\x00\x00\x00"
+			"\x00\x00\x00\x00\x00\x00\x00\x00",
+		.iv =	"\x00\x00\x00\x00\x00\x00\x00\x00"
+			"\x00\x00\x00\x00",
+		.aad =	NULL,
+		.aad_len = 0,
+		.pt =	NULL,
+		.pt_len = 0,
+		.ct =	NULL,
+		.tag =	"\x58\xe2\xfc\xce\xfa\x7e\x30\x61"
+			"\x36\x7f\x1d\x57\xa4\xe7\x45\x5a",
+	},
+	{
+		.key =	"\x00\x00\x00\x00\x00\x00\x00\x00"
+			"\x00\x00\x00\x00\x00\x00\x00\x00",
+		.iv =	"\x00\x00\x00\x00\x00\x00\x00\x00"
+			"\x00\x00\x00\x00",
+		.aad =	NULL,
+		.aad_len = 0,
+		.pt =	"\x00\x00\x00\x00\x00\x00\x00\x00"
+			"\x00\x00\x00\x00\x00\x00\x00\x00",
+		.pt_len = 16,
+		.ct =	"\x03\x88\xda\xce\x60\xb6\xa3\x92"
+			"\xf3\x28\xc2\xb9\x71\xb2\xfe\x78",
+		.tag =	"\xab\x6e\x47\xd4\x2c\xec\x13\xbd"
+			"\xf5\x3a\x67\xb2\x12\x57\xbd\xdf",
+	},
+	{
+		.key =	"\xfe\xff\xe9\x92\x86\x65\x73\x1c"
+			"\x6d\x6a\x8f\x94\x67\x30\x83\x08",
+		.iv =	"\xca\xfe\xba\xbe\xfa\xce\xdb\xad"
+			"\xde\xca\xf8\x88",
+		.aad =	NULL,
+		.aad_len = 0,
+		.pt =	"\xd9\x31\x32\x25\xf8\x84\x06\xe5"
+			"\xa5\x59\x09\xc5\xaf\xf5\x26\x9a"
+			"\x86\xa7\xa9\x53\x15\x34\xf7\xda"
+			"\x2e\x4c\x30\x3d\x8a\x31\x8a\x72"
+			"\x1c\x3c\x0c\x95\x95\x68\x09\x53"
+			"\x2f\xcf\x0e\x24\x49\xa6\xb5\x25"
+			"\xb1\x6a\xed\xf5\xaa\x0d\xe6\x57"
+			"\xba\x63\x7b\x39\x1a\xaf\xd2\x55",
+		.pt_len = 64,
+		.ct =	"\x42\x83\x1e\xc2\x21\x77\x74\x24"
+			"\x4b\x72\x21\xb7\x84\xd0\xd4\x9c"
+			"\xe3\xaa\x21\x2f\x2c\x02\xa4\xe0"
+			"\x35\xc1\x7e\x23\x29\xac\xa1\x2e"
+			"\x21\xd5\x14\xb2\x54\x66\x93\x1c"
+			"\x7d\x8f\x6a\x5a\xac\x84\xaa\x05"
+			"\x1b\xa3\x0b\x39\x6a\x0a\xac\x97"
+			"\x3d\x58\xe0\x91\x47\x3f\x59\x85",
+		.tag =	"\x4d\x5c\x2a\xf3\x27\xcd\x64\xa6"
+			"\x2c\xf3\x5a\xbd\x2b\xa6\xfa\xb4",
+	},
+	{
+		.key =	"\xfe\xff\xe9\x92\x86\x65\x73\x1c"
+			"\x6d\x6a\x8f\x94\x67\x30\x83\x08",
+		.iv =	"\xca\xfe\xba\xbe\xfa\xce\xdb\xad"
+			"\xde\xca\xf8\x88",
+		.aad =	"\xfe\xed\xfa\xce\xde\xad\xbe\xef"
+			"\xfe\xed\xfa\xce\xde\xad\xbe\xef"
+			"\xab\xad\xda\xd2",
+		.aad_len = 20,
+		.pt =	"\xd9\x31\x32\x25\xf8\x84\x06\xe5"
+			"\xa5\x59\x09\xc5\xaf\xf5\x26\x9a"
+			"\x86\xa7\xa9\x53\x15\x34\xf7\xda"
+			"\x2e\x4c\x30\x3d\x8a\x31\x8a\x72"
+			"\x1c\x3c\x0c\x95\x95\x68\x09\x53"
+			"\x2f\xcf\x0e\x24\x49\xa6\xb5\x25"
+			"\xb1\x6a\xed\xf5\xaa\x0d\xe6\x57"
+			"\xba\x63\x7b\x39",
+		.pt_len = 60,
+		.ct =	"\x42\x83\x1e\xc2\x21\x77\x74\x24"
+			"\x4b\x72\x21\xb7\x84\xd0\xd4\x9c"
+			"\xe3\xaa\x21\x2f\x2c\x02\xa4\xe0"
+			"\x35\xc1\x7e\x23\x29\xac\xa1\x2e"
+			"\x21\xd5\x14\xb2\x54\x66\x93\x1c"
+			"\x7d\x8f\x6a\x5a\xac\x84\xaa\x05"
+			"\x1b\xa3\x0b\x39\x6a\x0a\xac\x97"
+			"\x3d\x58\xe0\x91",
+		.tag =	"\x5b\xc9\x4f\xbc\x32\x21\xa5\xdb"
+			"\x94\xfa\xe9\x5a\xe7\x12\x1a\x47",
+	},
+};
+
+static char *gcm_impls[] = {
+	"generic",
+	"pclmulqdq",
+};
+
+static void
+hexdump(char *str, uint8_t *src, uint_t len)
+{
+	int i;
+
+	printf("\t%s\t", str);
+	for (i = 0; i < len; i++) {
+		printf("%02x", src[i] & 0xff);
+	}
+	printf("\n");
+}
+
+static void
+gcm_setup(crypto_mechanism_t *mech, CK_AES_GCM_PARAMS *gcmp,
+    crypto_key_t *key, uint8_t *keydata, uint8_t *iv, uint8_t *aad,
+    uint_t aad_len)
+{
+	gcmp->pIv = iv;
+	gcmp->ulIvLen = GCM_IV_LEN;
+	gcmp->ulIvBits = CRYPTO_BYTES2BITS(GCM_IV_LEN);
+	gcmp->pAAD = aad;
+	gcmp->ulAADLen = aad_len;
+	gcmp->ulTagBits = CRYPTO_BYTES2BITS(GCM_TAG_LEN);
+
+	mech->cm_type = crypto_mech2id(SUN_CKM_AES_GCM);
+	mech->cm_param = (char *)gcmp;
+	mech->cm_param_len = sizeof (CK_AES_GCM_PARAMS);
+
+	key->ck_format = CRYPTO_KEY_RAW;
+	key->ck_data = keydata;
+	key->ck_length = CRYPTO_BYTES2BITS(16);
+}
+
+static void
+gcm_data(crypto_data_t *cd, uint8_t *buf, uint_t len)
+{
+	bzero(cd, sizeof (*cd));
+	cd->cd_format = CRYPTO_DATA_RAW;
+	cd->cd_offset = 0;
+	cd->cd_length = len;
+	cd->cd_raw.iov_base = (char *)buf;
+	cd->cd_raw.iov_len = len;
+}
+
+/*
+ * Encrypt 'pt' into 'ct' (which has room for the appended tag), then
+ * decrypt it again into 'rt'.
+ */
+static int
+gcm_roundtrip(uint8_t *keydata, uint8_t *iv, uint8_t *aad, uint_t aad_len,
+    uint8_t *pt, uint_t pt_len, uint8_t *ct, uint8_t *rt)
+{
+	crypto_mechanism_t mech;
+	CK_AES_GCM_PARAMS gcmp;
+	crypto_key_t key;
+	crypto_data_t pd, cd;
+	int ret;
+
+	gcm_setup(&mech, &gcmp, &key, keydata, iv, aad, aad_len);
+	gcm_data(&pd, pt, pt_len);
+	gcm_data(&cd, ct, pt_len + GCM_TAG_LEN);
+
+	ret = crypto_encrypt(&mech, &pd, &key, NULL, &cd, NULL);
+	if (ret != CRYPTO_SUCCESS) {
+		printf("encryption failed with error code %d\n", ret);
+		return (1);
+	}
+
+	gcm_setup(&mech, &gcmp, &key, keydata, iv, aad, aad_len);
+	gcm_data(&cd, ct, pt_len + GCM_TAG_LEN);
+	gcm_data(&pd, rt, pt_len);
+
+	ret = crypto_decrypt(&mech, &cd, &key, NULL, &pd, NULL);
+	if (ret != CRYPTO_SUCCESS) {
+		printf("decryption failed with error code %d\n", ret);
+		return (1);
+	}
+
+	if (bcmp(pt, rt, pt_len) != 0) {
+		printf("decrypted data does not match plaintext\n");
+		return (1);
+	}
+
+	return (0);
+}
+
+static int
+run_test(char *impl, int i, gcm_tv_t *tv)
+{
+	uint8_t ct[128 + GCM_TAG_LEN], rt[128];
+
+	printf("TEST %s %d:\t", impl, i);
+
+	if (gcm_roundtrip((uint8_t *)tv->key, (uint8_t *)tv->iv,
+	    (uint8_t *)tv->aad, tv->aad_len, (uint8_t *)tv->pt, tv->pt_len,
+	    ct, rt) != 0)
+		return (1);
+
+	if (tv->pt_len > 0 && bcmp(ct, tv->ct, tv->pt_len) != 0) {
+		printf("Ciphertext Mismatch\n");
+		hexdump("Expected:", (uint8_t *)tv->ct, tv->pt_len);
+		hexdump("Actual:  ", ct, tv->pt_len);
+		return (1);
+	}
+
+	if (bcmp(ct + tv->pt_len, tv->tag, GCM_TAG_LEN) != 0) {
+		printf("Tag Mismatch\n");
+		hexdump("Expected:", (uint8_t *)tv->tag, GCM_TAG_LEN);
+		hexdump("Actual:  ", ct + tv->pt_len, GCM_TAG_LEN);
+		return (1);
+	}
+
+	printf("Passed\n");
+
+	return (0);
+}
+
+/*
+ * Encrypt a large random buffer, with a length that is not a multiple of
+ * the block size, with every implementation and check that they all
+ * produce the same ciphertext and tag.
+ */
+static int
+run_random_test(void)
+{
+	uint8_t keydata[16], iv[GCM_IV_LEN], aad[40];
+	uint8_t *pt, *rt, *ct, *ct_ref;
+	uint_t len = GCM_RANDOM_SIZE - 5;
+	int i, ret = 0, nimpls = 0;
+
+	pt = malloc(GCM_RANDOM_SIZE);
+	rt = malloc(GCM_RANDOM_SIZE);
+	ct = malloc(GCM_RANDOM_SIZE + GCM_TAG_LEN);
+	ct_ref = malloc(GCM_RANDOM_SIZE + GCM_TAG_LEN);
+	if (pt == NULL || rt == NULL || ct == NULL || ct_ref == NULL) {
+		ret = 1;
+		goto out;
+	}
+
+	srandom(0x5eed);
+	for (i = 0; i < sizeof (keydata); i++)
+		keydata[i] = random();
+	for (i = 0; i < sizeof (iv); i++)
+		iv[i] = random();
+	for (i = 0; i < sizeof (aad); i++)
+		aad[i] = random();
+	for (i = 0; i < len; i++)
+		pt[i] = random();
+
+	for (i = 0; i < NELEMS(gcm_impls); i++) {
+		if (gcm_impl_set(gcm_impls[i]) != 0)
+			continue;
+
+		printf("TEST %s random:\t", gcm_impls[i]);
+
+		if (gcm_roundtrip(keydata, iv, aad, sizeof (aad), pt, len,
+		    nimpls == 0 ? ct_ref : ct, rt) != 0) {
+			ret = 1;
+			break;
+		}
+
+		if (nimpls > 0 &&
+		    bcmp(ct, ct_ref, len + GCM_TAG_LEN) != 0) {
+			printf("Mismatch against %s\n", gcm_impls[0]);
+			ret = 1;
+			break;
+		}
+
+		printf("Passed\n");
+		nimpls++;
+	}
+
+out:
+	free(pt);
+	free(rt);
+	free(ct);
+	free(ct_ref);
+
+	return (ret);
+}
+
+int
+main(int argc, char **argv)
+{
+	int ret = 0, i, j;
+
+	icp_init();
+
+	for (j = 0; j < NELEMS(gcm_impls) && ret == 0; j++) {
+		/* skip implementations this cpu does not support */
+		if (gcm_impl_set(gcm_impls[j]) != 0)
+			continue;
+
+		for (i = 0; i < NELEMS(test_vectors); i++) {
+			ret = run_test(gcm_impls[j], i, &test_vectors[i]);
+			if (ret != 0)
+				break;
+		}
+	}
+
+	if (ret == 0)
+		ret = run_random_test();
+
+	(void) gcm_impl_set("fastest");
+
+	icp_fini();
+
+	if (ret == 0) {
+		printf("All tests passed successfully.\n");
+		return (0);
+	} else {
+		printf("Test failed.\n");
+		return (1);
+	}
+}